@@ -950,7 +950,7 @@ typedef struct {
 } sound_state_node, *sound_state_type;
 
 
-int nyx_get_audio(nyx_audio_callback callback, void *userdata)
+int nyx_get_audio(nyx_audio_put_callback callback, void *userdata)
 {
    sound_state_type states;  // tracks progress reading multiple channels
    float *buffer = NULL;     // samples to push to callback
@@ -1086,14 +1086,22 @@ int nyx_get_audio(nyx_audio_callback callback, void *userdata)
       for (ch = 0; ch < num_channels; ch++) {
          sound_state_type state = &states[ch];
          sound_type snd = getsound(getelement(nyx_result, ch));
-         // Copy and scale the samples
-         for (int i = 0; i < togo; i++) {
-            buffer[i] = *(state->samps++) * (float) snd->scale;
+         const float *out = buffer;
+         if (snd->scale == 1.0) {
+            // Unscaled samples are given straight from the sample block
+            out = state->samps;
+            state->samps += togo;
+         }
+         else {
+            // Copy and scale the samples
+            for (int i = 0; i < togo; i++) {
+               buffer[i] = *(state->samps++) * (float) snd->scale;
+            }
          }
          state->cnt -= togo;
          // TODO: What happens here when we don't know the total length,
          // i.e. nyx_input_length == 0? Should we pass total+togo instead?
-         result = callback(buffer, ch, total, togo, nyx_input_length, userdata);
+         result = callback(out, ch, total, togo, nyx_input_length, userdata);
          if (result != 0) {
             result = -1;
             break;
@@ -39,6 +39,14 @@ extern "C"
                                      int64_t totlen,
                                      void *userdata);
 
+   /* The buffer may be a sample block of Nyquist, which must not be
+    * modified; should return 0 for success, -1 for error */
+   typedef int (*nyx_audio_put_callback)(const float *buffer,
+                                         int channel,
+                                         int64_t start, int64_t len,
+                                         int64_t totlen,
+                                         void *userdata);
+
    typedef void (*nyx_output_callback)(int c,
                                        void *userdata);
 
@@ -75,7 +83,8 @@ extern "C"
     * Nyquist returns an array of samples (which we can't handle)
     */
    int         nyx_get_audio_num_channels();
-   int         nyx_get_audio(nyx_audio_callback callback,
+
+   int         nyx_get_audio(nyx_audio_put_callback callback,
                              void *userdata);
 
    int         nyx_get_int();
@@ -0,0 +1,179 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: TaskPool.cpp
+ */
+
+#include "TaskPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace audacity::concurrency
+{
+namespace
+{
+// Chunks per participating thread, so the threads finishing early can help
+constexpr size_t ChunksPerThread = 4;
+} // namespace
+
+struct TaskPool::Job final
+{
+   Job(const RangeFunction& function, size_t count, size_t chunkSize,
+       size_t chunksCount)
+       : function { function }
+       , count { count }
+       , chunkSize { chunkSize }
+       , chunksCount { chunksCount }
+   {
+   }
+
+   const RangeFunction& function;
+   const size_t count;
+   const size_t chunkSize;
+   const size_t chunksCount;
+
+   std::atomic<size_t> nextChunk { 0 };
+   std::atomic<bool> failed { false };
+
+   std::mutex mutex;
+   std::condition_variable finished;
+   size_t doneChunks { 0 };
+   std::exception_ptr exception;
+};
+
+TaskPool& TaskPool::Get()
+{
+   static TaskPool pool;
+   return pool;
+}
+
+TaskPool::TaskPool(size_t workersCount)
+{
+   if (workersCount == 0)
+      workersCount =
+         std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+   mThreads.reserve(workersCount);
+   for (size_t i = 0; i < workersCount; ++i)
+      mThreads.emplace_back([this] { WorkerThread(); });
+}
+
+TaskPool::~TaskPool()
+{
+   {
+      std::lock_guard lock { mMutex };
+      mStopping = true;
+   }
+   mCondition.notify_all();
+
+   for (auto& thread : mThreads)
+      thread.join();
+}
+
+size_t TaskPool::GetWorkersCount() const noexcept
+{
+   return mThreads.size();
+}
+
+void TaskPool::ParallelFor(
+   size_t count, size_t minChunkSize, const RangeFunction& function)
+{
+   if (count == 0)
+      return;
+
+   const auto threadsCount = mThreads.size() + 1;
+   const auto chunkSize = std::max(
+      { minChunkSize, size_t { 1 },
+        (count + threadsCount * ChunksPerThread - 1) /
+           (threadsCount * ChunksPerThread) });
+   const auto chunksCount = (count + chunkSize - 1) / chunkSize;
+
+   if (chunksCount == 1 || mThreads.empty())
+   {
+      function(0, count);
+      return;
+   }
+
+   auto job = std::make_shared<Job>(function, count, chunkSize, chunksCount);
+
+   {
+      std::lock_guard lock { mMutex };
+      mJobs.push_back(job);
+   }
+   mCondition.notify_all();
+
+   Participate(*job);
+
+   {
+      std::unique_lock lock { job->mutex };
+      job->finished.wait(
+         lock, [&] { return job->doneChunks == job->chunksCount; });
+   }
+
+   if (job->exception)
+      std::rethrow_exception(job->exception);
+}
+
+void TaskPool::WorkerThread()
+{
+   while (true)
+   {
+      std::shared_ptr<Job> job;
+      {
+         std::unique_lock lock { mMutex };
+         mCondition.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+
+         if (mStopping)
+            return;
+
+         job = mJobs.front();
+
+         // All chunks are taken, nobody else needs to find the job
+         if (job->nextChunk.load(std::memory_order_relaxed) >= job->chunksCount)
+         {
+            mJobs.pop_front();
+            continue;
+         }
+      }
+
+      Participate(*job);
+
+      std::lock_guard lock { mMutex };
+      if (!mJobs.empty() && mJobs.front() == job)
+         mJobs.pop_front();
+   }
+}
+
+void TaskPool::Participate(Job& job)
+{
+   while (true)
+   {
+      const auto chunk = job.nextChunk.fetch_add(1);
+      if (chunk >= job.chunksCount)
+         return;
+
+      if (!job.failed.load(std::memory_order_relaxed))
+      {
+         const auto begin = chunk * job.chunkSize;
+         const auto end = std::min(begin + job.chunkSize, job.count);
+
+         try
+         {
+            job.function(begin, end);
+         }
+         catch (...)
+         {
+            std::lock_guard lock { job.mutex };
+            if (!job.exception)
+               job.exception = std::current_exception();
+            job.failed = true;
+         }
+      }
+
+      std::lock_guard lock { job.mutex };
+      if (++job.doneChunks == job.chunksCount)
+         job.finished.notify_all();
+   }
+}
+} // namespace audacity::concurrency
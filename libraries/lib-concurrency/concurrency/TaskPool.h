@@ -0,0 +1,65 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ * SPDX-FileName: TaskPool.h
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace audacity::concurrency
+{
+//! A process-wide pool of worker threads for data parallel computations
+/*!
+ ParallelFor splits a range of indices into chunks which the workers and the
+ calling thread process concurrently.  The calling thread always takes part,
+ so ParallelFor may be nested, or called from a worker, without deadlocking.
+ */
+class CONCURRENCY_API TaskPool final
+{
+public:
+   //! Processes the indices in [begin, end)
+   using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+   static TaskPool& Get();
+
+   //! Creates the given number of workers; 0 means the hardware concurrency minus one
+   explicit TaskPool(size_t workersCount = 0);
+   ~TaskPool();
+
+   TaskPool(const TaskPool&)            = delete;
+   TaskPool& operator=(const TaskPool&) = delete;
+
+   size_t GetWorkersCount() const noexcept;
+
+   //! Calls function on consecutive chunks of [0, count) and waits for all of them
+   /*!
+    Each chunk has at least minChunkSize indices, except maybe the last one.
+    Chunks are processed in no particular order, possibly concurrently.  If
+    function throws, the remaining chunks are skipped and the first exception
+    is rethrown to the caller, once no chunk is running.
+    */
+   void ParallelFor(
+      size_t count, size_t minChunkSize, const RangeFunction& function);
+
+private:
+   struct Job;
+
+   void WorkerThread();
+   //! Processes the chunks of the job until there are none left
+   static void Participate(Job& job);
+
+   std::mutex mMutex;
+   std::condition_variable mCondition;
+   std::deque<std::shared_ptr<Job>> mJobs;
+   std::vector<std::thread> mThreads;
+   bool mStopping { false };
+};
+} // namespace audacity::concurrency
@@ -30,6 +30,168 @@
 #include "WaveTrack.h"
 #include "WaveTrackSink.h"
 #include "WideSampleSource.h"
+#include "concurrency/TaskPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+BoolSetting ConcurrentTrackProcessing{
+   L"/Effects/ConcurrentTrackProcessing", true };
+
+namespace {
+using namespace std::chrono_literals;
+
+//! How often the serving thread reports progress while tasks run
+constexpr auto PollInterval = 50ms;
+
+//! Lets tasks on worker threads have their sinks acquired on the thread that
+//! serves them, one sink at a time
+/*!
+ So sinks that write to tracks need not be thread-safe, and a track is never
+ written while the task reading it runs.
+ */
+class SinkDispatcher final {
+public:
+   //! Called by the thread of a task; waits until Serve() did sink.Acquire()
+   bool Acquire(AudioGraph::Sink &sink, AudioGraph::Buffers &data)
+   {
+      Request request{ sink, data };
+      std::unique_lock lock{ mMutex };
+      mRequests.push_back(&request);
+      mRequested.notify_one();
+      mServed.wait(lock, [&]{ return request.result.has_value(); });
+      return *request.result;
+   }
+
+   //! Serves Acquire() until Finish(), and calls poll now and then
+   /*!
+    Does not throw; an exception of a sink or of poll cancels the tasks, and
+    RethrowException() rethrows it later.
+    @param poll returns false to cancel the tasks
+    */
+   void Serve(const std::function<bool()> &poll)
+   {
+      std::unique_lock lock{ mMutex };
+      while (true) {
+         mRequested.wait_for(lock, PollInterval,
+            [this]{ return mFinished || !mRequests.empty(); });
+         while (!mRequests.empty()) {
+            const auto pRequest = mRequests.front();
+            mRequests.pop_front();
+            lock.unlock();
+            bool result = false;
+            try {
+               result = pRequest->sink.Acquire(pRequest->data);
+            }
+            catch (...) {
+               Fail(std::current_exception());
+            }
+            lock.lock();
+            pRequest->result = result;
+            mServed.notify_all();
+         }
+         if (mFinished)
+            return;
+         lock.unlock();
+         try {
+            if (!poll())
+               Cancel();
+         }
+         catch (...) {
+            Fail(std::current_exception());
+         }
+         lock.lock();
+      }
+   }
+
+   //! Called when no task will call Acquire() again
+   void Finish()
+   {
+      std::lock_guard lock{ mMutex };
+      mFinished = true;
+      mRequested.notify_one();
+   }
+
+   void Cancel() { mCancelled.store(true, std::memory_order_relaxed); }
+   bool IsCancelled() const
+   {
+      return mCancelled.load(std::memory_order_relaxed);
+   }
+
+   void RethrowException()
+   {
+      if (mException)
+         std::rethrow_exception(mException);
+   }
+
+private:
+   struct Request {
+      AudioGraph::Sink &sink;
+      AudioGraph::Buffers &data;
+      std::optional<bool> result;
+   };
+
+   //! Called on the serving thread only
+   void Fail(std::exception_ptr pException)
+   {
+      if (!mException)
+         mException = pException;
+      Cancel();
+   }
+
+   std::mutex mMutex;
+   std::condition_variable mRequested;
+   std::condition_variable mServed;
+   std::deque<Request*> mRequests;
+   bool mFinished{ false };
+   std::atomic<bool> mCancelled{ false };
+   std::exception_ptr mException;
+};
+
+//! Sink for a task on a worker thread, deferring to another sink on the
+//! serving thread of a SinkDispatcher
+/*!
+ Acquire() is deferred only when the buffers lack room for another block, the
+ only case in which a WaveTrackSink does more than report its status, which
+ does not change meanwhile.  Release() is called directly.
+ */
+class DeferredSink final : public AudioGraph::Sink {
+public:
+   DeferredSink(SinkDispatcher &dispatcher, AudioGraph::Sink &sink)
+      : mDispatcher{ dispatcher }, mSink{ sink }
+   {}
+
+   bool AcceptsBuffers(const Buffers &buffers) const override
+   {
+      return mSink.AcceptsBuffers(buffers);
+   }
+
+   bool Acquire(Buffers &data) override
+   {
+      if (mDispatcher.IsCancelled())
+         return false;
+      if (data.BlockSize() <= data.Remaining())
+         // post is satisfied
+         return true;
+      return mDispatcher.Acquire(mSink, data);
+   }
+
+   bool Release(const Buffers &data, size_t curBlockSize) override
+   {
+      return mSink.Release(data, curBlockSize);
+   }
+
+private:
+   SinkDispatcher &mDispatcher;
+   AudioGraph::Sink &mSink;
+};
+}
 
 PerTrackEffect::Instance::~Instance() = default;
 
@@ -49,8 +211,43 @@ bool PerTrackEffect::Instance::ProcessFinalize() noexcept
    return true;
 }
 
+bool PerTrackEffect::Instance::CanProcessConcurrently() const
+{
+   return false;
+}
+
 PerTrackEffect::~PerTrackEffect() = default;
 
+bool PerTrackEffect::ProcessesConcurrently() const
+{
+   return false;
+}
+
+bool PerTrackEffect::CanChain(const EffectPlugin &effect)
+{
+   const auto pEffect = dynamic_cast<const PerTrackEffect*>(&effect);
+   return pEffect && effect.GetType() == EffectTypeProcess &&
+      pEffect->ProcessesConcurrently();
+}
+
+bool PerTrackEffect::CanChain(
+   const EffectPlugin &effect, const EffectInstance &instance)
+{
+   const auto pInstance = dynamic_cast<const Instance*>(&instance);
+   return CanChain(effect) &&
+      pInstance && pInstance->CanProcessConcurrently();
+}
+
+void PerTrackEffect::SetFollowers(std::vector<Follower> followers) const
+{
+   mFollowers = move(followers);
+}
+
+auto PerTrackEffect::TakeFollowers() const -> std::vector<Follower>
+{
+   return std::exchange(mFollowers, {});
+}
+
 bool PerTrackEffect::DoPass1() const
 {
    return true;
@@ -66,8 +263,10 @@ bool PerTrackEffect::Process(
 {
    auto pThis = const_cast<PerTrackEffect *>(this);
 
-   // Destroy any pre-formed output tracks when done
-   auto pOutputs = mpOutputTracks.get();
+   // Destroy any pre-formed output tracks when done; hold them meanwhile,
+   // because instances made for concurrent processing may destroy them sooner
+   const auto pPreformed = mpOutputTracks;
+   auto pOutputs = pPreformed.get();
 
    std::optional<EffectOutputTracks> outputs;
    if (!pOutputs)
@@ -78,10 +277,14 @@ bool PerTrackEffect::Process(
    // mPass = 1;
    if (DoPass1()) {
       auto &myInstance = dynamic_cast<Instance&>(instance);
-      bGoodResult = pThis->ProcessPass(pOutputs->Get(), myInstance, settings);
+      const auto followers = TakeFollowers();
+      assert(followers.empty() || CanChain(*this, myInstance));
+      bGoodResult =
+         pThis->ProcessPass(pOutputs->Get(), myInstance, settings, followers);
       // mPass = 2;
       if (bGoodResult && DoPass2())
-         bGoodResult = pThis->ProcessPass(pOutputs->Get(), myInstance, settings);
+         bGoodResult =
+            pThis->ProcessPass(pOutputs->Get(), myInstance, settings, {});
    }
    if (bGoodResult)
       pOutputs->Commit();
@@ -90,8 +293,16 @@ bool PerTrackEffect::Process(
 }
 
 bool PerTrackEffect::ProcessPass(TrackList &outputs,
-   Instance &instance, EffectSettings &settings)
+   Instance &instance, EffectSettings &settings,
+   const std::vector<Follower> &followers)
 {
+   const auto pIsolated =
+      followers.empty() ? IsolatedInstance::Call(*this, instance) : nullptr;
+   if (!pIsolated && (!followers.empty() ||
+       (GetType() == EffectTypeProcess && instance.CanProcessConcurrently() &&
+        ConcurrentTrackProcessing.Read())))
+      return ProcessPassConcurrently(outputs, instance, settings, followers);
+
    const auto duration = settings.extra.GetDuration();
    bool bGoodResult = true;
    bool isGenerator = GetType() == EffectTypeGenerate;
@@ -112,9 +323,10 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
 
    // Instances that can be reused in each loop pass
    std::vector<std::shared_ptr<EffectInstance>> recycledInstances{
-      // First one is the given one; any others pushed onto here are
-      // discarded when we exit
-      std::dynamic_pointer_cast<EffectInstanceEx>(instance.shared_from_this())
+      // First one is the given one, or its replacement; any others pushed
+      // onto here are discarded when we exit
+      pIsolated ? pIsolated : std::dynamic_pointer_cast<EffectInstanceEx>(
+         instance.shared_from_this())
    };
 
    const bool multichannel = numAudioIn > 1;
@@ -155,7 +367,9 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
 
          // Get the block size the client wants to use
          auto max = wt.GetMaxBlockSize() * 2;
-         const auto blockSize = instance.SetBlockSize(max);
+         const auto blockSize = (pIsolated
+            ? *pIsolated : static_cast<EffectInstance&>(instance)
+         ).SetBlockSize(max);
          if (blockSize == 0) {
             bGoodResult = false;
             return;
@@ -283,13 +497,27 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
          assert(sink.AcceptsBuffers(outBuffers));
 
          // Go process the track(s)
-         const auto factory =
-         [this, &recycledInstances, counter = 0]() mutable {
+         const auto factory = [this, &instance, &recycledInstances, blockSize,
+            isolated = (pIsolated != nullptr), counter = 0]() mutable {
             auto index = counter++;
+            std::shared_ptr<EffectInstance> pInstance;
             if (index < recycledInstances.size())
-               return recycledInstances[index];
-            else
-               return recycledInstances.emplace_back(MakeInstance());
+               pInstance = recycledInstances[index];
+            else {
+               // Don't make a local instance only to replace it.  A local
+               // instance would differ in latency from the replacements of
+               // the other channels; then fail the track
+               pInstance = isolated
+                  ? IsolatedInstance::Call(*this, instance)
+                  : MakeInstance();
+               if (!pInstance)
+                  return pInstance;
+               recycledInstances.push_back(pInstance);
+            }
+            // The first replacement chose the block size
+            if (isolated && pInstance)
+               pInstance->SetBlockSize(blockSize);
+            return pInstance;
          };
          bGoodResult = ProcessTrack(channel, factory, settings, source, sink,
             genLength, sampleRate, wt, inBuffers, outBuffers);
@@ -355,6 +583,267 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
    return bGoodResult;
 }
 
+bool PerTrackEffect::ProcessPassConcurrently(TrackList &outputs,
+   Instance &instance, EffectSettings &settings,
+   const std::vector<Follower> &followers)
+{
+   using audacity::concurrency::TaskPool;
+
+   const auto duration = settings.extra.GetDuration();
+   const auto numAudioIn = instance.GetAudioInCount();
+   const auto numAudioOut = instance.GetAudioOutCount();
+   if (numAudioOut < 1)
+      return false;
+   // A chain takes whole tracks, and each stage makes as many instances as
+   // it needs for the channels, as in a Mixer
+   const bool chained = !followers.empty();
+   const bool multichannel = chained || numAudioIn > 1;
+   const bool needsDither = instance.NeedsDither() ||
+      std::any_of(followers.begin(), followers.end(),
+         [](const Follower &follower){
+            return follower.pInstance->NeedsDither(); });
+
+   // Each selected track, or each channel of it, is processed by one instance
+   struct Unit {
+      WaveTrack &track;
+      WaveChannel &channel;
+      //! -1 for all channels
+      int iChannel;
+      sampleCount start;
+      sampleCount len;
+   };
+   std::vector<Unit> units;
+   double totalLength = 0;
+   outputs.Any().Visit(
+      [&](auto &&fallthrough){ return [&](WaveTrack &wt) {
+         if (!wt.GetSelected())
+            return fallthrough();
+         sampleCount start = 0;
+         sampleCount len = 0;
+         GetBounds(wt, &start, &len);
+         const auto channels = wt.Channels();
+         if (multichannel)
+            units.push_back({ wt, **channels.begin(), -1, start, len });
+         else {
+            int iChannel = 0;
+            for (const auto pChannel : channels)
+               units.push_back({ wt, *pChannel, iChannel++, start, len });
+         }
+      }; },
+      [&](Track &t) {
+         if (SyncLock::IsSyncLockSelected(t))
+            t.SyncLockAdjust(mT1, mT0 + duration);
+      }
+   );
+   for (const auto &unit : units) {
+      if (unit.len > 0 && numAudioIn < 1)
+         return false;
+      totalLength += unit.len.as_double();
+   }
+
+   // Everything for the processing of one unit.  The members are destroyed
+   // in reverse, so the stages finalize their instances first.
+   struct Job {
+      explicit Job(const EffectSettings &settings) : settings{ settings } {}
+      //! Each job has its own copy, as an instance may modify it
+      EffectSettings settings;
+      //! Likewise for the followers
+      std::vector<EffectSettings> followerSettings;
+      //! Each instance, with the index of its stage
+      std::vector<std::pair<size_t, std::shared_ptr<EffectInstance>>>
+         instances;
+      Buffers inBuffers;
+      //! Input of each follower
+      std::vector<Buffers> stageBuffers;
+      Buffers outBuffers;
+      std::optional<WideSampleSource> source;
+      std::optional<WaveTrackSink> sink;
+      std::optional<DeferredSink> deferredSink;
+      std::unique_ptr<EffectStage> pStage;
+      std::vector<std::unique_ptr<EffectStage>> followerStages;
+      std::optional<AudioGraph::Task> task;
+      //! Samples consumed by the source, updated by the worker thread
+      std::atomic<long long> done{ 0 };
+      bool result{ false };
+   };
+
+   // For each stage, instances finalized by previous batches, to be
+   // initialized again; the first are the given ones
+   std::vector<std::vector<std::shared_ptr<EffectInstance>>> idleInstances{
+      { std::dynamic_pointer_cast<EffectInstanceEx>(
+         instance.shared_from_this()) }
+   };
+   for (const auto &follower : followers)
+      idleInstances.push_back({ follower.pInstance });
+
+   // Jobs are made in batches no larger than the pool can run at once, which
+   // bounds the memory for buffers
+   const auto batchSize = ConcurrentTrackProcessing.Read()
+      ? TaskPool::Get().GetWorkersCount() + 1
+      : 1;
+   double finishedLength = 0;
+   for (size_t first = 0; first < units.size(); first += batchSize) {
+      const auto last = std::min(units.size(), first + batchSize);
+      SinkDispatcher dispatcher;
+      std::vector<std::unique_ptr<Job>> jobs;
+
+      // Make the jobs on this thread
+      for (auto ii = first; ii < last; ++ii) {
+         const auto &unit = units[ii];
+         auto &wt = unit.track;
+         auto &job = *jobs.emplace_back(std::make_unique<Job>(settings));
+
+         WaveChannel *const pRight = (multichannel && wt.NChannels() == 2)
+            // TODO: more-than-two-channels
+            ? (*wt.Channels().rbegin()).get()
+            : nullptr;
+
+         mSampleCnt = unit.len;
+
+         const auto max = wt.GetMaxBlockSize() * 2;
+         const auto blockSize = instance.SetBlockSize(max);
+         if (blockSize == 0)
+            return false;
+         const auto bufferSize =
+            ((max + (blockSize - 1)) / blockSize) * blockSize;
+         if (bufferSize == 0)
+            return false;
+
+         // New buffers are zeroed, including any input channels not read.
+         // Those of a chain have room for two channels and a dummy third,
+         // whatever the instances of each stage take
+         // TODO: more-than-two-channels
+         job.inBuffers.Reinit(chained ? 3u : std::max(1u, numAudioIn),
+            blockSize, std::max<size_t>(1, bufferSize / blockSize));
+         job.outBuffers.Reinit(chained ? 3u : numAudioOut, blockSize,
+            (bufferSize / blockSize) + 1);
+
+         // Called on the worker thread
+         const auto pollUser = [&job, &dispatcher, start = unit.start](
+            sampleCount inPos
+         ){
+            job.done.store(
+               (inPos - start).as_long_long(), std::memory_order_relaxed);
+            return !dispatcher.IsCancelled();
+         };
+         WideSampleSequence *pSeq = &unit.channel;
+         if (pRight)
+            pSeq = &wt;
+         job.source.emplace(*pSeq, size_t(pRight ? 2 : 1),
+            unit.start, unit.len, pollUser);
+         job.sink.emplace(unit.channel, pRight, nullptr, unit.start, true,
+            needsDither ? widestSampleFormat : narrowestSampleFormat);
+         job.deferredSink.emplace(dispatcher, *job.sink);
+
+         const auto makeFactory = [&](size_t stage) {
+            return [&, stage, max, blockSize]()
+               -> std::shared_ptr<EffectInstance>
+            {
+               auto &idle = idleInstances[stage];
+               std::shared_ptr<EffectInstance> pInstance;
+               if (!idle.empty()) {
+                  pInstance = move(idle.back());
+                  idle.pop_back();
+               }
+               else if (stage == 0)
+                  pInstance = MakeInstance();
+               else
+                  pInstance = followers[stage - 1].effect.MakeInstance();
+               // Followers must take the blocks the first stage gives
+               if (!pInstance || pInstance->SetBlockSize(
+                     stage == 0 ? max : blockSize) != blockSize)
+                  return nullptr;
+               job.instances.emplace_back(stage, pInstance);
+               return pInstance;
+            };
+         };
+         job.pStage = EffectStage::Create(unit.iChannel, *job.source,
+            job.inBuffers, makeFactory(0), job.settings, wt.GetRate(), {}, wt);
+         if (!job.pStage)
+            return false;
+         assert(job.pStage->AcceptsBlockSize(blockSize)); // post of ctor
+
+         // Each follower pulls from the stage before
+         AudioGraph::Source *pUpstream = job.pStage.get();
+         job.followerSettings.reserve(followers.size());
+         job.stageBuffers.reserve(followers.size());
+         for (size_t ii = 0; ii < followers.size(); ++ii) {
+            auto &settings = job.followerSettings.emplace_back(
+               followers[ii].settings);
+            auto &stageInput = job.stageBuffers.emplace_back(
+               3, blockSize, std::max<size_t>(1, bufferSize / blockSize));
+            auto &pStage = job.followerStages.emplace_back(
+               EffectStage::Create(unit.iChannel, *pUpstream, stageInput,
+                  makeFactory(ii + 1), settings, wt.GetRate(), {}, wt));
+            if (!pStage)
+               return false;
+            pUpstream = pStage.get();
+         }
+         job.task.emplace(*pUpstream, job.outBuffers, *job.deferredSink);
+      }
+
+      // Run the tasks on the pool, from another thread, so that this thread
+      // is free to write the tracks and report progress
+      std::exception_ptr pException;
+      std::thread driver{ [&]{
+         try {
+            TaskPool::Get().ParallelFor(jobs.size(), 1,
+               [&](size_t begin, size_t end) {
+                  for (; begin < end; ++begin) {
+                     auto &job = *jobs[begin];
+                     try {
+                        job.result = job.task->RunLoop();
+                     }
+                     catch (...) {
+                        dispatcher.Cancel();
+                        throw;
+                     }
+                     if (!job.result)
+                        dispatcher.Cancel();
+                  }
+               });
+         }
+         catch (...) {
+            pException = std::current_exception();
+         }
+         dispatcher.Finish();
+      } };
+      dispatcher.Serve([&]{
+         auto done = finishedLength;
+         for (const auto &pJob : jobs)
+            done += pJob->done.load(std::memory_order_relaxed);
+         return !TotalProgress(
+            totalLength > 0 ? done / totalLength : 1.0);
+      });
+      driver.join();
+      if (pException)
+         std::rethrow_exception(pException);
+      dispatcher.RethrowException();
+
+      // Commit the rest of the output, in the order of the tracks
+      for (const auto &pJob : jobs) {
+         if (!pJob->result)
+            return false;
+         pJob->sink->Flush(pJob->outBuffers);
+         if (!pJob->sink->IsOk())
+            return false;
+      }
+
+      for (auto &pJob : jobs) {
+         pJob->task.reset();
+         // Finalize the instances before they are reused
+         pJob->followerStages.clear();
+         pJob->pStage.reset();
+         for (auto &[stage, pInstance] : pJob->instances)
+            idleInstances[stage].push_back(move(pInstance));
+      }
+      for (auto ii = first; ii < last; ++ii)
+         finishedLength += units[ii].len.as_double();
+   }
+
+   return true;
+}
+
 bool PerTrackEffect::ProcessTrack(int channel, const Factory &factory,
    EffectSettings &settings,
    AudioGraph::Source &upstream, AudioGraph::Sink &sink,
@@ -17,10 +17,13 @@
 #include "AudioGraphSink.h" // to inherit
 #include "AudioGraphSource.h" // to inherit
 #include "Effect.h" // to inherit
+#include "GlobalVariable.h"
 #include "MemoryX.h"
+#include "Prefs.h"
 #include "SampleCount.h"
 #include <functional>
 #include <memory>
+#include <vector>
 
 class EffectOutputTracks;
 class SampleTrack;
@@ -54,10 +57,76 @@ public:
          double sampleRate, ChannelNames chanMap) override;
 
       bool ProcessFinalize() noexcept override;
+
+      //! Whether other instances of the effect may process other tracks
+      //! at the same time as this
+      /*!
+       If so, each track, or channel, gets its own instance and its own copy of
+       the settings, and ProcessBlock() is called on a worker thread.
+       ProcessInitialize() and ProcessFinalize() are still called on the main
+       thread.  Default returns false.
+       */
+      virtual bool CanProcessConcurrently() const;
    protected:
       const PerTrackEffect &mProcessor;
    };
 
+   //! Hook function that may replace instances with others that run in a
+   //! separate process, so that a crash of the effect does not end Audacity
+   /*!
+    Called in each pass without followers with the instance given to
+    Process(), once for it and once more for each other channel, for which
+    no local instance is made.  Returns null to keep the instance, or a
+    replacement that reports the same channel counts and dither need.  That
+    instance is still made in this process, so only the processing is
+    isolated.  The first replacement chooses the block size for each track,
+    and the others are given it.  With a replacement, the pass
+    processes the tracks one at a time, and fails if the others return null.
+    */
+   struct EFFECTS_API IsolatedInstance : GlobalHook<IsolatedInstance,
+      std::shared_ptr<EffectInstance>(
+         const PerTrackEffect &effect, const EffectInstance &instance)
+   >{};
+
+   //! An effect applied in the same pass as another, to its output
+   struct Follower {
+      const PerTrackEffect &effect;
+      //! Initialized, and used for the first track
+      std::shared_ptr<EffectInstance> pInstance;
+      EffectSettings settings;
+   };
+
+   //! Whether every instance of the effect answers true to
+   //! Instance::CanProcessConcurrently(); default returns false
+   /*! Lets a macro decide to chain the effect without making an instance */
+   virtual bool ProcessesConcurrently() const;
+
+   //! Whether the effect may be followed by others, or follow another, in one
+   //! pass
+   /*!
+    It must be a processor whose instances may process concurrently, so
+    the output of one effect may stream into the next without any change to
+    the tracks between.  That excludes effects that analyse their input in a
+    first pass, such as Normalize, Loudness and Compressor, and effects that
+    are not PerTrackEffects, such as Equalization.
+    */
+   static bool CanChain(const EffectPlugin &effect);
+   //! Like the other overload, also checking the instance that will process
+   static bool CanChain(
+      const EffectPlugin &effect, const EffectInstance &instance);
+
+   //! Makes the next Process() apply the followers too, in order, so that
+   //! each track is read and written once for all of the effects
+   /*!
+    @pre CanChain() is true for each of followers, and for this effect with
+    the instance that will be given to Process()
+    @pre no effect occurs twice, counting this, because the settings of some
+    effects are in the effect object
+    */
+   void SetFollowers(std::vector<Follower> followers) const;
+   //! Removes the followers if Process() did not use them
+   std::vector<Follower> TakeFollowers() const;
+
 protected:
    // These were overridables but the generality wasn't used yet
    /* virtual */ bool DoPass1() const;
@@ -78,7 +147,18 @@ private:
    using Buffers = AudioGraph::Buffers;
 
    bool ProcessPass(TrackList &outputs,
-      Instance &instance, EffectSettings &settings);
+      Instance &instance, EffectSettings &settings,
+      const std::vector<Follower> &followers);
+   //! ProcessPass() for processors whose instances can process concurrently,
+   //! and for chains of them
+   /*!
+    With followers, each track is one unit of work even for instances of one
+    channel, and the tracks are processed one at a time unless
+    ConcurrentTrackProcessing allows otherwise
+    */
+   bool ProcessPassConcurrently(TrackList &outputs,
+      Instance &instance, EffectSettings &settings,
+      const std::vector<Follower> &followers);
    using Factory = std::function<std::shared_ptr<EffectInstance>()>;
    /*!
     Previous contents of inBuffers and outBuffers are ignored
@@ -100,5 +180,10 @@ private:
 
    // TODO: put this in struct EffectContext? (Which doesn't exist yet)
    mutable std::shared_ptr<EffectOutputTracks> mpOutputTracks;
+   mutable std::vector<Follower> mFollowers;
 };
+
+//! Whether to process tracks, or independent parts of them, concurrently,
+//! for effects that allow it
+extern EFFECTS_API BoolSetting ConcurrentTrackProcessing;
 #endif
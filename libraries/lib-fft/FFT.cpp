@@ -48,9 +48,8 @@
 #include <stdlib.h>
 #include <math.h>
 
-#include "RealFFTf.h"
+#include "FFTPlan.h"
 
-using Floats = ArrayOf<float>;
 static ArraysOf<int> gFFTBitTable;
 static const size_t MaxFastBits = 16;
 
@@ -222,24 +221,23 @@ void FFT(size_t NumSamples,
 /*
  * Real Fast Fourier Transform
  *
- * This is merely a wrapper of RealFFTf() from RealFFTf.h.
+ * This is merely a wrapper of FFTPlan::Forward() from FFTPlan.h.
  */
 
 void RealFFT(size_t NumSamples, const float *RealIn, float *RealOut, float *ImagOut)
 {
-   auto hFFT = GetFFT(NumSamples);
-   Floats pFFT{ NumSamples };
+   const auto plan = FFTPlan::Get(NumSamples);
    // Copy the data into the processing buffer
-   for(size_t i = 0; i < NumSamples; i++)
-      pFFT[i] = RealIn[i];
+   PffftFloatVector pFFT(RealIn, RealIn + NumSamples);
+   PffftFloatVector work(NumSamples);
 
    // Perform the FFT
-   RealFFTf(pFFT.get(), hFFT.get());
+   plan->Forward(pFFT.data(), pFFT.data(), work.data());
 
    // Copy the data into the real and imaginary outputs
    for (size_t i = 1; i<(NumSamples / 2); i++) {
-      RealOut[i]=pFFT[hFFT->BitReversed[i]  ];
-      ImagOut[i]=pFFT[hFFT->BitReversed[i]+1];
+      RealOut[i]=pFFT[2*i  ];
+      ImagOut[i]=pFFT[2*i+1];
    }
    // Handle the (real-only) DC and Fs/2 bins
    RealOut[0] = pFFT[0];
@@ -261,13 +259,14 @@ void RealFFT(size_t NumSamples, const float *RealIn, float *RealOut, float *Imag
  * Only the first half of RealIn and ImagIn are used due to this
  * symmetry assumption.
  *
- * This is merely a wrapper of InverseRealFFTf() from RealFFTf.h.
+ * This is merely a wrapper of FFTPlan::Inverse() from FFTPlan.h.
  */
 void InverseRealFFT(size_t NumSamples, const float *RealIn, const float *ImagIn,
 		    float *RealOut)
 {
-   auto hFFT = GetFFT(NumSamples);
-   Floats pFFT{ NumSamples };
+   const auto plan = FFTPlan::Get(NumSamples);
+   PffftFloatVector pFFT(NumSamples);
+   PffftFloatVector work(NumSamples);
    // Copy the data into the processing buffer
    for (size_t i = 0; i < (NumSamples / 2); i++)
       pFFT[2*i  ] = RealIn[i];
@@ -282,16 +281,18 @@ void InverseRealFFT(size_t NumSamples, const float *RealIn, const float *ImagIn,
    pFFT[1] = RealIn[NumSamples / 2];
 
    // Perform the FFT
-   InverseRealFFTf(pFFT.get(), hFFT.get());
+   plan->Inverse(pFFT.data(), pFFT.data(), work.data());
 
-   // Copy the data to the (purely real) output buffer
-   ReorderToTime(hFFT.get(), pFFT.get(), RealOut);
+   // Copy the data to the (purely real) output buffer, undoing the scaling
+   const auto scale = 1.0f / NumSamples;
+   for (size_t i = 0; i < NumSamples; i++)
+      RealOut[i] = pFFT[i] * scale;
 }
 
 /*
  * PowerSpectrum
  *
- * This function uses RealFFTf() from RealFFTf.h to perform the real
+ * This function uses FFTPlan::Forward() from FFTPlan.h to perform the real
  * FFT computation, and then squares the real and imaginary part of
  * each coefficient, extracting the power and throwing away the phase.
  *
@@ -301,19 +302,18 @@ void InverseRealFFT(size_t NumSamples, const float *RealIn, const float *ImagIn,
 
 void PowerSpectrum(size_t NumSamples, const float *In, float *Out)
 {
-   auto hFFT = GetFFT(NumSamples);
-   Floats pFFT{ NumSamples };
+   const auto plan = FFTPlan::Get(NumSamples);
    // Copy the data into the processing buffer
-   for (size_t i = 0; i<NumSamples; i++)
-      pFFT[i] = In[i];
+   PffftFloatVector pFFT(In, In + NumSamples);
+   PffftFloatVector work(NumSamples);
 
    // Perform the FFT
-   RealFFTf(pFFT.get(), hFFT.get());
+   plan->Forward(pFFT.data(), pFFT.data(), work.data());
 
    // Copy the data into the real and imaginary outputs
    for (size_t i = 1; i<NumSamples / 2; i++) {
-      Out[i]= (pFFT[hFFT->BitReversed[i]  ]*pFFT[hFFT->BitReversed[i]  ])
-         + (pFFT[hFFT->BitReversed[i]+1]*pFFT[hFFT->BitReversed[i]+1]);
+      Out[i]= (pFFT[2*i  ]*pFFT[2*i  ])
+         + (pFFT[2*i+1]*pFFT[2*i+1]);
    }
    // Handle the (real-only) DC and Fs/2 bins
    Out[0] = pFFT[0]*pFFT[0];
@@ -0,0 +1,170 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file FFTPlan.cpp
+
+**********************************************************************/
+#include "FFTPlan.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "RealFFTf.h"
+#include "pffft.h"
+
+namespace
+{
+// Like MAX_HFFT of the former pool of GetFFT, with room for both backends
+constexpr size_t MaxCachedPlans = 20;
+
+std::mutex sPlansMutex;
+std::map<std::pair<size_t, FFTPlan::Backend>, std::shared_ptr<const FFTPlan>>
+   sPlans;
+} // namespace
+
+std::shared_ptr<const FFTPlan> FFTPlan::Get(size_t fftLen, Backend preferred)
+{
+   const auto backend =
+      preferred == Backend::Pffft && IsPffftSupported(fftLen) ?
+         Backend::Pffft :
+         Backend::RealFFTf;
+   const auto key = std::make_pair(fftLen, backend);
+
+   std::lock_guard lock { sPlansMutex };
+
+   if (auto iter = sPlans.find(key); iter != sPlans.end())
+      return iter->second;
+
+   auto plan = std::make_shared<const FFTPlan>(fftLen, backend);
+   if (sPlans.size() < MaxCachedPlans)
+      sPlans.emplace(key, plan);
+   return plan;
+}
+
+bool FFTPlan::IsPffftSupported(size_t fftLen)
+{
+   if (fftLen == 0 ||
+       fftLen % pffft_min_fft_size(PFFFT_REAL) != 0)
+      return false;
+
+   auto n = fftLen;
+   for (const size_t factor : { 2, 3, 5 })
+      while (n % factor == 0)
+         n /= factor;
+   return n == 1;
+}
+
+const char* FFTPlan::GetPffftInstructionSet()
+{
+   // pffft reports only the width of the vectors it was built for
+   if (pffft_simd_size() == 1)
+      return "scalar";
+#if defined(__ppc__) || defined(__ppc64__)
+   return "Altivec";
+#elif defined(__aarch64__) || defined(__arm64__) || defined(_M_ARM64)
+   return "NEON";
+#else
+   return "SSE";
+#endif
+}
+
+FFTPlan::FFTPlan(size_t fftLen, Backend backend)
+    : mFftLen { fftLen }
+    , mBackend { backend }
+    , mFFTParam { backend == Backend::RealFFTf ? InitializeFFT(fftLen) :
+                                                 nullptr }
+    , mPffftSetup { backend == Backend::Pffft ?
+                       pffft_new_setup(static_cast<int>(fftLen), PFFFT_REAL) :
+                       nullptr }
+{
+   assert(backend != Backend::Pffft || IsPffftSupported(fftLen));
+}
+
+FFTPlan::~FFTPlan() = default;
+
+void FFTPlan::Forward(const float* in, float* out, float* work) const
+{
+   if (mPffftSetup)
+   {
+      pffft_transform_ordered(
+         mPffftSetup.get(), in, out, work, PFFFT_FORWARD);
+      return;
+   }
+
+   if (in != out)
+      std::copy(in, in + mFftLen, out);
+   RealFFTf(out, mFFTParam.get());
+
+   // Undo the bit reversal; the first pair is DC and Nyquist in both layouts
+   const auto& bitReversed = mFFTParam->BitReversed;
+   work[0] = out[0];
+   work[1] = out[1];
+   for (size_t i = 1; i < mFFTParam->Points; ++i)
+   {
+      work[2 * i] = out[bitReversed[i]];
+      work[2 * i + 1] = out[bitReversed[i] + 1];
+   }
+   std::copy(work, work + mFftLen, out);
+}
+
+void FFTPlan::Inverse(const float* in, float* out, float* work) const
+{
+   if (mPffftSetup)
+   {
+      pffft_transform_ordered(
+         mPffftSetup.get(), in, out, work, PFFFT_BACKWARD);
+      return;
+   }
+
+   if (in != out)
+      std::copy(in, in + mFftLen, out);
+   InverseRealFFTf(out, mFFTParam.get());
+   ReorderToTime(mFFTParam.get(), out, work);
+
+   // InverseRealFFTf divides by fftLen, unlike pffft
+   const auto scale = static_cast<float>(mFftLen);
+   std::transform(
+      work, work + mFftLen, out, [scale](float x) { return x * scale; });
+}
+
+void FFTPlan::ForwardUnordered(const float* in, float* out, float* work) const
+{
+   if (mPffftSetup)
+      pffft_transform(mPffftSetup.get(), in, out, work, PFFFT_FORWARD);
+   else
+      Forward(in, out, work);
+}
+
+void FFTPlan::InverseUnordered(const float* in, float* out, float* work) const
+{
+   if (mPffftSetup)
+      pffft_transform(mPffftSetup.get(), in, out, work, PFFFT_BACKWARD);
+   else
+      Inverse(in, out, work);
+}
+
+void FFTPlan::MultiplyAccumulate(
+   const float* a, const float* b, float* sum, float scale) const
+{
+   if (mPffftSetup)
+   {
+      pffft_zconvolve_accumulate(mPffftSetup.get(), a, b, sum, scale);
+      return;
+   }
+
+   // The packed layout of Forward; DC and Nyquist are real
+   sum[0] += a[0] * b[0] * scale;
+   sum[1] += a[1] * b[1] * scale;
+   for (size_t i = 2; i < mFftLen; i += 2)
+   {
+      const auto re = a[i] * b[i] - a[i + 1] * b[i + 1];
+      const auto im = a[i] * b[i + 1] + a[i + 1] * b[i];
+      sum[i] += re * scale;
+      sum[i + 1] += im * scale;
+   }
+}
@@ -0,0 +1,110 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file FFTPlan.h
+  @brief Real FFTs of one size, shared by all threads, by the fastest backend
+
+**********************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include "PowerSpectrumGetter.h" // PffftSetupHolder
+
+struct FFTParam;
+
+//! Immutable tables for the real FFTs of one size, cached for all threads
+/*!
+ The plans are checked out by Get, which keeps the plans of the first sizes
+ requested for the lifetime of the process, like the pool of GetFFT did; plans
+ of more sizes are made for each call.  A plan has no mutable state, so one may
+ be used by several threads at once, each with its own work area.
+
+ The backend is chosen at run time for each size: pffft, which is vectorized
+ with the instructions it was built for, when it supports the size, otherwise
+ the radix 2 RealFFTf.  Both give the same results in the same layout.
+ */
+class FFT_API FFTPlan final
+{
+public:
+   enum class Backend
+   {
+      Pffft,
+      RealFFTf,
+   };
+
+   //! Finds or makes the plan for fftLen points
+   /*!
+    @param preferred is used if it supports fftLen, otherwise RealFFTf
+    @pre fftLen is a power of 2, or else pffft supports it
+    */
+   static std::shared_ptr<const FFTPlan>
+   Get(size_t fftLen, Backend preferred = Backend::Pffft);
+
+   //! Whether pffft can transform fftLen points, a multiple of 32 with no
+   //! prime factors other than 2, 3 and 5
+   static bool IsPffftSupported(size_t fftLen);
+
+   //! Name of the instructions used by pffft, "SSE", "NEON", "Altivec" or
+   //! "scalar"
+   static const char* GetPffftInstructionSet();
+
+   //! Use Get instead, unless a plan which is not shared is really needed
+   FFTPlan(size_t fftLen, Backend backend);
+   ~FFTPlan();
+
+   FFTPlan(const FFTPlan&) = delete;
+   FFTPlan& operator=(const FFTPlan&) = delete;
+
+   size_t GetSize() const noexcept { return mFftLen; }
+   Backend GetBackend() const noexcept { return mBackend; }
+
+   //! Transforms fftLen real samples into fftLen / 2 + 1 complex bins
+   /*!
+    The output is packed as Re(0), Re(fftLen / 2), Re(1), Im(1), Re(2) ...,
+    because the imaginary parts of the first and last bins are zero.  It is not
+    scaled, so a unit DC signal gives Re(0) = fftLen.
+
+    @param in fftLen samples, may be the same as out
+    @param out fftLen floats
+    @param work fftLen floats, distinct from in and out
+    @pre all of the buffers are aligned as by PffftFloatVector
+    */
+   void Forward(const float* in, float* out, float* work) const;
+
+   //! Inverse of Forward, except for the factor fftLen
+   /*! The arguments are as for Forward, with the packed bins as input */
+   void Inverse(const float* in, float* out, float* work) const;
+
+   //! Like Forward, but the bins are in an order that suits the backend
+   /*!
+    Faster than Forward for pffft.  The output is meant only for
+    MultiplyAccumulate and InverseUnordered.  Arguments are as for Forward.
+    */
+   void ForwardUnordered(const float* in, float* out, float* work) const;
+
+   //! Inverse of ForwardUnordered, except for the factor fftLen
+   void InverseUnordered(const float* in, float* out, float* work) const;
+
+   //! Adds the products of the bins of a and b, times scale, to those of sum
+   /*!
+    This is convolution in the time domain.
+    @param a, b, sum fftLen floats each, as from ForwardUnordered; sum may
+    be the same as a or b
+    */
+   void MultiplyAccumulate(
+      const float* a, const float* b, float* sum, float scale) const;
+
+   //! Tables for the bit reversed transforms of RealFFTf.h
+   /*! @return null unless the backend is RealFFTf */
+   FFTParam* GetFFTParam() const noexcept { return mFFTParam.get(); }
+
+private:
+   const size_t mFftLen;
+   const Backend mBackend;
+   const std::unique_ptr<FFTParam> mFFTParam;
+   const PffftSetupHolder mPffftSetup;
+};
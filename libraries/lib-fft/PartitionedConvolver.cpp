@@ -0,0 +1,166 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file PartitionedConvolver.cpp
+
+**********************************************************************/
+#include "PartitionedConvolver.h"
+#include "FFTPlan.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+// Shorter blocks would spend more time in calls than in the transforms
+constexpr size_t MinOfflineBlockSize = 256;
+} // namespace
+
+size_t PartitionedConvolver::OfflineBlockSize(size_t impulseLength)
+{
+   // One partition; a longer block would only make the transforms slower
+   size_t blockSize = MinOfflineBlockSize;
+   while (blockSize < impulseLength)
+      blockSize *= 2;
+   return blockSize;
+}
+
+PartitionedConvolver::PartitionedConvolver(
+   size_t blockSize, size_t nChannels, size_t maxImpulseLength)
+    : mPlan { FFTPlan::Get(2 * blockSize) }
+    , mBlockSize { blockSize }
+    , mChannels { nChannels }
+    , mMaxPartitions { std::max<size_t>(
+         1, (maxImpulseLength + blockSize - 1) / blockSize) }
+    , mSpectrumStride { PffftAlignedCount { 2 * blockSize } }
+    , mBlockStride { PffftAlignedCount { blockSize } }
+    , mFilter(mMaxPartitions * mSpectrumStride)
+    , mHistory(nChannels * mMaxPartitions * mSpectrumStride)
+    , mInput(nChannels * mSpectrumStride)
+    , mSum(nChannels * mSpectrumStride)
+    , mWork(mSpectrumStride)
+    , mPendingIn(nChannels * mBlockStride)
+    , mPendingOut(nChannels * mBlockStride)
+{
+   assert(blockSize >= MinBlockSize);
+   assert((blockSize & (blockSize - 1)) == 0);
+   assert(nChannels > 0);
+
+   for (size_t channel = 0; channel < nChannels; ++channel)
+   {
+      mPendingInPointers.push_back(
+         mPendingIn.data() + channel * mBlockStride);
+      mPendingOutPointers.push_back(
+         mPendingOut.data() + channel * mBlockStride);
+   }
+}
+
+PartitionedConvolver::~PartitionedConvolver() = default;
+
+void PartitionedConvolver::SetImpulse(const float* impulse, size_t length)
+{
+   assert(length <= mMaxPartitions * mBlockSize);
+
+   const auto fftLen = 2 * mBlockSize;
+   mPartitions = (length + mBlockSize - 1) / mBlockSize;
+   for (size_t partition = 0; partition < mPartitions; ++partition)
+   {
+      // Each partition is zero padded to the size of the transforms
+      float* const spectrum = mFilter.data() + partition * mSpectrumStride;
+      const auto offset = partition * mBlockSize;
+      const auto count = std::min(mBlockSize, length - offset);
+      std::copy(impulse + offset, impulse + offset + count, spectrum);
+      std::fill(spectrum + count, spectrum + fftLen, 0.0f);
+      mPlan->ForwardUnordered(spectrum, spectrum, mWork.data());
+   }
+}
+
+void PartitionedConvolver::Reset()
+{
+   std::fill(mHistory.begin(), mHistory.end(), 0.0f);
+   std::fill(mInput.begin(), mInput.end(), 0.0f);
+   std::fill(mPendingIn.begin(), mPendingIn.end(), 0.0f);
+   std::fill(mPendingOut.begin(), mPendingOut.end(), 0.0f);
+   mNewest = 0;
+   mPendingCount = 0;
+}
+
+float* PartitionedConvolver::History(size_t channel, size_t slot)
+{
+   return mHistory.data() +
+          (channel * mMaxPartitions + slot) * mSpectrumStride;
+}
+
+void PartitionedConvolver::ProcessBlock(
+   const float* const* in, float* const* out)
+{
+   assert(mPendingCount == 0);
+
+   const auto fftLen = 2 * mBlockSize;
+
+   // The newest spectra replace the oldest in the rings
+   mNewest = (mNewest + 1) % mMaxPartitions;
+   for (size_t channel = 0; channel < mChannels; ++channel)
+   {
+      float* const input = mInput.data() + channel * mSpectrumStride;
+      std::copy(input + mBlockSize, input + fftLen, input);
+      std::copy(in[channel], in[channel] + mBlockSize, input + mBlockSize);
+      mPlan->ForwardUnordered(
+         input, History(channel, mNewest), mWork.data());
+   }
+
+   // Partition-major, so that each spectrum of the filter is loaded once;
+   // the normalization of the inverse transform is done here too
+   const auto scale = 1.0f / fftLen;
+   std::fill(mSum.begin(), mSum.end(), 0.0f);
+   for (size_t partition = 0; partition < mPartitions; ++partition)
+   {
+      const float* const filter =
+         mFilter.data() + partition * mSpectrumStride;
+      const auto slot =
+         (mNewest + mMaxPartitions - partition) % mMaxPartitions;
+      for (size_t channel = 0; channel < mChannels; ++channel)
+         mPlan->MultiplyAccumulate(
+            History(channel, slot), filter,
+            mSum.data() + channel * mSpectrumStride, scale);
+   }
+
+   // The second half of the inverse transform is free of circular aliasing
+   for (size_t channel = 0; channel < mChannels; ++channel)
+   {
+      float* const sum = mSum.data() + channel * mSpectrumStride;
+      mPlan->InverseUnordered(sum, sum, mWork.data());
+      std::copy(sum + mBlockSize, sum + fftLen, out[channel]);
+   }
+}
+
+void PartitionedConvolver::Process(
+   const float* const* in, float* const* out, size_t len)
+{
+   size_t done = 0;
+   while (done < len)
+   {
+      const auto count = std::min(len - done, mBlockSize - mPendingCount);
+      for (size_t channel = 0; channel < mChannels; ++channel)
+      {
+         // Take the input before giving the output, which may overwrite it
+         const float* const source = in[channel] + done;
+         std::copy(
+            source, source + count,
+            mPendingInPointers[channel] + mPendingCount);
+         const float* const pending =
+            mPendingOutPointers[channel] + mPendingCount;
+         std::copy(pending, pending + count, out[channel] + done);
+      }
+      done += count;
+      mPendingCount += count;
+
+      if (mPendingCount == mBlockSize)
+      {
+         mPendingCount = 0;
+         ProcessBlock(mPendingInPointers.data(), mPendingOutPointers.data());
+      }
+   }
+}
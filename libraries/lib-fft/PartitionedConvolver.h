@@ -0,0 +1,119 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file PartitionedConvolver.h
+  @brief Fast convolution of streams with long impulse responses
+
+**********************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "PowerSpectrumGetter.h" // PffftFloatVector
+
+class FFTPlan;
+
+//! Convolves channels with one impulse response, by uniformly partitioned
+//! overlap-save
+/*!
+ The response is cut into partitions of the block size, whose spectra are kept.
+ Each block of input is transformed once, together with the block before it,
+ into a delay line of spectra.  A block of output is the inverse transform of
+ the sum of the products of the recent input spectra with the partition
+ spectra.
+
+ So the cost per sample grows with the logarithm of the block size and with
+ the number of partitions.  Small blocks give low latency for realtime
+ processing, and one or two large partitions suit offline processing.
+
+ The channels are done together, partition by partition, so that each
+ partition spectrum is reused while in the cache; the products use the vector
+ instructions of FFTPlan's backend.
+
+ SetImpulse(), Reset(), ProcessBlock() and Process() do not allocate.
+ */
+class FFT_API PartitionedConvolver final
+{
+public:
+   //! Smallest block size supported
+   static constexpr size_t MinBlockSize = 16;
+
+   //! A block size for offline processing with a response of the given length
+   static size_t OfflineBlockSize(size_t impulseLength);
+
+   /*!
+    @pre `blockSize >= MinBlockSize`, and is a power of 2
+    @pre `nChannels > 0`
+    */
+   PartitionedConvolver(
+      size_t blockSize, size_t nChannels, size_t maxImpulseLength);
+   ~PartitionedConvolver();
+
+   PartitionedConvolver(const PartitionedConvolver&) = delete;
+   PartitionedConvolver& operator=(const PartitionedConvolver&) = delete;
+
+   size_t GetBlockSize() const noexcept { return mBlockSize; }
+   size_t GetChannelsCount() const noexcept { return mChannels; }
+   //! Delay of the output of Process(); ProcessBlock() has none
+   size_t GetLatency() const noexcept { return mBlockSize; }
+
+   //! Replaces the impulse response, which is initially silence
+   /*!
+    Input already given is remembered, so the following output is as if all
+    of the input were convolved with the new response.
+    @pre `length <= maxImpulseLength` of the constructor
+    */
+   void SetImpulse(const float* impulse, size_t length);
+
+   //! Forgets all input given, as if it were silence
+   void Reset();
+
+   //! Convolves the next block of each channel
+   /*!
+    @param in GetChannelsCount() pointers to GetBlockSize() samples
+    @param out likewise; the same pointers as in are allowed
+    @pre no samples are held by Process()
+    */
+   void ProcessBlock(const float* const* in, float* const* out);
+
+   //! Convolves any number of samples of each channel, delayed by GetLatency()
+   /*!
+    @param in GetChannelsCount() pointers to len samples
+    @param out likewise; the same pointers as in are allowed
+    */
+   void Process(const float* const* in, float* const* out, size_t len);
+
+private:
+   float* History(size_t channel, size_t slot);
+
+   const std::shared_ptr<const FFTPlan> mPlan;
+   const size_t mBlockSize;
+   const size_t mChannels;
+   const size_t mMaxPartitions;
+   //! Strides, in floats, of the spectra and of the blocks of Process()
+   const size_t mSpectrumStride;
+   const size_t mBlockStride;
+
+   size_t mPartitions { 0 };
+   //! Spectra of the partitions of the response
+   PffftFloatVector mFilter;
+   //! For each channel, a ring of the spectra of the latest blocks of input
+   PffftFloatVector mHistory;
+   //! Slot of the newest spectra in the rings
+   size_t mNewest { 0 };
+   //! For each channel, the last block of input, then the next block
+   PffftFloatVector mInput;
+   PffftFloatVector mSum;
+   PffftFloatVector mWork;
+
+   //! Input gathered and output not yet given by Process()
+   PffftFloatVector mPendingIn;
+   PffftFloatVector mPendingOut;
+   size_t mPendingCount { 0 };
+   std::vector<float*> mPendingInPointers;
+   std::vector<float*> mPendingOutPointers;
+};
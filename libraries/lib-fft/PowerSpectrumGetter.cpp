@@ -9,6 +9,7 @@
 
 **********************************************************************/
 #include "PowerSpectrumGetter.h"
+#include "FFTPlan.h"
 
 #include <cassert>
 #include <pffft.h>
@@ -40,7 +41,7 @@ PffftConstFloats PffftFloatVector::aligned(PffftAlignedCount c) const
 
 PowerSpectrumGetter::PowerSpectrumGetter(int fftSize)
     : mFftSize { fftSize }
-    , mSetup { pffft_new_setup(fftSize, PFFFT_REAL) }
+    , mPlan { FFTPlan::Get(fftSize) }
     , mWork(fftSize)
 {
 }
@@ -54,8 +55,7 @@ void PowerSpectrumGetter::operator()(
 {
    const auto buffer = alignedBuffer.get();
    const auto output = alignedOutput.get();
-   pffft_transform_ordered(mSetup.get(),
-      buffer, buffer, mWork.data(), PFFFT_FORWARD);
+   mPlan->Forward(buffer, buffer, mWork.data());
    output[0] = buffer[0] * buffer[0];
    for (auto i = 1; i < mFftSize / 2; ++i)
       output[i] =
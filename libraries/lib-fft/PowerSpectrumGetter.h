@@ -10,6 +10,7 @@
 **********************************************************************/
 #pragma once
 
+class FFTPlan;
 struct PFFFT_Setup;
 
 #include <memory>
@@ -222,6 +223,6 @@ public:
 
 private:
    const int mFftSize;
-   PffftSetupHolder mSetup;
+   const std::shared_ptr<const FFTPlan> mPlan;
    PffftFloatVector mWork;
 };
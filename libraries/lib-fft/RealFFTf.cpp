@@ -37,13 +37,12 @@
 */
 
 #include "RealFFTf.h"
+#include "FFTPlan.h"
 
 #include <vector>
 #include <stdlib.h>
 #include <math.h>
 
-#include <wx/thread.h>
-
 #ifndef M_PI
 #define	M_PI		3.14159265358979323846  /* pi */
 #endif
@@ -52,10 +51,10 @@
 *  Initialize the Sine table and Twiddle pointers (bit-reversed pointers)
 *  for the FFT routine.
 */
-HFFT InitializeFFT(size_t fftlen)
+std::unique_ptr<FFTParam> InitializeFFT(size_t fftlen)
 {
    int temp;
-   HFFT h{ safenew FFTParam };
+   auto h = std::make_unique<FFTParam>();
 
    /*
    *  FFT size is only half the number of data points
@@ -83,61 +82,17 @@ HFFT InitializeFFT(size_t fftlen)
       h->SinTable[h->BitReversed[i]+1]=(fft_type)-cos(2*M_PI*i/(2*h->Points));
    }
 
-#ifdef EXPERIMENTAL_EQ_SSE_THREADED
-   // NEW SSE FFT routines work on live data
-   for(size_t i = 0; i < 32; i++)
-      if((1 << i) & fftlen)
-         h->pow2Bits = i;
-#endif
-
    return h;
 }
 
-enum : size_t { MAX_HFFT = 10 };
-
-// Maintain a pool:
-static std::vector< std::unique_ptr<FFTParam> > hFFTArray(MAX_HFFT);
-wxCriticalSection getFFTMutex;
-
 /* Get a handle to the FFT tables of the desired length */
-/* This version keeps common tables rather than allocating a NEW table every time */
+/* The tables are shared with the plans of FFTPlan, which may be used by
+   any thread */
 HFFT GetFFT(size_t fftlen)
 {
-   // To do:  smarter policy about when to retain in the pool and when to
-   // allocate a unique instance.
-
-   wxCriticalSectionLocker locker{ getFFTMutex };
-   
-   size_t h = 0;
-   auto n = fftlen/2;
-   auto size = hFFTArray.size();
-   for(;
-       (h < size) && hFFTArray[h] && (n != hFFTArray[h]->Points);
-       h++)
-      ;
-   if(h < size) {
-      if(hFFTArray[h] == NULL) {
-         hFFTArray[h].reset( InitializeFFT(fftlen).release() );
-      }
-      return HFFT{ hFFTArray[h].get() };
-   } else {
-      // All buffers used, so fall back to allocating a NEW set of tables
-      return InitializeFFT(fftlen);
-   }
-}
-
-/* Release a previously requested handle to the FFT tables */
-void FFTDeleter::operator() (FFTParam *hFFT) const
-{
-   wxCriticalSectionLocker locker{ getFFTMutex };
-
-   auto it = hFFTArray.begin(), end = hFFTArray.end();
-   while (it != end && it->get() != hFFT)
-      ++it;
-   if ( it != end )
-      ;
-   else
-      delete hFFT;
+   auto plan = FFTPlan::Get(fftlen, FFTPlan::Backend::RealFFTf);
+   const auto hFFT = plan->GetFFTParam();
+   return HFFT{ hFFT, FFTDeleter{ std::move(plan) } };
 }
 
 /*
@@ -8,20 +8,22 @@ struct FFTParam {
    ArrayOf<int> BitReversed;
    ArrayOf<fft_type> SinTable;
    size_t Points;
-#ifdef EXPERIMENTAL_EQ_SSE_THREADED
-   int pow2Bits;
-#endif
 };
 
-struct FFT_API FFTDeleter{
-   void operator () (FFTParam *p) const;
+//! Keeps the plan owning the tables alive while the handle exists
+struct FFTDeleter{
+   std::shared_ptr<const void> owner;
+   void operator () (FFTParam *) const {}
 };
 
 using HFFT = std::unique_ptr<
    FFTParam, FFTDeleter
 >;
 
-FFT_API HFFT GetFFT(size_t);
+//! Makes the tables, which are not shared; prefer GetFFT or FFTPlan::Get
+FFT_API std::unique_ptr<FFTParam> InitializeFFT(size_t);
+//! Gets the shared tables of RealFFTf for fftlen points, from FFTPlan
+FFT_API HFFT GetFFT(size_t fftlen);
 FFT_API void RealFFTf(fft_type *, const FFTParam *);
 FFT_API void InverseRealFFTf(fft_type *, const FFTParam *);
 FFT_API void ReorderToTime(const FFTParam *hFFT, const fft_type *buffer, fft_type *TimeOut);
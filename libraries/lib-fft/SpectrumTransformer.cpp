@@ -11,8 +11,32 @@ Edward Hui
 #include "SpectrumTransformer.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <cstring>
 #include "FFT.h"
-#include "WaveTrack.h"
+#include "concurrency/TaskPool.h"
+
+namespace {
+// Samples of output of each segment, unless the history of the processor
+// needs longer ones
+constexpr long long DefaultSegmentLength = 1 << 20;
+}
+
+//! The part of the output of one channel that one transformer computes
+struct SpectrumTransformer::Segment
+{
+   //! Samples from some windows before the segment, until some after it
+   FloatVector input;
+   //! Whether the input reaches the end of the range, so the queue is flushed
+   bool flush = false;
+   //! Steps of output of the warm-up windows, to discard
+   long long skipSteps = 0;
+   //! Steps of output to keep after those
+   long long keepSteps = 0;
+   FloatVector output;
+};
 
 SpectrumTransformer::SpectrumTransformer( bool needsOutput,
    eWindowFunctions inWindowType,
@@ -34,12 +58,12 @@ SpectrumTransformer::SpectrumTransformer( bool needsOutput,
    // Check preconditions
 
    // Powers of 2 only!
-   wxASSERT(mWindowSize > 0 &&
+   assert(mWindowSize > 0 &&
       0 == (mWindowSize & (mWindowSize - 1)));
 
-   wxASSERT(mWindowSize % mStepsPerWindow == 0);
+   assert(mWindowSize % mStepsPerWindow == 0);
 
-   wxASSERT(!(inWindowType == eWinFuncRectangular && outWindowType == eWinFuncRectangular));
+   assert(!(inWindowType == eWinFuncRectangular && outWindowType == eWinFuncRectangular));
 
    // To do:  check that inWindowType, outWindowType, and mStepsPerWindow
    // are compatible for correct overlap-add reconstruction.
@@ -79,7 +103,7 @@ SpectrumTransformer::SpectrumTransformer( bool needsOutput,
       pWindow = mOutWindow.data();
    else
       // Can only happen if both window types were rectangular
-      wxASSERT(false);
+      assert(false);
    for (size_t ii = 0; ii < mWindowSize; ++ii)
       *pWindow++ /= denom;
 }
@@ -100,12 +124,6 @@ bool SpectrumTransformer::DoFinish()
    return true;
 }
 
-void
-TrackSpectrumTransformer::DoOutput(const float *outBuffer, size_t mStepSize)
-{
-   mOutputTrack->Append((constSamplePtr)outBuffer, floatSample, mStepSize);
-}
-
 bool SpectrumTransformer::Start(size_t queueLength)
 {
    // Prepare clean queue
@@ -264,13 +282,15 @@ bool SpectrumTransformer::Finish(const WindowProcessor &processor)
 
 size_t SpectrumTransformer::CurrentQueueSize() const
 {
-   auto allocSize = mQueue.size();
-   auto size = mOutStepCount + allocSize;
+   const auto allocSize = mQueue.size();
+   auto size = mOutStepCount + static_cast<long long>(allocSize);
    if (mLeadingPadding)
       size += mStepsPerWindow - 1;
 
-   if (size < allocSize)
-      return size.as_size_t();
+   if (size < static_cast<long long>(allocSize)) {
+      assert(size >= 0);
+      return size;
+   }
    else
       return allocSize;
 }
@@ -322,7 +342,7 @@ void SpectrumTransformer::OutputStep()
       auto buffer = mOutOverlapBuffer.data();
       if (mOutStepCount >= 0) {
          // Output the first portion of the overlap buffer, they're done
-         DoOutput(buffer, mStepSize);
+         Output(buffer);
       }
       // Shift the remainder over.
       memmove(buffer, buffer + mStepSize, sizeof(float)*(mWindowSize - mStepSize));
@@ -338,61 +358,129 @@ bool SpectrumTransformer::QueueIsFull() const
       return (mOutStepCount >= 0);
 }
 
-bool TrackSpectrumTransformer::Process(const WindowProcessor &processor,
-   const WaveChannel &channel, size_t queueLength, sampleCount start,
-   sampleCount len)
+void SpectrumTransformer::Output(const float *outBuffer)
 {
-   mpChannel = &channel;
+   if (!mpSegment) {
+      DoOutput(outBuffer, mStepSize);
+      return;
+   }
 
+   auto &segment = *mpSegment;
+   if (segment.skipSteps > 0)
+      // Output of the warm-up, which may differ from the unsegmented output
+      --segment.skipSteps;
+   else if (segment.keepSteps > 0) {
+      --segment.keepSteps;
+      segment.output.insert(
+         segment.output.end(), outBuffer, outBuffer + mStepSize);
+   }
+}
+
+bool SpectrumTransformer::ProcessSegment(
+   const WindowProcessor &processor, Segment &segment, size_t queueLength)
+{
    if (!Start(queueLength))
       return false;
 
-   auto bufferSize = channel.GetMaxBlockSize();
-   FloatVector buffer(bufferSize);
-
-   bool bLoopSuccess = true;
-   auto samplePos = start;
-   while (bLoopSuccess && samplePos < start + len) {
-      //Get a blockSize of samples (smaller than the size of the buffer)
-      const auto blockSize = limitSampleBufferSize(
-         std::min(bufferSize, channel.GetBestBlockSize(samplePos)),
-         start + len - samplePos);
-
-      //Get the samples from the track and put them in the buffer
-      channel.GetFloats(buffer.data(), samplePos, blockSize);
-      samplePos += blockSize;
-      bLoopSuccess = ProcessSamples(processor, buffer.data(), blockSize);
-   }
+   mpSegment = &segment;
+   auto cleanup = finally([this]{ mpSegment = nullptr; });
 
-   if (!Finish(processor))
+   if (!ProcessSamples(processor, segment.input.data(), segment.input.size()))
       return false;
-
-   return bLoopSuccess;
+   // Flush the queue with zeroes only at the end of the range, as would be
+   // done without segmentation
+   return segment.flush ? Finish(processor) : DoFinish();
 }
 
-bool TrackSpectrumTransformer::DoFinish()
+bool SpectrumTransformer::ProcessConcurrently(const WindowProcessor &processor,
+   const std::vector<Channel> &channels, size_t queueLength,
+   long long len, size_t historyLen, const ProgressReporter &progress,
+   size_t segmentSteps)
 {
-   return SpectrumTransformer::DoFinish();
-}
+   if (channels.empty() || len <= 0)
+      return true;
+
+   std::unique_ptr<SpectrumTransformer> pProbe = channels[0].factory();
+   assert(pProbe->mNeedsOutput);
+   assert(pProbe->mLeadingPadding && pProbe->mTrailingPadding);
+   const auto stepSize = static_cast<long long>(pProbe->mStepSize);
+   const auto stepsPerWindow = static_cast<long long>(pProbe->mStepsPerWindow);
+   pProbe.reset();
+
+   // A segment begins with windows that are processed only so that, when
+   // output begins, all windows of the overlap-add and of the queue, and the
+   // state of the processor, are as without segmentation
+   const auto warmUpSteps = stepsPerWindow - 1 +
+      static_cast<long long>(queueLength + historyLen);
+   // Its input goes on until the queue has passed its last step to output
+   const auto lookAheadSteps =
+      stepsPerWindow - 1 + static_cast<long long>(queueLength);
+   const auto stepsPerSegment = segmentSteps > 0
+      ? static_cast<long long>(segmentSteps)
+      : std::max<long long>(
+         (DefaultSegmentLength + stepSize - 1) / stepSize, 4 * warmUpSteps);
+   const auto nSteps = (len + stepSize - 1) / stepSize;
+   const auto nSegments =
+      std::max<long long>(1, (nSteps + stepsPerSegment - 1) / stepsPerSegment);
+
+   // Do as many segments at once as there are threads, segment after segment
+   // and channel after channel, so that the output is written in order, and
+   // the memory used is bounded
+   const auto nChannels = static_cast<long long>(channels.size());
+   const auto nTasks = nSegments * nChannels;
+   auto &pool = audacity::concurrency::TaskPool::Get();
+   const auto batchSize = static_cast<long long>(pool.GetWorkersCount() + 1);
+
+   std::vector<Segment> segments;
+   std::vector<std::unique_ptr<SpectrumTransformer>> transformers;
+   for (long long first = 0; first < nTasks; first += batchSize) {
+      const auto count = std::min(batchSize, nTasks - first);
+      segments.clear();
+      segments.resize(count);
+      transformers.clear();
+
+      for (long long ii = 0; ii < count; ++ii) {
+         const auto &channel = channels[(first + ii) % nChannels];
+         const auto iSegment = (first + ii) / nChannels;
+         const auto firstStep = iSegment * stepsPerSegment;
+         const auto startStep = std::max<long long>(0, firstStep - warmUpSteps);
+         const auto inputStart = startStep * stepSize;
+         const auto inputEnd = std::min(len,
+            (firstStep + stepsPerSegment + lookAheadSteps) * stepSize);
+
+         auto &segment = segments[ii];
+         segment.input.resize(inputEnd - inputStart);
+         channel.read(segment.input.data(), inputStart, segment.input.size());
+         segment.flush = (inputEnd == len);
+         segment.skipSteps = firstStep - startStep;
+         // The last segment keeps the tail that flushing makes, too
+         segment.keepSteps =
+            iSegment + 1 == nSegments ? LLONG_MAX : stepsPerSegment;
+         transformers.push_back(channel.factory());
+      }
+
+      std::atomic<bool> success{ true };
+      pool.ParallelFor(count, 1, [&](size_t begin, size_t end) {
+         for (auto ii = begin; ii < end; ++ii)
+            if (!transformers[ii]->ProcessSegment(
+               processor, segments[ii], queueLength))
+               success = false;
+      });
+      if (!success)
+         return false;
+
+      for (long long ii = 0; ii < count; ++ii) {
+         const auto &output = segments[ii].output;
+         channels[(first + ii) % nChannels].write(output.data(), output.size());
+      }
+
+      if (progress && !progress(static_cast<double>(first + count) / nTasks))
+         return false;
+   }
 
-bool TrackSpectrumTransformer::PostProcess(
-   WaveTrack &outputTrack, sampleCount len)
-{
-   outputTrack.Flush();
-   auto tLen = outputTrack.LongSamplesToTime(len);
-   // Filtering effects always end up with more data than they started with.
-   // Delete this 'tail'.
-   outputTrack.Clear(tLen, outputTrack.GetEndTime());
    return true;
 }
 
 SpectrumTransformer::~SpectrumTransformer() = default;
 
 SpectrumTransformer::Window::~Window() = default;
-
-TrackSpectrumTransformer::~TrackSpectrumTransformer() = default;
-
-bool TrackSpectrumTransformer::DoStart()
-{
-   return SpectrumTransformer::DoStart();
-}
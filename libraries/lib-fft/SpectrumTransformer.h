@@ -11,28 +11,24 @@ Paul Licameli
 
 #ifndef __AUDACITY_SPECTRUM_TRANSFORMER__
 #define __AUDACITY_SPECTRUM_TRANSFORMER__
- 
+
 #include <functional>
 #include <memory>
 #include <vector>
-#include "audacity/Types.h"
 #include "RealFFTf.h"
-#include "SampleCount.h"
 
 enum eWindowFunctions : int;
 
-class WaveChannel;
-
 /*!
  @brief A class that transforms a portion of a wave track (preserving duration)
  by applying Fourier transform, then modifying coefficients, then inverse
  Fourier transform and overlap-add to reconstruct.
- 
+
  @par The procedure that modifies coefficients can be varied, and can employ lookahead
  and -behind to nearby windows.  May also be used just to gather information
  without producing output.
 */
-class SpectrumTransformer /* not final */
+class FFT_API SpectrumTransformer /* not final */
 {
 public:
    // Public interface
@@ -82,6 +78,44 @@ public:
    /*! @return success */
    bool Finish(const WindowProcessor &processor);
 
+   //! One channel of input for ProcessConcurrently()
+   struct Channel {
+      //! Makes a transformer, with its own state for the processor
+      /*! Its DoOutput() is not called */
+      std::function<std::unique_ptr<SpectrumTransformer>()> factory;
+      //! Fills buffer with len samples, from start samples into the range
+      std::function<void(float *buffer, long long start, size_t len)> read;
+      //! Receives the output, in order, as DoOutput() would
+      std::function<void(const float *buffer, size_t len)> write;
+   };
+
+   //! Type of function reporting the fraction done
+   /*! @return false to abort processing */
+   using ProgressReporter = std::function<bool(double)>;
+
+   //! Like Start(), ProcessSamples() and Finish() for each channel in turn,
+   //! but the channels and segments of their ranges are done concurrently
+   /*!
+    Each segment is processed by its own transformer, beginning some windows
+    before the segment, so that the queue and the state of the processor are
+    as they would be without the segmentation.  The output is the same, to
+    the bit.
+
+    The functions of the channels and progress are called on the calling
+    thread only.  The processor is called concurrently, each time with the
+    transformer of one segment.
+
+    @param historyLen how many windows before those in the queue may still
+    affect the processing of the queue, through state of the processor
+    @param segmentSteps steps of output in each segment, or 0 for a default
+    @pre transformers made by the channels need output and have leading and
+    trailing padding, and all have the same window size and steps
+    */
+   static bool ProcessConcurrently(const WindowProcessor &processor,
+      const std::vector<Channel> &channels, size_t queueLength,
+      long long len, size_t historyLen, const ProgressReporter &progress,
+      size_t segmentSteps = 0);
+
    //! Derive this class to add information to the queue.  @see NewWindow()
    struct Window
    {
@@ -146,10 +180,15 @@ public:
    Window &Latest() { return **mQueue.rbegin(); }
 
 private:
+   struct Segment;
+
    void ResizeQueue(size_t queueLength);
    void FillFirstWindow();
    void RotateWindows();
    void OutputStep();
+   void Output(const float *outBuffer);
+   bool ProcessSegment(const WindowProcessor &processor, Segment &segment,
+      size_t queueLength);
 
 protected:
    const size_t mWindowSize;
@@ -157,7 +196,7 @@ protected:
 
    const unsigned mStepsPerWindow;
    const size_t mStepSize;
-   
+
    const bool mLeadingPadding;
 
    const bool mTrailingPadding;
@@ -165,8 +204,8 @@ protected:
 private:
    std::vector<std::unique_ptr<Window>> mQueue;
    HFFT     hFFT;
-   sampleCount mInSampleCount = 0;
-   sampleCount mOutStepCount = 0; //!< sometimes negative
+   long long mInSampleCount = 0;
+   long long mOutStepCount = 0; //!< sometimes negative
    size_t mInWavePos = 0;
 
    //! These have size mWindowSize:
@@ -178,46 +217,9 @@ private:
    FloatVector mOutWindow;
 
    const bool mNeedsOutput;
-};
 
-class WaveTrack;
-
-//! Subclass of SpectrumTransformer that rewrites a track
-class TrackSpectrumTransformer /* not final */ : public SpectrumTransformer {
-public:
-   /*!
-    @copydoc SpectrumTransformer::SpectrumTransformer(bool,
-       eWindowFunctions, eWindowFunctions, size_t, unsigned, bool, bool)
-    @pre `!needsOutput || pOutputTrack != nullptr`
-    */
-   TrackSpectrumTransformer(WaveChannel *pOutputTrack,
-      bool needsOutput, eWindowFunctions inWindowType,
-      eWindowFunctions outWindowType, size_t windowSize,
-      unsigned stepsPerWindow, bool leadingPadding, bool trailingPadding
-   )  : SpectrumTransformer{ needsOutput, inWindowType, outWindowType,
-         windowSize, stepsPerWindow, leadingPadding, trailingPadding
-      }
-      , mOutputTrack{ pOutputTrack }
-   {
-      assert(!needsOutput || pOutputTrack != nullptr);
-   }
-   ~TrackSpectrumTransformer() override;
-
-   //! Invokes Start(), ProcessSamples(), and Finish()
-   bool Process(const WindowProcessor &processor, const WaveChannel &channel,
-      size_t queueLength, sampleCount start, sampleCount len);
-
-   //! Final flush and trimming of tail samples
-   static bool PostProcess(WaveTrack &outputTrack, sampleCount len);
-
-protected:
-   bool DoStart() override;
-   void DoOutput(const float *outBuffer, size_t mStepSize) override;
-   bool DoFinish() override;
-
-private:
-   WaveChannel *const mOutputTrack;
-   const WaveChannel *mpChannel = nullptr;
+   //! Not null while the transformer does a segment for ProcessConcurrently
+   Segment *mpSegment = nullptr;
 };
 
 #endif
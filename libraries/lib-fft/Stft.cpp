@@ -0,0 +1,168 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file Stft.cpp
+
+**********************************************************************/
+#include "Stft.h"
+#include "FFTPlan.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+// Floats of the windowed frames transformed in one batch, so they stay in
+// the cache between the windowing and the transforms
+constexpr size_t BatchFloats = 1 << 16;
+
+void MultiplyWindow(
+   const float* __restrict samples, const float* __restrict window,
+   float* __restrict frame, size_t count)
+{
+   for (size_t i = 0; i < count; ++i)
+      frame[i] = samples[i] * window[i];
+}
+
+void CopyPower(
+   const float* __restrict spectrum, float* __restrict out, size_t fftLen)
+{
+   const auto half = fftLen / 2;
+   out[0] = spectrum[0] * spectrum[0];
+   for (size_t i = 1; i < half; ++i)
+      out[i] = spectrum[2 * i] * spectrum[2 * i] +
+               spectrum[2 * i + 1] * spectrum[2 * i + 1];
+   out[half] = spectrum[1] * spectrum[1];
+}
+} // namespace
+
+StftSampleSource::~StftSampleSource() = default;
+
+StftBufferSource::StftBufferSource(const float* samples, long long count)
+    : mSamples { samples }
+    , mCount { count }
+{
+}
+
+StftBufferSource::~StftBufferSource() = default;
+
+long long StftBufferSource::GetSampleCount() const
+{
+   return mCount;
+}
+
+size_t StftBufferSource::GetSamples(long long start, const float*& samples)
+{
+   assert(0 <= start && start < mCount);
+   samples = mSamples + start;
+   return static_cast<size_t>(mCount - start);
+}
+
+Stft::Stft(const std::vector<float>& window)
+    : mPlan { FFTPlan::Get(window.size()) }
+    , mWindow(window.begin(), window.end())
+{
+}
+
+Stft::~Stft() = default;
+
+size_t Stft::GetFrameSize(Output output) const noexcept
+{
+   return output == Output::Complex ? GetFftSize() : GetFftSize() / 2 + 1;
+}
+
+void Stft::Compute(
+   StftSampleSource& source, const long long* frameStarts, size_t nFrames,
+   Output output, float* out) const
+{
+   if (nFrames == 0)
+      return;
+
+   const auto fftLen = GetFftSize();
+   const auto frameSize = GetFrameSize(output);
+   const auto stride = PffftAlignedCount { fftLen };
+   const auto batchFrames = std::clamp<size_t>(BatchFloats / fftLen, 1, nFrames);
+
+   // The windowed frames, followed by the work area of the plan
+   PffftFloatVector scratch((batchFrames + 1) * stride);
+   float* const work = scratch.data() + batchFrames * stride;
+
+   for (size_t first = 0; first < nFrames; first += batchFrames)
+   {
+      const auto count = std::min(batchFrames, nFrames - first);
+
+      for (size_t i = 0; i < count; ++i)
+         WindowFrame(
+            source, frameStarts[first + i], scratch.data() + i * stride);
+
+      for (size_t i = 0; i < count; ++i)
+      {
+         float* const spectrum = scratch.data() + i * stride;
+         float* const result = out + (first + i) * frameSize;
+         mPlan->Forward(spectrum, spectrum, work);
+
+         switch (output)
+         {
+         case Output::Complex:
+            std::copy(spectrum, spectrum + fftLen, result);
+            break;
+         case Output::Power:
+            CopyPower(spectrum, result, fftLen);
+            break;
+         case Output::Magnitude:
+            CopyPower(spectrum, result, fftLen);
+            std::transform(result, result + frameSize, result,
+               [](float power) { return std::sqrt(power); });
+            break;
+         }
+      }
+   }
+}
+
+void Stft::Compute(
+   StftSampleSource& source, double firstStart, double hop, size_t nFrames,
+   Output output, float* out) const
+{
+   std::vector<long long> frameStarts(nFrames);
+   for (size_t i = 0; i < nFrames; ++i)
+      frameStarts[i] = std::llround(firstStart + i * hop);
+   Compute(source, frameStarts.data(), nFrames, output, out);
+}
+
+void Stft::WindowFrame(
+   StftSampleSource& source, long long start, float* frame) const
+{
+   const auto fftLen = GetFftSize();
+   const auto sampleCount = source.GetSampleCount();
+
+   size_t i = 0;
+   while (i < fftLen)
+   {
+      const auto position = start + static_cast<long long>(i);
+      if (position < 0)
+      {
+         // Zeroes before the beginning of the source
+         const auto zeroes = static_cast<size_t>(
+            std::min<long long>(-position, fftLen - i));
+         std::fill(frame + i, frame + i + zeroes, 0.0f);
+         i += zeroes;
+      }
+      else if (position >= sampleCount)
+      {
+         // ... and after its end
+         std::fill(frame + i, frame + fftLen, 0.0f);
+         break;
+      }
+      else
+      {
+         const float* samples = nullptr;
+         const auto count =
+            std::min(source.GetSamples(position, samples), fftLen - i);
+         MultiplyWindow(samples, mWindow.data() + i, frame + i, count);
+         i += count;
+      }
+   }
+}
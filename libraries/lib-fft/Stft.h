@@ -0,0 +1,111 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file Stft.h
+  @brief Short-time Fourier transforms of many frames at once
+
+**********************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "PowerSpectrumGetter.h" // PffftFloatVector
+
+class FFTPlan;
+
+//! Gives the samples analysed by Stft, in contiguous pieces
+/*!
+ The pieces are read in place, so a source backed by blocks of samples, such as
+ those of a Sequence, needs not copy them into one buffer first.
+ */
+class FFT_API StftSampleSource
+{
+public:
+   virtual ~StftSampleSource();
+
+   //! The frames are padded with zeroes outside of [0, GetSampleCount())
+   virtual long long GetSampleCount() const = 0;
+
+   //! Points samples at the contiguous samples beginning at start
+   /*!
+    @pre `0 <= start && start < GetSampleCount()`
+    @return how many samples there are at samples, at least 1; they remain
+    valid until the next call
+    */
+   virtual size_t GetSamples(long long start, const float*& samples) = 0;
+};
+
+//! Source of samples which are all in one buffer
+class FFT_API StftBufferSource final : public StftSampleSource
+{
+public:
+   StftBufferSource(const float* samples, long long count);
+   ~StftBufferSource() override;
+
+   long long GetSampleCount() const override;
+   size_t GetSamples(long long start, const float*& samples) override;
+
+private:
+   const float* const mSamples;
+   const long long mCount;
+};
+
+//! Computes the spectra of windowed frames of a source
+/*!
+ The frames are windowed in batches straight from the pieces of the source,
+ then transformed by the shared FFTPlan of the size, and the results are
+ written contiguously, frame after frame.
+
+ Compute does not modify the object, so threads may share one, each with its
+ own source.
+ */
+class FFT_API Stft final
+{
+public:
+   enum class Output
+   {
+      //! fftLen floats, packed as by FFTPlan::Forward
+      Complex,
+      //! fftLen / 2 + 1 squared magnitudes
+      Power,
+      //! fftLen / 2 + 1 magnitudes
+      Magnitude,
+   };
+
+   //! The length of the window is the size of the transforms
+   /*!
+    Zero padding is done by padding the window with zeroes.
+    @pre `window.size()` is a power of 2, or else supported by pffft
+    */
+   explicit Stft(const std::vector<float>& window);
+   ~Stft();
+
+   size_t GetFftSize() const noexcept { return mWindow.size(); }
+
+   //! Number of floats of each frame of the output
+   size_t GetFrameSize(Output output) const noexcept;
+
+   //! Computes the frames beginning at the given positions of the source
+   /*! @param out `nFrames * GetFrameSize(output)` floats */
+   void Compute(
+      StftSampleSource& source, const long long* frameStarts, size_t nFrames,
+      Output output, float* out) const;
+
+   //! Computes the frames beginning at `llround(firstStart + i * hop)`
+   /*! @param out `nFrames * GetFrameSize(output)` floats */
+   void Compute(
+      StftSampleSource& source, double firstStart, double hop, size_t nFrames,
+      Output output, float* out) const;
+
+private:
+   //! Multiplies the window by the samples of the frame beginning at start
+   void WindowFrame(
+      StftSampleSource& source, long long start, float* frame) const;
+
+   const std::shared_ptr<const FFTPlan> mPlan;
+   const PffftFloatVector mWindow;
+};
@@ -0,0 +1,200 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  FFTBenchmark.cpp
+
+**********************************************************************/
+#include "FFT.h"
+#include "FFTPlan.h"
+#include "PartitionedConvolver.h"
+#include "PowerSpectrumGetter.h"
+#include "RealFFTf.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace
+{
+// Set to true to compare the FFT implementations on your machine
+constexpr auto runLocally = false;
+
+// Transforms timed for each implementation and size
+constexpr size_t PointsPerRun = 1 << 24;
+
+//! @return nanoseconds per call of transform
+double Time(size_t fftLen, const std::function<void()>& transform)
+{
+   const auto runs = std::max<size_t>(PointsPerRun / fftLen, 16);
+   // Warm up the caches and the plans
+   transform();
+   const auto start = std::chrono::steady_clock::now();
+   for (size_t i = 0; i < runs; ++i)
+      transform();
+   const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+   return elapsed.count() / runs;
+}
+} // namespace
+
+TEST_CASE("FFTBenchmark")
+{
+   if (!runLocally)
+      return;
+
+   std::printf(
+      "pffft instructions: %s\n"
+      "%8s %12s %12s %12s %12s %14s %14s (ns per transform)\n",
+      FFTPlan::GetPffftInstructionSet(), "size", "RealFFTf", "RealFFT",
+      "plan:RealFFTf", "plan:pffft", "PowerSpectrum",
+      "PowerSpectrumGetter");
+
+   for (size_t fftLen = 64; fftLen <= 32768; fftLen *= 2)
+   {
+      PffftFloatVector signal(fftLen);
+      for (size_t i = 0; i < fftLen; ++i)
+         signal[i] = std::sin(0.01 * i * i);
+      PffftFloatVector buffer(fftLen);
+      PffftFloatVector work(fftLen);
+      PffftFloatVector real(fftLen);
+      PffftFloatVector imag(fftLen);
+
+      // The bit reversed transform, as used before FFTPlan
+      const auto hFFT = GetFFT(fftLen);
+      const auto realFFTf = Time(fftLen, [&] {
+         std::copy(signal.begin(), signal.end(), buffer.begin());
+         RealFFTf(buffer.data(), hFFT.get());
+      });
+
+      // The wrapper of FFT.h, which allocates and reorders
+      const auto realFFT = Time(fftLen, [&] {
+         RealFFT(fftLen, signal.data(), real.data(), imag.data());
+      });
+
+      const auto scalarPlan = FFTPlan::Get(fftLen, FFTPlan::Backend::RealFFTf);
+      const auto planRealFFTf = Time(fftLen, [&] {
+         scalarPlan->Forward(signal.data(), buffer.data(), work.data());
+      });
+
+      const auto pffftPlan = FFTPlan::Get(fftLen, FFTPlan::Backend::Pffft);
+      const auto planPffft = Time(fftLen, [&] {
+         pffftPlan->Forward(signal.data(), buffer.data(), work.data());
+      });
+
+      const auto powerSpectrum = Time(fftLen, [&] {
+         PowerSpectrum(fftLen, signal.data(), real.data());
+      });
+
+      PowerSpectrumGetter getter(static_cast<int>(fftLen));
+      PffftFloatVector power(fftLen / 2 + 1);
+      const auto powerSpectrumGetter = Time(fftLen, [&] {
+         std::copy(signal.begin(), signal.end(), buffer.begin());
+         getter(buffer.aligned(), power.aligned());
+      });
+
+      std::printf(
+         "%8zu %12.0f %12.0f %12.0f %12.0f %14.0f %14.0f\n", fftLen, realFFTf,
+         realFFT, planRealFFTf, planPffft, powerSpectrum, powerSpectrumGetter);
+   }
+}
+
+TEST_CASE("PartitionedConvolverBenchmark")
+{
+   if (!runLocally)
+      return;
+
+   // The window of the overlap-add that Equalization did before
+   constexpr size_t windowSize = 16384;
+   constexpr size_t signalLength = 1 << 20;
+
+   std::printf(
+      "%8s %8s %14s %14s %14s (ns per sample)\n", "taps", "channels",
+      "overlap-add", "offline", "block 256");
+
+   for (const size_t taps : { 21, 1001, 8191 })
+   {
+      std::vector<float> impulse(taps);
+      for (size_t i = 0; i < taps; ++i)
+         impulse[i] = std::sin(0.3 * i) / (i + 1);
+
+      for (const size_t nChannels : { 1, 2 })
+      {
+         std::vector<std::vector<float>> signals(
+            nChannels, std::vector<float>(signalLength));
+         for (auto& signal : signals)
+            for (size_t i = 0; i < signalLength; ++i)
+               signal[i] = std::sin(0.01 * i * i);
+         std::vector<std::vector<float>> outputs = signals;
+
+         // One channel after another, with the bit reversed transforms
+         std::vector<float> filterR(windowSize), filterI(windowSize);
+         std::vector<float> padded(windowSize);
+         std::copy(impulse.begin(), impulse.end(), padded.begin());
+         RealFFT(windowSize, padded.data(), filterR.data(), filterI.data());
+         const auto hFFT = GetFFT(windowSize);
+         std::vector<float> thisWindow(windowSize), lastWindow(windowSize);
+         std::vector<float> spectrum(windowSize);
+         const auto overlapAdd = Time(signalLength, [&] {
+            const auto L = windowSize - (taps - 1);
+            for (size_t channel = 0; channel < nChannels; ++channel)
+               for (size_t i = 0; i < signalLength; i += L)
+               {
+                  const auto count = std::min(L, signalLength - i);
+                  std::copy_n(
+                     signals[channel].begin() + i, count, thisWindow.begin());
+                  std::fill(
+                     thisWindow.begin() + count, thisWindow.end(), 0.0f);
+                  RealFFTf(thisWindow.data(), hFFT.get());
+                  spectrum[0] = thisWindow[0] * filterR[0];
+                  for (size_t k = 1; k < windowSize / 2; ++k)
+                  {
+                     const auto re = thisWindow[hFFT->BitReversed[k]];
+                     const auto im = thisWindow[hFFT->BitReversed[k] + 1];
+                     spectrum[2 * k] = re * filterR[k] - im * filterI[k];
+                     spectrum[2 * k + 1] = re * filterI[k] + im * filterR[k];
+                  }
+                  spectrum[1] = thisWindow[1] * filterR[windowSize / 2];
+                  InverseRealFFTf(spectrum.data(), hFFT.get());
+                  ReorderToTime(hFFT.get(), spectrum.data(), thisWindow.data());
+                  for (size_t j = 0; j < count; ++j)
+                     outputs[channel][i + j] =
+                        thisWindow[j] + (j < taps - 1 ? lastWindow[L + j] : 0);
+                  std::swap(thisWindow, lastWindow);
+               }
+         });
+
+         const auto timeConvolver = [&](size_t blockSize) {
+            PartitionedConvolver convolver { blockSize, nChannels, taps };
+            convolver.SetImpulse(impulse.data(), taps);
+            std::vector<const float*> in(nChannels);
+            std::vector<float*> out(nChannels);
+            return Time(signalLength, [&] {
+               for (size_t i = 0; i < signalLength; i += blockSize)
+               {
+                  for (size_t channel = 0; channel < nChannels; ++channel)
+                  {
+                     in[channel] = signals[channel].data() + i;
+                     out[channel] = outputs[channel].data() + i;
+                  }
+                  convolver.ProcessBlock(in.data(), out.data());
+               }
+            });
+         };
+         const auto offline =
+            timeConvolver(PartitionedConvolver::OfflineBlockSize(taps));
+         const auto lowLatency = timeConvolver(256);
+
+         const double samples = signalLength * nChannels;
+         std::printf(
+            "%8zu %8zu %14.2f %14.2f %14.2f\n", taps, nChannels,
+            overlapAdd / samples, offline / samples, lowLatency / samples);
+      }
+   }
+}
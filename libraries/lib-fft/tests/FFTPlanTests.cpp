@@ -0,0 +1,198 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  FFTPlanTests.cpp
+
+**********************************************************************/
+#include "FFT.h"
+#include "FFTPlan.h"
+#include "RealFFTf.h"
+
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace
+{
+PffftFloatVector MakeSignal(size_t size)
+{
+   PffftFloatVector signal(size);
+   for (size_t i = 0; i < size; ++i)
+      signal[i] = std::sin(0.1 * i * i) + 0.25f * std::cos(3.0 * i);
+   return signal;
+}
+
+//! The packed layout of FFTPlan::Forward, computed by definition
+std::vector<double> DirectDFT(const PffftFloatVector& signal)
+{
+   const auto size = signal.size();
+   std::vector<double> result(size);
+   for (size_t k = 0; k <= size / 2; ++k)
+   {
+      double re = 0, im = 0;
+      for (size_t n = 0; n < size; ++n)
+      {
+         const auto angle = -2 * M_PI * k * n / size;
+         re += signal[n] * std::cos(angle);
+         im += signal[n] * std::sin(angle);
+      }
+      if (k == 0)
+         result[0] = re;
+      else if (k == size / 2)
+         result[1] = re;
+      else
+      {
+         result[2 * k] = re;
+         result[2 * k + 1] = im;
+      }
+   }
+   return result;
+}
+} // namespace
+
+TEST_CASE("FFTPlan::IsPffftSupported")
+{
+   REQUIRE(FFTPlan::IsPffftSupported(32));
+   REQUIRE(FFTPlan::IsPffftSupported(96));
+   REQUIRE(FFTPlan::IsPffftSupported(480));
+   REQUIRE(FFTPlan::IsPffftSupported(4096));
+   REQUIRE(!FFTPlan::IsPffftSupported(0));
+   REQUIRE(!FFTPlan::IsPffftSupported(16));
+   REQUIRE(!FFTPlan::IsPffftSupported(224));
+}
+
+TEST_CASE("FFTPlan::Get")
+{
+   SECTION("plans are shared")
+   {
+      const auto plan = FFTPlan::Get(1024);
+      REQUIRE(plan == FFTPlan::Get(1024));
+      REQUIRE(plan->GetSize() == 1024);
+      REQUIRE(plan->GetBackend() == FFTPlan::Backend::Pffft);
+      REQUIRE(plan->GetFFTParam() == nullptr);
+   }
+
+   SECTION("RealFFTf is used for the sizes pffft does not support")
+   {
+      const auto plan = FFTPlan::Get(16);
+      REQUIRE(plan->GetBackend() == FFTPlan::Backend::RealFFTf);
+      REQUIRE(plan->GetFFTParam() != nullptr);
+      REQUIRE(plan->GetFFTParam()->Points == 8);
+   }
+
+   SECTION("GetFFT shares the tables of the plans")
+   {
+      const auto hFFT = GetFFT(2048);
+      REQUIRE(
+         hFFT.get() ==
+         FFTPlan::Get(2048, FFTPlan::Backend::RealFFTf)->GetFFTParam());
+   }
+
+   SECTION("concurrent checkouts get the same plan")
+   {
+      constexpr auto threadsCount = 8;
+      std::vector<std::shared_ptr<const FFTPlan>> plans(threadsCount);
+      std::vector<std::thread> threads;
+      for (auto i = 0; i < threadsCount; ++i)
+         threads.emplace_back([&plans, i] { plans[i] = FFTPlan::Get(8192); });
+      for (auto& thread : threads)
+         thread.join();
+      for (const auto& plan : plans)
+         REQUIRE(plan == plans[0]);
+   }
+}
+
+TEST_CASE("FFTPlan transforms")
+{
+   const auto backend =
+      GENERATE(FFTPlan::Backend::Pffft, FFTPlan::Backend::RealFFTf);
+   const size_t size = GENERATE(8, 32, 64, 96, 512, 2048);
+
+   if (backend == FFTPlan::Backend::RealFFTf && size % 3 == 0)
+      return;
+
+   const auto plan = FFTPlan::Get(size, backend);
+   const auto signal = MakeSignal(size);
+   PffftFloatVector spectrum(size);
+   PffftFloatVector work(size);
+
+   plan->Forward(signal.data(), spectrum.data(), work.data());
+
+   SECTION("Forward computes the DFT")
+   {
+      const auto expected = DirectDFT(signal);
+      for (size_t i = 0; i < size; ++i)
+         REQUIRE(spectrum[i] == Approx(expected[i]).margin(1e-3 * size));
+   }
+
+   SECTION("Forward may be done in place")
+   {
+      auto buffer = signal;
+      plan->Forward(buffer.data(), buffer.data(), work.data());
+      REQUIRE(buffer == spectrum);
+   }
+
+   SECTION("Inverse undoes Forward, except for the factor fftLen")
+   {
+      PffftFloatVector result(size);
+      plan->Inverse(spectrum.data(), result.data(), work.data());
+      for (size_t i = 0; i < size; ++i)
+         REQUIRE(result[i] / size == Approx(signal[i]).margin(1e-5));
+   }
+
+   SECTION("MultiplyAccumulate convolves circularly")
+   {
+      PffftFloatVector other(size);
+      for (size_t i = 0; i < size; ++i)
+         other[i] = 1.0f / (i + 1);
+      PffftFloatVector a(size), b(size), sum(size);
+      plan->ForwardUnordered(signal.data(), a.data(), work.data());
+      plan->ForwardUnordered(other.data(), b.data(), work.data());
+      // Twice, with half the scale each time
+      plan->MultiplyAccumulate(a.data(), b.data(), sum.data(), 0.5f / size);
+      plan->MultiplyAccumulate(a.data(), b.data(), sum.data(), 0.5f / size);
+      plan->InverseUnordered(sum.data(), sum.data(), work.data());
+      for (size_t n = 0; n < size; ++n)
+      {
+         double expected = 0;
+         for (size_t k = 0; k < size; ++k)
+            expected += double(signal[k]) * other[(n + size - k) % size];
+         REQUIRE(sum[n] == Approx(expected).margin(1e-4));
+      }
+   }
+}
+
+TEST_CASE("RealFFT, InverseRealFFT and PowerSpectrum")
+{
+   const size_t size = GENERATE(16, 1024);
+   const auto signal = MakeSignal(size);
+   const auto expected = DirectDFT(signal);
+
+   std::vector<float> real(size), imag(size);
+   RealFFT(size, signal.data(), real.data(), imag.data());
+   REQUIRE(real[0] == Approx(expected[0]).margin(1e-3 * size));
+   REQUIRE(real[size / 2] == Approx(expected[1]).margin(1e-3 * size));
+   for (size_t k = 1; k < size / 2; ++k)
+   {
+      REQUIRE(real[k] == Approx(expected[2 * k]).margin(1e-3 * size));
+      REQUIRE(imag[k] == Approx(expected[2 * k + 1]).margin(1e-3 * size));
+      REQUIRE(real[size - k] == real[k]);
+      REQUIRE(imag[size - k] == -imag[k]);
+   }
+
+   std::vector<float> power(size / 2 + 1);
+   PowerSpectrum(size, signal.data(), power.data());
+   for (size_t k = 0; k <= size / 2; ++k)
+      REQUIRE(
+         power[k] ==
+         Approx(real[k] * real[k] + imag[k] * imag[k]).epsilon(1e-4).margin(1e-3));
+
+   std::vector<float> result(size);
+   InverseRealFFT(size, real.data(), imag.data(), result.data());
+   for (size_t i = 0; i < size; ++i)
+      REQUIRE(result[i] == Approx(signal[i]).margin(1e-5));
+}
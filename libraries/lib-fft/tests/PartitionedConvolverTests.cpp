@@ -0,0 +1,169 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PartitionedConvolverTests.cpp
+
+**********************************************************************/
+#include "PartitionedConvolver.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+std::vector<float> MakeNoise(size_t size, unsigned seed)
+{
+   std::mt19937 engine { seed };
+   std::uniform_real_distribution<float> noise { -1.0f, 1.0f };
+   std::vector<float> result(size);
+   for (auto& sample : result)
+      sample = noise(engine);
+   return result;
+}
+
+//! The first size samples of the convolution, computed the obvious way
+std::vector<float> Convolve(
+   const std::vector<float>& signal, const std::vector<float>& impulse,
+   size_t size)
+{
+   std::vector<float> result(size);
+   for (size_t n = 0; n < size; ++n)
+   {
+      double sum = 0;
+      for (size_t k = 0; k < impulse.size() && k <= n; ++k)
+         if (n - k < signal.size())
+            sum += double(impulse[k]) * signal[n - k];
+      result[n] = sum;
+   }
+   return result;
+}
+
+void RequireClose(
+   const float* actual, const std::vector<float>& expected, size_t offset,
+   size_t count)
+{
+   for (size_t i = 0; i < count; ++i)
+      REQUIRE(actual[i] == Approx(expected[offset + i]).margin(1e-4));
+}
+} // namespace
+
+TEST_CASE("PartitionedConvolver")
+{
+   const size_t blockSize = GENERATE(16, 64, 1024);
+   const size_t impulseLength = GENERATE(1, 15, 100, 1000);
+   const size_t nChannels = GENERATE(1, 3);
+   constexpr size_t nBlocks = 12;
+   const auto length = blockSize * nBlocks;
+
+   const auto impulse = MakeNoise(impulseLength, 7);
+   std::vector<std::vector<float>> signals;
+   std::vector<std::vector<float>> expected;
+   for (size_t channel = 0; channel < nChannels; ++channel)
+   {
+      signals.push_back(MakeNoise(length, channel));
+      expected.push_back(Convolve(signals.back(), impulse, length));
+   }
+
+   PartitionedConvolver convolver { blockSize, nChannels, impulseLength };
+   REQUIRE(convolver.GetBlockSize() == blockSize);
+   REQUIRE(convolver.GetChannelsCount() == nChannels);
+   convolver.SetImpulse(impulse.data(), impulse.size());
+
+   SECTION("Blocks are convolved without delay")
+   {
+      std::vector<float> buffers(nChannels * blockSize);
+      std::vector<const float*> in(nChannels);
+      std::vector<float*> out(nChannels);
+      for (size_t block = 0; block < nBlocks; ++block)
+      {
+         const auto offset = block * blockSize;
+         for (size_t channel = 0; channel < nChannels; ++channel)
+         {
+            in[channel] = signals[channel].data() + offset;
+            out[channel] = buffers.data() + channel * blockSize;
+         }
+         convolver.ProcessBlock(in.data(), out.data());
+         for (size_t channel = 0; channel < nChannels; ++channel)
+            RequireClose(out[channel], expected[channel], offset, blockSize);
+      }
+   }
+
+   SECTION("Any lengths are convolved with the latency, in place")
+   {
+      auto buffers = signals;
+      std::vector<float*> pointers(nChannels);
+      size_t offset = 0;
+      for (size_t count = 1; offset < length; count = count * 3 + 1)
+      {
+         count = std::min(count, length - offset);
+         for (size_t channel = 0; channel < nChannels; ++channel)
+            pointers[channel] = buffers[channel].data() + offset;
+         convolver.Process(pointers.data(), pointers.data(), count);
+         offset += count;
+      }
+
+      const auto latency = convolver.GetLatency();
+      for (size_t channel = 0; channel < nChannels; ++channel)
+      {
+         REQUIRE(std::all_of(
+            buffers[channel].begin(), buffers[channel].begin() + latency,
+            [](float sample) { return sample == 0; }));
+         RequireClose(
+            buffers[channel].data() + latency, expected[channel], 0,
+            length - latency);
+      }
+   }
+
+   SECTION("A new response applies to the input already given")
+   {
+      const auto half = (nBlocks / 2) * blockSize;
+      std::vector<float> buffer(blockSize);
+      std::vector<const float*> in(nChannels);
+      std::vector<float*> out(nChannels, buffer.data());
+      for (size_t offset = 0; offset < half; offset += blockSize)
+      {
+         for (size_t channel = 0; channel < nChannels; ++channel)
+            in[channel] = signals[channel].data() + offset;
+         // Only the last channel is kept
+         convolver.ProcessBlock(in.data(), out.data());
+      }
+
+      const auto newImpulse = MakeNoise(impulseLength, 8);
+      convolver.SetImpulse(newImpulse.data(), newImpulse.size());
+      const auto newExpected =
+         Convolve(signals.back(), newImpulse, length);
+      for (size_t offset = half; offset < length; offset += blockSize)
+      {
+         for (size_t channel = 0; channel < nChannels; ++channel)
+            in[channel] = signals[channel].data() + offset;
+         convolver.ProcessBlock(in.data(), out.data());
+         RequireClose(buffer.data(), newExpected, offset, blockSize);
+      }
+
+      // After Reset, the earlier input is forgotten
+      convolver.Reset();
+      const std::vector<float> tail(
+         signals.back().begin() + half, signals.back().end());
+      const auto tailExpected = Convolve(tail, newImpulse, tail.size());
+      for (size_t offset = 0; offset < tail.size(); offset += blockSize)
+      {
+         for (size_t channel = 0; channel < nChannels; ++channel)
+            in[channel] = signals[channel].data() + half + offset;
+         convolver.ProcessBlock(in.data(), out.data());
+         RequireClose(buffer.data(), tailExpected, offset, blockSize);
+      }
+   }
+}
+
+TEST_CASE("PartitionedConvolver::OfflineBlockSize")
+{
+   REQUIRE(PartitionedConvolver::OfflineBlockSize(21) == 256);
+   REQUIRE(PartitionedConvolver::OfflineBlockSize(256) == 256);
+   REQUIRE(PartitionedConvolver::OfflineBlockSize(8191) == 8192);
+}
@@ -0,0 +1,151 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrumTransformerTests.cpp
+
+**********************************************************************/
+#include "FFT.h"
+#include "SpectrumTransformer.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr size_t WindowSize = 256;
+constexpr unsigned StepsPerWindow = 4;
+constexpr size_t QueueLength = 3;
+constexpr auto Floor = 1.0f / 1024;
+// Windows through which the gain falls from 1 to the floor
+constexpr size_t HistoryLen = 10;
+
+class TestTransformer final : public SpectrumTransformer
+{
+public:
+   explicit TestTransformer(std::vector<float>* pOutput = nullptr)
+       : SpectrumTransformer { true,           eWinFuncHann,
+                               eWinFuncHann,   WindowSize,
+                               StepsPerWindow, true,
+                               true }
+       , mpOutput { pOutput }
+   {
+   }
+
+   bool DoStart() override
+   {
+      mGain = Floor;
+      return true;
+   }
+
+   void DoOutput(const float* outBuffer, size_t stepSize) override
+   {
+      mpOutput->insert(mpOutput->end(), outBuffer, outBuffer + stepSize);
+   }
+
+   float mGain = Floor;
+
+private:
+   std::vector<float>* const mpOutput;
+};
+
+//! Looks ahead in the queue, and has state that outlives the queue
+bool Processor(SpectrumTransformer& trans)
+{
+   auto& transformer = static_cast<TestTransformer&>(trans);
+   const auto loud = std::abs(transformer.Newest().mRealFFTs[0]) > 20 ||
+                     std::abs(transformer.Nth(1).mRealFFTs[0]) > 20;
+   transformer.mGain =
+      loud ? 1.0f : std::max(Floor, transformer.mGain * 0.5f);
+
+   auto& latest = transformer.Latest();
+   for (auto& coefficient : latest.mRealFFTs)
+      coefficient *= transformer.mGain;
+   for (auto& coefficient : latest.mImagFFTs)
+      coefficient *= transformer.mGain;
+   return true;
+}
+
+std::vector<float> MakeSignal(size_t size, unsigned seed)
+{
+   std::mt19937 engine { seed };
+   std::uniform_real_distribution<float> noise { -0.1f, 0.1f };
+   std::vector<float> signal(size);
+   for (size_t i = 0; i < size; ++i)
+   {
+      signal[i] = noise(engine);
+      // Loud bursts now and then
+      if ((i / 1000) % 7 == 3)
+         signal[i] += 0.8f;
+   }
+   return signal;
+}
+
+std::vector<float> ProcessSerially(const std::vector<float>& signal)
+{
+   std::vector<float> output;
+   TestTransformer transformer { &output };
+   REQUIRE(transformer.Start(QueueLength));
+   // Feed in uneven pieces, as blocks of a track would be
+   for (size_t pos = 0; pos < signal.size(); pos += 1000)
+      REQUIRE(transformer.ProcessSamples(
+         Processor, signal.data() + pos,
+         std::min<size_t>(1000, signal.size() - pos)));
+   REQUIRE(transformer.Finish(Processor));
+   return output;
+}
+} // namespace
+
+TEST_CASE("SpectrumTransformer::ProcessConcurrently")
+{
+   const size_t length = GENERATE(50, 12345, 40000);
+   const size_t segmentSteps = GENERATE(1, 7, 40, 0);
+
+   const std::vector<std::vector<float>> signals { MakeSignal(length, 1),
+                                                   MakeSignal(length, 2) };
+   std::vector<std::vector<float>> outputs(signals.size());
+
+   std::vector<SpectrumTransformer::Channel> channels;
+   for (size_t ii = 0; ii < signals.size(); ++ii)
+      channels.push_back(
+         { [] { return std::make_unique<TestTransformer>(); },
+           [&signal = signals[ii]](float* buffer, long long start, size_t len) {
+              REQUIRE(start >= 0);
+              REQUIRE(start + len <= signal.size());
+              std::copy_n(signal.begin() + start, len, buffer);
+           },
+           [&output = outputs[ii]](const float* buffer, size_t len) {
+              output.insert(output.end(), buffer, buffer + len);
+           } });
+
+   double lastFraction = 0;
+   REQUIRE(SpectrumTransformer::ProcessConcurrently(
+      Processor, channels, QueueLength, length, HistoryLen,
+      [&](double fraction) {
+         REQUIRE(fraction > lastFraction);
+         lastFraction = fraction;
+         return true;
+      },
+      segmentSteps));
+   REQUIRE(lastFraction == 1.0);
+
+   for (size_t ii = 0; ii < signals.size(); ++ii)
+   {
+      // The very same samples as without segmentation
+      const auto expected = ProcessSerially(signals[ii]);
+      REQUIRE(outputs[ii].size() == expected.size());
+      REQUIRE(outputs[ii] == expected);
+   }
+
+   SECTION("Processing may be cancelled")
+   {
+      REQUIRE(!SpectrumTransformer::ProcessConcurrently(
+         Processor, channels, QueueLength, length, HistoryLen,
+         [](double) { return false; }, segmentSteps));
+   }
+}
@@ -0,0 +1,170 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  StftTests.cpp
+
+**********************************************************************/
+#include "FFTPlan.h"
+#include "Stft.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+//! Gives the samples in pieces of a few samples, like the blocks of a Sequence
+class ChoppedSource final : public StftSampleSource
+{
+public:
+   ChoppedSource(const std::vector<float>& samples, size_t pieceSize)
+       : mSamples { samples }
+       , mPieceSize { pieceSize }
+   {
+   }
+
+   long long GetSampleCount() const override
+   {
+      return static_cast<long long>(mSamples.size());
+   }
+
+   size_t GetSamples(long long start, const float*& samples) override
+   {
+      // Copy, so that reading a stale piece is detected
+      const auto position = static_cast<size_t>(start);
+      const auto pieceStart = position - position % mPieceSize;
+      const auto pieceEnd =
+         std::min(pieceStart + mPieceSize, mSamples.size());
+      mPiece.assign(
+         mSamples.begin() + pieceStart, mSamples.begin() + pieceEnd);
+      samples = mPiece.data() + (position - pieceStart);
+      return pieceEnd - position;
+   }
+
+private:
+   const std::vector<float>& mSamples;
+   const size_t mPieceSize;
+   std::vector<float> mPiece;
+};
+
+std::vector<float> MakeSignal(size_t size)
+{
+   std::vector<float> signal(size);
+   for (size_t i = 0; i < size; ++i)
+      signal[i] = std::sin(0.05 * i) + 0.5f * std::sin(0.3 * i + 1);
+   return signal;
+}
+
+std::vector<float> MakeHann(size_t size)
+{
+   std::vector<float> window(size);
+   for (size_t i = 0; i < size; ++i)
+      window[i] = 0.5 - 0.5 * std::cos(2 * M_PI * i / size);
+   return window;
+}
+
+//! One frame computed the obvious way
+std::vector<float> ExpectedFrame(
+   const std::vector<float>& signal, const std::vector<float>& window,
+   long long start)
+{
+   const auto fftLen = window.size();
+   PffftFloatVector frame(fftLen);
+   PffftFloatVector work(fftLen);
+   for (size_t i = 0; i < fftLen; ++i)
+   {
+      const auto position = start + static_cast<long long>(i);
+      if (position >= 0 && position < static_cast<long long>(signal.size()))
+         frame[i] = signal[position] * window[i];
+   }
+   FFTPlan::Get(fftLen)->Forward(frame.data(), frame.data(), work.data());
+   return { frame.begin(), frame.end() };
+}
+} // namespace
+
+TEST_CASE("Stft")
+{
+   constexpr size_t fftLen = 256;
+   const auto signal = MakeSignal(5000);
+   const auto window = MakeHann(fftLen);
+   const Stft stft { window };
+
+   REQUIRE(stft.GetFftSize() == fftLen);
+   REQUIRE(stft.GetFrameSize(Stft::Output::Complex) == fftLen);
+   REQUIRE(stft.GetFrameSize(Stft::Output::Power) == fftLen / 2 + 1);
+
+   // Frames overlapping both ends of the signal are padded with zeroes
+   const std::vector<long long> starts { -300, -100, 0, 77, 1000, 4900, 5100 };
+   const auto nFrames = starts.size();
+
+   const auto pieceSize = GENERATE(size_t { 13 }, size_t { 4096 });
+   ChoppedSource source { signal, pieceSize };
+
+   SECTION("Complex output")
+   {
+      std::vector<float> out(nFrames * fftLen);
+      stft.Compute(
+         source, starts.data(), nFrames, Stft::Output::Complex, out.data());
+      for (size_t f = 0; f < nFrames; ++f)
+      {
+         const auto expected = ExpectedFrame(signal, window, starts[f]);
+         for (size_t i = 0; i < fftLen; ++i)
+            REQUIRE(out[f * fftLen + i] == Approx(expected[i]).margin(1e-3));
+      }
+   }
+
+   SECTION("Power and magnitude output")
+   {
+      const auto frameSize = fftLen / 2 + 1;
+      std::vector<float> power(nFrames * frameSize);
+      std::vector<float> magnitude(nFrames * frameSize);
+      stft.Compute(
+         source, starts.data(), nFrames, Stft::Output::Power, power.data());
+      stft.Compute(
+         source, starts.data(), nFrames, Stft::Output::Magnitude,
+         magnitude.data());
+      for (size_t f = 0; f < nFrames; ++f)
+      {
+         const auto expected = ExpectedFrame(signal, window, starts[f]);
+         const auto at = [&](size_t bin) {
+            if (bin == 0)
+               return expected[0] * expected[0];
+            if (bin == fftLen / 2)
+               return expected[1] * expected[1];
+            return expected[2 * bin] * expected[2 * bin] +
+                   expected[2 * bin + 1] * expected[2 * bin + 1];
+         };
+         for (size_t bin = 0; bin < frameSize; ++bin)
+         {
+            REQUIRE(
+               power[f * frameSize + bin] ==
+               Approx(at(bin)).epsilon(1e-4).margin(1e-3));
+            REQUIRE(
+               magnitude[f * frameSize + bin] ==
+               Approx(std::sqrt(at(bin))).epsilon(1e-4).margin(1e-3));
+         }
+      }
+   }
+
+   SECTION("Uniform hop rounds the frame positions")
+   {
+      StftBufferSource bufferSource { signal.data(),
+                                      static_cast<long long>(signal.size()) };
+      constexpr size_t count = 40;
+      constexpr auto hop = 110.25;
+      std::vector<float> out(count * fftLen);
+      stft.Compute(
+         bufferSource, -64.0, hop, count, Stft::Output::Complex, out.data());
+      for (size_t f = 0; f < count; ++f)
+      {
+         const auto expected =
+            ExpectedFrame(signal, window, std::llround(-64.0 + f * hop));
+         for (size_t i = 0; i < fftLen; ++i)
+            REQUIRE(out[f * fftLen + i] == Approx(expected[i]).margin(1e-3));
+      }
+   }
+}
@@ -42,6 +42,8 @@ public:
       WaveBitmapCachePreprocess,
       //! Time required to access the wave bitmaps cache
       WaveBitmapCache,
+      //! Time from requesting a wave data cache element in background to its arrival
+      WaveDataCacheBackground,
       //! Number of the sections
       Count
    };
@@ -106,8 +108,9 @@ public:
    static const Section& GetSection(SectionID section) noexcept;
    //! Subscribe to sections update
    static Observer::Subscription Subscribe(UpdatePublisher::Callback callback);
+   //! Add an event measured without a Stopwatch. Must be called from the main thread
+   static void AddEvent(SectionID section, Duration duration);
 private:
-   void AddEvent(SectionID section, Duration duration);
 
    Section mSections[size_t(SectionID::Count)];
 
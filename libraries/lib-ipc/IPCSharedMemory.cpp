@@ -0,0 +1,344 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file IPCSharedMemory.cpp
+
+  Part of lib-ipc library
+
+**********************************************************************/
+
+#include "IPCSharedMemory.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <mutex>
+#include <unordered_map>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#elif !defined(__APPLE__)
+#include <thread>
+#endif
+#endif
+
+#if defined(__APPLE__)
+// Not in the SDK headers, but used by libc++ for std::atomic::wait since
+// macOS 10.12; the shared operation works across processes
+extern "C" int __ulock_wait(
+   uint32_t operation, void* address, uint64_t value, uint32_t timeout);
+extern "C" int __ulock_wake(
+   uint32_t operation, void* address, uint64_t wakeValue);
+#endif
+
+namespace
+{
+   std::string MakeName()
+   {
+      static std::atomic<unsigned> counter{ 0 };
+#ifdef _WIN32
+      const auto pid = static_cast<unsigned long>(GetCurrentProcessId());
+      const std::string prefix = "Local\\audacity-";
+#else
+      const auto pid = static_cast<unsigned long>(getpid());
+      // Some systems limit names to 31 characters
+      const std::string prefix = "/audacity-";
+#endif
+      return prefix + std::to_string(pid) + "-" + std::to_string(++counter);
+   }
+}
+
+#ifdef _WIN32
+
+class IPCSharedMemory::Impl final
+{
+public:
+   HANDLE mMapping{ nullptr };
+   void* mData{ nullptr };
+   size_t mSize{ 0 };
+   std::string mName;
+
+   std::mutex mEventsMutex;
+   //! Auto-reset events for Wait and Wake, by the offsets of the words
+   std::unordered_map<size_t, HANDLE> mEvents;
+
+   ~Impl()
+   {
+      for(const auto& [offset, event] : mEvents)
+         if(event != nullptr)
+            CloseHandle(event);
+      if(mData != nullptr)
+         UnmapViewOfFile(mData);
+      if(mMapping != nullptr)
+         CloseHandle(mMapping);
+   }
+
+   bool Map()
+   {
+      mData = MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, mSize);
+      return mData != nullptr;
+   }
+
+   //! WaitOnAddress works only within one process, so the processes
+   //! find the same event by name instead
+   HANDLE GetEvent(const std::atomic<uint32_t>& word)
+   {
+      const auto offset = static_cast<size_t>(
+         reinterpret_cast<const char*>(&word) - static_cast<char*>(mData));
+      std::lock_guard lock{ mEventsMutex };
+      auto& event = mEvents[offset];
+      if(event == nullptr)
+         // Created by the first process to use it, opened by the other
+         event = CreateEventA(nullptr, FALSE, FALSE,
+            (mName + "-wake-" + std::to_string(offset)).c_str());
+      return event;
+   }
+};
+
+std::unique_ptr<IPCSharedMemory> IPCSharedMemory::Create(size_t size)
+{
+   auto impl = std::make_unique<Impl>();
+   impl->mSize = size;
+   impl->mName = MakeName();
+   const auto size64 = static_cast<unsigned long long>(size);
+   impl->mMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+      PAGE_READWRITE, static_cast<DWORD>(size64 >> 32),
+      static_cast<DWORD>(size64 & 0xFFFFFFFF), impl->mName.c_str());
+   if(impl->mMapping == nullptr || GetLastError() == ERROR_ALREADY_EXISTS)
+      return nullptr;
+   if(!impl->Map())
+      return nullptr;
+   return std::unique_ptr<IPCSharedMemory>{ new IPCSharedMemory(std::move(impl)) };
+}
+
+std::unique_ptr<IPCSharedMemory> IPCSharedMemory::Open(
+   const std::string& name, size_t size)
+{
+   auto impl = std::make_unique<Impl>();
+   impl->mSize = size;
+   impl->mName = name;
+   impl->mMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+   if(impl->mMapping == nullptr || !impl->Map())
+      return nullptr;
+   return std::unique_ptr<IPCSharedMemory>{ new IPCSharedMemory(std::move(impl)) };
+}
+
+void IPCSharedMemory::RemoveName() noexcept
+{
+}
+
+void IPCSharedMemory::Wait(const std::atomic<uint32_t>& word,
+   uint32_t expected, std::chrono::milliseconds timeout) const
+{
+   const auto event = mImpl->GetEvent(word);
+   // A Wake between this check and the wait leaves the event set
+   if(word.load(std::memory_order_acquire) != expected)
+      return;
+   if(event == nullptr)
+   {
+      Sleep(1);
+      return;
+   }
+   WaitForSingleObject(event, static_cast<DWORD>(
+      std::min<long long>(timeout.count(), INFINITE - 1)));
+}
+
+void IPCSharedMemory::Wake(std::atomic<uint32_t>& word) const
+{
+   if(const auto event = mImpl->GetEvent(word); event != nullptr)
+      SetEvent(event);
+}
+
+#else
+
+class IPCSharedMemory::Impl final
+{
+public:
+   void* mData{ MAP_FAILED };
+   size_t mSize{ 0 };
+   std::string mName;
+   bool mOwner{ false };
+
+   ~Impl()
+   {
+      if(mData != MAP_FAILED)
+         munmap(mData, mSize);
+      if(mOwner)
+         shm_unlink(mName.c_str());
+   }
+
+   bool Map(int fd)
+   {
+      mData = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      return mData != MAP_FAILED;
+   }
+};
+
+std::unique_ptr<IPCSharedMemory> IPCSharedMemory::Create(size_t size)
+{
+   auto impl = std::make_unique<Impl>();
+   impl->mSize = size;
+   impl->mName = MakeName();
+   const auto fd =
+      shm_open(impl->mName.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+   if(fd == -1)
+      return nullptr;
+   impl->mOwner = true;
+   if(ftruncate(fd, static_cast<off_t>(size)) == -1)
+   {
+      close(fd);
+      return nullptr;
+   }
+   if(!impl->Map(fd))
+      return nullptr;
+   return std::unique_ptr<IPCSharedMemory>{ new IPCSharedMemory(std::move(impl)) };
+}
+
+std::unique_ptr<IPCSharedMemory> IPCSharedMemory::Open(
+   const std::string& name, size_t size)
+{
+   auto impl = std::make_unique<Impl>();
+   impl->mSize = size;
+   impl->mName = name;
+   const auto fd = shm_open(name.c_str(), O_RDWR, 0);
+   if(fd == -1)
+      return nullptr;
+   struct stat status {};
+   if(fstat(fd, &status) == -1 || static_cast<size_t>(status.st_size) < size)
+   {
+      close(fd);
+      return nullptr;
+   }
+   if(!impl->Map(fd))
+      return nullptr;
+   return std::unique_ptr<IPCSharedMemory>{ new IPCSharedMemory(std::move(impl)) };
+}
+
+void IPCSharedMemory::RemoveName() noexcept
+{
+   if(mImpl->mOwner)
+   {
+      shm_unlink(mImpl->mName.c_str());
+      mImpl->mOwner = false;
+   }
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+
+namespace
+{
+   void* Address(const std::atomic<uint32_t>& word)
+   {
+      // The kernel only compares and hashes the address; the word is mapped
+      // shared, so the operations must not be the private ones
+      return const_cast<std::atomic<uint32_t>*>(&word);
+   }
+}
+
+#endif
+
+#if defined(__linux__)
+
+void IPCSharedMemory::Wait(const std::atomic<uint32_t>& word,
+   uint32_t expected, std::chrono::milliseconds timeout) const
+{
+   const auto count = timeout.count();
+   timespec relative {};
+   relative.tv_sec = static_cast<time_t>(count / 1000);
+   relative.tv_nsec = static_cast<long>((count % 1000) * 1000000);
+   syscall(SYS_futex, Address(word), FUTEX_WAIT, expected, &relative,
+      nullptr, 0);
+}
+
+void IPCSharedMemory::Wake(std::atomic<uint32_t>& word) const
+{
+   syscall(SYS_futex, Address(word), FUTEX_WAKE, INT_MAX, nullptr,
+      nullptr, 0);
+}
+
+#elif defined(__APPLE__)
+
+namespace
+{
+   // From the xnu sources, bsd/sys/ulock.h
+   constexpr uint32_t CompareAndWaitShared = 3;
+   constexpr uint32_t WakeAll = 0x100;
+}
+
+void IPCSharedMemory::Wait(const std::atomic<uint32_t>& word,
+   uint32_t expected, std::chrono::milliseconds timeout) const
+{
+   // In microseconds, where zero means no timeout
+   const auto microseconds = std::clamp<long long>(
+      timeout.count() * 1000, 1, UINT32_MAX);
+   __ulock_wait(CompareAndWaitShared, Address(word), expected,
+      static_cast<uint32_t>(microseconds));
+}
+
+void IPCSharedMemory::Wake(std::atomic<uint32_t>& word) const
+{
+   __ulock_wake(CompareAndWaitShared | WakeAll, Address(word), 0);
+}
+
+#else
+
+void IPCSharedMemory::Wait(const std::atomic<uint32_t>& word,
+   uint32_t expected, std::chrono::milliseconds timeout) const
+{
+   using namespace std::chrono;
+   // Spin a little first, because the other side usually answers within
+   // microseconds, then sleep in short steps
+   constexpr auto SpinCount = 100;
+   constexpr auto SleepInterval = microseconds{ 50 };
+   for(int i = 0; i < SpinCount; ++i)
+   {
+      if(word.load(std::memory_order_acquire) != expected)
+         return;
+      std::this_thread::yield();
+   }
+   const auto deadline = steady_clock::now() + timeout;
+   while(word.load(std::memory_order_acquire) == expected &&
+      steady_clock::now() < deadline)
+      std::this_thread::sleep_for(SleepInterval);
+}
+
+void IPCSharedMemory::Wake(std::atomic<uint32_t>&) const
+{
+   // Waiting polls
+}
+
+#endif
+
+#endif
+
+IPCSharedMemory::IPCSharedMemory(std::unique_ptr<Impl> impl)
+   : mImpl{ std::move(impl) }
+{
+}
+
+IPCSharedMemory::~IPCSharedMemory() = default;
+
+void* IPCSharedMemory::Data() const noexcept
+{
+   return mImpl->mData;
+}
+
+size_t IPCSharedMemory::Size() const noexcept
+{
+   return mImpl->mSize;
+}
+
+const std::string& IPCSharedMemory::GetName() const noexcept
+{
+   return mImpl->mName;
+}
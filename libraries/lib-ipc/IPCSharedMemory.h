@@ -0,0 +1,87 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file IPCSharedMemory.h
+
+  Part of lib-ipc library
+
+**********************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+   "Atomic variables in IPCSharedMemory must not depend on a lock");
+
+/**
+ * \brief Memory mapped into the address spaces of more than one process,
+ * found by name. Complements IPCChannel where copying data through a
+ * socket would cost too much, e.g. for audio exchanged block by block.
+ * Synchronize access with atomic variables placed into the memory; Wait
+ * and Wake let one process sleep until another changes such a variable,
+ * without a round trip through a socket.
+ */
+class IPC_API IPCSharedMemory final
+{
+   class Impl;
+   std::unique_ptr<Impl> mImpl;
+
+   explicit IPCSharedMemory(std::unique_ptr<Impl> impl);
+public:
+   /**
+    * \brief Creates a new zero-filled memory region with a unique name
+    * \param size Number of bytes, greater than zero
+    * \return null if the region could not be created
+    */
+   static std::unique_ptr<IPCSharedMemory> Create(size_t size);
+   /**
+    * \brief Maps the region made by Create in another process
+    * \param name Result of GetName() in the creating process
+    * \param size Same as was passed to Create
+    * \return null if there is no such region
+    */
+   static std::unique_ptr<IPCSharedMemory> Open(
+      const std::string& name, size_t size);
+
+   /**
+    * \brief Unmaps the region; it is freed when no process maps it
+    */
+   ~IPCSharedMemory();
+
+   void* Data() const noexcept;
+   size_t Size() const noexcept;
+   const std::string& GetName() const noexcept;
+
+   /**
+    * \brief Makes the region unreachable by name, so that it can't outlive
+    * its processes. Call in the creating process once the others have
+    * opened it. Does nothing where the name goes away with the last mapping
+    * anyway (Windows).
+    */
+   void RemoveName() noexcept;
+
+   /**
+    * \brief Blocks while word equals expected, until Wake is called
+    * for it, or the timeout elapses. May also return spuriously, so
+    * check the variable again. Uses the futex system call on Linux,
+    * __ulock_wait on macOS, and an event named after the region and the
+    * offset of the word on Windows; elsewhere polls the variable.
+    * \pre word is in this region, and no other thread waits for it
+    */
+   void Wait(const std::atomic<uint32_t>& word, uint32_t expected,
+      std::chrono::milliseconds timeout) const;
+
+   /**
+    * \brief Unblocks the caller of Wait for the word, in any process.
+    * Change the variable first.
+    * \pre word is in this region
+    */
+   void Wake(std::atomic<uint32_t>& word) const;
+};
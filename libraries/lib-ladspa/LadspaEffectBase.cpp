@@ -289,6 +289,12 @@ std::shared_ptr<EffectInstance> LadspaEffectBase::MakeInstance() const
       mLatencyPort);
 }
 
+bool LadspaEffectBase::ProcessesConcurrently() const
+{
+   // Each instance runs its own handle of the plugin
+   return true;
+}
+
 bool LadspaEffectBase::SaveSettings(
    const EffectSettings &settings, CommandParameters & parms) const
 {
@@ -179,6 +179,12 @@ size_t LadspaInstance::ProcessBlock(EffectSettings &,
    return blockLen;
 }
 
+bool LadspaInstance::CanProcessConcurrently() const
+{
+   // Each instance runs its own handle of the plugin
+   return true;
+}
+
 bool LadspaInstance::RealtimeInitialize(EffectSettings &, double)
 {
    return true;
@@ -72,6 +72,7 @@ struct LADSPA_API LadspaInstance
    size_t ProcessBlock(EffectSettings &settings,
       const float *const *inBlock, float *const *outBlock, size_t blockLen)
       override;
+   bool CanProcessConcurrently() const override;
 
    SampleCount GetLatency(const EffectSettings &settings, double sampleRate)
       const override;
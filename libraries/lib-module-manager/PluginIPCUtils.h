@@ -34,11 +34,11 @@ namespace detail
 
    ///Writes the length of the string and string bytes into the channel.
    ///Message can be then extracted with InputMessageReader
-   void PutMessage(IPCChannel& channel, const wxString& value);
+   MODULE_MANAGER_API void PutMessage(IPCChannel& channel, const wxString& value);
 
    ///Stores consumed bytes into buffer,
    ///so that individual messages can be extracted later.
-   class InputMessageReader
+   class MODULE_MANAGER_API InputMessageReader
    {
       std::vector<char> mBuffer;
    public:
@@ -407,6 +407,12 @@ void PluginManager::Initialize(ConfigFactory factory)
    InitializePlugins();
 }
 
+void PluginManager::InitializeSettings(ConfigFactory factory)
+{
+   sFactory = move(factory);
+   GetSettings();
+}
+
 void PluginManager::Terminate()
 {
    // Get rid of all non-module(effects?) plugins first
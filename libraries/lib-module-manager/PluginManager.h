@@ -101,6 +101,11 @@ public:
       std::unique_ptr<audacity::BasicSettings>(const FilePath &localFilename ) >;
    /*! @pre `factory != nullptr` */
    void Initialize(ConfigFactory factory);
+   //! Injects the factory for GetSettings() only, without loading, updating
+   //! or saving the registry, for a process that hosts plug-ins on behalf of
+   //! the main one
+   /*! @pre `factory != nullptr` */
+   void InitializeSettings(ConfigFactory factory);
    void Terminate();
 
    bool DropFile(const wxString &fileName);
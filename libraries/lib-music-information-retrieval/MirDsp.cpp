@@ -9,6 +9,7 @@
 
 **********************************************************************/
 #include "MirDsp.h"
+#include "FFTPlan.h"
 #include "IteratorX.h"
 #include "MathApprox.h"
 #include "MemoryX.h"
@@ -19,7 +20,6 @@
 #include <cassert>
 #include <cmath>
 #include <numeric>
-#include <pffft.h>
 
 namespace MIR
 {
@@ -76,11 +76,10 @@ GetNormalizedCircularAutocorr(const std::vector<float>& ux /* unaligned x*/)
       return ux;
    const auto N = ux.size();
    assert(IsPowOfTwo(N));
-   PffftSetupHolder setup { pffft_new_setup(N, PFFFT_REAL) };
+   const auto plan = FFTPlan::Get(N);
    PffftFloatVector x { ux.begin(), ux.end() };
    PffftFloatVector work(N);
-   pffft_transform_ordered(
-      setup.get(), x.data(), x.data(), work.data(), PFFFT_FORWARD);
+   plan->Forward(x.data(), x.data(), work.data());
 
    // Transform to a power spectrum, but preserving the layout expected by PFFFT
    // in preparation for the inverse transform.
@@ -92,8 +91,7 @@ GetNormalizedCircularAutocorr(const std::vector<float>& ux /* unaligned x*/)
       x[n + 1] = 0.f;
    }
 
-   pffft_transform_ordered(
-      setup.get(), x.data(), x.data(), work.data(), PFFFT_BACKWARD);
+   plan->Inverse(x.data(), x.data(), work.data());
 
    // The second half of the circular autocorrelation is the mirror of the first
    // half. We are economic and only keep the first half.
@@ -867,9 +867,12 @@ void NoteTrack::WriteXML(XMLWriter &xmlFile) const
 
    xmlFile.WriteAttr(wxT("velocity"),
       static_cast<double>(saveme->GetVelocity()));
-   saveme->Attachments::ForEach([&](auto &attachment){
-      attachment.WriteXML(xmlFile);
-   });
+   {
+      std::lock_guard<std::recursive_mutex> lock{ ExtensionWritersMutex() };
+      saveme->Attachments::ForEach([&](auto &attachment){
+         attachment.WriteXML(xmlFile);
+      });
+   }
    xmlFile.WriteAttr(wxT("data"), wxString(data.str().c_str(), wxConvUTF8));
    xmlFile.EndTag(wxT("notetrack"));
 }
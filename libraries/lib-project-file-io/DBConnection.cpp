@@ -13,6 +13,8 @@ Paul Licameli -- split from ProjectFileIO.cpp
 
 #include "sqlite3.h"
 
+#include <algorithm>
+
 #include <wx/string.h>
 
 #include "AudacityLogger.h"
@@ -58,6 +60,7 @@ DBConnection::DBConnection(
 {
    mDB = nullptr;
    mCheckpointDB = nullptr;
+   mReclaimDB = nullptr;
    mBypass = false;
 }
 
@@ -148,9 +151,26 @@ int DBConnection::Open(const FilePath fileName)
    mCheckpointStop = false;
    mCheckpointPending = false;
    mCheckpointActive = false;
+
+   // Initialize reclamation controls
+   mReclaimStop = false;
+   mReclaimActive = false;
+   mReclaimQueue.clear();
+   mReclaimRetry = { {}, 0 };
+   mPendingReclaimCount = 0;
+   mPendingReclaimBytes = 0;
+
+   mHasSummary4kTable = -1;
+
    rc = OpenStepByStep( fileName );
    if ( rc != SQLITE_OK)
    {
+      if (mReclaimDB)
+      {
+         sqlite3_close(mReclaimDB);
+         mReclaimDB = nullptr;
+      }
+
       if (mCheckpointDB)
       {
          sqlite3_close(mCheckpointDB);
@@ -221,10 +241,33 @@ int DBConnection::OpenStepByStep(const FilePath fileName)
       return rc;
    }
 
+   rc = sqlite3_open(name, &mReclaimDB);
+   if (rc != SQLITE_OK)
+   {
+      ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "DBConnection::OpenStepByStep::open_reclaim");
+
+      wxLogMessage("Failed to open reclaim connection to %s: %d, %s\n",
+         fileName,
+         rc,
+         sqlite3_errstr(rc));
+      return rc;
+   }
+
+   rc = ModeConfig(mReclaimDB, "main", SafeConfig);
+   if (rc != SQLITE_OK) {
+      SetDBError(XO("Failed to set safe mode on reclaim connection to %s").Format(fileName));
+      return rc;
+   }
+
    auto db = mCheckpointDB;
    mCheckpointThread = std::thread(
       [this, db, fileName]{ CheckpointThread(db, fileName); });
 
+   auto reclaimDB = mReclaimDB;
+   mReclaimThread = std::thread(
+      [this, reclaimDB, fileName]{ ReclaimThread(reclaimDB, fileName); });
+
    // Install our checkpoint hook
    sqlite3_wal_hook(mDB, CheckpointHook, this);
    return rc;
@@ -241,6 +284,29 @@ bool DBConnection::Close()
       return true;
    }
 
+   // Finish queued deletions of sample blocks, unless the database will be
+   // deleted anyway, then tell the reclaim thread to shutdown
+   {
+      if (mBypass)
+      {
+         std::lock_guard<std::mutex> guard(mReclaimMutex);
+         mReclaimQueue.clear();
+         mReclaimRetry = { {}, 0 };
+      }
+      else
+         FlushReclaim();
+
+      std::lock_guard<std::mutex> guard(mReclaimMutex);
+      mReclaimStop = true;
+      mReclaimCondition.notify_one();
+   }
+
+   // And wait for it to do so
+   if (mReclaimThread.joinable())
+   {
+      mReclaimThread.join();
+   }
+
    // Uninstall our checkpoint hook so that no additional checkpoints
    // are sent our way.  (Though this shouldn't really happen.)
    sqlite3_wal_hook(mDB, nullptr, nullptr);
@@ -321,6 +387,20 @@ bool DBConnection::Close()
    }
    mCheckpointDB = nullptr;
 
+   // Close the reclaim connection
+   rc = sqlite3_close(mReclaimDB);
+   if (rc != SQLITE_OK)
+   {
+      ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "DBConnection::Close::close_reclaim");
+
+      wxLogMessage("Failed to close reclaim connection for %s\n"
+                   "\tError: %s\n",
+                   sqlite3_db_filename(mReclaimDB, nullptr),
+                   sqlite3_errmsg(mReclaimDB));
+   }
+   mReclaimDB = nullptr;
+
    // Close the primary connection
    rc = sqlite3_close(mDB);
    if (rc != SQLITE_OK)
@@ -490,6 +570,68 @@ sqlite3_stmt *DBConnection::Prepare(enum StatementID id, const char *sql)
    return stmt;
 }
 
+bool DBConnection::HasSummary4kTable()
+{
+   const auto known = mHasSummary4kTable.load(std::memory_order_relaxed);
+   if (known >= 0)
+      return known != 0;
+
+   // Prepare and cache statement...automatically finalized at DB close
+   sqlite3_stmt *stmt = Prepare(DBConnection::FindSummary4kTable,
+      "SELECT 1 FROM sqlite_master"
+      "  WHERE type = 'table' AND name = 'sampleblocksummaries';");
+
+   const auto result = sqlite3_step(stmt) == SQLITE_ROW;
+
+   // Rewind statement
+   sqlite3_reset(stmt);
+
+   mHasSummary4kTable.store(result ? 1 : 0, std::memory_order_relaxed);
+   return result;
+}
+
+bool DBConnection::CreateSummary4kTable(const char *schema)
+{
+   static const char *sql =
+      // CREATE SQL sampleblocksummaries
+      // Summaries of the sampleblocks at 4096 samples per frame, for drawing
+      // at the zoom levels between the 256 and the 64k summaries.
+      //
+      // Not a column of sampleblocks, so that older versions can still copy
+      // the blocks of the project.  A missing row is not an error, the
+      // summary is then computed from summary256.
+      "CREATE TABLE IF NOT EXISTS <schema>.sampleblocksummaries"
+      "("
+      "  blockid              INTEGER PRIMARY KEY,"
+      "  summary4k            BLOB"
+      ");"
+      ""
+      // Older versions know nothing about the table, but still delete the
+      // blocks of the projects they open
+      "CREATE TRIGGER IF NOT EXISTS <schema>.sampleblocksummaries_delete"
+      "  AFTER DELETE ON sampleblocks"
+      "  BEGIN"
+      "    DELETE FROM sampleblocksummaries WHERE blockid = old.blockid;"
+      "  END;";
+
+   wxString statement{ sql };
+   statement.Replace("<schema>", schema);
+
+   int rc = sqlite3_exec(mDB, statement, nullptr, nullptr, nullptr);
+   if (rc != SQLITE_OK)
+   {
+      wxLogDebug(wxT("Unable to add the sample block summaries: %s"),
+         sqlite3_errmsg(mDB));
+      return false;
+   }
+
+   // Query again when next asked, in case an enclosing transaction is rolled
+   // back
+   if (wxStrcmp(schema, "main") == 0)
+      mHasSummary4kTable.store(-1, std::memory_order_relaxed);
+   return true;
+}
+
 void DBConnection::CheckpointThread(sqlite3 *db, const FilePath &fileName)
 {
    int rc = SQLITE_OK;
@@ -597,6 +739,238 @@ int DBConnection::CheckpointHook(void *data, sqlite3 *db, const char *schema, in
    return SQLITE_OK;
 }
 
+void DBConnection::ReclaimBlocks(
+   std::vector<SampleBlockID> blockids, size_t bytes)
+{
+   if (blockids.empty())
+      return;
+
+   std::lock_guard<std::mutex> guard(mReclaimMutex);
+   mPendingReclaimCount += blockids.size();
+   mPendingReclaimBytes += bytes;
+   mReclaimQueue.push_back({ std::move(blockids), bytes });
+   RequeueReclaimRetry();
+   mReclaimCondition.notify_one();
+}
+
+void DBConnection::RequeueReclaimRetry()
+{
+   if (mReclaimRetry.blockids.empty())
+      return;
+   // Still counted as pending
+   mReclaimQueue.push_back(std::move(mReclaimRetry));
+   mReclaimRetry = { {}, 0 };
+}
+
+void DBConnection::FlushReclaim()
+{
+   std::unique_lock<std::mutex> lock(mReclaimMutex);
+   RequeueReclaimRetry();
+   mReclaimCondition.notify_one();
+   // Deletions that found the database busy are queued again until none are
+   // left; the caller holds no write transaction that they wait for
+   auto done = [this]{
+      if (!mReclaimQueue.empty() || mReclaimActive)
+         return false;
+      if (mReclaimRetry.blockids.empty())
+         return true;
+      RequeueReclaimRetry();
+      mReclaimCondition.notify_one();
+      return false;
+   };
+   if (done())
+      return;
+
+   // Provides a progress dialog with indeterminate mode
+   using namespace BasicUI;
+   auto pd = MakeGenericProgress({},
+      XO("Discarding undo/redo history"), XO("This may take several seconds"));
+
+   using namespace std::chrono;
+   while (!mReclaimDoneCondition.wait_for(lock, 50ms, done))
+   {
+      if (pd)
+      {
+         lock.unlock();
+         pd->Pulse();
+         lock.lock();
+      }
+   }
+}
+
+size_t DBConnection::GetPendingReclaimCount() const
+{
+   std::lock_guard<std::mutex> guard(mReclaimMutex);
+   return mPendingReclaimCount;
+}
+
+size_t DBConnection::GetPendingReclaimBytes() const
+{
+   std::lock_guard<std::mutex> guard(mReclaimMutex);
+   return mPendingReclaimBytes;
+}
+
+void DBConnection::ReclaimThread(sqlite3 *db, const FilePath &fileName)
+{
+   while (true)
+   {
+      ReclaimBatch batch;
+      {
+         // Wait for work or the stop signal
+         std::unique_lock<std::mutex> lock(mReclaimMutex);
+         mReclaimCondition.wait(lock,
+                                [&]
+                                {
+                                   return !mReclaimQueue.empty() || mReclaimStop;
+                                });
+
+         // Requested to stop, so bail
+         if (mReclaimStop)
+         {
+            break;
+         }
+
+         batch = std::move(mReclaimQueue.front());
+         mReclaimQueue.pop_front();
+         mReclaimActive = true;
+      }
+
+      auto now = std::chrono::high_resolution_clock::now();
+      size_t deleted = 0;
+      int rc = DeleteReclaimed(db, batch.blockids, deleted);
+      auto duration = std::chrono::high_resolution_clock::now() - now;
+
+      // Estimate the space of the rows not yet deleted
+      const auto total = batch.blockids.size();
+      const auto remainingBytes = total == 0 ? 0 : static_cast<size_t>(
+         static_cast<double>(batch.bytes) * (total - deleted) / total);
+      batch.blockids.erase(
+         batch.blockids.begin(), batch.blockids.begin() + deleted);
+
+      if (deleted > 0)
+      {
+         wxLogDebug("Reclaimed %llu sample blocks (%llu bytes) in %lld ms",
+            static_cast<unsigned long long>(deleted),
+            static_cast<unsigned long long>(batch.bytes - remainingBytes),
+            std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+               .count());
+
+         // This connection has no hook of its own; let the checkpoint thread
+         // fold the deletions into the database
+         CheckpointHook(this, db, "main", 0);
+      }
+
+      // Another connection wrote for longer than the busy timeout; try again
+      // later rather than leave orphans
+      const bool busy = (rc & 0xff) == SQLITE_BUSY ||
+         (rc & 0xff) == SQLITE_LOCKED;
+      if (busy)
+      {
+         wxLogDebug("Database busy; deferred deleting %llu sample blocks",
+            static_cast<unsigned long long>(batch.blockids.size()));
+      }
+      else if (rc != SQLITE_OK)
+      {
+         ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+         ADD_EXCEPTION_CONTEXT("sqlite3.context", "DBConnection::ReclaimThread");
+
+         // Not fatal; the orphans are removed when the project is next opened
+         wxLogMessage("Failed to delete %llu sample blocks from %s\n"
+                      "\tErrCode: %d\n"
+                      "\tErrMsg: %s",
+                      static_cast<unsigned long long>(batch.blockids.size()),
+                      fileName,
+                      sqlite3_errcode(db),
+                      sqlite3_errmsg(db));
+      }
+
+      {
+         std::lock_guard<std::mutex> guard(mReclaimMutex);
+         mReclaimActive = false;
+         mPendingReclaimCount -= deleted;
+         mPendingReclaimBytes -= batch.bytes - remainingBytes;
+         if (busy)
+         {
+            auto &retry = mReclaimRetry.blockids;
+            retry.insert(retry.end(),
+               batch.blockids.begin(), batch.blockids.end());
+            mReclaimRetry.bytes += remainingBytes;
+         }
+         else
+         {
+            mPendingReclaimCount -= batch.blockids.size();
+            mPendingReclaimBytes -= remainingBytes;
+         }
+         mReclaimDoneCondition.notify_all();
+      }
+   }
+}
+
+int DBConnection::DeleteReclaimed(sqlite3 *db,
+   const std::vector<SampleBlockID> &blockids, size_t &deleted)
+{
+   using namespace std::chrono;
+
+   // Other connections that write wait for the lock no longer than one short
+   // transaction takes
+   constexpr size_t MaxTransactionRows = 256;
+   constexpr auto MaxTransactionTime = 20ms;
+
+   sqlite3_stmt *stmt = nullptr;
+   bool inTransaction = false;
+   auto cleanup = finally([&]
+   {
+      if (stmt)
+         // No need to check return code
+         sqlite3_finalize(stmt);
+
+      if (inTransaction)
+         sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+   });
+
+   int rc = sqlite3_prepare_v2(db,
+      "DELETE FROM sampleblocks WHERE blockid = ?1;", -1, &stmt, nullptr);
+   if (rc != SQLITE_OK)
+      return rc;
+
+   deleted = 0;
+   while (deleted < blockids.size())
+   {
+      // Contention with the other connections is resolved by the busy
+      // timeout
+      rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+      if (rc != SQLITE_OK)
+         return rc;
+      inTransaction = true;
+
+      const auto start = steady_clock::now();
+      auto next = deleted;
+      const auto last = std::min(blockids.size(), deleted + MaxTransactionRows);
+      while (next < last &&
+         (next == deleted || steady_clock::now() - start < MaxTransactionTime))
+      {
+         rc = sqlite3_bind_int64(stmt, 1, blockids[next]);
+         if (rc != SQLITE_OK)
+            return rc;
+
+         rc = sqlite3_step(stmt);
+         sqlite3_reset(stmt);
+         if (rc != SQLITE_DONE)
+            return rc;
+
+         ++next;
+      }
+
+      rc = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+      if (rc != SQLITE_OK)
+         return rc;
+      inTransaction = false;
+      deleted = next;
+   }
+
+   return SQLITE_OK;
+}
+
 // Install an implementation of TransactionScope
 #include "TransactionScope.h"
 
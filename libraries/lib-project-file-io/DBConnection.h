@@ -14,11 +14,13 @@ Paul Licameli -- split from ProjectFileIO.h
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "ClientData.h"
 #include "Identifier.h"
@@ -28,6 +30,9 @@ struct sqlite3_stmt;
 class wxString;
 class AudacityProject;
 
+// From SampleBlock.h
+using SampleBlockID = long long;
+
 struct DBConnectionErrors
 {
    TranslatableString mLastError;
@@ -76,17 +81,60 @@ public:
       GetSamples,
       GetSummary256,
       GetSummary64k,
+      GetSummary4k,
+      InsertSummary4k,
+      FindSummary4kTable,
       LoadSampleBlock,
       InsertSampleBlock,
       DeleteSampleBlock,
       GetSampleBlockSize,
-      GetAllSampleBlocksSize
+      GetAllSampleBlocksSize,
+      GetSampleBlockSizeWithSummary,
+      GetAllSampleBlocksSizeWithSummaries,
+      GetTile,
+      InsertTile,
+      TouchTile,
+      DeleteTile,
+      GetOldestTiles
    };
    sqlite3_stmt *Prepare(enum StatementID id, const char *sql);
 
+   //! Whether the project has the table for the 4k summaries
+   /*! It is missing until a summary is first written, so projects that are
+    only read, or written by older versions, lack it.  Queried once per
+    connection */
+   bool HasSummary4kTable();
+
+   //! Creates the table for the 4k summaries, and the trigger that deletes
+   //! them with their blocks, if they don't exist
+   /*! @return whether the table exists now */
+   bool CreateSummary4kTable(const char *schema = "main");
+
    void SetBypass( bool bypass );
    bool ShouldBypass();
 
+   //! Queue rows of the sampleblocks table for deletion by a worker thread
+   /*!
+    The rows are deleted using a separate connection, so the calling thread
+    does not wait, in transactions short enough that other writers do not
+    time out.  If the database stays busy, the rows are queued again with the
+    next call or flush; if deletion fails otherwise, the rows are left as
+    orphans, which are removed when the project is next opened.
+    @param bytes estimated space used by the rows
+    */
+   void ReclaimBlocks(std::vector<SampleBlockID> blockids, size_t bytes);
+
+   //! Wait until all queued deletions are done, retrying those that found
+   //! the database busy
+   /*! Must not be called while the primary connection holds a write
+    transaction, which the worker thread would wait for */
+   void FlushReclaim();
+
+   //! Number of rows queued for deletion but not yet deleted
+   size_t GetPendingReclaimCount() const;
+   //! Estimated space of rows queued for deletion but not yet deleted
+   size_t GetPendingReclaimBytes() const;
+
    //! Just set stored errors
    void SetError(
       const TranslatableString &msg,
@@ -106,6 +154,15 @@ private:
    void CheckpointThread(sqlite3 *db, const FilePath &fileName);
    static int CheckpointHook(void *data, sqlite3 *db, const char *schema, int pages);
 
+   void ReclaimThread(sqlite3 *db, const FilePath &fileName);
+   //! Requires mReclaimMutex to be locked
+   void RequeueReclaimRetry();
+   //! Deletes the rows in short transactions, so that other connections
+   //! don't wait long to write
+   /*! @param[out] deleted how many of blockids, from the front, were deleted */
+   static int DeleteReclaimed(sqlite3 *db,
+      const std::vector<SampleBlockID> &blockids, size_t &deleted);
+
 private:
    std::weak_ptr<AudacityProject> mpProject;
    sqlite3 *mDB;
@@ -118,6 +175,26 @@ private:
    std::atomic_bool mCheckpointPending{ false };
    std::atomic_bool mCheckpointActive{ false };
 
+   struct ReclaimBatch {
+      std::vector<SampleBlockID> blockids;
+      size_t bytes;
+   };
+   sqlite3 *mReclaimDB;
+   std::thread mReclaimThread;
+   std::condition_variable mReclaimCondition;
+   std::condition_variable mReclaimDoneCondition;
+   mutable std::mutex mReclaimMutex;
+   std::deque<ReclaimBatch> mReclaimQueue;
+   //! Rows whose deletion found the database busy, to be queued again
+   ReclaimBatch mReclaimRetry{ {}, 0 };
+   bool mReclaimStop{ false };
+   bool mReclaimActive{ false };
+   size_t mPendingReclaimCount{ 0 };
+   size_t mPendingReclaimBytes{ 0 };
+
+   //! -1 until queried, then 0 or 1
+   std::atomic<int> mHasSummary4kTable{ -1 };
+
    std::mutex mStatementMutex;
    using StatementIndex = std::pair<enum StatementID, std::thread::id>;
    std::map<StatementIndex, sqlite3_stmt *> mStatements;
@@ -10,10 +10,14 @@ Paul Licameli split from AudacityProject.cpp
 
 #include "ProjectFileIO.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <sqlite3.h>
 #include <optional>
 #include <cstring>
+#include <thread>
 
 #include <wx/crt.h>
 #include <wx/log.h>
@@ -31,11 +35,13 @@ Paul Licameli split from AudacityProject.cpp
 #include "ProjectSerializer.h"
 #include "FileNames.h"
 #include "SampleBlock.h"
+#include "StretchCache.h"
 #include "TempDirectory.h"
 #include "TransactionScope.h"
 #include "WaveTrack.h"
 #include "WaveTrackUtilities.h"
 #include "BasicUI.h"
+#include "concurrency/TaskPool.h"
 #include "wxFileNameWrapper.h"
 #include "XMLFileReader.h"
 #include "SentryHelper.h"
@@ -44,7 +50,6 @@ Paul Licameli split from AudacityProject.cpp
 #include "ProjectFileIOExtension.h"
 #include "ProjectFormatExtensionsRegistry.h"
 
-#include "BufferedStreamReader.h"
 #include "FromChars.h"
 
 #include "sqlite/SQLiteUtils.h"
@@ -167,6 +172,17 @@ static const char *ProjectFileSchema =
    "  samples              BLOB"
    ");";
 
+// The table of 4k summaries (see DBConnection::CreateSummary4kTable) is a
+// change of the schema, recorded in the version, so that versions that
+// don't maintain the table don't open the project once it has one
+static ProjectFormatExtensionsRegistry::Extension summariesExtension(
+   [](const AudacityProject &project) -> ProjectFormatVersion {
+      const auto &pConn = ConnectionPtr::Get(project).mpConnection;
+      if (pConn && pConn->HasSummary4kTable())
+         return { 3, 6, 0, 0 };
+      return BaseProjectFormatVersion;
+   }
+);
 
 class SQLiteBlobStream final
 {
@@ -193,7 +209,7 @@ public:
        : mBlob(blob)
        , mIsReadOnly(readOnly)
    {
-      mBlobSize = sqlite3_blob_bytes(blob);
+      mBlobSize = static_cast<size_t>(std::max(0, sqlite3_blob_bytes(blob)));
    }
 
    SQLiteBlobStream(SQLiteBlobStream&& rhs) noexcept
@@ -235,7 +251,7 @@ public:
       return rc;
    }
 
-   int Write(const void* ptr, int size) noexcept
+   int Write(const void* ptr, size_t size) noexcept
    {
       // Stream APIs usually return the number of bytes written.
       // sqlite3_blob_write is all-or-nothing function,
@@ -243,7 +259,12 @@ public:
       if (!IsOpen() || mIsReadOnly || ptr == nullptr)
          return SQLITE_MISUSE;
 
-      const int rc = sqlite3_blob_write(mBlob, ptr, size, mOffset);
+      // Blobs are no larger than SQLite's limit on lengths, which fits int
+      if (size > mBlobSize - mOffset)
+         return SQLITE_TOOBIG;
+
+      const int rc = sqlite3_blob_write(
+         mBlob, ptr, static_cast<int>(size), static_cast<int>(mOffset));
 
       if (rc == SQLITE_OK)
          mOffset += size;
@@ -251,12 +272,12 @@ public:
       return rc;
    }
 
-   int Read(void* ptr, int& size) noexcept
+   int Read(void* ptr, size_t& size) noexcept
    {
       if (!IsOpen() || ptr == nullptr)
          return SQLITE_MISUSE;
 
-      const int availableBytes = mBlobSize - mOffset;
+      const size_t availableBytes = mBlobSize - mOffset;
 
       if (availableBytes == 0)
       {
@@ -268,7 +289,9 @@ public:
          size = availableBytes;
       }
 
-      const int rc = sqlite3_blob_read(mBlob, ptr, size, mOffset);
+      // size and mOffset are within the blob, which fits int
+      const int rc = sqlite3_blob_read(
+         mBlob, ptr, static_cast<int>(size), static_cast<int>(mOffset));
 
       if (rc == SQLITE_OK)
          mOffset += size;
@@ -281,96 +304,67 @@ public:
       return mOffset == mBlobSize;
    }
 
+   size_t GetSize() const noexcept
+   {
+      return mBlobSize;
+   }
+
 private:
    sqlite3_blob* mBlob { nullptr };
    size_t mBlobSize { 0 };
 
-   int mOffset { 0 };
+   size_t mOffset { 0 };
 
    bool mIsReadOnly { false };
 };
 
-class BufferedProjectBlobStream : public BufferedStreamReader
+//! Reads the dictionary and the document of a project row into one buffer
+/*!
+ Keeping the whole document in memory lets ProjectSerializer::Decode pass
+ attribute values to the handlers without copying them.
+ */
+static bool ReadProjectDoc(
+   sqlite3* db, const char* schema, const char* table, int64_t rowID,
+   std::vector<uint8_t>& buffer)
 {
-public:
    static constexpr std::array<const char*, 2> Columns = { "dict", "doc" };
 
-   BufferedProjectBlobStream(
-      sqlite3* db, const char* schema, const char* table,
-      int64_t rowID)
-       // Despite we use 64k pages in SQLite - it is impossible to guarantee
-       // that read is satisfied from a single page.
-       // Reading 64k proved to be slower, (64k - 8) gives no measurable difference
-       // to reading 32k.
-       // Reading 4k is slower than reading 32k.
-       : BufferedStreamReader(32 * 1024)
-       , mDB(db)
-       , mSchema(schema)
-       , mTable(table)
-       , mRowID(rowID)
-   {
-   }
+   std::array<std::optional<SQLiteBlobStream>, Columns.size()> streams;
+   size_t totalSize = 0;
 
-private:
-   bool OpenBlob(size_t index)
+   for (size_t index = 0; index < Columns.size(); ++index)
    {
-      if (index >= Columns.size())
-      {
-         mBlobStream.reset();
-         return false;
-      }
-
-      mBlobStream = SQLiteBlobStream::Open(
-         mDB, mSchema, mTable, Columns[index], mRowID, true);
+      // A column that can't be opened contributes no data, the decoder
+      // decides whether the rest makes up a valid document
+      streams[index] = SQLiteBlobStream::Open(
+         db, schema, table, Columns[index], rowID, true);
 
-      return mBlobStream.has_value();
+      if (streams[index])
+         totalSize += streams[index]->GetSize();
    }
 
-   std::optional<SQLiteBlobStream> mBlobStream;
-   size_t mNextBlobIndex { 0 };
+   buffer.clear();
+   buffer.resize(totalSize);
 
-   sqlite3* mDB;
-   const char* mSchema;
-   const char* mTable;
-   const int64_t mRowID;
+   size_t offset = 0;
 
-protected:
-   bool HasMoreData() const override
+   for (auto& stream : streams)
    {
-      return mBlobStream.has_value() || mNextBlobIndex < Columns.size();
-   }
-
-   size_t ReadData(void* buffer, size_t maxBytes) override
-   {
-      if (!mBlobStream || mBlobStream->IsEof())
-      {
-         if (!OpenBlob(mNextBlobIndex++))
-            return {};
-      }
-
-      // Do not allow reading more then 2GB at a time (O_o)
-      maxBytes = std::min<size_t>(maxBytes, std::numeric_limits<int>::max());
-      auto bytesRead = static_cast<int>(maxBytes);
+      if (!stream || stream->GetSize() == 0)
+         continue;
 
-      if (SQLITE_OK != mBlobStream->Read(buffer, bytesRead))
-      {
-         // Reading has failed, close the stream and do not allow opening
-         // the next one
-         mBlobStream = {};
-         mNextBlobIndex = Columns.size();
+      auto bytesRead = stream->GetSize();
 
-         return 0;
-      }
-      else if (bytesRead == 0)
-      {
-         mBlobStream = {};
-      }
+      if (SQLITE_OK != stream->Read(buffer.data() + offset, bytesRead))
+         return false;
 
-      return static_cast<size_t>(bytesRead);
+      offset += bytesRead;
    }
-};
 
-constexpr std::array<const char*, 2> BufferedProjectBlobStream::Columns;
+   buffer.resize(offset);
+
+   return true;
+}
 
 bool ProjectFileIO::InitializeSQL()
 {
@@ -433,6 +427,14 @@ ProjectFileIO::ProjectFileIO(AudacityProject &project)
             );
       }
    }
+
+   mStretchCacheSubscription = StretchCache::Get().Subscribe(
+      [this](const StretchCacheMessage &message)
+   {
+      if (message.pFactory ==
+          WaveTrackFactory::Get(mProject).GetSampleBlockFactory().get())
+         RecordStretchedCopyBlocks(message.blockIDs);
+   });
 }
 
 ProjectFileIO::~ProjectFileIO()
@@ -548,6 +550,10 @@ bool ProjectFileIO::CloseConnection()
    if (!curConn)
       return false;
 
+   // Stretched copies of clips are not saved; delete their sample blocks
+   // while the connection allows it
+   ClearStretchedCopies();
+
    if (!curConn->Close())
    {
       return false;
@@ -559,6 +565,107 @@ bool ProjectFileIO::CloseConnection()
    return true;
 }
 
+void ProjectFileIO::ClearStretchedCopies()
+{
+   StretchCache::Get().Clear(
+      *WaveTrackFactory::Get(mProject).GetSampleBlockFactory());
+}
+
+void ProjectFileIO::RecordStretchedCopyBlocks(
+   const std::vector<SampleBlockID> &blockids)
+{
+   auto &currConn = CurrConn();
+   if (!currConn)
+      return;
+   auto db = currConn->DB();
+
+   sqlite3_stmt *stmt = nullptr;
+   bool success = false;
+   auto cleanup = finally([&]
+   {
+      if (stmt)
+         // No need to check return code
+         sqlite3_finalize(stmt);
+
+      sqlite3_exec(db,
+         success
+            ? "RELEASE StretchBlocks;"
+            : "ROLLBACK TO StretchBlocks; RELEASE StretchBlocks;",
+         nullptr, nullptr, nullptr);
+   });
+
+   // The table is made with the first copy, so that the projects without
+   // stretched clips are not modified.  Its rows of deleted blocks do no
+   // harm, because block ids are not reused
+   if (sqlite3_exec(db,
+          "SAVEPOINT StretchBlocks;"
+          "CREATE TABLE IF NOT EXISTS main.stretchblocks"
+          "("
+          "  blockid              INTEGER PRIMARY KEY"
+          ");",
+          nullptr, nullptr, nullptr) != SQLITE_OK ||
+       sqlite3_prepare_v2(db,
+          "INSERT OR IGNORE INTO main.stretchblocks VALUES(?1);",
+          -1, &stmt, nullptr) != SQLITE_OK)
+   {
+      // Not an error of the project, only the next open may report orphans
+      wxLogDebug(wxT("ProjectFileIO::RecordStretchedCopyBlocks - SQLITE error %s"),
+         sqlite3_errmsg(db));
+      return;
+   }
+
+   for (auto blockid : blockids)
+   {
+      if (sqlite3_bind_int64(stmt, 1, blockid) != SQLITE_OK ||
+          sqlite3_step(stmt) != SQLITE_DONE)
+      {
+         wxLogDebug(wxT("ProjectFileIO::RecordStretchedCopyBlocks - SQLITE error %s"),
+            sqlite3_errmsg(db));
+         return;
+      }
+      sqlite3_reset(stmt);
+   }
+
+   success = true;
+}
+
+bool ProjectFileIO::DeleteStretchedCopyBlocks(const BlockIDs &active)
+{
+   auto db = DB();
+
+   // Only the blocks still there, so that nothing is written to the database
+   // in the usual case
+   BlockIDs blockids;
+   sqlite3_stmt *stmt = nullptr;
+   if (sqlite3_prepare_v2(db,
+          "SELECT blockid FROM main.stretchblocks"
+          "  WHERE blockid IN (SELECT blockid FROM main.sampleblocks);",
+          -1, &stmt, nullptr) != SQLITE_OK)
+   {
+      // No table, no stretched copies were ever made in the project
+      sqlite3_finalize(stmt);
+      return true;
+   }
+   while (sqlite3_step(stmt) == SQLITE_ROW)
+   {
+      const auto blockid = sqlite3_column_int64(stmt, 0);
+      if (active.count(blockid) == 0)
+         blockids.insert(blockid);
+   }
+   sqlite3_finalize(stmt);
+
+   if (blockids.empty())
+      return true;
+
+   if (!DeleteBlocks(blockids, false))
+      return false;
+
+   // No need to check return code; the rows of deleted blocks do no harm
+   sqlite3_exec(db, "DELETE FROM main.stretchblocks;", nullptr, nullptr, nullptr);
+
+   return true;
+}
+
 // Put the current database connection aside, keeping it open, so that
 // another may be opened with OpenConnection()
 void ProjectFileIO::SaveConnection()
@@ -566,6 +673,10 @@ void ProjectFileIO::SaveConnection()
    // Should do nothing in proper usage, but be sure not to leak a connection:
    DiscardConnection();
 
+   // The sample blocks of stretched copies of clips are not copied to the
+   // other database
+   ClearStretchedCopies();
+
    mPrevConn = std::move(CurrConn());
    mPrevFileName = mFileName;
    mPrevTemporary = mTemporary;
@@ -785,7 +896,7 @@ bool ProjectFileIO::CheckVersion()
       );
       return false;
    }
-   
+
    return true;
 }
 
@@ -812,65 +923,150 @@ bool ProjectFileIO::InstallSchema(sqlite3 *db, const char *schema /* = "main" */
 // The orphan block handling should be removed once autosave and related
 // blocks become part of the same transaction.
 
-// An SQLite function that takes a blockid and looks it up in a set of
-// blockids captured during project load.  If the blockid isn't found
-// in the set, it will be deleted.
-namespace
-{
-struct ContextData final
-{
-   const AudacityProject& project;
-   const BlockIDs& blockids;
-};
-}
-
-void ProjectFileIO::InSet(sqlite3_context *context, int argc, sqlite3_value **argv)
-{
-   auto contextData = reinterpret_cast<ContextData*>(sqlite3_user_data(context));
-   SampleBlockID blockid = sqlite3_value_int64(argv[0]);
-
-   sqlite3_result_int(
-      context,
-      contextData->blockids.find(blockid) != contextData->blockids.end() ||
-         ProjectFileIOExtensionRegistry::IsBlockLocked(
-            contextData->project, blockid));
-}
-
-bool ProjectFileIO::DeleteBlocks(const BlockIDs &blockids, bool complement)
+// Sets of blockids are copied into a temporary table, keyed by blockid, so
+// that SQLite can merge it with the primary key of sampleblocks, rather than
+// calling back into the application for every row of a (possibly huge)
+// project.
+bool ProjectFileIO::FillBlockIDTable(const BlockIDs &blockids)
 {
    auto db = DB();
    int rc;
 
-   ContextData contextData{ mProject, blockids };
+   rc = sqlite3_exec(db,
+      "CREATE TEMP TABLE IF NOT EXISTS blockidset"
+      "("
+      "  blockid              INTEGER PRIMARY KEY"
+      ");"
+      "DELETE FROM temp.blockidset;",
+      nullptr, nullptr, nullptr);
+   if (rc != SQLITE_OK)
+   {
+      ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectFileIO::FillBlockIDTable::create");
+
+      /* i18n-hint: An error message.  Don't translate blockids.*/
+      SetDBError(XO("Unable to create temporary table (can't verify blockids)"));
+      return false;
+   }
+
+   // Inserting in ascending order only ever appends to the b-tree
+   std::vector<SampleBlockID> sorted;
+   sorted.reserve(blockids.size());
+   for (auto blockid : blockids)
+      // Silent blocks have pseudo ids and no rows
+      if (blockid > 0)
+         sorted.push_back(blockid);
+   std::sort(sorted.begin(), sorted.end());
 
+   sqlite3_stmt *stmt = nullptr;
+   bool success = false;
    auto cleanup = finally([&]
    {
-      // Remove our function, whether it was successfully defined or not.
-      sqlite3_create_function(db, "inset", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, nullptr, nullptr, nullptr);
+      if (stmt)
+         // No need to check return code
+         sqlite3_finalize(stmt);
+
+      sqlite3_exec(db,
+         success
+            ? "RELEASE FillBlockIDTable;"
+            : "ROLLBACK TO FillBlockIDTable; RELEASE FillBlockIDTable;",
+         nullptr, nullptr, nullptr);
    });
 
-   // Add the function used to verify each row's blockid against the set of active blockids
-   rc = sqlite3_create_function(db, "inset", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, &contextData, InSet, nullptr, nullptr);
+   // Without a savepoint, each insertion would be its own transaction
+   sqlite3_exec(db, "SAVEPOINT FillBlockIDTable;", nullptr, nullptr, nullptr);
+
+   rc = sqlite3_prepare_v2(db,
+      "INSERT INTO temp.blockidset VALUES(?1);", -1, &stmt, nullptr);
    if (rc != SQLITE_OK)
    {
       ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
-      ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::DeleteBlocks::create_function");
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectFileIO::FillBlockIDTable::prepare");
 
-      /* i18n-hint: An error message.  Don't translate inset or blockids.*/
-      SetDBError(XO("Unable to add 'inset' function (can't verify blockids)"));
+      /* i18n-hint: An error message.  Don't translate blockids.*/
+      SetDBError(XO("Unable to fill temporary table (can't verify blockids)"));
       return false;
    }
 
-   // Delete all rows in the set, or not in it
+   for (auto blockid : sorted)
+   {
+      if (sqlite3_bind_int64(stmt, 1, blockid) != SQLITE_OK ||
+          (rc = sqlite3_step(stmt)) != SQLITE_DONE)
+      {
+         ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+         ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectFileIO::FillBlockIDTable::step");
+
+         /* i18n-hint: An error message.  Don't translate blockids.*/
+         SetDBError(XO("Unable to fill temporary table (can't verify blockids)"));
+         return false;
+      }
+      sqlite3_reset(stmt);
+   }
+
+   success = true;
+   return true;
+}
+
+void ProjectFileIO::ClearBlockIDTable()
+{
+   // No need to check return code; the table is emptied before reuse anyway
+   sqlite3_exec(DB(), "DELETE FROM temp.blockidset;", nullptr, nullptr, nullptr);
+}
+
+bool ProjectFileIO::DeleteBlocks(const BlockIDs &blockids, bool complement)
+{
+   auto now = std::chrono::high_resolution_clock::now();
+
+   auto db = DB();
+   int rc;
+
+   // Determine exactly which rows go.  Orphans locked by an extension must
+   // survive.
+   BlockIDs doomed;
+   if (complement)
+   {
+      if (!FillBlockIDTable(blockids))
+         return false;
+      auto cleanup = finally([this]{ ClearBlockIDTable(); });
+
+      auto cb = [&](int cols, char **vals, char **)
+      {
+         SampleBlockID blockid;
+         wxString{ vals[0] }.ToLongLong(&blockid);
+         if (!ProjectFileIOExtensionRegistry::IsBlockLocked(mProject, blockid))
+            doomed.insert(blockid);
+         return 0;
+      };
+
+      if (!Query(
+         "SELECT blockid FROM sampleblocks"
+         "  WHERE blockid NOT IN (SELECT blockid FROM temp.blockidset);", cb))
+      {
+         // Error message already captured.
+         return false;
+      }
+   }
+
+   const auto &ids = complement ? doomed : blockids;
+
+   // The usual case when loading a project:  no orphans, nothing more to do
+   if (ids.empty())
+      return true;
+
+   if (!FillBlockIDTable(ids))
+      return false;
+   auto cleanup = finally([this]{ ClearBlockIDTable(); });
+
+   // Delete all rows in the set
    // This is the first command that writes to the database, and so we
    // do more informative error reporting than usual, if it fails.
-   auto sql = wxString::Format(
-      "DELETE FROM sampleblocks WHERE %sinset(blockid);",
-      complement ? "NOT " : "" );
+   const char *sql =
+      "DELETE FROM sampleblocks"
+      "  WHERE blockid IN (SELECT blockid FROM temp.blockidset);";
    rc = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
    if (rc != SQLITE_OK)
    {
-      ADD_EXCEPTION_CONTEXT("sqlite3.query", sql.ToStdString());
+      ADD_EXCEPTION_CONTEXT("sqlite3.query", sql);
       ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
       ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::GetBlob");
 
@@ -902,14 +1098,21 @@ bool ProjectFileIO::DeleteBlocks(const BlockIDs &blockids, bool complement)
       return false;
    }
 
-   // Mark the project recovered if we deleted any rows
+   // Mark the project recovered if we deleted any orphan rows
    int changes = sqlite3_changes(db);
-   if (changes > 0)
+   if (complement && changes > 0)
    {
       wxLogInfo(XO("Total orphan blocks deleted %d").Translation(), changes);
       mRecovered = true;
    }
 
+   auto duration = std::chrono::high_resolution_clock::now() - now;
+
+   wxLogDebug(
+      "DeleteBlocks: %d blocks deleted in %lld ms",
+      changes,
+      std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+
    return true;
 }
 
@@ -925,6 +1128,14 @@ bool ProjectFileIO::CopyTo(const FilePath &destpath,
    if (!pConn)
       return false;
 
+   // Stretched copies of clips are not saved, and no track refers to their
+   // blocks, which an unpruned copy would otherwise keep
+   if (!prune)
+      ClearStretchedCopies();
+
+   // Don't copy blocks that are about to be deleted
+   pConn->FlushReclaim();
+
    // Get access to the active tracklist
    auto pProject = &mProject;
 
@@ -1141,6 +1352,22 @@ bool ProjectFileIO::CopyTo(const FilePath &destpath,
          }
       }
 
+      // Copy the summaries of the copied blocks, if there are any.  They are
+      // optional, so failure is not an error
+      if (pConn->HasSummary4kTable() &&
+          pConn->CreateSummary4kTable("outbound"))
+      {
+         rc = sqlite3_exec(db,
+            "INSERT INTO outbound.sampleblocksummaries"
+            "  SELECT summaries.* FROM main.sampleblocksummaries AS summaries"
+            "  JOIN outbound.sampleblocks USING (blockid);",
+            nullptr, nullptr, nullptr);
+
+         if (rc != SQLITE_OK)
+            wxLogDebug(wxT("Unable to copy the sample block summaries: %s"),
+               sqlite3_errmsg(db));
+      }
+
       // Write the doc.
       //
       // If we're compacting a temporary project (user initiated from the File
@@ -1177,37 +1404,82 @@ bool ProjectFileIO::CopyTo(const FilePath &destpath,
 
 bool ProjectFileIO::ShouldCompact(const std::vector<const TrackList *> &tracks)
 {
+   auto now = std::chrono::high_resolution_clock::now();
+
+   // Count only blocks that will remain
+   FlushReclaim();
+
    WaveTrackUtilities::SampleBlockIDSet active;
-   unsigned long long current = 0;
+   for (auto pTracks : tracks)
+      if (pTracks)
+         WaveTrackUtilities::InspectBlocks(*pTracks, {}, &active);
 
-   {
-      auto fn = BlockSpaceUsageAccumulator( current );
-      for (auto pTracks : tracks)
-         if (pTracks)
-            WaveTrackUtilities::InspectBlocks(*pTracks, fn,
-               &active // Visit unique blocks only
-            );
-   }
+   // Measure the active blocks and the whole project file in one join,
+   // rather than with one query for each active block
+   if (!FillBlockIDTable(active))
+      return false;
+   auto cleanup = finally([this]{ ClearBlockIDTable(); });
 
-   // Get the number of blocks and total length from the project file.
-   unsigned long long total = GetTotalUsage();
+   unsigned long long current = 0;
+   unsigned long long total = 0;
+   unsigned long long activecount = 0;
    unsigned long long blockcount = 0;
-   
-   auto cb = [&blockcount](int cols, char **vals, char **)
+
+   auto cb = [&](int cols, char **vals, char **)
    {
       // Convert
       wxString(vals[0]).ToULongLong(&blockcount);
+      wxString(vals[1]).ToULongLong(&activecount);
+      wxString(vals[2]).ToULongLong(&total);
+      wxString(vals[3]).ToULongLong(&current);
       return 0;
    };
 
-   if (!Query("SELECT Count(*) FROM sampleblocks;", cb) || blockcount == 0)
+   static const char *statement =
+R"(SELECT
+	count(*), count(active.blockid),
+	coalesce(sum(blocks.size), 0),
+	coalesce(sum(CASE WHEN active.blockid IS NULL THEN 0 ELSE blocks.size END), 0)
+FROM (SELECT blockid,
+	length(blockid) + length(sampleformat) +
+	length(summin) + length(summax) + length(sumrms) +
+	length(summary256) + length(summary64k) +
+	length(samples) AS size
+	FROM sampleblocks) AS blocks
+LEFT JOIN temp.blockidset AS active USING (blockid);)";
+
+   // The same, counting the 4k summaries too
+   static const char *statementWithSummaries =
+R"(SELECT
+	count(*), count(active.blockid),
+	coalesce(sum(blocks.size), 0),
+	coalesce(sum(CASE WHEN active.blockid IS NULL THEN 0 ELSE blocks.size END), 0)
+FROM (SELECT blockid,
+	length(blockid) + length(sampleformat) +
+	length(summin) + length(summax) + length(sumrms) +
+	length(summary256) + length(summary64k) +
+	length(samples) + coalesce(length(summary4k), 0) AS size
+	FROM sampleblocks LEFT JOIN sampleblocksummaries USING (blockid)) AS blocks
+LEFT JOIN temp.blockidset AS active USING (blockid);)";
+
+   const auto pConn = CurrConn().get();
+   const auto sql = pConn && pConn->HasSummary4kTable()
+      ? statementWithSummaries : statement;
+   if (!Query(sql, cb) || blockcount == 0)
    {
       // Shouldn't compact since we don't have the full picture
       return false;
    }
 
+   auto duration = std::chrono::high_resolution_clock::now() - now;
+
+   wxLogDebug(
+      "ShouldCompact: %llu of %llu blocks in use, measured in %lld ms",
+      activecount, blockcount,
+      std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+
    // Remember if we had unused blocks in the project file
-   mHadUnused = (blockcount > active.size());
+   mHadUnused = (blockcount > activecount);
 
    // Let's make a percentage...should be plenty of head room
    current *= 100;
@@ -1223,6 +1495,12 @@ bool ProjectFileIO::ShouldCompact(const std::vector<const TrackList *> &tracks)
    return true;
 }
 
+void ProjectFileIO::FlushReclaim()
+{
+   if (auto pConn = CurrConn().get())
+      pConn->FlushReclaim();
+}
+
 Connection &ProjectFileIO::CurrConn()
 {
    auto &connectionPtr = ConnectionPtr::Get( mProject );
@@ -1742,6 +2020,9 @@ void ProjectFileIO::WriteXMLHeader(XMLWriter &xmlFile) const
    xmlFile.Write(wxT(">\n"));
 }
 
+// Fewer tracks are written on the calling thread
+static constexpr size_t MinTracksPerFragment = 4;
+
 void ProjectFileIO::WriteXML(XMLWriter &xmlFile,
                              bool recording /* = false */,
                              const TrackList *tracks /* = nullptr */)
@@ -1760,6 +2041,10 @@ void ProjectFileIO::WriteXML(XMLWriter &xmlFile,
 
    ProjectFileIORegistry::Get().CallWriters(proj, xmlFile);
 
+   // Decide which tracks to write on this thread; tracks only read
+   // themselves while writing, and call the writers of other modules under
+   // Track::ExtensionWritersMutex(), so they can then be written concurrently
+   std::vector<const Track*> tracksToWrite;
    auto &pendingTracks = PendingTracks::Get(proj);
    tracklist.Any().Visit([&](const Track &t) {
       auto useTrack = &t;
@@ -1777,9 +2062,38 @@ void ProjectFileIO::WriteXML(XMLWriter &xmlFile,
          // when pushing.  Don't auto-save it.
          return;
       }
-      useTrack->WriteXML(xmlFile);
+      tracksToWrite.push_back(useTrack);
    });
 
+   // Every fragment costs a serializer, which allocates in 1MB chunks, so
+   // write in parallel only when there are enough tracks to share out
+   using audacity::concurrency::TaskPool;
+   auto &pool = TaskPool::Get();
+   const auto nFragments = std::min<size_t>(
+      tracksToWrite.size() / MinTracksPerFragment,
+      pool.GetWorkersCount() + 1);
+   const auto pSerializer = dynamic_cast<ProjectSerializer*>(&xmlFile);
+
+   if (!pSerializer || nFragments < 2) {
+      for (auto pTrack : tracksToWrite)
+         pTrack->WriteXML(xmlFile);
+   }
+   else {
+      // Each fragment is a contiguous run of tracks with its own serializer,
+      // so the fragments join in the original order
+      std::vector<ProjectSerializer> fragments(nFragments);
+      pool.ParallelFor(nFragments, 1, [&](size_t begin, size_t end) {
+         for (auto ii = begin; ii < end; ++ii) {
+            const auto first = tracksToWrite.size() * ii / nFragments;
+            const auto last = tracksToWrite.size() * (ii + 1) / nFragments;
+            for (auto jj = first; jj < last; ++jj)
+               tracksToWrite[jj]->WriteXML(fragments[ii]);
+         }
+      });
+      for (const auto &fragment : fragments)
+         pSerializer->AppendFragment(fragment);
+   }
+
    xmlFile.EndTag(wxT("project"));
 
    //TIMER_STOP( xml_writer_timer );
@@ -1874,8 +2188,10 @@ bool ProjectFileIO::WriteDoc(const char *table,
    // Might return SQL_MISUSE which means it's our mistake that we violated
    // preconditions; should return SQL_OK which is 0
    if (
-      sqlite3_bind_zeroblob(stmt, 1, dict.GetSize()) ||
-      sqlite3_bind_zeroblob(stmt, 2, data.GetSize()))
+      // The 64 bit versions fail on documents too large for SQLite, rather
+      // than truncating the size
+      sqlite3_bind_zeroblob64(stmt, 1, dict.GetSize()) ||
+      sqlite3_bind_zeroblob64(stmt, 2, data.GetSize()))
    {
       ADD_EXCEPTION_CONTEXT("sqlite3.query", sql);
       ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
@@ -2066,10 +2382,10 @@ auto ProjectFileIO::LoadProject(const FilePath &fileName, bool ignoreAutosave)
    else
    {
       // Load 'er up
-      BufferedProjectBlobStream stream(
-         DB(), "main", useAutosave ? "autosave" : "project", rowId);
-
-      success = ProjectSerializer::Decode(stream, this);
+      std::vector<uint8_t> doc;
+      success = ReadProjectDoc(
+         DB(), "main", useAutosave ? "autosave" : "project", rowId, doc) &&
+         ProjectSerializer::Decode(doc.data(), doc.size(), this);
 
       if (!success)
       {
@@ -2084,6 +2400,12 @@ auto ProjectFileIO::LoadProject(const FilePath &fileName, bool ignoreAutosave)
       auto blockids = WaveTrackFactory::Get( mProject )
          .GetSampleBlockFactory()
             ->GetActiveBlockIDs();
+
+      // The blocks of stretched copies of clips that a crash left are not
+      // orphans of the project
+      if (!DeleteStretchedCopyBlocks(blockids))
+         return {};
+
       if (blockids.size() > 0)
       {
          success = DeleteBlocks(blockids, true);
@@ -2153,6 +2475,9 @@ bool ProjectFileIO::UpdateSaved(const TrackList *tracks)
 bool ProjectFileIO::SaveProject(
    const FilePath &fileName, const TrackList *lastSaved)
 {
+   // Finish deleting blocks discarded from undo history
+   FlushReclaim();
+
    // In the case where we're saving a temporary project to a permanent project,
    // we'll try to simply rename the project to save a bit of time. We then fall
    // through to the normal Save (not SaveAs) processing.
@@ -2563,6 +2888,14 @@ int64_t ProjectFileIO::GetCurrentUsage(
    return current;
 }
 
+int64_t ProjectFileIO::GetPendingReclaimUsage() const
+{
+   auto &pConn = ConnectionPtr::Get(mProject).mpConnection;
+   if (!pConn)
+      return 0;
+   return pConn->GetPendingReclaimBytes();
+}
+
 int64_t ProjectFileIO::GetTotalUsage()
 {
    auto pConn = CurrConn().get();
@@ -2580,7 +2913,23 @@ int64_t ProjectFileIO::GetDiskUsage(DBConnection &conn, SampleBlockID blockid /*
 {
    sqlite3_stmt* stmt = nullptr;
 
-   if (blockid == 0)
+   // Count the 4k summaries too, if the project has them
+   const bool summaries = conn.HasSummary4kTable();
+
+   if (blockid == 0 && summaries)
+   {
+      static const char* statement =
+R"(SELECT
+	sum(length(blockid) + length(sampleformat) +
+	length(summin) + length(summax) + length(sumrms) +
+	length(summary256) + length(summary64k) +
+	length(samples) + coalesce(length(summary4k), 0))
+FROM sampleblocks LEFT JOIN sampleblocksummaries USING (blockid);)";
+
+      stmt = conn.Prepare(
+         DBConnection::GetAllSampleBlocksSizeWithSummaries, statement);
+   }
+   else if (blockid == 0)
    {
       static const char* statement =
 R"(SELECT
@@ -2592,6 +2941,20 @@ FROM sampleblocks;)";
 
       stmt = conn.Prepare(DBConnection::GetAllSampleBlocksSize, statement);
    }
+   else if (summaries)
+   {
+      static const char* statement =
+R"(SELECT
+	length(blockid) + length(sampleformat) +
+	length(summin) + length(summax) + length(sumrms) +
+	length(summary256) + length(summary64k) +
+	length(samples) + coalesce(length(summary4k), 0)
+FROM sampleblocks LEFT JOIN sampleblocksummaries USING (blockid)
+WHERE blockid = ?1;)";
+
+      stmt = conn.Prepare(
+         DBConnection::GetSampleBlockSizeWithSummary, statement);
+   }
    else
    {
       static const char* statement =
@@ -23,9 +23,7 @@ Paul Licameli split from AudacityProject.h
 #include "XMLTagHandler.h" // to inherit
 
 struct sqlite3;
-struct sqlite3_context;
 struct sqlite3_stmt;
-struct sqlite3_value;
 
 class AudacityProject;
 class DBConnection;
@@ -139,6 +137,11 @@ public:
    // they are attached to the active tracks or held by the Undo manager.
    int64_t GetTotalUsage();
 
+   // Return the estimated bytes of sample blocks discarded from undo history,
+   // whose deletion from the project file has not yet finished.  These are
+   // still included in GetTotalUsage().
+   int64_t GetPendingReclaimUsage() const;
+
    // Return the bytes used for the given block using the connection to a
    // specific database. This is the workhorse for the above 3 methods.
    static int64_t GetDiskUsage(DBConnection &conn, SampleBlockID blockid);
@@ -213,6 +216,8 @@ public:
 
    // In one SQL command, delete sample blocks with ids in the given set, or
    // (when complement is true), with ids not in the given set.
+   // In the complement case, blocks locked by a ProjectFileIOExtension are
+   // kept.
    bool DeleteBlocks(const BlockIDs &blockids, bool complement);
 
    // Type of function that is given the fields of one row and returns
@@ -251,6 +256,18 @@ private:
    bool OpenConnection(FilePath fileName = {});
    bool CloseConnection();
 
+   // Delete the stretched copies of the clips of this project from the cache
+   void ClearStretchedCopies();
+
+   // Remember the blocks of the stretched copies in the database, so that
+   // they are not taken for orphans after a crash
+   void RecordStretchedCopyBlocks(const std::vector<SampleBlockID> &blockids);
+
+   // Delete the blocks of stretched copies left by a crash, except the active
+   // ones, without marking the project recovered
+   // Returns false on failure, with the error already set.
+   bool DeleteStretchedCopyBlocks(const BlockIDs &active);
+
    // Put the current database connection aside, keeping it open, so that
    // another may be opened with OpenDB()
    void SaveConnection();
@@ -275,8 +292,13 @@ private:
    // Write project or autosave XML (binary) documents
    bool WriteDoc(const char *table, const ProjectSerializer &autosave, const char *schema = "main");
 
-   // Application defined function to verify blockid exists is in set of blockids
-   static void InSet(sqlite3_context *context, int argc, sqlite3_value **argv);
+   // Fill a temporary table with the given blockids (in ascending order), so
+   // that statements on sampleblocks can join against the set of ids instead
+   // of testing each row with an application defined function.
+   // Returns false on failure, with the error already set.
+   bool FillBlockIDTable(const BlockIDs &blockids);
+   // Empty the temporary table again
+   void ClearBlockIDTable();
 
    // Return a database connection if successful, which caller must close
    bool CopyTo(const FilePath &destpath,
@@ -301,6 +323,9 @@ private:
 
    bool ShouldCompact(const std::vector<const TrackList *> &tracks);
 
+   // Wait for pending deletions of sample blocks discarded from undo history
+   void FlushReclaim();
+
 private:
    Connection &CurrConn();
 
@@ -332,6 +357,8 @@ private:
    Connection mPrevConn;
    FilePath mPrevFileName;
    bool mPrevTemporary;
+
+   Observer::Subscription mStretchCacheSubscription;
 };
 
 //! Makes a temporary project that doesn't display on the screen
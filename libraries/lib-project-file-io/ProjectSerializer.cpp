@@ -16,12 +16,11 @@
 #include "ProjectSerializer.h"
 
 #include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <cstdint>
-#include <mutex>
-#include <wx/ustring.h>
-#include <codecvt>
-#include <locale>
-#include <deque>
+#include <cstring>
+#include <unordered_set>
 
 #include <wx/log.h>
 
@@ -50,6 +49,10 @@
 // to preserve the active dictionary.  The decoder will then restore the
 // dictionary when an FT_Pop is encountered.  Nesting is unlimited.
 //
+// Subtrees let fragments that were serialized independently, each with its
+// own dictionary (possibly on other threads), be concatenated without
+// renumbering their names.
+//
 // To save space, each name (attribute or element) encountered is stored in
 // the name dictionary and replaced with the assigned 2-byte identifier.
 //
@@ -78,15 +81,6 @@ enum FieldTypes
    FT_Name           // type, ID, name length, name
 };
 
-// Static so that the dict can be reused each time.
-//
-// If entries get added later, like when an envelope node (for example)
-// is written and then the envelope is later removed, the dict will still
-// contain the envelope name, but that's not a problem.
-
-NameMap ProjectSerializer::mNames;
-MemoryStream ProjectSerializer::mDict;
-
 TranslatableString ProjectSerializer::FailureMessage( const FilePath &/*filePath*/ )
 {
    return 
@@ -141,24 +135,6 @@ template <typename Number> void WriteBigEndian(MemoryStream& out, Number value)
    out.AppendData(&value, sizeof(value));
 }
 
-// Read little-endian file format to native little-endian
-template <typename Number> Number ReadLittleEndian(BufferedStreamReader& in)
-{
-   Number result;
-   in.ReadValue(result);
-   return result;
-}
-
-// Read little-endian file format to native big-endian
-template <typename Number> Number ReadBigEndian(BufferedStreamReader& in)
-{
-   Number result;
-   in.ReadValue(result);
-   auto begin = static_cast<unsigned char*>(static_cast<void*>(&result));
-   std::reverse(begin, begin + sizeof(result));
-   return result;
-}
-
 // Choose between implementations!
 static const auto WriteUShort =
    IsLittleEndian() ? &WriteLittleEndian<UShort> : &WriteBigEndian<UShort>;
@@ -171,28 +147,192 @@ static const auto WriteULong =
 static const auto WriteLongLong =
    IsLittleEndian() ? &WriteLittleEndian<LongLong> : &WriteBigEndian<LongLong>;
 
-static const auto ReadUShort =
-   IsLittleEndian() ? &ReadLittleEndian<UShort> : &ReadBigEndian<UShort>;
-static const auto ReadInt =
-   IsLittleEndian() ? &ReadLittleEndian<Int> : &ReadBigEndian<Int>;
-static const auto ReadLong =
-   IsLittleEndian() ? &ReadLittleEndian<Long> : &ReadBigEndian<Long>;
-static const auto ReadULong =
-   IsLittleEndian() ? &ReadLittleEndian<ULong> : &ReadBigEndian<ULong>;
-static const auto ReadLongLong =
-   IsLittleEndian() ? &ReadLittleEndian<LongLong> : &ReadBigEndian<LongLong>;
-
 // Functions to read and write certain lengths -- maybe we will change
 // our choices for widths or signedness?
 
 using Length = Int; // Instead, as wide as size_t?
 static const auto WriteLength = WriteInt;
-static const auto ReadLength = ReadInt;
 
 using Digits = Int; // Instead, just an unsigned char?
 static const auto WriteDigits = WriteInt;
-static const auto ReadDigits = ReadInt;
 
+// Exception type for short-range try/catch in Decode
+struct DecodeError {};
+
+//! Reads the fields of a document held entirely in memory
+/*! Values are never copied out of the document unless they need to be
+ converted; strings are returned as views into the original bytes.
+ */
+class BinaryDocumentReader final
+{
+public:
+   BinaryDocumentReader(const void* data, size_t size) noexcept
+       : mCurrent(static_cast<const uint8_t*>(data))
+       , mEnd(mCurrent + size)
+   {
+   }
+
+   bool Eof() const noexcept
+   {
+      return mCurrent == mEnd;
+   }
+
+   //! Returns a pointer to the next count bytes and skips them
+   const uint8_t* Consume(size_t count)
+   {
+      if (static_cast<size_t>(mEnd - mCurrent) < count)
+         throw DecodeError {};
+
+      const auto result = mCurrent;
+      mCurrent += count;
+      return result;
+   }
+
+   uint8_t GetC()
+   {
+      return *Consume(1);
+   }
+
+   //! Reads a value stored in the native byte order of the writer
+   template <typename Value> Value ReadNative()
+   {
+      Value result;
+      std::memcpy(&result, Consume(sizeof(result)), sizeof(result));
+      return result;
+   }
+
+   //! Reads a little-endian integer, see WriteUShort and friends
+   template <typename Number> Number ReadNumber()
+   {
+      auto result = ReadNative<Number>();
+
+      if (!IsLittleEndian())
+      {
+         auto begin = static_cast<unsigned char*>(static_cast<void*>(&result));
+         std::reverse(begin, begin + sizeof(result));
+      }
+
+      return result;
+   }
+
+   UShort ReadUShort() { return ReadNumber<UShort>(); }
+   Int ReadInt() { return ReadNumber<Int>(); }
+   Long ReadLong() { return ReadNumber<Long>(); }
+   ULong ReadULong() { return ReadNumber<ULong>(); }
+   LongLong ReadLongLong() { return ReadNumber<LongLong>(); }
+   Length ReadLength()
+   {
+      const auto length = ReadNumber<Length>();
+      if (length < 0)
+         throw DecodeError {};
+      return length;
+   }
+   Digits ReadDigits() { return ReadNumber<Digits>(); }
+
+private:
+   const uint8_t* mCurrent;
+   const uint8_t* const mEnd;
+};
+
+void AppendCodePoint(std::string& out, char32_t c)
+{
+   if (c < 0x80)
+      out.push_back(static_cast<char>(c));
+   else if (c < 0x800)
+   {
+      out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+   }
+   else if (c < 0x10000)
+   {
+      // Lone surrogates can not be represented in UTF-8
+      if (c >= 0xD800 && c <= 0xDFFF)
+         c = 0xFFFD;
+
+      out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+   }
+   else if (c < 0x110000)
+   {
+      out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+   }
+   else
+      AppendCodePoint(out, 0xFFFD);
+}
+
+//! Appends UTF-16 or UTF-32 text in the native byte order to out as UTF-8
+template <typename BaseCharType>
+void AppendUTF8(std::string& out, const uint8_t* bytes, size_t bytesCount)
+{
+   constexpr size_t charSize = sizeof(BaseCharType);
+
+   if (bytesCount % charSize != 0)
+      throw DecodeError {};
+
+   const auto count = bytesCount / charSize;
+   // Characters are not necessarily aligned within the document
+   auto charAt = [bytes](size_t index)
+   {
+      BaseCharType c;
+      std::memcpy(&c, bytes + index * charSize, charSize);
+      return static_cast<char32_t>(c);
+   };
+
+   // Most of the strings in a project are ASCII and need one byte per
+   // character
+   out.reserve(out.size() + count);
+
+   for (size_t i = 0; i < count; ++i)
+   {
+      auto c = charAt(i);
+
+      if constexpr (charSize == 2)
+      {
+         if (c >= 0xD800 && c <= 0xDBFF && i + 1 < count)
+         {
+            const auto low = charAt(i + 1);
+            if (low >= 0xDC00 && low <= 0xDFFF)
+            {
+               c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+               ++i;
+            }
+         }
+      }
+
+      AppendCodePoint(out, c);
+   }
+}
+
+void AppendString(
+   std::string& out, char charSize, const uint8_t* bytes, size_t bytesCount)
+{
+   switch (charSize)
+   {
+   case 1:
+      out.append(reinterpret_cast<const char*>(bytes), bytesCount);
+      break;
+   case 2:
+      AppendUTF8<char16_t>(out, bytes, bytesCount);
+      break;
+   case 4:
+      AppendUTF8<char32_t>(out, bytes, bytesCount);
+      break;
+   default:
+      wxASSERT_MSG(false, wxT("Characters size not 1, 2, or 4"));
+      throw DecodeError {};
+   }
+}
+
+//! Replays the decoded document as calls to XMLTagHandler
+/*! Names and values passed to the handlers are views that either point into
+ the document itself, into the interned dictionary names, or into a scratch
+ buffer that is reused for every tag, so that no allocation happens per
+ attribute once the buffers have grown to the size of the largest tag.
+ */
 class XMLTagHandlerAdapter final
 {
 public:
@@ -215,20 +355,43 @@ public:
       if (mInTag)
          EmitStartTag();
 
+      if (mHandlers.empty())
+         throw DecodeError {};
+
       if (XMLTagHandler* const handler = mHandlers.back())
          handler->HandleXMLEndTag(name);
 
       mHandlers.pop_back();
    }
 
-   void WriteAttr(const std::string_view& name, std::string value)
+   //! Adds a string attribute whose value must outlive the decoding
+   void WriteAttr(const std::string_view& name, const std::string_view& value)
    {
       assert(mInTag);
 
       if (!mInTag)
          return;
 
-      mAttributes.emplace_back(name, CacheString(std::move(value)));
+      mAttributes.emplace_back(name, XMLAttributeValueView(value));
+   }
+
+   //! Adds a string attribute that must be converted to UTF-8 first
+   void WriteAttr(
+      const std::string_view& name, char charSize, const uint8_t* bytes,
+      size_t bytesCount)
+   {
+      assert(mInTag);
+
+      if (!mInTag)
+         return;
+
+      // The scratch buffer may be reallocated while the tag is collected,
+      // so the views are only made in EmitStartTag
+      const auto offset = mScratch.size();
+      AppendString(mScratch, charSize, bytes, bytesCount);
+      mConvertedAttributes.push_back(
+         { mAttributes.size(), offset, mScratch.size() - offset });
+      mAttributes.emplace_back(name, XMLAttributeValueView {});
    }
 
    template <typename T> void WriteAttr(const std::string_view& name, T value)
@@ -241,21 +404,27 @@ public:
       mAttributes.emplace_back(name, XMLAttributeValueView(value));
    }
 
-   void WriteData(std::string value)
+   void WriteData(char charSize, const uint8_t* bytes, size_t bytesCount)
    {
       if (mInTag)
          EmitStartTag();
 
-      if (XMLTagHandler* const handler = mHandlers.back())
-         handler->HandleXMLContent(CacheString(std::move(value)));
-   }
+      if (mHandlers.empty())
+         return;
 
-   void WriteRaw(std::string)
-   {
-      // This method is intentionally left empty.
-      // The only data that is serialized by FT_Raw
-      // is the boilerplate code like <?xml > and <!DOCTYPE>
-      // which are ignored
+      if (XMLTagHandler* const handler = mHandlers.back())
+      {
+         if (charSize == 1)
+            handler->HandleXMLContent(std::string_view(
+               reinterpret_cast<const char*>(bytes), bytesCount));
+         else
+         {
+            mScratch.clear();
+            AppendString(mScratch, charSize, bytes, bytesCount);
+            handler->HandleXMLContent(mScratch);
+            mScratch.clear();
+         }
+      }
    }
 
    bool Finalize()
@@ -272,6 +441,11 @@ public:
 private:
    void EmitStartTag()
    {
+      for (const auto& converted : mConvertedAttributes)
+         mAttributes[converted.index].second = XMLAttributeValueView(
+            std::string_view(
+               mScratch.data() + converted.offset, converted.length));
+
       if (mHandlers.empty())
       {
          mHandlers.push_back(mBaseHandler);
@@ -295,16 +469,19 @@ private:
          }
       }
 
-      mStringsCache.clear();
+      // clear() keeps the capacity, so the buffers are reused by the next tag
+      mScratch.clear();
+      mConvertedAttributes.clear();
       mAttributes.clear();
       mInTag = false;
    }
 
-   std::string_view CacheString(std::string string)
+   struct ConvertedAttribute
    {
-      mStringsCache.emplace_back(std::move(string));
-      return mStringsCache.back();
-   }
+      size_t index;
+      size_t offset;
+      size_t length;
+   };
 
    XMLTagHandler* mBaseHandler;
 
@@ -312,53 +489,21 @@ private:
 
    std::string_view mCurrentTagName;
 
-   std::deque<std::string> mStringsCache;
+   std::string mScratch;
+   std::vector<ConvertedAttribute> mConvertedAttributes;
    AttributesList mAttributes;
 
    bool mInTag { false };
 };
-
-// template<typename BaseCharType>
-// std::string FastStringConvertFromAscii(const BaseCharType* begin, const BaseCharType* end)
-// {
-// 
-// }
-
-template<typename BaseCharType>
-std::string FastStringConvert(const void* bytes, int bytesCount)
-{
-   constexpr int charSize = sizeof(BaseCharType);
-
-   assert(bytesCount % charSize == 0);
-
-   const auto begin = static_cast<const BaseCharType*>(bytes);
-   const auto end = begin + bytesCount / charSize;
-
-   const bool isAscii = std::all_of(
-      begin, end,
-      [](BaseCharType c)
-      { return static_cast<std::make_unsigned_t<BaseCharType>>(c) < 0x7f; });
-
-   if (isAscii)
-      return std::string(begin, end);
-   
-   return std::wstring_convert<std::codecvt_utf8<BaseCharType>, BaseCharType>()
-      .to_bytes(begin, end);
-}
 } // namespace
 
 ProjectSerializer::ProjectSerializer(size_t allocSize)
 {
-   static std::once_flag flag;
-   std::call_once(flag, []{
-      // Just once per run, store header information in the unique static
-      // dictionary that will be written into each project that is saved.
-      // Store the size of "wxStringCharType" so we can convert during recovery
-      // in case the file is used on a system with a different character size.
-      char size = sizeof(wxStringCharType);
-      mDict.AppendByte(FT_CharSize);
-      mDict.AppendData(&size, 1);
-   });
+   // Store the size of "wxStringCharType" so we can convert during recovery
+   // in case the file is used on a system with a different character size.
+   char size = sizeof(wxStringCharType);
+   mDict.AppendByte(FT_CharSize);
+   mDict.AppendData(&size, 1);
 
    mDictChanged = false;
 }
@@ -481,8 +626,7 @@ void ProjectSerializer::WriteName(const wxString & name)
    }
    else
    {
-      // mNames is static.  This appends each name to static mDict only once
-      // in each run.
+      // This appends each name to mDict only once per serializer.
       UShort len = name.length() * sizeof(wxStringCharType);
 
       id = mNames.size();
@@ -499,6 +643,21 @@ void ProjectSerializer::WriteName(const wxString & name)
    WriteUShort( mBuffer, id );
 }
 
+void ProjectSerializer::AppendFragment(const ProjectSerializer& fragment)
+{
+   // The fragment has its own dictionary, so its ids are only valid between
+   // FT_Push and FT_Pop
+   mBuffer.AppendByte(FT_Push);
+
+   for (const auto [data, size] : fragment.mDict)
+      mBuffer.AppendData(data, size);
+
+   for (const auto [data, size] : fragment.mBuffer)
+      mBuffer.AppendData(data, size);
+
+   mBuffer.AppendByte(FT_Pop);
+}
+
 const MemoryStream &ProjectSerializer::GetDict() const
 {
    return mDict;
@@ -525,56 +684,74 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
    if (handler == nullptr)
       return false;
 
-   XMLTagHandlerAdapter adapter(handler);
+   // Gather the whole document, so that values can be viewed in place
+   constexpr size_t chunkSize = 32 * 1024;
+   std::vector<uint8_t> bytes;
 
-   std::vector<char> bytes;
-   IdMap mIds;
-   std::vector<IdMap> mIdStack;
-   char mCharSize = 0;
+   while (!in.Eof())
+   {
+      const auto offset = bytes.size();
+      bytes.resize(offset + chunkSize);
+      bytes.resize(offset + in.Read(bytes.data() + offset, chunkSize));
+   }
 
-   mIds.clear();
+   return Decode(bytes.data(), bytes.size(), handler);
+}
 
-   struct Error{}; // exception type for short-range try/catch
-   auto Lookup = [&mIds]( UShort id ) -> std::string_view
+bool ProjectSerializer::Decode(
+   const void* data, size_t size, XMLTagHandler* handler)
+{
+   if (handler == nullptr)
+      return false;
+
+   auto now = std::chrono::high_resolution_clock::now();
+
+   XMLTagHandlerAdapter adapter(handler);
+   BinaryDocumentReader in(data, size);
+
+   // Names indexed by id.  Views point either into the document or into
+   // namePool, so that saving and restoring the dictionary is cheap and
+   // every name is converted only once.
+   using Names = std::vector<std::string_view>;
+   Names ids;
+   std::vector<Names> idStack;
+   std::unordered_set<std::string> namePool;
+   std::string nameScratch;
+   char charSize = 0;
+
+   auto Lookup = [&ids]( UShort id ) -> std::string_view
    {
-      auto iter = mIds.find( id );
-      if (iter == mIds.end())
-      {
-         throw Error{};
-      }
+      // An id that was never defined has a null view
+      if (id >= ids.size() || ids[id].data() == nullptr)
+         throw DecodeError{};
 
-      return iter->second;
+      return ids[id];
+   };
+
+   auto Intern = [&](const uint8_t* bytes, size_t len) -> std::string_view
+   {
+      if (charSize == 1)
+         return { reinterpret_cast<const char*>(bytes), len };
+
+      nameScratch.clear();
+      AppendString(nameScratch, charSize, bytes, len);
+
+      auto iter = namePool.find(nameScratch);
+      if (iter == namePool.end())
+         iter = namePool.insert(nameScratch).first;
+
+      return *iter;
    };
 
    int64_t stringsCount = 0;
    int64_t stringsLength = 0;
 
-   auto ReadString = [&mCharSize, &in, &bytes, &stringsCount, &stringsLength](int len) -> std::string
+   auto ReadString = [&](size_t len)
    {
-      bytes.reserve( len );
-      auto data = bytes.data();
-      in.Read( data, len );
-
       stringsCount++;
       stringsLength += len;
-      
-      switch (mCharSize)
-      {
-         case 1:
-            return std::string(bytes.data(), len);
-
-         case 2:
-            return FastStringConvert<char16_t>(bytes.data(), len);
-
-         case 4:
-            return FastStringConvert<char32_t>(bytes.data(), len);
-
-         default:
-            wxASSERT_MSG(false, wxT("Characters size not 1, 2, or 4"));
-         break;
-      }
 
-      return {};
+      return in.Consume(len);
    };
 
    try
@@ -587,29 +764,36 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
          {
             case FT_Push:
             {
-               mIdStack.push_back(mIds);
-               mIds.clear();
+               idStack.push_back(ids);
+               ids.clear();
             }
             break;
 
             case FT_Pop:
             {
-               mIds = mIdStack.back();
-               mIdStack.pop_back();
+               if (idStack.empty())
+                  throw DecodeError{};
+
+               ids = std::move(idStack.back());
+               idStack.pop_back();
             }
             break;
 
             case FT_Name:
             {
-               id = ReadUShort( in );
-               auto len = ReadUShort( in );
-               mIds[id] = ReadString(len);
+               id = in.ReadUShort();
+               auto len = in.ReadUShort();
+               auto name = Intern(in.Consume(len), len);
+
+               if (id >= ids.size())
+                  ids.resize(id + 1);
+               ids[id] = name;
             }
             break;
 
             case FT_StartTag:
             {
-               id = ReadUShort( in );
+               id = in.ReadUShort();
 
                adapter.EmitStartTag(Lookup(id));
             }
@@ -617,7 +801,7 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_EndTag:
             {
-               id = ReadUShort( in );
+               id = in.ReadUShort();
 
                adapter.EndTag(Lookup(id));
             }
@@ -625,20 +809,25 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_String:
             {
-               id = ReadUShort( in );
-               int len = ReadLength( in );
-               
-               adapter.WriteAttr(Lookup(id), ReadString(len));
+               id = in.ReadUShort();
+               const auto name = Lookup(id);
+               const size_t len = in.ReadLength();
+               const auto bytes = ReadString(len);
+
+               if (charSize == 1)
+                  adapter.WriteAttr(
+                     name, std::string_view(
+                        reinterpret_cast<const char*>(bytes), len));
+               else
+                  adapter.WriteAttr(name, charSize, bytes, len);
             }
             break;
 
             case FT_Float:
             {
-               float val;
-
-               id = ReadUShort( in );
-               in.Read(&val, sizeof(val));
-               /* int dig = */ReadDigits(in);
+               id = in.ReadUShort();
+               auto val = in.ReadNative<float>();
+               /* int dig = */in.ReadDigits();
 
                adapter.WriteAttr(Lookup(id), val);
             }
@@ -646,11 +835,9 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Double:
             {
-               double val;
-
-               id = ReadUShort( in );
-               in.Read(&val, sizeof(val));
-               /*int dig = */ReadDigits(in);
+               id = in.ReadUShort();
+               auto val = in.ReadNative<double>();
+               /*int dig = */in.ReadDigits();
 
                adapter.WriteAttr(Lookup(id), val);
             }
@@ -658,8 +845,8 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Int:
             {
-               id = ReadUShort( in );
-               int val = ReadInt( in );
+               id = in.ReadUShort();
+               int val = in.ReadInt();
 
                adapter.WriteAttr(Lookup(id), val);
             }
@@ -667,10 +854,8 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Bool:
             {
-               unsigned char val;
-
-               id = ReadUShort( in );
-               in.Read(&val, 1);
+               id = in.ReadUShort();
+               unsigned char val = in.GetC();
 
                adapter.WriteAttr(Lookup(id), val);
             }
@@ -678,8 +863,8 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Long:
             {
-               id = ReadUShort( in );
-               long val = ReadLong( in );
+               id = in.ReadUShort();
+               long val = in.ReadLong();
 
                adapter.WriteAttr(Lookup(id), val);
             }
@@ -687,16 +872,16 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_LongLong:
             {
-               id = ReadUShort( in );
-               long long val = ReadLongLong( in );
+               id = in.ReadUShort();
+               long long val = in.ReadLongLong();
                adapter.WriteAttr(Lookup(id), val);
             }
             break;
 
             case FT_SizeT:
             {
-               id = ReadUShort( in );
-               size_t val = ReadULong( in );
+               id = in.ReadUShort();
+               size_t val = in.ReadULong();
 
                adapter.WriteAttr(Lookup(id), val);
             }
@@ -704,21 +889,24 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Data:
             {
-               int len = ReadLength( in );
-               adapter.WriteData(ReadString(len));
+               const size_t len = in.ReadLength();
+               adapter.WriteData(charSize, ReadString(len), len);
             }
             break;
 
             case FT_Raw:
             {
-               int len = ReadLength( in );
-               adapter.WriteRaw(ReadString(len));
+               // The only data that is serialized by FT_Raw
+               // is the boilerplate code like <?xml > and <!DOCTYPE>
+               // which are ignored
+               const size_t len = in.ReadLength();
+               in.Consume(len);
             }
             break;
 
             case FT_CharSize:
             {
-               in.Read(&mCharSize, 1);
+               charSize = in.GetC();
             }
             break;
 
@@ -728,15 +916,21 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
          }
       }
    }
-   catch( const Error& )
+   catch( const DecodeError& )
    {
       // Document was corrupt, or platform differences in size or endianness
       // were not well canonicalized
       return false;
    }
 
+   const auto result = adapter.Finalize();
+
+   auto duration = std::chrono::high_resolution_clock::now() - now;
+
    wxLogInfo(
-      "Loaded %lld string %f Kb in size", stringsCount, stringsLength / 1024.0);
+      "Decoded %lld strings %f Kb in size, %f Kb total, in %lld ms",
+      stringsCount, stringsLength / 1024.0, size / 1024.0,
+      std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
 
-   return adapter.Finalize();
+   return result;
 }
@@ -30,7 +30,6 @@ class BufferedStreamReader;
 ///
 
 using NameMap = std::unordered_map<wxString, unsigned short>;
-using IdMap = std::unordered_map<unsigned short, std::string>;
 
 // This class's overrides do NOT throw AudacityException.
 class PROJECT_FILE_IO_API ProjectSerializer final : public XMLWriter
@@ -59,15 +58,29 @@ public:
    void WriteData(const wxString & value) override;
    void Write(const wxString & data) override;
 
+   //! Append a document fragment written by another serializer
+   /*! The fragment keeps its own dictionary, so fragments can be written
+    concurrently by independent serializers and then joined in order.
+    */
+   void AppendFragment(const ProjectSerializer& fragment);
+
    const MemoryStream& GetDict() const;
    const MemoryStream& GetData() const;
 
    bool IsEmpty() const;
    bool DictChanged() const;
 
-   // Returns empty string if decoding fails
+   // Returns false if decoding fails
    static bool Decode(BufferedStreamReader& in, XMLTagHandler* handler);
 
+   //! Decode a document (dictionary followed by data) held in memory
+   /*!
+    String values and names are passed to the handler as views into the
+    document whenever no conversion is needed, so the memory must stay
+    valid for the duration of the call.
+    */
+   static bool Decode(const void* data, size_t size, XMLTagHandler* handler);
+
 private:
    void WriteName(const wxString& name);
 
@@ -75,8 +88,8 @@ private:
    MemoryStream mBuffer;
    bool mDictChanged;
 
-   static NameMap mNames;
-   static MemoryStream mDict;
+   NameMap mNames;
+   MemoryStream mDict;
 };
 
 #endif
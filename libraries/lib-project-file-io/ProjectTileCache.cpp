@@ -0,0 +1,382 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file ProjectTileCache.cpp
+
+**********************************************************************/
+#include "ProjectTileCache.h"
+
+#include "sqlite3.h"
+
+#include <algorithm>
+#include <wx/log.h>
+
+#include "AudacityException.h"
+#include "BasicUI.h"
+#include "DBConnection.h"
+#include "MemoryX.h"
+#include "Prefs.h"
+#include "Project.h"
+
+namespace
+{
+BoolSetting ProjectTileCacheEnabled { L"/Spectrum/TileCache", true };
+//! Limit of the size of the table, in megabytes
+IntSetting ProjectTileCacheBudget { L"/Spectrum/TileCacheBudget", 128 };
+
+constexpr size_t Megabyte = 1024 * 1024;
+
+// The size of the table is allowed to exceed the budget by 1/8 of it,
+// so the eviction is not done on every flush
+constexpr size_t EvictionSlackDivisor = 8;
+
+// A table of another format is dropped, the tiles can be computed again
+const char *const TileCacheSchema =
+   "DROP TABLE IF EXISTS main.tilecache;"
+   "CREATE TABLE main.tilecache"
+   "("
+   "  key                   INTEGER PRIMARY KEY,"
+   "  lastaccess            INTEGER,"
+   "  keydata               BLOB,"
+   "  data                  BLOB"
+   ");"
+   "CREATE INDEX IF NOT EXISTS main.tilecache_lastaccess"
+   "  ON tilecache(lastaccess);";
+
+//! Resets the statement when leaving the scope
+auto ResetStatement(sqlite3_stmt *stmt)
+{
+   return finally([stmt]
+   {
+      // Clear statement bindings and rewind statement
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+   });
+}
+} // namespace
+
+static const AudacityProject::AttachedObjects::RegisteredFactory sTileCacheKey{
+   []( AudacityProject &parent ){
+      return std::make_shared< ProjectTileCache >( parent );
+   }
+};
+
+ProjectTileCache &ProjectTileCache::Get( AudacityProject &project )
+{
+   return project.AttachedObjects::Get< ProjectTileCache >( sTileCacheKey );
+}
+
+const ProjectTileCache &ProjectTileCache::Get( const AudacityProject &project )
+{
+   return Get( const_cast< AudacityProject & >( project ) );
+}
+
+ProjectTileCache::ProjectTileCache(AudacityProject &project)
+   : mProject{ project }
+{
+}
+
+// Tiles still queued are lost, the connection may be already closed
+ProjectTileCache::~ProjectTileCache() = default;
+
+bool ProjectTileCache::IsEnabled()
+{
+   return ProjectTileCacheEnabled.Read();
+}
+
+size_t ProjectTileCache::GetBudget()
+{
+   const auto budget = ProjectTileCacheBudget.Read();
+   return static_cast<size_t>(
+      budget > 0 ? budget : ProjectTileCacheBudget.GetDefault()) * Megabyte;
+}
+
+bool ProjectTileCache::Read(Key key, const KeyData &keyData, Tile &tile)
+{
+   if (auto iter = mPendingWrites.find(key); iter != mPendingWrites.end())
+   {
+      if (iter->second.keyData != keyData)
+         return false;
+      tile = iter->second.tile;
+      return true;
+   }
+
+   auto pConnection = Conn();
+   if (!pConnection || !Attach(*pConnection))
+      return false;
+
+   try
+   {
+      // Prepare and cache statement...automatically finalized at DB close
+      sqlite3_stmt *stmt = pConnection->Prepare(DBConnection::GetTile,
+         "SELECT keydata, data FROM tilecache WHERE key = ?1;");
+      auto cleanup = ResetStatement(stmt);
+
+      if (sqlite3_bind_int64(stmt, 1, key) ||
+          sqlite3_step(stmt) != SQLITE_ROW)
+         return false;
+
+      // Another tile with the same hash is a miss
+      const auto storedKey =
+         static_cast<const uint8_t *>(sqlite3_column_blob(stmt, 0));
+      const auto storedKeySize =
+         static_cast<size_t>(sqlite3_column_bytes(stmt, 0));
+      if (storedKeySize != keyData.size() ||
+          (storedKeySize > 0 &&
+           !std::equal(keyData.begin(), keyData.end(), storedKey)))
+         return false;
+
+      const auto src = static_cast<const uint8_t *>(sqlite3_column_blob(stmt, 1));
+      const auto size = static_cast<size_t>(sqlite3_column_bytes(stmt, 1));
+
+      if (src == nullptr || size == 0)
+         return false;
+
+      tile.assign(src, src + size);
+   }
+   catch (const AudacityException &)
+   {
+      return false;
+   }
+
+   mPendingAccesses[key] = ++mAccessTick;
+   ScheduleFlush();
+
+   return true;
+}
+
+void ProjectTileCache::Write(Key key, KeyData keyData, Tile tile)
+{
+   if (tile.empty() || keyData.size() + tile.size() > GetBudget())
+      return;
+
+   mPendingAccesses.erase(key);
+   mPendingWrites[key] = { std::move(keyData), std::move(tile) };
+   ScheduleFlush();
+}
+
+void ProjectTileCache::Flush()
+{
+   mFlushScheduled = false;
+
+   // A rollback of a transaction of the project would also undo the tiles,
+   // and the size of the table would be wrong.  Keep the queues, the next
+   // access schedules another flush
+   if (auto pConnection = Conn(); pConnection && pConnection->DB() &&
+       !sqlite3_get_autocommit(pConnection->DB()))
+      return;
+
+   auto pendingWrites = std::move(mPendingWrites);
+   auto pendingAccesses = std::move(mPendingAccesses);
+   mPendingWrites.clear();
+   mPendingAccesses.clear();
+
+   auto pConnection = Conn();
+   if (!pConnection || (pendingWrites.empty() && pendingAccesses.empty()))
+      return;
+
+   auto &connection = *pConnection;
+
+   if (!Attach(connection) && (pendingWrites.empty() || !CreateTable(connection)))
+      return;
+
+   auto db = connection.DB();
+
+   if (sqlite3_exec(db, "SAVEPOINT TileCache;", nullptr, nullptr, nullptr) !=
+       SQLITE_OK)
+      return;
+
+   bool success = true;
+
+   try
+   {
+      if (!pendingWrites.empty())
+      {
+         sqlite3_stmt *stmt = connection.Prepare(DBConnection::InsertTile,
+            "INSERT OR REPLACE INTO tilecache (key, lastaccess, keydata, data)"
+            "                             VALUES(?1,?2,?3,?4);");
+
+         for (const auto &[key, pending] : pendingWrites)
+         {
+            auto cleanup = ResetStatement(stmt);
+
+            if (sqlite3_bind_int64(stmt, 1, key) ||
+                sqlite3_bind_int64(stmt, 2, ++mAccessTick) ||
+                sqlite3_bind_blob(stmt, 3, pending.keyData.data(),
+                   pending.keyData.size(), SQLITE_STATIC) ||
+                sqlite3_bind_blob(stmt, 4, pending.tile.data(),
+                   pending.tile.size(), SQLITE_STATIC) ||
+                sqlite3_step(stmt) != SQLITE_DONE)
+            {
+               success = false;
+               break;
+            }
+
+            // A replaced tile is counted twice, until the table is attached again
+            mTableBytes += pending.keyData.size() + pending.tile.size();
+         }
+      }
+
+      if (success && !pendingAccesses.empty())
+      {
+         sqlite3_stmt *stmt = connection.Prepare(DBConnection::TouchTile,
+            "UPDATE tilecache SET lastaccess = ?2 WHERE key = ?1;");
+
+         for (const auto &[key, tick] : pendingAccesses)
+         {
+            auto cleanup = ResetStatement(stmt);
+
+            if (sqlite3_bind_int64(stmt, 1, key) ||
+                sqlite3_bind_int64(stmt, 2, tick) ||
+                sqlite3_step(stmt) != SQLITE_DONE)
+            {
+               success = false;
+               break;
+            }
+         }
+      }
+
+      if (success)
+         success = Evict(connection);
+   }
+   catch (const AudacityException &)
+   {
+      success = false;
+   }
+
+   if (success)
+      success = sqlite3_exec(
+         db, "RELEASE TileCache;", nullptr, nullptr, nullptr) == SQLITE_OK;
+
+   if (!success)
+   {
+      wxLogDebug(wxT("ProjectTileCache::Flush - SQLITE error %s"),
+         sqlite3_errmsg(db));
+
+      sqlite3_exec(db, "ROLLBACK TO TileCache;", nullptr, nullptr, nullptr);
+      sqlite3_exec(db, "RELEASE TileCache;", nullptr, nullptr, nullptr);
+
+      // The rolled back writes were counted; read the size of the table
+      // again on the next access
+      mDB = nullptr;
+   }
+}
+
+DBConnection *ProjectTileCache::Conn() const
+{
+   return ConnectionPtr::Get(mProject).mpConnection.get();
+}
+
+bool ProjectTileCache::Attach(DBConnection &connection)
+{
+   auto db = connection.DB();
+   if (db == nullptr)
+      return false;
+
+   if (db == mDB)
+      return mHasTable;
+
+   mDB = db;
+   mHasTable = false;
+   mTableBytes = 0;
+   mAccessTick = 0;
+
+   sqlite3_stmt *stmt = nullptr;
+   if (sqlite3_prepare_v2(db,
+          "SELECT coalesce(sum(length(keydata) + length(data)), 0),"
+          "       coalesce(max(lastaccess), 0)"
+          "  FROM tilecache;", -1, &stmt, nullptr) != SQLITE_OK)
+   {
+      // No table yet, or one of another format
+      sqlite3_finalize(stmt);
+      return false;
+   }
+
+   if (sqlite3_step(stmt) == SQLITE_ROW)
+   {
+      mHasTable = true;
+      mTableBytes = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+      mAccessTick = sqlite3_column_int64(stmt, 1);
+   }
+
+   sqlite3_finalize(stmt);
+
+   return mHasTable;
+}
+
+bool ProjectTileCache::CreateTable(DBConnection &connection)
+{
+   auto db = connection.DB();
+   char *errmsg = nullptr;
+
+   if (sqlite3_exec(db, TileCacheSchema, nullptr, nullptr, &errmsg) != SQLITE_OK)
+   {
+      wxLogDebug(wxT("ProjectTileCache::CreateTable - SQLITE error %s"),
+         errmsg ? errmsg : "");
+      sqlite3_free(errmsg);
+      return false;
+   }
+
+   // Read the state of the new table
+   mDB = nullptr;
+   return Attach(connection);
+}
+
+bool ProjectTileCache::Evict(DBConnection &connection)
+{
+   const auto budget = GetBudget();
+
+   if (mTableBytes <= budget + budget / EvictionSlackDivisor)
+      return true;
+
+   // Free some extra space, so the tiles are not evicted on every flush
+   const auto target = budget - budget / EvictionSlackDivisor;
+
+   std::vector<Key> evicted;
+   size_t evictedBytes = 0;
+
+   {
+      sqlite3_stmt *stmt = connection.Prepare(DBConnection::GetOldestTiles,
+         "SELECT key, length(keydata) + length(data) FROM tilecache"
+         "  ORDER BY lastaccess;");
+      auto cleanup = ResetStatement(stmt);
+
+      while (evictedBytes < mTableBytes - target &&
+             sqlite3_step(stmt) == SQLITE_ROW)
+      {
+         evicted.push_back(sqlite3_column_int64(stmt, 0));
+         evictedBytes += static_cast<size_t>(sqlite3_column_int64(stmt, 1));
+      }
+   }
+
+   sqlite3_stmt *stmt = connection.Prepare(DBConnection::DeleteTile,
+      "DELETE FROM tilecache WHERE key = ?1;");
+
+   for (const auto key : evicted)
+   {
+      auto cleanup = ResetStatement(stmt);
+
+      if (sqlite3_bind_int64(stmt, 1, key) || sqlite3_step(stmt) != SQLITE_DONE)
+         return false;
+   }
+
+   mTableBytes -= evictedBytes;
+
+   return true;
+}
+
+void ProjectTileCache::ScheduleFlush()
+{
+   if (mFlushScheduled)
+      return;
+
+   mFlushScheduled = true;
+
+   BasicUI::CallAfter([wThis = weak_from_this()]
+   {
+      if (auto pThis = wThis.lock())
+         pThis->Flush();
+   });
+}
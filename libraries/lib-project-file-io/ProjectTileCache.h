@@ -0,0 +1,109 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file ProjectTileCache.h
+  @brief Declare ProjectTileCache, a size bounded store of derived data in the project file
+
+**********************************************************************/
+#ifndef __AUDACITY_PROJECT_TILE_CACHE__
+#define __AUDACITY_PROJECT_TILE_CACHE__
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ClientData.h"
+
+struct sqlite3;
+class AudacityProject;
+class DBConnection;
+
+//! Persists tiles of data derived from the samples in a sidecar table of the project file
+/*!
+ Tiles are opaque blobs keyed by a description of everything the contents
+ depend on (the ids of the sample blocks, the settings, the zoom level ...),
+ which the clients compute, so the stale tiles are never found again and simply
+ age out.  The table is indexed by a 64-bit hash of the description, but the
+ description itself is stored and compared too, so colliding hashes are misses.
+ The table is bounded by size, least recently used tiles are evicted first.
+
+ The table is created on the first write, so the projects where nothing is
+ cached are not modified.  It is not copied when the project is compacted or
+ saved to a new file, because the block ids may be reused there.
+
+ Reads are done directly; writes and access times are queued and flushed
+ to the database in one savepoint, in idle time, but never inside a transaction
+ of the project, whose rollback would also undo the tiles.  Failures are not
+ reported, the cache is only an optimization.
+
+ Must only be used from the main thread.
+ */
+class PROJECT_FILE_IO_API ProjectTileCache final
+   : public ClientData::Base
+   , public std::enable_shared_from_this<ProjectTileCache>
+{
+public:
+   //! Hash of the KeyData
+   using Key = int64_t;
+   //! Full description of the contents of a tile
+   using KeyData = std::vector<uint8_t>;
+   using Tile = std::vector<uint8_t>;
+
+   static ProjectTileCache &Get(AudacityProject &project);
+   static const ProjectTileCache &Get(const AudacityProject &project);
+
+   explicit ProjectTileCache(AudacityProject &project);
+   ProjectTileCache(const ProjectTileCache &) = delete;
+   ProjectTileCache &operator=(const ProjectTileCache &) = delete;
+   ~ProjectTileCache() override;
+
+   //! Whether tiles are cached in the project files, from the preferences
+   static bool IsEnabled();
+   //! Limit of the size of the table, in bytes, from the preferences
+   static size_t GetBudget();
+
+   //! Finds the tile and marks it as recently used
+   /*! @return false if there is no such tile, or the database can't be read */
+   bool Read(Key key, const KeyData &keyData, Tile &tile);
+   //! Queues the tile to be written in idle time, replacing any with the same hash
+   void Write(Key key, KeyData keyData, Tile tile);
+
+   //! Writes the queued tiles and access times, then evicts the tiles over the budget
+   void Flush();
+
+private:
+   //! Current connection of the project, without opening a new one
+   DBConnection *Conn() const;
+   //! Reads the state of the table of the current database, if that changed
+   /*! @return false if there is no table yet */
+   bool Attach(DBConnection &connection);
+   bool CreateTable(DBConnection &connection);
+   bool Evict(DBConnection &connection);
+   void ScheduleFlush();
+
+   AudacityProject &mProject;
+
+   //! Database whose table is described by the fields below
+   sqlite3 *mDB { nullptr };
+   bool mHasTable { false };
+   //! Sum of the sizes of the tiles and their keys in the table
+   size_t mTableBytes { 0 };
+   //! Monotonic stamp of the accesses, persisted with the tiles
+   int64_t mAccessTick { 0 };
+
+   struct PendingWrite
+   {
+      KeyData keyData;
+      Tile tile;
+   };
+
+   std::unordered_map<Key, PendingWrite> mPendingWrites;
+   std::unordered_map<Key, int64_t> mPendingAccesses;
+   bool mFlushScheduled { false };
+};
+
+#endif
@@ -27,7 +27,9 @@ Paul Licameli -- split from SampleBlock.cpp and SampleBlock.h
 #include "SentryHelper.h"
 #include <wx/log.h>
 
+#include <algorithm>
 #include <mutex>
+#include <vector>
 
 class SqliteSampleBlockFactory;
 
@@ -68,6 +70,7 @@ public:
 
    bool GetSummary256(float *dest, size_t frameoffset, size_t numframes) override;
    bool GetSummary64k(float *dest, size_t frameoffset, size_t numframes) override;
+   bool GetSummary4k(float *dest, size_t frameoffset, size_t numframes) override;
    double GetSumMin() const;
    double GetSumMax() const;
    double GetSumRms() const;
@@ -79,11 +82,17 @@ public:
    MinMaxRMS DoGetMinMaxRMS() const override;
 
    size_t GetSpaceUsage() const override;
+   size_t EstimateSpaceUsage() const override;
    void SaveXML(XMLWriter &xmlFile) override;
 
 private:
+
    bool IsSilent() const { return mBlockID <= 0; }
    void Load(SampleBlockID sbid);
+   //! Reads the persisted 4k summary into mSummary4k
+   /*! @return false if there is no row for the block */
+   bool ReadSummary4k();
+   void WriteSummary4k();
    bool GetSummary(float *dest,
                    size_t frameoffset,
                    size_t numframes,
@@ -127,6 +136,9 @@ private:
 
    ArrayOf<char> mSummary256;
    ArrayOf<char> mSummary64k;
+   //! Small enough to be kept for the lifetime of the block, once computed or read
+   std::vector<float> mSummary4k;
+   std::mutex mSummary4kMutex;
    double mSumMin;
    double mSumMax;
    double mSumRms;
@@ -178,6 +190,11 @@ private:
    void OnBeginPurge(size_t begin, size_t end);
    void OnEndPurge();
 
+   //! While undo history is purged, remember the id of a discarded block
+   //! instead of deleting its row at once
+   /*! @return whether the deletion was deferred */
+   bool DeferDeletion(SampleBlockID id, size_t bytes);
+
    friend SqliteSampleBlock;
 
    AudacityProject &mProject;
@@ -192,6 +209,13 @@ private:
    using AllBlocksMap =
       std::map< SampleBlockID, std::weak_ptr< SqliteSampleBlock > >;
    AllBlocksMap mAllBlocks;
+
+   //! Blocks discarded during a purge, handed to the connection's reclaim
+   //! thread at its end
+   std::mutex mPurgedBlocksMutex;
+   std::vector<SampleBlockID> mPurgedBlockIDs;
+   size_t mPurgedBytes{ 0 };
+   bool mPurging{ false };
 };
 
 SqliteSampleBlockFactory::SqliteSampleBlockFactory( AudacityProject &project )
@@ -371,7 +395,8 @@ SqliteSampleBlock::~SqliteSampleBlock()
          // is presented to the user.
          // The failure in this case may be a less harmful waste of space in the
          // database, which should not cause aborting of the attempted edit.
-         Delete();
+         if (!mpFactory->DeferDeletion(mBlockID, EstimateSpaceUsage()))
+            Delete();
       }
    } );
 }
@@ -466,6 +491,124 @@ bool SqliteSampleBlock::GetSummary64k(float *dest,
       "SELECT summary64k FROM sampleblocks WHERE blockid = ?1;");
 }
 
+bool SqliteSampleBlock::GetSummary4k(float *dest,
+                                    size_t frameoffset,
+                                    size_t numframes)
+{
+   // Non-throwing, it returns true for success
+   if (IsSilent())
+   {
+      memset(dest, 0, 3 * numframes * sizeof( float ));
+      return true;
+   }
+
+   std::lock_guard<std::mutex> lock(mSummary4kMutex);
+
+   if (mSummary4k.empty())
+   {
+      try {
+         if (!mValid)
+            Load(mBlockID);
+
+         if (!ReadSummary4k())
+         {
+            // Blocks of older projects have no 4k summary, compute it once.
+            // It is not written back, the blocks are read from the
+            // background threads drawing the waveform
+            const auto frames4k = ((mSampleCount + 65535) / 65536) * 16;
+            std::vector<float> summary4k(3 * frames4k);
+
+            if (!SampleBlock::GetSummary4k(summary4k.data(), 0, frames4k))
+               return SampleBlock::GetSummary4k(dest, frameoffset, numframes);
+
+            mSummary4k = std::move(summary4k);
+         }
+      }
+      catch ( const AudacityException & ) {
+         memset(dest, 0, 3 * numframes * sizeof( float ));
+         return false;
+      }
+   }
+
+   const auto framesCount = mSummary4k.size() / fields;
+   const auto first = std::min(frameoffset, framesCount);
+   const auto copied = std::min(numframes, framesCount - first);
+
+   std::copy(
+      mSummary4k.begin() + first * fields,
+      mSummary4k.begin() + (first + copied) * fields, dest);
+   std::fill(dest + copied * fields, dest + numframes * fields, 0.0f);
+
+   return true;
+}
+
+bool SqliteSampleBlock::ReadSummary4k()
+{
+   if (!Conn()->HasSummary4kTable())
+      return false;
+
+   // Prepare and cache statement...automatically finalized at DB close
+   sqlite3_stmt *stmt = Conn()->Prepare(DBConnection::GetSummary4k,
+      "SELECT summary4k FROM sampleblocksummaries WHERE blockid = ?1;");
+
+   auto cleanup = finally([stmt]
+   {
+      // Clear statement bindings and rewind statement
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+   });
+
+   if (sqlite3_bind_int64(stmt, 1, mBlockID) ||
+       sqlite3_step(stmt) != SQLITE_ROW)
+      return false;
+
+   const auto src =
+      static_cast<const float *>(sqlite3_column_blob(stmt, 0));
+   const auto count =
+      static_cast<size_t>(sqlite3_column_bytes(stmt, 0)) / sizeof(float);
+
+   if (src == nullptr || count == 0)
+      return false;
+
+   mSummary4k.assign(src, src + count);
+
+   return true;
+}
+
+void SqliteSampleBlock::WriteSummary4k()
+{
+   // The summary is optional, it is computed again if the row is missing.
+   // The table is made when first needed, so that projects only read are
+   // not changed
+   if (mSummary4k.empty() ||
+       !(Conn()->HasSummary4kTable() || Conn()->CreateSummary4kTable()))
+      return;
+
+   // Prepare and cache statement...automatically finalized at DB close
+   sqlite3_stmt *stmt = Conn()->Prepare(DBConnection::InsertSummary4k,
+      "INSERT OR REPLACE INTO sampleblocksummaries (blockid, summary4k)"
+      "                                       VALUES(?1,?2);");
+
+   auto cleanup = finally([stmt]
+   {
+      // Clear statement bindings and rewind statement
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+   });
+
+   if (sqlite3_bind_int64(stmt, 1, mBlockID) ||
+       sqlite3_bind_blob(stmt, 2, mSummary4k.data(),
+          mSummary4k.size() * sizeof(float), SQLITE_STATIC))
+   {
+      wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
+      return;
+   }
+
+   if (sqlite3_step(stmt) != SQLITE_DONE)
+      wxLogDebug(wxT("SqliteSampleBlock::WriteSummary4k - SQLITE error %s"),
+         sqlite3_errmsg(DB()));
+}
+
 bool SqliteSampleBlock::GetSummary(float *dest,
                                    size_t frameoffset,
                                    size_t numframes,
@@ -824,6 +967,12 @@ void SqliteSampleBlock::Commit(Sizes sizes)
    // Retrieve returned data
    mBlockID = sqlite3_last_insert_rowid(db);
 
+   // Clear statement bindings and rewind statement
+   sqlite3_clear_bindings(stmt);
+   sqlite3_reset(stmt);
+
+   WriteSummary4k();
+
    // Reset local arrays
    mSamples.reset();
    mSummary256.reset();
@@ -833,10 +982,6 @@ void SqliteSampleBlock::Commit(Sizes sizes)
       mCache.reset();
    }
 
-   // Clear statement bindings and rewind statement
-   sqlite3_clear_bindings(stmt);
-   sqlite3_reset(stmt);
-
    mValid = true;
 }
 
@@ -891,6 +1036,15 @@ void SqliteSampleBlock::SaveXML(XMLWriter &xmlFile)
    xmlFile.WriteAttr(wxT("blockid"), mBlockID);
 }
 
+size_t SqliteSampleBlock::EstimateSpaceUsage() const
+{
+   if (IsSilent())
+      return 0;
+   // Samples, and the 256, 4k and 64k summaries
+   const auto frames64k = (mSampleCount + 65535) / 65536;
+   return mSampleBytes + frames64k * (256 + 16 + 1) * bytesPerFrame;
+}
+
 auto SqliteSampleBlock::SetSizes(
    size_t numsamples, sampleFormat srcformat ) -> Sizes
 {
@@ -934,6 +1088,9 @@ void SqliteSampleBlock::CalcSummary(Sizes sizes)
    float *summary256 = (float *) mSummary256.get();
    float *summary64k = (float *) mSummary64k.get();
 
+   const auto frames4k = mSummary256Bytes / bytesPerFrame / 16;
+   mSummary4k.resize(frames4k * fields);
+
    float min;
    float max;
    float sumsq;
@@ -994,6 +1151,10 @@ void SqliteSampleBlock::CalcSummary(Sizes sizes)
    // Calculate now while we can do it accurately
    mSumRms = sqrt(totalSquares / mSampleCount);
 
+   // Recalc 4K summaries
+   SampleBlock::Summary4kFromSummary256(
+      summary256, 0, mSampleCount, mSummary4k.data(), frames4k);
+
    // Recalc 64K summaries
    sumLen = (mSampleCount + 65535) / 65536;
 
@@ -1099,8 +1260,23 @@ static size_t EstimateRemovedBlocks(
    return mayDelete.size();
 }
 
+bool SqliteSampleBlockFactory::DeferDeletion(SampleBlockID id, size_t bytes)
+{
+   std::lock_guard<std::mutex> lock{ mPurgedBlocksMutex };
+   if (!mPurging)
+      return false;
+   mPurgedBlockIDs.push_back(id);
+   mPurgedBytes += bytes;
+   return true;
+}
+
 void SqliteSampleBlockFactory::OnBeginPurge(size_t begin, size_t end)
 {
+   {
+      std::lock_guard<std::mutex> lock{ mPurgedBlocksMutex };
+      mPurging = true;
+   }
+
    // Install a callback function that updates a progress indicator
    using namespace BasicUI;
 
@@ -1131,6 +1307,30 @@ void SqliteSampleBlockFactory::OnBeginPurge(size_t begin, size_t end)
 void SqliteSampleBlockFactory::OnEndPurge()
 {
    mSampleBlockDeletionCallback = {};
+
+   std::vector<SampleBlockID> purged;
+   size_t bytes = 0;
+   {
+      std::lock_guard<std::mutex> lock{ mPurgedBlocksMutex };
+      mPurging = false;
+      purged.swap(mPurgedBlockIDs);
+      std::swap(bytes, mPurgedBytes);
+   }
+   if (purged.empty())
+      return;
+
+   // Delete the discarded blocks off the main thread.  The connection
+   // finishes the deletions before it closes; saving flushes them too.
+   if (auto &pConnection = mppConnection->mpConnection)
+      pConnection->ReclaimBlocks(std::move(purged), bytes);
+   else
+   {
+      // Keep the ids for the next purge rather than leave orphans
+      std::lock_guard<std::mutex> lock{ mPurgedBlocksMutex };
+      mPurgedBlockIDs.insert(mPurgedBlockIDs.end(),
+         purged.begin(), purged.end());
+      mPurgedBytes += bytes;
+   }
 }
 
 // Inject our database implementation at startup
@@ -23,6 +23,7 @@ UndoManager
 
 #include "UndoManager.h"
 
+#include <algorithm>
 #include <wx/hashset.h>
 
 #include "BasicUI.h"
@@ -38,6 +39,10 @@ bool UndoStateExtension::CanUndoOrRedo(const AudacityProject &)
    return true;
 }
 
+void UndoStateExtension::VisitStorage(const StorageVisitor &) const
+{
+}
+
 namespace {
    using Savers = std::vector<UndoRedoExtensionRegistry::Saver>;
    static Savers &GetSavers()
@@ -54,6 +59,14 @@ namespace {
             result.emplace_back(saver(project));
       return result;
    }
+
+   void VisitStorage(const UndoStackElem &elem,
+      const UndoStateExtension::StorageVisitor &visitor)
+   {
+      for (auto &pExt : elem.state.extensions)
+         if (pExt)
+            pExt->VisitStorage(visitor);
+   }
 }
 
 UndoRedoExtensionRegistry::Entry::Entry(const Saver &saver)
@@ -117,6 +130,87 @@ void UndoManager::RemoveStateAt(int n)
    auto iter = stack.begin() + n;
    auto state = std::move(*iter);
    stack.erase(iter);
+
+   UnaccountStorage(*state);
+}
+
+void UndoManager::AccountStorage(UndoStackElem &elem)
+{
+   VisitStorage(elem, [&](long long id,
+      const UndoStateExtension::SizeFunction &size
+   ){
+      auto [iter, inserted] = mStorage.try_emplace(id);
+      auto &item = iter->second;
+      if (inserted) {
+         // Only newly introduced items need the (possibly costly) size
+         item.bytes = size();
+         mTotalSpaceUsage += item.bytes;
+      }
+      const bool first = (item.count++ == 0);
+      if (first || item.newest <= elem.serial) {
+         // Move the item's contribution from an older state, if any
+         if (!first && item.newest < elem.serial)
+            if (auto pOlder = FindState(item.newest))
+               pOlder->spaceUsage -= item.bytes;
+         item.newest = elem.serial;
+         elem.spaceUsage += item.bytes;
+         if (!mRelocated.empty())
+            mRelocated.erase(id);
+      }
+   });
+}
+
+void UndoManager::UnaccountStorage(UndoStackElem &elem)
+{
+   VisitStorage(elem, [&](long long id,
+      const UndoStateExtension::SizeFunction &
+   ){
+      auto iter = mStorage.find(id);
+      if (iter == mStorage.end())
+         return;
+      auto &item = iter->second;
+      if (--item.count == 0) {
+         mTotalSpaceUsage -= item.bytes;
+         mRelocated.erase(id);
+         mStorage.erase(iter);
+      }
+      else if (item.newest == elem.serial)
+         mRelocated.insert(id);
+   });
+   elem.spaceUsage = 0;
+}
+
+void UndoManager::RelocateStorage()
+{
+   // Visit newest states first, so the first one found holding the item is
+   // the newest
+   for (auto iter = stack.rbegin(), end = stack.rend();
+      !mRelocated.empty() && iter != end; ++iter
+   ) {
+      auto &elem = **iter;
+      VisitStorage(elem, [&](long long id,
+         const UndoStateExtension::SizeFunction &
+      ){
+         if (mRelocated.erase(id)) {
+            auto &item = mStorage[id];
+            item.newest = elem.serial;
+            elem.spaceUsage += item.bytes;
+         }
+      });
+   }
+   // Should be empty already
+   mRelocated.clear();
+}
+
+UndoStackElem *UndoManager::FindState(unsigned long long serial)
+{
+   // The stack is always sorted by serial number
+   auto iter = std::lower_bound(stack.begin(), stack.end(), serial,
+      [](const auto &pElem, unsigned long long serial){
+         return pElem->serial < serial; });
+   if (iter != stack.end() && (*iter)->serial == serial)
+      return iter->get();
+   return nullptr;
 }
 
 void UndoManager::EnqueueMessage(UndoRedoMessage message)
@@ -145,6 +239,8 @@ void UndoManager::RemoveStates(size_t begin, size_t end)
         --saved;
    }
 
+   RelocateStorage();
+
    // Success, commit the savepoint
    trans.Commit();
    
@@ -196,11 +292,17 @@ void UndoManager::ModifyState()
    }
 
 //   SonifyBeginModifyState();
-   auto &state = stack[current]->state;
+   auto &elem = *stack[current];
+   auto &state = elem.state;
+
+   UnaccountStorage(elem);
 
    // Re-create all captured project state
    state.extensions = GetExtensions(mProject);
 
+   AccountStorage(elem);
+   RelocateStorage();
+
 //   SonifyEndModifyState();
 
    EnqueueMessage({ UndoRedoMessage::Modified });
@@ -244,6 +346,8 @@ void UndoManager::PushState(const TranslatableString &longDescription,
       std::make_unique<UndoStackElem>
          (GetExtensions(mProject), longDescription, shortDescription)
    );
+   stack.back()->serial = ++mNextSerial;
+   AccountStorage(*stack.back());
 
    current++;
 
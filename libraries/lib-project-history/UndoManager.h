@@ -46,6 +46,8 @@
 
 #include <functional>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "ClientData.h"
 #include "Observer.h"
@@ -89,6 +91,18 @@ public:
 
    //! Whether undo or redo is now permitted; default returns true
    virtual bool CanUndoOrRedo(const AudacityProject &project);
+
+   //! Type of function that computes the size in bytes of an item of storage
+   using SizeFunction = std::function<unsigned long long()>;
+   //! Type of function that receives an identifier of an item of storage,
+   //! unique within the project, and a function to compute its size if needed
+   using StorageVisitor =
+      std::function<void(long long id, const SizeFunction &size)>;
+
+   //! Visit each item of storage (such as a sample block) held by the state,
+   //! once; default visits nothing
+   /*! Must visit the same items each time it is called for the same object */
+   virtual void VisitStorage(const StorageVisitor &visitor) const;
 };
 
 class PROJECT_HISTORY_API UndoRedoExtensionRegistry {
@@ -128,6 +142,14 @@ struct UndoStackElem {
    UndoState state;
    TranslatableString description;
    TranslatableString shortDescription;
+
+   //! Increases with each push; maintained by UndoManager
+   unsigned long long serial{ 0 };
+   //! Bytes of storage held by this state and by no newer state; maintained
+   //! by UndoManager
+   /*! Counting each item only in the newest state that holds it means that
+    removal of all states up to and including this one reclaims the space */
+   unsigned long long spaceUsage{ 0 };
 };
 
 using UndoStack = std::vector <std::unique_ptr<UndoStackElem>>;
@@ -203,6 +225,11 @@ class PROJECT_HISTORY_API UndoManager final
    bool UndoAvailable();
    bool RedoAvailable();
 
+   //! Bytes of storage held by all states, counting shared items once
+   /*! Maintained incrementally as states are pushed, modified and removed;
+    see also UndoStackElem::spaceUsage */
+   unsigned long long GetTotalSpaceUsage() const { return mTotalSpaceUsage; }
+
    void MarkUnsaved();
    bool UnsavedChanges() const;
    int GetSavedState() const;
@@ -216,6 +243,15 @@ class PROJECT_HISTORY_API UndoManager final
    void EnqueueMessage(UndoRedoMessage message);
    void RemoveStateAt(int n);
 
+   //! Count storage of a state just pushed or modified
+   void AccountStorage(UndoStackElem &elem);
+   //! Uncount storage of a state about to be removed or modified
+   void UnaccountStorage(UndoStackElem &elem);
+   //! Count items whose newest state was uncounted in the newest state that
+   //! still holds them
+   void RelocateStorage();
+   UndoStackElem *FindState(unsigned long long serial);
+
    AudacityProject &mProject;
  
    int current;
@@ -225,6 +261,18 @@ class PROJECT_HISTORY_API UndoManager final
 
    TranslatableString lastAction;
    bool mayConsolidate { false };
+
+   struct StorageItem {
+      unsigned long long bytes{ 0 };
+      //! Number of states holding the item
+      size_t count{ 0 };
+      //! Serial number of the newest state holding the item
+      unsigned long long newest{ 0 };
+   };
+   std::unordered_map<long long, StorageItem> mStorage;
+   std::unordered_set<long long> mRelocated;
+   unsigned long long mTotalSpaceUsage{ 0 };
+   unsigned long long mNextSerial{ 0 };
 };
 
 #endif
@@ -60,7 +60,8 @@ AudioSegmentFactory::CreateAudioSegmentSequenceForward(double t0)
       else if (clip->GetPlayEndTime() <= t0)
          continue;
       segments.push_back(std::make_shared<ClipSegment>(
-         *clip, t0 - clip->GetPlayStartTime(), PlaybackDirection::forward));
+         *clip, t0 - clip->GetPlayStartTime(), PlaybackDirection::forward,
+         RenderedClip::Call(clip)));
       t0 = clip->GetPlayEndTime();
    }
    return segments;
@@ -91,7 +92,8 @@ AudioSegmentFactory::CreateAudioSegmentSequenceBackward(double t0)
       else if (clip->GetPlayStartTime() >= t0)
          continue;
       segments.push_back(std::make_shared<ClipSegment>(
-         *clip, clip->GetPlayEndTime() - t0, PlaybackDirection::backward));
+         *clip, clip->GetPlayEndTime() - t0, PlaybackDirection::backward,
+         RenderedClip::Call(clip)));
       t0 = clip->GetPlayStartTime();
    }
    return segments;
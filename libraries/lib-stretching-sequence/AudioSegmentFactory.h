@@ -13,6 +13,7 @@
 
 #include "AudioSegmentFactoryInterface.h"
 #include "ClipInterface.h"
+#include "GlobalVariable.h"
 #include "TimeAndPitchInterface.h"
 
 #include <memory>
@@ -24,6 +25,19 @@ class STRETCHING_SEQUENCE_API AudioSegmentFactory final :
     public AudioSegmentFactoryInterface
 {
 public:
+   //! Hook function giving the clip already stretched and pitch-shifted, if
+   //! some cache has it
+   /*!
+    Called on the thread creating the segments, possibly the audio thread, so
+    it must not wait for the rendering.  A null result means the clip is
+    stretched as it is played.  A non-null result has stretch ratio 1, no pitch
+    shift, and as many samples as the clip after stretching.
+    */
+   struct STRETCHING_SEQUENCE_API RenderedClip : GlobalHook<RenderedClip,
+      std::shared_ptr<const ClipInterface>(
+         const std::shared_ptr<const ClipInterface>&)
+   >{};
+
    AudioSegmentFactory(int sampleRate, int numChannels, ClipConstHolders clips);
 
    std::vector<std::shared_ptr<AudioSegment>> CreateAudioSegmentSequence(
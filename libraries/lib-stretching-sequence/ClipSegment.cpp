@@ -40,16 +40,16 @@ GetTotalNumSamplesToProduce(const ClipInterface& clip, double durationToDiscard)
 
 ClipSegment::ClipSegment(
    const ClipInterface& clip, double durationToDiscard,
-   PlaybackDirection direction)
-    : mTotalNumSamplesToProduce { GetTotalNumSamplesToProduce(
+   PlaybackDirection direction, std::shared_ptr<const ClipInterface> rendered)
+    : mClip { clip }
+    , mDirection { direction }
+    , mDurationToDiscard { durationToDiscard }
+    , mTotalNumSamplesToProduce { GetTotalNumSamplesToProduce(
          clip, durationToDiscard) }
-    , mSource { clip, durationToDiscard, direction }
+    , mRendered { std::move(rendered) }
     , mPreserveFormants { clip.GetPitchAndSpeedPreset() ==
                           PitchAndSpeedPreset::OptimizeForVoice }
     , mCentShift { clip.GetCentShift() }
-    , mStretcher { std::make_unique<StaffPadTimeAndPitch>(
-         clip.GetRate(), clip.NChannels(), mSource,
-         GetStretchingParameters(clip)) }
     , mOnSemitoneShiftChangeSubscription { clip.SubscribeToCentShiftChange(
          [this](int cents) {
             mCentShift = cents;
@@ -64,6 +64,13 @@ ClipSegment::ClipSegment(
           })
     }
 {
+   if (mRendered)
+   {
+      assert(mRendered->GetStretchRatio() == 1.);
+      mRenderedSource.emplace(*mRendered, durationToDiscard, direction);
+   }
+   else
+      StartStretching(durationToDiscard);
 }
 
 ClipSegment::~ClipSegment()
@@ -72,8 +79,35 @@ ClipSegment::~ClipSegment()
    mOnFormantPreservationChangeSubscription.Reset();
 }
 
+void ClipSegment::StartStretching(double durationToDiscard)
+{
+   mSource.emplace(mClip, durationToDiscard, mDirection);
+   mStretcher = std::make_unique<StaffPadTimeAndPitch>(
+      mClip.GetRate(), mClip.NChannels(), *mSource,
+      GetStretchingParameters(mClip));
+}
+
 size_t ClipSegment::GetFloats(float* const* buffers, size_t numSamples)
 {
+   const auto numSamplesToProduce = limitSampleBufferSize(
+      numSamples, mTotalNumSamplesToProduce - mTotalNumSamplesProduced);
+   if (mRenderedSource)
+   {
+      if (
+         !mUpdateFormantPreservation.exchange(false) &&
+         !mUpdateCentShift.exchange(false))
+      {
+         mRenderedSource->Pull(buffers, numSamplesToProduce);
+         mTotalNumSamplesProduced += numSamplesToProduce;
+         return numSamplesToProduce;
+      }
+      // The rendering is outdated: stretch from where it was left, with the
+      // new parameters.
+      mRenderedSource.reset();
+      StartStretching(
+         mDurationToDiscard +
+         mTotalNumSamplesProduced.as_double() / mClip.GetRate());
+   }
    // Check if formant preservation of pitch shift needs to be updated.
    // This approach is not immune to a race condition, but it is unlikely and
    // not critical, as it would only affect one playback pass, during which the
@@ -85,8 +119,6 @@ size_t ClipSegment::GetFloats(float* const* buffers, size_t numSamples)
       mStretcher->OnFormantPreservationChange(mPreserveFormants);
    if (mUpdateCentShift.exchange(false))
       mStretcher->OnCentShiftChange(mCentShift);
-   const auto numSamplesToProduce = limitSampleBufferSize(
-      numSamples, mTotalNumSamplesToProduce - mTotalNumSamplesProduced);
    mStretcher->GetSamples(buffers, numSamplesToProduce);
    mTotalNumSamplesProduced += numSamplesToProduce;
    return numSamplesToProduce;
@@ -99,5 +131,5 @@ bool ClipSegment::Empty() const
 
 size_t ClipSegment::NChannels() const
 {
-   return mSource.NChannels();
+   return mClip.NChannels();
 }
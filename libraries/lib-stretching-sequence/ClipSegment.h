@@ -16,6 +16,7 @@
 #include "PlaybackDirection.h"
 #include <atomic>
 #include <memory>
+#include <optional>
 
 class ClipInterface;
 class TimeAndPitchInterface;
@@ -30,8 +31,15 @@ using PitchRatioChangeCbSubscriber =
 class STRETCHING_SEQUENCE_API ClipSegment final : public AudioSegment
 {
 public:
+   /*!
+    * @param rendered if not null, the same audio as the clip after stretching
+    * and pitch shifting, which is then read instead of stretching the clip, as
+    * long as the pitch shift and formant preservation of the clip do not change
+    * @pre `!rendered || rendered->GetStretchRatio() == 1`
+    */
    ClipSegment(const ClipInterface&,
-      double durationToDiscard, PlaybackDirection);
+      double durationToDiscard, PlaybackDirection,
+      std::shared_ptr<const ClipInterface> rendered = nullptr);
    ~ClipSegment() override;
 
    // AudioSegment
@@ -40,16 +48,22 @@ public:
    size_t NChannels() const override;
 
 private:
+   //! Stretches the clip from `durationToDiscard` on
+   void StartStretching(double durationToDiscard);
+
+   const ClipInterface& mClip;
+   const PlaybackDirection mDirection;
+   const double mDurationToDiscard;
    const sampleCount mTotalNumSamplesToProduce;
    sampleCount mTotalNumSamplesProduced = 0;
-   ClipTimeAndPitchSource mSource;
+   const std::shared_ptr<const ClipInterface> mRendered;
+   std::optional<ClipTimeAndPitchSource> mRenderedSource;
+   std::optional<ClipTimeAndPitchSource> mSource;
    bool mPreserveFormants;
    int mCentShift;
    std::atomic<bool> mUpdateFormantPreservation = false;
    std::atomic<bool> mUpdateCentShift = false;
-   // Careful that this guy is constructed after `mSource`, which it refers to
-   // in its ctor.
-   // todo(mhodgkinson) make this safe.
+   // Refers to `mSource`; null while reading `mRenderedSource`
    std::unique_ptr<TimeAndPitchInterface> mStretcher;
    Observer::Subscription mOnSemitoneShiftChangeSubscription;
    Observer::Subscription mOnFormantPreservationChangeSubscription;
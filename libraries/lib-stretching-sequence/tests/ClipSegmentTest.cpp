@@ -75,4 +75,27 @@ TEST_CASE("ClipSegment")
                                std::vector<float> { 3.f, 2.f, 1.f, 0.f, 0.f };
       REQUIRE(output.channelVectors[0] == expected);
    }
+
+   SECTION("reads the rendered clip in place of stretching")
+   {
+      const auto clip = std::make_shared<FloatVectorClip>(
+         sampleRate, FloatVectorVector { { 1.f, 2.f, 3.f } });
+      clip->stretchRatio = 2.;
+      // Not what stretching would give, so that it shows which was read
+      const auto rendered = std::make_shared<FloatVectorClip>(
+         sampleRate, FloatVectorVector { { 6.f, 5.f, 4.f, 3.f, 2.f, 1.f } });
+      // Offset of two samples, in seconds.
+      constexpr auto playbackOffset = 2 / static_cast<double>(sampleRate);
+      ClipSegment sut { *clip, playbackOffset, direction, rendered };
+      AudioContainer output(6u, 1u);
+      REQUIRE(sut.GetFloats(output.channelPointers.data(), 6u) == 4);
+      REQUIRE(sut.Empty());
+      const auto expected = direction == PlaybackDirection::forward ?
+                               std::vector<float> { 4.f, 3.f, 2.f, 1.f } :
+                               std::vector<float> { 3.f, 4.f, 5.f, 6.f };
+      const auto produced = std::vector<float> {
+         output.channelVectors[0].begin(), output.channelVectors[0].begin() + 4
+      };
+      REQUIRE(produced == expected);
+   }
 }
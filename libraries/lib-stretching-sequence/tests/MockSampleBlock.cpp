@@ -66,6 +66,11 @@ size_t MockSampleBlock::GetSpaceUsage() const
    return data.size();
 }
 
+size_t MockSampleBlock::EstimateSpaceUsage() const
+{
+   return data.size();
+}
+
 void MockSampleBlock::SaveXML(XMLWriter&)
 {
 }
@@ -35,6 +35,8 @@ public:
 
    size_t GetSpaceUsage() const override;
 
+   size_t EstimateSpaceUsage() const override;
+
    void SaveXML(XMLWriter&) override;
 
    size_t DoGetSamples(
@@ -0,0 +1,125 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  StretchCacheTest.cpp
+
+**********************************************************************/
+#include "StretchCache.h"
+#include "BasicUI.h"
+#include "MockSampleBlockFactory.h"
+#include "Prefs.h"
+#include "TestWaveClipMaker.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+constexpr auto sampleRate = 44100;
+constexpr auto numSamples = 100000;
+constexpr auto stretchRatio = 2.;
+
+const auto sampleBlockFactory = std::make_shared<MockSampleBlockFactory>();
+TestWaveClipMaker clipMaker { sampleRate, sampleBlockFactory };
+
+WaveClipHolder StretchedClip(float frequency)
+{
+   std::vector<float> values(numSamples);
+   for (auto i = 0u; i < values.size(); ++i)
+      values[i] = .5f * std::sin(2 * M_PI * frequency * i / sampleRate);
+   return clipMaker.ClipFilledWith(values, 1u, [](WaveClip& clip) {
+      clip.StretchBy(stretchRatio);
+   });
+}
+
+// Plays the clip twice, which requests a copy, then dispatches the rendering
+// until the copy is found
+std::shared_ptr<const WaveClip> Render(const WaveClipHolder& clip)
+{
+   auto& cache = StretchCache::Get();
+   cache.Find(clip);
+   cache.Find(clip);
+   const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds { 30 };
+   while (std::chrono::steady_clock::now() < deadline)
+   {
+      BasicUI::Yield();
+      if (auto copy = cache.Find(clip))
+         return copy;
+      std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+   }
+   return nullptr;
+}
+} // namespace
+
+TEST_CASE("StretchCache")
+{
+   auto& cache = StretchCache::Get();
+   cache.Clear();
+   StretchCacheBudget.Reset();
+
+   const auto clip = StretchedClip(440.f);
+   const auto copy = Render(clip);
+   REQUIRE(copy != nullptr);
+   REQUIRE(copy->GetStretchRatio() == 1.);
+   REQUIRE(
+      copy->GetVisibleSampleCount().as_double() ==
+      Approx(numSamples * stretchRatio).margin(1));
+   const auto copyBytes = cache.GetTotalBytes();
+   REQUIRE(copyBytes > 0);
+
+   SECTION("finds the copy by the stretch ratio and the block ids")
+   {
+      // Shares the blocks
+      const auto sameContents =
+         std::make_shared<WaveClip>(*clip, sampleBlockFactory, false);
+      REQUIRE(cache.Find(sameContents) == copy);
+
+      const auto otherRatio =
+         std::make_shared<WaveClip>(*clip, sampleBlockFactory, false);
+      otherRatio->StretchBy(1.5);
+      REQUIRE(cache.Find(otherRatio) == nullptr);
+
+      // Same samples, but other blocks
+      const auto otherBlocks = StretchedClip(440.f);
+      REQUIRE(cache.Find(otherBlocks) == nullptr);
+   }
+
+   SECTION("does not find the copy of a clip after an edit")
+   {
+      std::vector<float> silence(1000);
+      clip->SetSamples(
+         0u, reinterpret_cast<constSamplePtr>(silence.data()), floatSample, 0,
+         silence.size(), floatSample);
+      REQUIRE(cache.Find(clip) == nullptr);
+
+      // The stale copy is dropped with the blocks it was made from
+      const auto newCopy = Render(clip);
+      REQUIRE(newCopy != nullptr);
+      REQUIRE(newCopy != copy);
+      REQUIRE(cache.GetTotalBytes() == copyBytes);
+   }
+
+   SECTION("evicts the least recently used copies beyond the budget")
+   {
+      // Room for one copy only
+      StretchCacheBudget.Write(1);
+      REQUIRE(copyBytes <= 1024 * 1024);
+      REQUIRE(2 * copyBytes > 1024 * 1024);
+
+      const auto other = StretchedClip(880.f);
+      const auto otherCopy = Render(other);
+      REQUIRE(otherCopy != nullptr);
+      REQUIRE(cache.GetTotalBytes() == copyBytes);
+      REQUIRE(cache.Find(other) == otherCopy);
+      REQUIRE(cache.Find(clip) == nullptr);
+   }
+
+   cache.Clear();
+   StretchCacheBudget.Reset();
+}
@@ -1,5 +1,6 @@
 #include "FourierTransform_pffft.h"
 
+#include "FFTPlan.h"
 #include "pffft.h"
 
 namespace staffpad::audio {
@@ -8,7 +9,7 @@ FourierTransform::FourierTransform(int32_t newBlockSize)
     : _blockSize { newBlockSize }
 {
   _pffft_scratch = (float*)pffft_aligned_malloc(_blockSize * sizeof(float));
-  realFftSpec = pffft_new_setup(_blockSize, PFFFT_REAL);
+  realFftSpec = FFTPlan::Get(_blockSize);
 }
 
 FourierTransform::~FourierTransform()
@@ -18,11 +19,6 @@ FourierTransform::~FourierTransform()
     pffft_aligned_free(_pffft_scratch);
     _pffft_scratch = nullptr;
   }
-  if (realFftSpec)
-  {
-    pffft_destroy_setup(realFftSpec);
-    realFftSpec = nullptr;
-  }
 }
 
 void FourierTransform::forwardReal(const SamplesReal& t, SamplesComplex& c)
@@ -33,7 +29,7 @@ void FourierTransform::forwardReal(const SamplesReal& t, SamplesComplex& c)
   {
     auto* spec = c.getPtr(ch); // interleaved complex numbers, size _blockSize + 2
     auto* cpx_flt = (float*)spec;
-    pffft_transform_ordered(realFftSpec, t.getPtr(ch), cpx_flt, _pffft_scratch, PFFFT_FORWARD);
+    realFftSpec->Forward(t.getPtr(ch), cpx_flt, _pffft_scratch);
     // pffft combines dc and nyq values into the first complex value,
     // adjust to CCS format.
     auto dc = cpx_flt[0];
@@ -55,7 +51,7 @@ void FourierTransform::inverseReal(const SamplesComplex& c, SamplesReal& t)
     auto* ts = t.getPtr(ch);
     ts[0] = spec[0].real();
     ts[1] = spec[c.getNumSamples() - 1].real();
-    pffft_transform_ordered(realFftSpec, ts, ts, _pffft_scratch, PFFFT_BACKWARD);
+    realFftSpec->Inverse(ts, ts, _pffft_scratch);
   }
 }
 
@@ -3,11 +3,12 @@
 
 #pragma once
 
+#include <memory>
 #include <stdint.h>
 
 #include "SamplesFloat.h"
 
-struct PFFFT_Setup;
+class FFTPlan;
 
 namespace staffpad::audio {
 
@@ -23,8 +24,8 @@ public:
   void inverseReal(const SamplesComplex& c, SamplesReal& t);
 
 private:
-  PFFFT_Setup* realFftSpec = nullptr;
-  PFFFT_Setup* complexFftSpec = nullptr;
+  // Shared with the other transforms of the same size, see FFTPlan::Get
+  std::shared_ptr<const FFTPlan> realFftSpec;
   float* _pffft_scratch = nullptr;
 
   const int32_t _blockSize;
@@ -23,6 +23,14 @@
 #   include "SimdComplexConversions_sse2.h"
 #endif
 
+// AVX2 and FMA versions of calcPhases, calcNorms and rotate, used if the
+// processor supports them
+#if defined(__x86_64__) || defined(_M_AMD64) || defined(_M_X64)
+#define USE_AVX2_DISPATCH 1
+#endif
+
+#include "VectorOps_avx2.h"
+
 namespace staffpad {
 namespace vo {
 
@@ -103,6 +111,10 @@ inline void findMaxElement(const T* src, int32_t n, int32_t& maxIndex, T& maxVal
 
 inline void calcPhases(const std::complex<float>* src, float* dst, int32_t n)
 {
+#if USE_AVX2_DISPATCH
+  if (avx2::isEnabled())
+    return avx2::calcPhases(src, dst, n);
+#endif
   simd_complex_conversions::perform_parallel_simd_aligned(
      src, dst, n,
      [](const __m128 rp, const __m128 ip, __m128& out)
@@ -111,6 +123,10 @@ inline void calcPhases(const std::complex<float>* src, float* dst, int32_t n)
 
 inline void calcNorms(const std::complex<float>* src, float* dst, int32_t n)
 {
+#if USE_AVX2_DISPATCH
+  if (avx2::isEnabled())
+    return avx2::calcNorms(src, dst, n);
+#endif
   simd_complex_conversions::perform_parallel_simd_aligned(
      src, dst, n,
      [](const __m128 rp, const __m128 ip, __m128& out)
@@ -121,24 +137,40 @@ inline void rotate(
    const float* oldPhase, const float* newPhase, std::complex<float>* dst,
    int32_t n)
 {
+#if USE_AVX2_DISPATCH
+  if (avx2::isEnabled())
+    return avx2::rotate(oldPhase, newPhase, dst, n);
+#endif
   simd_complex_conversions::rotate_parallel_simd_aligned(
      oldPhase, newPhase, dst, n);
 }
 #else
 inline void calcPhases(const std::complex<float>* src, float* dst, int32_t n)
 {
+#if USE_AVX2_DISPATCH
+  if (avx2::isEnabled())
+    return avx2::calcPhases(src, dst, n);
+#endif
   for (int32_t i = 0; i < n; i++)
     dst[i] = std::arg(src[i]);
 }
 
 inline void calcNorms(const std::complex<float>* src, float* dst, int32_t n)
 {
+#if USE_AVX2_DISPATCH
+  if (avx2::isEnabled())
+    return avx2::calcNorms(src, dst, n);
+#endif
   for (int32_t i = 0; i < n; i++)
     dst[i] = std::norm(src[i]);
 }
 
 inline void rotate(const float* oldPhase, const float* newPhase, std::complex<float>* dst, int32_t n)
 {
+#if USE_AVX2_DISPATCH
+  if (avx2::isEnabled())
+    return avx2::rotate(oldPhase, newPhase, dst, n);
+#endif
   for (int32_t i = 0; i < n; i++) {
     const auto theta = oldPhase ? newPhase[i] - oldPhase[i] : newPhase[i];
     dst[i] *= std::complex<float>(cosf(theta), sinf(theta));
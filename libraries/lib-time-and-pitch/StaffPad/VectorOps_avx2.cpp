@@ -0,0 +1,340 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+  AVX2 and FMA versions of the complex vector operations of VectorOps.h.
+
+  The arctangent and sine-cosine approximations are those of
+  SimdComplexConversions_sse2.h, eight lanes wide, with the polynomials
+  evaluated by fused multiply-adds.
+
+  Only the functions of this file that are marked STAFFPAD_AVX2 are compiled
+  for AVX2; the file needs no special compiler flags, and the instructions are
+  executed only if isSupported().
+ */
+
+#include "VectorOps_avx2.h"
+#include "VectorOps.h"
+
+#include <atomic>
+
+#if USE_AVX2_DISPATCH
+
+#include <cmath>
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+// MSVC allows the intrinsics of any instruction set in any function
+#define STAFFPAD_AVX2
+#else
+#define STAFFPAD_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace staffpad {
+namespace vo {
+namespace avx2 {
+
+namespace {
+
+bool detect()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  const bool fma = info[2] & (1 << 12);
+  const bool osxsave = info[2] & (1 << 27);
+  const bool avx = info[2] & (1 << 28);
+  if (!(fma && osxsave && avx))
+    return false;
+  // The operating system must save the ymm registers
+  if ((_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return info[1] & (1 << 5);
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+constexpr float PIF = 3.141592653589793238f;
+constexpr float PIO2F = 1.5707963267948966192f;
+constexpr float PIO4F = 0.7853981633974483096f;
+constexpr float FOPI = 1.27323954473516f; // 4 / M_PI
+constexpr float minus_DP1 = -0.78515625f;
+constexpr float minus_DP2 = -2.4187564849853515625e-4f;
+constexpr float minus_DP3 = -3.77489497744594108e-8f;
+constexpr float sincof_p0 = -1.9515295891e-4f;
+constexpr float sincof_p1 = 8.3321608736e-3f;
+constexpr float sincof_p2 = -1.6666654611e-1f;
+constexpr float coscof_p0 = 2.443315711809948e-005f;
+constexpr float coscof_p1 = -1.388731625493765e-003f;
+constexpr float coscof_p2 = 4.166664568298827e-002f;
+constexpr float atancof_p0 = 8.05374449538e-2f;
+constexpr float atancof_p1 = 1.38776856032e-1f;
+constexpr float atancof_p2 = 1.99777106478e-1f;
+constexpr float atancof_p3 = 3.33329491539e-1f;
+
+STAFFPAD_AVX2 inline __m256 signMask()
+{
+  return _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+}
+
+STAFFPAD_AVX2 inline __m256 atan_ps(__m256 x)
+{
+  const auto sign_bit = _mm256_and_ps(x, signMask());
+  x = _mm256_andnot_ps(signMask(), x);
+
+  // range reduction
+  const auto cmp0 = _mm256_cmp_ps(x, _mm256_set1_ps(2.414213562373095f), _CMP_GT_OQ);
+  auto cmp1 = _mm256_cmp_ps(x, _mm256_set1_ps(0.4142135623730950f), _CMP_GT_OQ);
+  const auto cmp2 = _mm256_andnot_ps(cmp0, cmp1);
+
+  // -( 1.0/x )
+  const auto y0 = _mm256_and_ps(cmp0, _mm256_set1_ps(PIO2F));
+  auto x0 = _mm256_div_ps(_mm256_set1_ps(1.0f), x);
+  x0 = _mm256_xor_ps(x0, signMask());
+
+  // (x-1.0)/(x+1.0)
+  const auto y1 = _mm256_and_ps(cmp2, _mm256_set1_ps(PIO4F));
+  const auto x1 = _mm256_div_ps(
+     _mm256_sub_ps(x, _mm256_set1_ps(1.0f)), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+  auto x2 = _mm256_and_ps(cmp2, x1);
+  x0 = _mm256_and_ps(cmp0, x0);
+  x2 = _mm256_or_ps(x2, x0);
+  cmp1 = _mm256_or_ps(cmp0, cmp2);
+  x2 = _mm256_and_ps(cmp1, x2);
+  x = _mm256_andnot_ps(cmp1, x);
+  x = _mm256_or_ps(x2, x);
+
+  auto y = _mm256_or_ps(y0, y1);
+
+  const auto zz = _mm256_mul_ps(x, x);
+  auto acc = _mm256_fmsub_ps(_mm256_set1_ps(atancof_p0), zz, _mm256_set1_ps(atancof_p1));
+  acc = _mm256_fmadd_ps(acc, zz, _mm256_set1_ps(atancof_p2));
+  acc = _mm256_fmsub_ps(acc, zz, _mm256_set1_ps(atancof_p3));
+  acc = _mm256_mul_ps(acc, zz);
+  acc = _mm256_fmadd_ps(acc, x, x);
+  y = _mm256_add_ps(y, acc);
+
+  // update the sign
+  return _mm256_xor_ps(y, sign_bit);
+}
+
+STAFFPAD_AVX2 inline __m256 atan2_ps(__m256 y, __m256 x)
+{
+  const auto zero = _mm256_setzero_ps();
+  const auto x_eq_0 = _mm256_cmp_ps(x, zero, _CMP_EQ_OQ);
+  const auto x_gt_0 = _mm256_cmp_ps(x, zero, _CMP_GT_OQ);
+  const auto y_eq_0 = _mm256_cmp_ps(y, zero, _CMP_EQ_OQ);
+  const auto x_lt_0 = _mm256_cmp_ps(x, zero, _CMP_LT_OQ);
+  const auto y_lt_0 = _mm256_cmp_ps(y, zero, _CMP_LT_OQ);
+
+  const auto zero_mask =
+     _mm256_or_ps(_mm256_and_ps(x_eq_0, y_eq_0), _mm256_and_ps(y_eq_0, x_gt_0));
+
+  const auto pio2_mask = _mm256_andnot_ps(y_eq_0, x_eq_0);
+  const auto pio2_mask_sign = _mm256_and_ps(y_lt_0, signMask());
+  auto pio2_result = _mm256_xor_ps(_mm256_set1_ps(PIO2F), pio2_mask_sign);
+  pio2_result = _mm256_and_ps(pio2_mask, pio2_result);
+
+  const auto pi_mask = _mm256_and_ps(y_eq_0, x_lt_0);
+  const auto pi_result = _mm256_and_ps(pi_mask, _mm256_set1_ps(PIF));
+
+  const auto swap_sign_mask_offset =
+     _mm256_and_ps(_mm256_and_ps(x_lt_0, y_lt_0), signMask());
+  const auto offset1 = _mm256_xor_ps(_mm256_set1_ps(PIF), swap_sign_mask_offset);
+  const auto offset = _mm256_and_ps(x_lt_0, offset1);
+
+  auto atan_result = atan_ps(_mm256_div_ps(y, x));
+  atan_result = _mm256_add_ps(atan_result, offset);
+
+  // select between zero_result, pio2_result and atan_result
+  auto result = _mm256_andnot_ps(zero_mask, pio2_result);
+  atan_result = _mm256_andnot_ps(zero_mask, atan_result);
+  atan_result = _mm256_andnot_ps(pio2_mask, atan_result);
+  result = _mm256_or_ps(result, atan_result);
+  return _mm256_or_ps(result, pi_result);
+}
+
+STAFFPAD_AVX2 inline void sincos_ps(__m256 x, __m256& sin, __m256& cos)
+{
+  auto sign_bit_sin = _mm256_and_ps(x, signMask());
+  x = _mm256_andnot_ps(signMask(), x);
+
+  // scale by 4/Pi and take the integer part, j=(j+1) & (~1)
+  auto y = _mm256_mul_ps(x, _mm256_set1_ps(FOPI));
+  auto emm2 = _mm256_cvttps_epi32(y);
+  emm2 = _mm256_add_epi32(emm2, _mm256_set1_epi32(1));
+  emm2 = _mm256_and_si256(emm2, _mm256_set1_epi32(~1));
+  y = _mm256_cvtepi32_ps(emm2);
+
+  auto emm4 = emm2;
+
+  // the swap sign flag for the sine
+  auto emm0 = _mm256_and_si256(emm2, _mm256_set1_epi32(4));
+  emm0 = _mm256_slli_epi32(emm0, 29);
+  const auto swap_sign_bit_sin = _mm256_castsi256_ps(emm0);
+
+  // the polynom selection mask
+  emm2 = _mm256_and_si256(emm2, _mm256_set1_epi32(2));
+  emm2 = _mm256_cmpeq_epi32(emm2, _mm256_setzero_si256());
+  const auto poly_mask = _mm256_castsi256_ps(emm2);
+
+  // Extended precision modular arithmetic
+  x = _mm256_fmadd_ps(y, _mm256_set1_ps(minus_DP1), x);
+  x = _mm256_fmadd_ps(y, _mm256_set1_ps(minus_DP2), x);
+  x = _mm256_fmadd_ps(y, _mm256_set1_ps(minus_DP3), x);
+
+  emm4 = _mm256_sub_epi32(emm4, _mm256_set1_epi32(2));
+  emm4 = _mm256_andnot_si256(emm4, _mm256_set1_epi32(4));
+  emm4 = _mm256_slli_epi32(emm4, 29);
+  const auto sign_bit_cos = _mm256_castsi256_ps(emm4);
+
+  sign_bit_sin = _mm256_xor_ps(sign_bit_sin, swap_sign_bit_sin);
+
+  // first polynom (0 <= x <= Pi/4)
+  const auto z = _mm256_mul_ps(x, x);
+  y = _mm256_fmadd_ps(_mm256_set1_ps(coscof_p0), z, _mm256_set1_ps(coscof_p1));
+  y = _mm256_fmadd_ps(y, z, _mm256_set1_ps(coscof_p2));
+  y = _mm256_mul_ps(y, _mm256_mul_ps(z, z));
+  y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+  y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+  // second polynom (Pi/4 <= x <= 0)
+  auto y2 = _mm256_fmadd_ps(_mm256_set1_ps(sincof_p0), z, _mm256_set1_ps(sincof_p1));
+  y2 = _mm256_fmadd_ps(y2, z, _mm256_set1_ps(sincof_p2));
+  y2 = _mm256_mul_ps(y2, z);
+  y2 = _mm256_fmadd_ps(y2, x, x);
+
+  // select the correct result from the two polynoms
+  const auto ysin = _mm256_blendv_ps(y, y2, poly_mask);
+  const auto ycos = _mm256_blendv_ps(y2, y, poly_mask);
+
+  sin = _mm256_xor_ps(ysin, sign_bit_sin);
+  cos = _mm256_xor_ps(ycos, sign_bit_cos);
+}
+
+// Real and imaginary parts of src[i] to src[i + 7], in the order
+// 0, 1, 4, 5, 2, 3, 6, 7, which _mm256_unpacklo_ps and _mm256_unpackhi_ps
+// interleave again
+STAFFPAD_AVX2 inline void load(const std::complex<float>* src, __m256& rp, __m256& ip)
+{
+  // Safe according to C++ standard
+  const auto p1 = _mm256_loadu_ps(reinterpret_cast<const float*>(src));
+  const auto p2 = _mm256_loadu_ps(reinterpret_cast<const float*>(src + 4));
+  rp = _mm256_shuffle_ps(p1, p2, _MM_SHUFFLE(2, 0, 2, 0));
+  ip = _mm256_shuffle_ps(p1, p2, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+// Exchanges the middle pairs of lanes, to and from the order of load()
+STAFFPAD_AVX2 inline __m256 swapMiddle(__m256 x)
+{
+  return _mm256_castpd_ps(
+     _mm256_permute4x64_pd(_mm256_castps_pd(x), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+} // namespace
+
+STAFFPAD_AVX2 void calcPhases(const std::complex<float>* src, float* dst, int32_t n)
+{
+  int32_t i = 0;
+  for (; i <= n - 8; i += 8)
+  {
+    __m256 rp, ip;
+    load(src + i, rp, ip);
+    _mm256_storeu_ps(dst + i, swapMiddle(atan2_ps(ip, rp)));
+  }
+  for (; i < n; ++i)
+    dst[i] = std::atan2(src[i].imag(), src[i].real());
+}
+
+STAFFPAD_AVX2 void calcNorms(const std::complex<float>* src, float* dst, int32_t n)
+{
+  int32_t i = 0;
+  for (; i <= n - 8; i += 8)
+  {
+    __m256 rp, ip;
+    load(src + i, rp, ip);
+    const auto norm = _mm256_fmadd_ps(rp, rp, _mm256_mul_ps(ip, ip));
+    _mm256_storeu_ps(dst + i, swapMiddle(norm));
+  }
+  for (; i < n; ++i)
+    dst[i] = src[i].real() * src[i].real() + src[i].imag() * src[i].imag();
+}
+
+STAFFPAD_AVX2 void rotate(const float* oldPhase, const float* newPhase, std::complex<float>* dst, int32_t n)
+{
+  int32_t i = 0;
+  for (; i <= n - 8; i += 8)
+  {
+    auto theta = _mm256_loadu_ps(newPhase + i);
+    if (oldPhase)
+      theta = _mm256_sub_ps(theta, _mm256_loadu_ps(oldPhase + i));
+    __m256 sin, cos;
+    sincos_ps(swapMiddle(theta), sin, cos);
+
+    __m256 rp, ip;
+    load(dst + i, rp, ip);
+
+    // (rp, ip) * (cos, sin) -> (rp*cos - ip*sin, rp*sin + ip*cos)
+    const auto out_rp = _mm256_fmsub_ps(rp, cos, _mm256_mul_ps(ip, sin));
+    const auto out_ip = _mm256_fmadd_ps(rp, sin, _mm256_mul_ps(ip, cos));
+
+    _mm256_storeu_ps(reinterpret_cast<float*>(dst + i), _mm256_unpacklo_ps(out_rp, out_ip));
+    _mm256_storeu_ps(reinterpret_cast<float*>(dst + i + 4), _mm256_unpackhi_ps(out_rp, out_ip));
+  }
+  for (; i < n; ++i)
+  {
+    const auto theta = oldPhase ? newPhase[i] - oldPhase[i] : newPhase[i];
+    dst[i] *= std::complex<float>(std::cos(theta), std::sin(theta));
+  }
+}
+
+} // namespace avx2
+} // namespace vo
+} // namespace staffpad
+
+#endif
+
+namespace staffpad {
+namespace vo {
+namespace avx2 {
+
+namespace {
+std::atomic<bool>& enabled()
+{
+  static std::atomic<bool> value { isSupported() };
+  return value;
+}
+} // namespace
+
+bool isSupported()
+{
+#if USE_AVX2_DISPATCH
+  static const bool supported = detect();
+  return supported;
+#else
+  return false;
+#endif
+}
+
+bool isEnabled()
+{
+  return enabled().load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool value)
+{
+  enabled().store(value && isSupported(), std::memory_order_relaxed);
+}
+
+} // namespace avx2
+} // namespace vo
+} // namespace staffpad
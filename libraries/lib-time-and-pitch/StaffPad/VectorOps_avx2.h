@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+  AVX2 and FMA versions of the complex vector operations of VectorOps.h,
+  chosen at run time, so that builds for any x86-64 processor may use them.
+ */
+
+#pragma once
+
+#include <complex>
+#include <cstdint>
+
+namespace staffpad {
+namespace vo {
+namespace avx2 {
+
+/// whether the processor and the operating system support AVX2 and FMA;
+/// always false if not USE_AVX2_DISPATCH
+TIME_AND_PITCH_API bool isSupported();
+
+/// whether VectorOps.h calls the functions below; initially isSupported()
+TIME_AND_PITCH_API bool isEnabled();
+
+/// lets tests and benchmarks compare with the portable functions; enabling has
+/// no effect if not isSupported()
+TIME_AND_PITCH_API void setEnabled(bool enabled);
+
+// The inline functions of VectorOps.h call those below, so they are exported,
+// though only for use by that header
+
+/// @pre isSupported()
+TIME_AND_PITCH_API void calcPhases(const std::complex<float>* src, float* dst, int32_t n);
+
+/// @pre isSupported()
+TIME_AND_PITCH_API void calcNorms(const std::complex<float>* src, float* dst, int32_t n);
+
+/// @pre isSupported()
+TIME_AND_PITCH_API void rotate(const float* oldPhase, const float* newPhase, std::complex<float>* dst, int32_t n);
+
+} // namespace avx2
+} // namespace vo
+} // namespace staffpad
@@ -11,15 +11,66 @@
 #include "StaffPadTimeAndPitch.h"
 #include "AudioContainer.h"
 #include "MockedPrefs.h"
+#include "StaffPad/VectorOps.h"
 #include "TimeAndPitchFakeSource.h"
 #include "TimeAndPitchRealSource.h"
 #include "WavFileIO.h"
+#include "concurrency/TaskPool.h"
 
 #include <catch2/catch.hpp>
 
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+
 using namespace std::literals::string_literals;
 using namespace std::literals::chrono_literals;
 
+namespace
+{
+// Set to true to measure the throughput on your machine
+constexpr auto runBenchmarkLocally = false;
+
+//! Writes numOutputFrames of the stretched input to the container
+void Stretch(
+   const std::vector<std::vector<float>>& input, const AudioFileInfo& info,
+   double timeRatio, double pitchRatio, AudioContainer& container,
+   size_t numOutputFrames)
+{
+   TimeAndPitchInterface::Parameters params;
+   params.timeRatio = timeRatio;
+   params.pitchRatio = pitchRatio;
+   TimeAndPitchRealSource src(input);
+   StaffPadTimeAndPitch sut(
+      info.sampleRate, info.numChannels, src, std::move(params));
+   constexpr size_t blockSize = 1234u;
+   auto offset = 0u;
+   while (offset < numOutputFrames)
+   {
+      std::vector<float*> offsetBuffers(info.numChannels);
+      for (auto i = 0u; i < info.numChannels; ++i)
+         offsetBuffers[i] = container.channelPointers[i] + offset;
+      const auto numToRead = std::min(numOutputFrames - offset, blockSize);
+      sut.GetSamples(offsetBuffers.data(), numToRead);
+      offset += numToRead;
+   }
+}
+
+//! @return seconds of output per second of processing
+double Throughput(
+   double outputDuration, size_t runs, const std::function<void()>& stretch)
+{
+   const auto start = std::chrono::steady_clock::now();
+   for (size_t i = 0; i < runs; ++i)
+      stretch();
+   const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+   return runs * outputDuration / elapsed.count();
+}
+} // namespace
+
 TEST_CASE("StaffPadTimeAndPitch")
 {
    MockedPrefs mockedPrefs;
@@ -59,24 +110,7 @@ TEST_CASE("StaffPadTimeAndPitch")
             const auto numOutputFrames =
                static_cast<size_t>(info.numFrames * tr);
             AudioContainer container(numOutputFrames, info.numChannels);
-            TimeAndPitchInterface::Parameters params;
-            params.timeRatio = tr;
-            params.pitchRatio = pr;
-            TimeAndPitchRealSource src(input);
-            StaffPadTimeAndPitch sut(
-               info.sampleRate, info.numChannels, src, std::move(params));
-            constexpr size_t blockSize = 1234u;
-            auto offset = 0u;
-            while (offset < numOutputFrames)
-            {
-               std::vector<float*> offsetBuffers(info.numChannels);
-               for (auto i = 0u; i < info.numChannels; ++i)
-                  offsetBuffers[i] = container.channelPointers[i] + offset;
-               const auto numToRead =
-                  std::min(numOutputFrames - offset, blockSize);
-               sut.GetSamples(offsetBuffers.data(), numToRead);
-               offset += numToRead;
-            }
+            Stretch(input, info, tr, pr, container, numOutputFrames);
 
             if (outputDir)
             {
@@ -135,3 +169,130 @@ TEST_CASE("StaffPadTimeAndPitch")
          requestedNumSamples); // This is just not supposed to hang.
    }
 }
+
+TEST_CASE("StaffPad vector operations")
+{
+   using namespace staffpad;
+
+   SECTION("AVX2 versions agree with the portable ones")
+   {
+      if (!vo::avx2::isSupported())
+         return;
+
+      // Not a multiple of the vector size, to cover the remainders too
+      constexpr auto n = 2049;
+      std::mt19937 engine;
+      std::uniform_real_distribution<float> dist(-10.f, 10.f);
+      std::vector<std::complex<float>> spectrum(n);
+      for (auto& bin : spectrum)
+         bin = { dist(engine), dist(engine) };
+      // The special cases of the arctangent
+      spectrum[0] = { 0.f, 0.f };
+      spectrum[1] = { -1.f, 0.f };
+      spectrum[2] = { 0.f, -2.f };
+      spectrum[3] = { 3.f, 0.f };
+      std::vector<float> oldPhases(n);
+      std::vector<float> newPhases(n);
+      for (auto i = 0; i < n; ++i)
+      {
+         oldPhases[i] = dist(engine);
+         newPhases[i] = 3 * dist(engine);
+      }
+
+      struct Result
+      {
+         std::vector<float> phases;
+         std::vector<float> norms;
+         std::vector<std::complex<float>> rotated;
+      };
+      const auto compute = [&](bool avx2) {
+         vo::avx2::setEnabled(avx2);
+         Result result { std::vector<float>(n), std::vector<float>(n),
+                         spectrum };
+         vo::calcPhases(spectrum.data(), result.phases.data(), n);
+         vo::calcNorms(spectrum.data(), result.norms.data(), n);
+         vo::rotate(
+            oldPhases.data(), newPhases.data(), result.rotated.data(), n);
+         return result;
+      };
+      const auto expected = compute(false);
+      const auto actual = compute(true);
+      vo::avx2::setEnabled(true);
+
+      for (auto i = 0; i < n; ++i)
+      {
+         REQUIRE(actual.phases[i] == Approx(expected.phases[i]).margin(1e-5));
+         REQUIRE(actual.norms[i] == Approx(expected.norms[i]).epsilon(1e-5));
+         const auto magnitude = std::abs(spectrum[i]);
+         REQUIRE(
+            std::abs(actual.rotated[i] - expected.rotated[i]) <=
+            1e-5f * magnitude);
+      }
+   }
+}
+
+TEST_CASE("StaffPadTimeAndPitchBenchmark")
+{
+   if (!runBenchmarkLocally)
+      return;
+
+   MockedPrefs mockedPrefs;
+   const auto inputPath =
+      std::string(CMAKE_SOURCE_DIR) + "/tests/samples/FifeAndDrumsStereo.wav";
+   std::vector<std::vector<float>> input;
+   AudioFileInfo info;
+   REQUIRE(WavFileIO::Read(inputPath, input, info, 10s));
+
+   constexpr auto runs = 4;
+   std::printf(
+      "AVX2 %s; output seconds per second of processing, stereo input\n"
+      "%10s %10s %12s %12s\n",
+      staffpad::vo::avx2::isSupported() ? "supported" : "not supported",
+      "time", "pitch", "portable", "AVX2");
+   for (const auto ratios : std::vector<std::pair<double, double>> {
+           { 1.25, 1. }, { 0.8, 1. }, { 1., 1.25 }, { 1., 0.8 } })
+   {
+      const auto tr = ratios.first;
+      const auto pr = ratios.second;
+      const auto numOutputFrames = static_cast<size_t>(info.numFrames * tr);
+      const auto duration = double(numOutputFrames) / info.sampleRate;
+      AudioContainer container(numOutputFrames, info.numChannels);
+      double throughput[2] {};
+      for (const auto avx2 : { false, true })
+      {
+         staffpad::vo::avx2::setEnabled(avx2);
+         throughput[avx2] = Throughput(duration, runs, [&] {
+            Stretch(input, info, tr, pr, container, numOutputFrames);
+         });
+      }
+      std::printf(
+         "%10.2f %10.2f %12.1f %12.1f\n", tr, pr, throughput[0],
+         throughput[1]);
+   }
+   staffpad::vo::avx2::setEnabled(true);
+
+   // Independent clips, as WaveTrack renders them, one after the other and on
+   // the task pool
+   auto& pool = audacity::concurrency::TaskPool::Get();
+   constexpr size_t numClips = 16;
+   constexpr auto tr = 1.25;
+   const auto numOutputFrames = static_cast<size_t>(info.numFrames * tr);
+   const auto duration = numClips * double(numOutputFrames) / info.sampleRate;
+   std::vector<std::unique_ptr<AudioContainer>> containers;
+   for (size_t i = 0; i < numClips; ++i)
+      containers.push_back(std::make_unique<AudioContainer>(
+         numOutputFrames, info.numChannels));
+   const auto serial = Throughput(duration, 1, [&] {
+      for (auto& pContainer : containers)
+         Stretch(input, info, tr, 1., *pContainer, numOutputFrames);
+   });
+   const auto concurrent = Throughput(duration, 1, [&] {
+      pool.ParallelFor(numClips, 1, [&](size_t begin, size_t end) {
+         for (auto i = begin; i < end; ++i)
+            Stretch(input, info, tr, 1., *containers[i], numOutputFrames);
+      });
+   });
+   std::printf(
+      "%zu clips: %.1f serially, %.1f on %zu threads\n", numClips, serial,
+      concurrent, pool.GetWorkersCount() + 1);
+}
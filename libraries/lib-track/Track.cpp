@@ -810,11 +810,18 @@ void Track::WriteCommonXMLAttributes(
       xmlFile.WriteAttr(wxT("name"), GetName());
       xmlFile.WriteAttr(wxT("isSelected"), this->GetSelected());
    }
+   std::lock_guard<std::recursive_mutex> lock{ ExtensionWritersMutex() };
    AttachedTrackObjects::ForEach([&](auto &attachment){
       attachment.WriteXMLAttributes( xmlFile );
    });
 }
 
+std::recursive_mutex &Track::ExtensionWritersMutex()
+{
+   static std::recursive_mutex mutex;
+   return mutex;
+}
+
 // Return true iff the attribute is recognized.
 bool Track::HandleCommonXMLAttribute(
    const std::string_view& attr, const XMLAttributeValueView& valueView)
@@ -15,6 +15,7 @@
 #include <atomic>
 #include <utility>
 #include <list>
+#include <mutex>
 #include <optional>
 #include <functional>
 #include <wx/longlong.h>
@@ -400,8 +401,17 @@ public:
    }
 
    // XMLTagHandler callback methods -- NEW virtual for writing
+   /*!
+    May be called for different tracks at once, on worker threads.  Writers
+    that other modules attach or register may touch state shared among
+    tracks or with the project, so overrides call them only while holding
+    ExtensionWritersMutex().
+    */
    virtual void WriteXML(XMLWriter &xmlFile) const = 0;
 
+   //! Serializes the calls to attached and registered XML writers of tracks
+   static std::recursive_mutex &ExtensionWritersMutex();
+
    //! Returns nonempty if an error was encountered while trying to
    //! open the track from XML
    /*!
@@ -34,6 +34,9 @@ struct TrackListRestorer final : UndoStateExtension {
    bool CanUndoOrRedo(const AudacityProject &project) override {
       return !PendingTracks::Get(project).HasPendingTracks();
    }
+   void VisitStorage(const StorageVisitor &visitor) const override {
+      UndoTracks::StorageInspector::Call(*mpTracks, visitor);
+   }
    const std::shared_ptr<TrackList> mpTracks;
 };
 
@@ -10,11 +10,19 @@
 #ifndef __AUDACITY_UNDO_TRACKS__
 #define __AUDACITY_UNDO_TRACKS__
 
+#include "GlobalVariable.h"
+#include "UndoManager.h"
+
 class TrackList;
-struct UndoStackElem;
 
 namespace UndoTracks {
 TRACK_API TrackList *Find(const UndoStackElem &state);
+
+//! Type of function that visits the storage held by tracks of an undo state,
+//! for space accounting by UndoManager
+struct TRACK_API StorageInspector : GlobalHook<StorageInspector,
+   void(const TrackList &, const UndoStateExtension::StorageVisitor &)
+> {};
 }
 
 #endif
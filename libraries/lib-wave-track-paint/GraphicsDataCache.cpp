@@ -71,10 +71,15 @@ auto GetPPSMatchRange(
 }
 } // namespace
 
+GraphicsDataCacheBase::~GraphicsDataCacheBase()
+{
+   GraphicsDataCacheGovernor::Get().Unregister(*this);
+}
+
 void GraphicsDataCacheBase::Invalidate()
 {
    for (auto& item : mLookup)
-      DisposeElement(item.Data);
+      EvictElement(item.Data);
 
    mLookup.clear();
 }
@@ -94,9 +99,16 @@ int64_t GraphicsDataCacheBase::GetMaxViewportWidth() const noexcept
    return mMaxWidth;
 }
 
+GraphicsDataCacheStatistics
+GraphicsDataCacheBase::GetStatistics() const noexcept
+{
+   return { mLookup.size(), mBytes, mHits, mMisses };
+}
+
 GraphicsDataCacheBase::GraphicsDataCacheBase(double sampleRate)
     : mScaledSampleRate { sampleRate }
 {
+   GraphicsDataCacheGovernor::Get().Register(*this);
 }
 
 void GraphicsDataCacheBase::SetScaledSampleRate(double scaledSampleRate)
@@ -119,6 +131,11 @@ void GraphicsDataCacheElementBase::Smooth(
 {
 }
 
+size_t GraphicsDataCacheElementBase::GetMemorySize() const
+{
+   return 0;
+}
+
 GraphicsDataCacheBase::BaseLookupResult
 GraphicsDataCacheBase::PerformBaseLookup(
    const ZoomInfo& zoomInfo, double t0, double t1)
@@ -144,6 +161,11 @@ GraphicsDataCacheBase::PerformBaseLookup(
 
    UpdateViewportWidth(width);
 
+   ++mLookupDepth;
+   auto lookupDepthGuard = finally([this] { --mLookupDepth; });
+
+   mLastAccess = GraphicsDataCacheGovernor::Get().NextAccessTick();
+
    mNewLookupItems.clear();
    mNewLookupItems.reserve(cacheItemsCount);
 
@@ -168,6 +190,9 @@ GraphicsDataCacheBase::PerformBaseLookup(
 
    bool needsSmoothing = !mNewLookupItems.empty();
 
+   mMisses += mNewLookupItems.size();
+   mHits += cacheItemsCount - mNewLookupItems.size();
+
    ++mCacheAccessIndex;
 
    if (!CreateNewItems())
@@ -213,6 +238,7 @@ GraphicsDataCacheBase::PerformBaseLookup(
          if (!UpdateElement(it->Key, *data))
             return {};
 
+         AccountElement(*data);
          needsSmoothing = true;
       }
 
@@ -244,14 +270,24 @@ GraphicsDataCacheBase::PerformBaseLookup(GraphicsDataCacheKey key)
 
    ++mCacheAccessIndex;
 
+   ++mLookupDepth;
+   auto lookupDepthGuard = finally([this] { --mLookupDepth; });
+
+   mLastAccess = GraphicsDataCacheGovernor::Get().NextAccessTick();
+
    if (it != mLookup.end())
    {
       GraphicsDataCacheElementBase* data = it->Data;
 
+      ++mHits;
+      data->LastCacheAccess = mCacheAccessIndex;
+
       if (!data->IsComplete && data->LastUpdate != mCacheAccessIndex)
       {
          if (!UpdateElement(it->Key, *data))
             return {};
+
+         AccountElement(*data);
       }
 
       data->Smooth(it == mLookup.begin() ? nullptr : (it - 1)->Data);
@@ -266,9 +302,13 @@ GraphicsDataCacheBase::PerformBaseLookup(GraphicsDataCacheKey key)
 
    LookupElement newElement { key, CreateElement(key) };
 
+   ++mMisses;
+
    if (newElement.Data == nullptr)
       return nullptr;
 
+   AccountElement(*newElement.Data);
+
    newElement.Data->LastUpdate      = mCacheAccessIndex;
    newElement.Data->LastCacheAccess = mCacheAccessIndex;
    newElement.Data->AwaitsEviction  = false;
@@ -295,6 +335,17 @@ GraphicsDataCacheBase::PerformBaseLookup(GraphicsDataCacheKey key)
    return newElement.Data;
 }
 
+void GraphicsDataCacheBase::ForEachElement(const ElementVisitor& visitor) const
+{
+   for (const auto& item : mLookup)
+      visitor(item.Key, *item.Data);
+}
+
+const void* GraphicsDataCacheBase::GetOwner() const noexcept
+{
+   return this;
+}
+
 bool GraphicsDataCacheBase::CreateNewItems()
 {
    for (auto& item : mNewLookupItems)
@@ -305,6 +356,7 @@ bool GraphicsDataCacheBase::CreateNewItems()
          return false;
 
       item.Data->LastUpdate = mCacheAccessIndex;
+      AccountElement(*item.Data);
    }
 
    return true;
@@ -314,11 +366,7 @@ void GraphicsDataCacheBase::DisposeNewItems()
 {
    std::for_each(
       mNewLookupItems.begin(), mNewLookupItems.end(),
-      [](auto elem)
-      {
-         if (elem.Data != nullptr)
-            elem.Data->Dispose();
-      });
+      [this](auto elem) { EvictElement(elem.Data); });
 }
 
 GraphicsDataCacheBase::Lookup::iterator
@@ -330,12 +378,89 @@ GraphicsDataCacheBase::FindKey(GraphicsDataCacheKey key)
       { return IsSameKey(sampleRate, lhs.Key, key); });
 }
 
+void GraphicsDataCacheBase::AccountElement(
+   GraphicsDataCacheElementBase& element)
+{
+   const auto bytes = element.GetMemorySize();
+
+   if (bytes == element.AccountedBytes)
+      return;
+
+   mBytes = mBytes - element.AccountedBytes + bytes;
+   GraphicsDataCacheGovernor::Get().UpdateBytes(element.AccountedBytes, bytes);
+
+   element.AccountedBytes = bytes;
+}
+
+void GraphicsDataCacheBase::EvictElement(GraphicsDataCacheElementBase* element)
+{
+   if (element == nullptr)
+      return;
+
+   mBytes -= element->AccountedBytes;
+   GraphicsDataCacheGovernor::Get().UpdateBytes(element->AccountedBytes, 0);
+
+   element->AccountedBytes = 0;
+
+   DisposeElement(element);
+}
+
+void GraphicsDataCacheBase::Trim(size_t bytesToFree, bool evictLatest)
+{
+   for (size_t i = 0; i < mLookup.size(); ++i)
+   {
+      if (evictLatest || mLookup[i].Data->LastCacheAccess < mCacheAccessIndex)
+         mLRUHelper.push_back(i);
+   }
+
+   std::sort(
+      mLRUHelper.begin(), mLRUHelper.end(),
+      [this](size_t lhs, size_t rhs)
+      {
+         return mLookup[lhs].Data->LastCacheAccess <
+                mLookup[rhs].Data->LastCacheAccess;
+      });
+
+   size_t freedBytes = 0;
+
+   for (const auto index : mLRUHelper)
+   {
+      if (freedBytes >= bytesToFree)
+         break;
+
+      auto data = mLookup[index].Data;
+
+      freedBytes += data->AccountedBytes;
+
+      EvictElement(data);
+      data->AwaitsEviction = true;
+   }
+
+   mLookup.erase(
+      std::remove_if(
+         mLookup.begin(), mLookup.end(),
+         [](auto item) { return item.Data->AwaitsEviction; }),
+      mLookup.end());
+
+   mLRUHelper.clear();
+}
+
 void GraphicsDataCacheBase::PerformCleanup()
 {
+   auto& governor = GraphicsDataCacheGovernor::Get();
+   // Evict elements of the other caches first
+   governor.Enforce();
+
    const int64_t lookupSize = static_cast<int64_t>(mLookup.size());
 
+   // While the memory budget allows it, keep more elements around,
+   // so the visible clips do not recompute the data when scrolling back
+   const auto sizeMultiplier =
+      governor.IsOverBudget() ? mCacheSizeMultiplier :
+                                mCacheSizeMultiplier * mRelaxedSizeMultiplier;
+
    const auto allowedItems =
-      RoundUpUnsafe(mMaxWidth, CacheElementWidth) * mCacheSizeMultiplier;
+      RoundUpUnsafe(mMaxWidth, CacheElementWidth) * sizeMultiplier;
 
    const int64_t itemsToEvict = lookupSize - allowedItems;
 
@@ -351,7 +476,7 @@ void GraphicsDataCacheBase::PerformCleanup()
 
       if (it->Data->LastCacheAccess < mCacheAccessIndex)
       {
-         DisposeElement(it->Data);
+         EvictElement(it->Data);
          mLookup.erase(it);
       }
    }
@@ -369,17 +494,17 @@ void GraphicsDataCacheBase::PerformFullCleanup(
    for (size_t i = 0; i < currentSize; ++i)
       mLRUHelper.push_back(i);
 
-   std::make_heap(
-      mLRUHelper.begin(), mLRUHelper.end(),
-      [this](size_t lhs, size_t rhs)
-      {
-         return mLookup[lhs].Data->LastCacheAccess >
-                mLookup[rhs].Data->LastCacheAccess;
-      });
+   const auto compare = [this](size_t lhs, size_t rhs)
+   {
+      return mLookup[lhs].Data->LastCacheAccess >
+             mLookup[rhs].Data->LastCacheAccess;
+   };
+
+   std::make_heap(mLRUHelper.begin(), mLRUHelper.end(), compare);
 
    for (int64_t itemIndex = 0; itemIndex < itemsToEvict; ++itemIndex)
    {
-      std::pop_heap(mLRUHelper.begin(), mLRUHelper.end());
+      std::pop_heap(mLRUHelper.begin(), mLRUHelper.end(), compare);
 
       const size_t index = mLRUHelper.back();
       mLRUHelper.pop_back();
@@ -389,7 +514,7 @@ void GraphicsDataCacheBase::PerformFullCleanup(
       if (data->LastCacheAccess >= mCacheAccessIndex)
          break;
 
-      DisposeElement(data);
+      EvictElement(data);
       data->AwaitsEviction = true;
    }
 
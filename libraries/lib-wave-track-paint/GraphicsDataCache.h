@@ -20,6 +20,8 @@
 #include "MemoryX.h"
 #include "IteratorX.h"
 
+#include "GraphicsDataCacheGovernor.h"
+
 class ZoomInfo;
 
 //! A key into the graphics data cache
@@ -39,6 +41,8 @@ struct WAVE_TRACK_PAINT_API GraphicsDataCacheElementBase /* not final */
    virtual void Dispose();
    //! This method is called during the lookup when new items are inserted. prevElement can be nullptr. Default implementation is empty
    virtual void Smooth(GraphicsDataCacheElementBase* prevElement);
+   //! Estimated number of bytes held by the element, used to enforce the global memory budget. Default implementation returns 0
+   virtual size_t GetMemorySize() const;
 
    //! Index filled by GraphicsDataCacheBase to implement LRU eviction policy
    uint64_t LastCacheAccess { 0 };
@@ -48,6 +52,8 @@ struct WAVE_TRACK_PAINT_API GraphicsDataCacheElementBase /* not final */
    bool IsComplete { false };
    //! This flag is used to simplify the eviction algorithm
    bool AwaitsEviction { false };
+   //! Memory size reported to GraphicsDataCacheGovernor when the element was last created or updated
+   size_t AccountedBytes { 0 };
 };
 
 //! A base class for the GraphicsDataCache. Implements LRU policy
@@ -57,7 +63,7 @@ public:
    // Number of pixels in a single cache element
    constexpr static uint32_t CacheElementWidth = 256;
 
-   virtual ~GraphicsDataCacheBase() = default;
+   virtual ~GraphicsDataCacheBase();
 
    //! Invalidate the cache content
    void Invalidate();
@@ -68,6 +74,9 @@ public:
    void UpdateViewportWidth(int64_t width) noexcept;
    int64_t GetMaxViewportWidth() const noexcept;
 
+   //! Returns the usage statistics of this cache
+   GraphicsDataCacheStatistics GetStatistics() const noexcept;
+
 protected:
    explicit GraphicsDataCacheBase(double scaledSampleRate);
 
@@ -109,6 +118,15 @@ protected:
    //! Perform a lookup for the given key. This method modifies mLookup and invalidates any previous result.
    const GraphicsDataCacheElementBase* PerformBaseLookup(GraphicsDataCacheKey key);
 
+   using ElementVisitor = std::function<void(
+      const GraphicsDataCacheKey& key,
+      const GraphicsDataCacheElementBase& element)>;
+   //! Call the visitor for every element in the cache, in the order of the keys
+   void ForEachElement(const ElementVisitor& visitor) const;
+
+   //! Object the cache belongs to. Statistics of the caches with the same owner are grouped together. Default implementation returns this
+   virtual const void* GetOwner() const noexcept;
+
 private:
    // Called internally to create a list of items in the mNewLookupItems
    bool CreateNewItems();
@@ -116,6 +134,14 @@ private:
    void DisposeNewItems();
    Lookup::iterator FindKey(GraphicsDataCacheKey key);
 
+   // Updates the memory accounted for the element after it was created or updated
+   void AccountElement(GraphicsDataCacheElementBase& element);
+   // Removes the element from the memory accounting and disposes it
+   void EvictElement(GraphicsDataCacheElementBase* element);
+   // Called by the governor to free at least bytesToFree bytes, least recently used elements first.
+   // Elements accessed by the latest lookup are only evicted if evictLatest is set.
+   void Trim(size_t bytesToFree, bool evictLatest);
+
    // Called internally to evict the no longer needed items. Cache keeps mCacheSizeMultiplier * mMaxWidth / CacheElementWidth items
    void PerformCleanup();
    // A heap based approach if cache needs to evict more than one item
@@ -138,6 +164,24 @@ private:
    uint64_t mCacheAccessIndex {};
    // A multiplier used to control the cache size
    int32_t mCacheSizeMultiplier { 4 };
+   // An additional multiplier applied while the global memory budget is not exceeded
+   int32_t mRelaxedSizeMultiplier { 4 };
+
+   // Estimated number of bytes held by the elements in mLookup
+   size_t mBytes { 0 };
+   // Number of elements found in the cache during lookups
+   uint64_t mHits { 0 };
+   // Number of elements created during lookups
+   uint64_t mMisses { 0 };
+   // GraphicsDataCacheGovernor tick of the latest lookup, used for LRU between the caches
+   uint64_t mLastAccess { 0 };
+   // Lookups can be nested (i. e. the bitmap cache looks up the data cache),
+   // governor never evicts elements of a cache in the middle of a lookup
+   int32_t mLookupDepth { 0 };
+   // Position of this cache in the governor list
+   size_t mGovernorIndex { 0 };
+
+   friend class GraphicsDataCacheGovernor;
 
    template <typename CacheElementType>
    friend class GraphicsDataCacheIterator;
@@ -0,0 +1,181 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  GraphicsDataCacheGovernor.cpp
+
+**********************************************************************/
+#include "GraphicsDataCacheGovernor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+
+#include "GraphicsDataCache.h"
+#include "Prefs.h"
+
+namespace
+{
+//! Memory budget for the waveform caches, in megabytes
+IntSetting GraphicsDataCacheBudget { L"/GUI/GraphicsDataCacheBudget", 512 };
+
+constexpr size_t Megabyte = 1024 * 1024;
+} // namespace
+
+double GraphicsDataCacheStatistics::GetHitRate() const noexcept
+{
+   const auto total = Hits + Misses;
+   return total > 0 ? static_cast<double>(Hits) / total : 0.0;
+}
+
+GraphicsDataCacheStatistics& GraphicsDataCacheStatistics::operator+=(
+   const GraphicsDataCacheStatistics& rhs) noexcept
+{
+   Elements += rhs.Elements;
+   Bytes += rhs.Bytes;
+   Hits += rhs.Hits;
+   Misses += rhs.Misses;
+
+   return *this;
+}
+
+GraphicsDataCacheGovernor& GraphicsDataCacheGovernor::Get()
+{
+   static GraphicsDataCacheGovernor governor;
+   return governor;
+}
+
+GraphicsDataCacheGovernor::GraphicsDataCacheGovernor()
+{
+   // Preferences may be not available (i. e. in the tests)
+   const auto budget = GraphicsDataCacheBudget.Read();
+
+   mBudget = static_cast<size_t>(
+                budget > 0 ? budget : GraphicsDataCacheBudget.GetDefault()) *
+             Megabyte;
+}
+
+void GraphicsDataCacheGovernor::SetBudget(size_t bytes)
+{
+   mBudget = bytes;
+   Enforce();
+}
+
+size_t GraphicsDataCacheGovernor::GetBudget() const noexcept
+{
+   return mBudget;
+}
+
+size_t GraphicsDataCacheGovernor::GetTotalBytes() const noexcept
+{
+   return mTotalBytes;
+}
+
+bool GraphicsDataCacheGovernor::IsOverBudget() const noexcept
+{
+   return mTotalBytes > mBudget;
+}
+
+size_t GraphicsDataCacheGovernor::GetCachesCount() const noexcept
+{
+   return mCaches.size();
+}
+
+GraphicsDataCacheStatistics GraphicsDataCacheGovernor::GetStatistics() const
+{
+   GraphicsDataCacheStatistics statistics;
+
+   for (auto cache : mCaches)
+      statistics += cache->GetStatistics();
+
+   return statistics;
+}
+
+std::vector<GraphicsDataCacheGovernor::OwnerStatistics>
+GraphicsDataCacheGovernor::GetOwnerStatistics() const
+{
+   std::vector<OwnerStatistics> result;
+   std::unordered_map<const void*, size_t> ownerIndices;
+
+   for (auto cache : mCaches)
+   {
+      const auto owner = cache->GetOwner();
+      const auto [it, inserted] = ownerIndices.emplace(owner, result.size());
+
+      if (inserted)
+         result.push_back({ owner, {} });
+
+      result[it->second].Statistics += cache->GetStatistics();
+   }
+
+   std::sort(
+      result.begin(), result.end(),
+      [](const auto& lhs, const auto& rhs)
+      { return lhs.Statistics.Bytes > rhs.Statistics.Bytes; });
+
+   return result;
+}
+
+void GraphicsDataCacheGovernor::Register(GraphicsDataCacheBase& cache)
+{
+   cache.mGovernorIndex = mCaches.size();
+   mCaches.push_back(&cache);
+}
+
+void GraphicsDataCacheGovernor::Unregister(GraphicsDataCacheBase& cache)
+{
+   const auto index = cache.mGovernorIndex;
+
+   assert(index < mCaches.size() && mCaches[index] == &cache);
+
+   if (index >= mCaches.size() || mCaches[index] != &cache)
+      return;
+
+   mCaches[index] = mCaches.back();
+   mCaches[index]->mGovernorIndex = index;
+   mCaches.pop_back();
+}
+
+uint64_t GraphicsDataCacheGovernor::NextAccessTick() noexcept
+{
+   return ++mAccessTick;
+}
+
+void GraphicsDataCacheGovernor::UpdateBytes(
+   size_t oldBytes, size_t newBytes) noexcept
+{
+   assert(mTotalBytes >= oldBytes);
+   mTotalBytes = mTotalBytes - oldBytes + newBytes;
+}
+
+void GraphicsDataCacheGovernor::Enforce()
+{
+   if (!IsOverBudget())
+      return;
+
+   // Free some extra space, so the caches are not sorted on every lookup
+   const size_t target = mBudget - mBudget / 8;
+
+   mEvictionOrder.assign(mCaches.begin(), mCaches.end());
+
+   std::sort(
+      mEvictionOrder.begin(), mEvictionOrder.end(),
+      [](auto lhs, auto rhs) { return lhs->mLastAccess < rhs->mLastAccess; });
+
+   // First pass keeps the elements that were used by the latest lookup
+   // of every cache, the second one only spares the caches doing a lookup
+   for (const bool evictLatest : { false, true })
+   {
+      for (auto cache : mEvictionOrder)
+      {
+         if (mTotalBytes <= target)
+            break;
+
+         if (cache->mLookupDepth == 0)
+            cache->Trim(mTotalBytes - target, evictLatest);
+      }
+   }
+
+   mEvictionOrder.clear();
+}
@@ -0,0 +1,96 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  GraphicsDataCacheGovernor.h
+
+**********************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class GraphicsDataCacheBase;
+
+//! Usage statistics of a single cache or of a group of caches
+struct WAVE_TRACK_PAINT_API GraphicsDataCacheStatistics final
+{
+   //! Number of elements held by the cache
+   size_t Elements { 0 };
+   //! Estimated number of bytes held by the elements
+   size_t Bytes { 0 };
+   //! Number of elements found in the cache during the lookups
+   uint64_t Hits { 0 };
+   //! Number of elements created during the lookups
+   uint64_t Misses { 0 };
+
+   //! Returns the ratio of hits to all the accessed elements, or 0 if there were no lookups
+   double GetHitRate() const noexcept;
+
+   GraphicsDataCacheStatistics&
+   operator+=(const GraphicsDataCacheStatistics& rhs) noexcept;
+};
+
+//! Enforces a process-wide memory budget over all the GraphicsDataCacheBase instances
+/*!
+ * Every cache registers itself with the governor and reports the memory held
+ * by its elements. Once the total exceeds the budget, the governor evicts
+ * elements from the caches that were least recently used. Elements used by the
+ * latest lookup of a cache are evicted only if that is not enough.
+ *
+ * Like the caches themselves, the governor must only be used from the main thread.
+ */
+class WAVE_TRACK_PAINT_API GraphicsDataCacheGovernor final
+{
+public:
+   //! Statistics of all the caches sharing the same owner (e. g. a clip)
+   struct OwnerStatistics final
+   {
+      const void* Owner { nullptr };
+      GraphicsDataCacheStatistics Statistics;
+   };
+
+   static GraphicsDataCacheGovernor& Get();
+
+   GraphicsDataCacheGovernor(const GraphicsDataCacheGovernor&) = delete;
+   GraphicsDataCacheGovernor& operator=(const GraphicsDataCacheGovernor&) = delete;
+
+   //! Sets the memory budget in bytes. Evicts the elements immediately if the budget is exceeded
+   void SetBudget(size_t bytes);
+   size_t GetBudget() const noexcept;
+
+   //! Estimated number of bytes held by all the caches
+   size_t GetTotalBytes() const noexcept;
+   bool IsOverBudget() const noexcept;
+
+   size_t GetCachesCount() const noexcept;
+
+   //! Statistics accumulated over all the registered caches
+   GraphicsDataCacheStatistics GetStatistics() const;
+   //! Statistics grouped by the cache owner, largest owners first
+   std::vector<OwnerStatistics> GetOwnerStatistics() const;
+
+private:
+   GraphicsDataCacheGovernor();
+
+   void Register(GraphicsDataCacheBase& cache);
+   void Unregister(GraphicsDataCacheBase& cache);
+
+   uint64_t NextAccessTick() noexcept;
+   void UpdateBytes(size_t oldBytes, size_t newBytes) noexcept;
+
+   //! Evicts the least recently used elements until the total fits the budget
+   void Enforce();
+
+   std::vector<GraphicsDataCacheBase*> mCaches;
+   // Helper vector used to sort the caches during the eviction
+   std::vector<GraphicsDataCacheBase*> mEvictionOrder;
+
+   size_t mBudget;
+   size_t mTotalBytes { 0 };
+   uint64_t mAccessTick { 0 };
+
+   friend class GraphicsDataCacheBase;
+};
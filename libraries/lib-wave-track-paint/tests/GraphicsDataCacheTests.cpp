@@ -10,11 +10,14 @@
 
 #include <catch2/catch.hpp>
 
+#include <memory>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <vector>
 
 #include "GraphicsDataCache.h"
+#include "GraphicsDataCacheGovernor.h"
 #include "ZoomInfo.h"
 
 namespace
@@ -35,6 +38,19 @@ struct CacheElement : GraphicsDataCacheElementBase
    GraphicsDataCacheKey Key;
 };
 
+struct SizedCacheElement : GraphicsDataCacheElementBase
+{
+   SizedCacheElement& operator=(GraphicsDataCacheKey)
+   {
+      return *this;
+   }
+
+   size_t GetMemorySize() const override
+   {
+      return 1024;
+   }
+};
+
 void CheckCacheElementLookup(GraphicsDataCache<CacheElement>& cache, const ZoomInfo& zoomInfo, double t0, double t1, size_t count)
 {
    auto range = cache.PerformLookup(zoomInfo, t0, t1);
@@ -117,3 +133,51 @@ TEST_CASE("graphics-data-cache", "")
       CheckCacheElementLookup(cache, info, t0, t1, itemsCount);
    }
 }
+
+TEST_CASE("graphics-data-cache-governor", "")
+{
+   auto& governor = GraphicsDataCacheGovernor::Get();
+
+   const auto initialBudget = governor.GetBudget();
+   const auto initialBytes = governor.GetTotalBytes();
+
+   constexpr size_t budget = 64 * 1024;
+   governor.SetBudget(initialBytes + budget);
+
+   ZoomInfo info(0.0, ZoomInfo::GetDefaultZoom());
+
+   using Cache = GraphicsDataCache<SizedCacheElement>;
+   std::vector<std::unique_ptr<Cache>> caches;
+
+   for (int i = 0; i < 32; ++i)
+   {
+      caches.push_back(std::make_unique<Cache>(
+         44100, []() { return std::make_unique<SizedCacheElement>(); }));
+
+      const auto range = caches.back()->PerformLookup(info, 0.0, 10.0);
+      REQUIRE(!range.empty());
+
+      REQUIRE(governor.GetTotalBytes() <= initialBytes + budget);
+      // The latest lookup is never evicted
+      REQUIRE(
+         caches.back()->GetStatistics().Bytes ==
+         caches.back()->GetStatistics().Elements * 1024);
+      REQUIRE(caches.back()->GetStatistics().Elements == range.size());
+   }
+
+   // Least recently used caches were evicted first
+   REQUIRE(caches.front()->GetStatistics().Elements == 0);
+
+   const auto statistics = caches.back()->GetStatistics();
+   REQUIRE(statistics.Hits == 0);
+   REQUIRE(statistics.Misses == statistics.Elements);
+
+   caches.back()->PerformLookup(info, 0.0, 10.0);
+   REQUIRE(caches.back()->GetStatistics().Hits == statistics.Elements);
+
+   caches.clear();
+
+   REQUIRE(governor.GetTotalBytes() == initialBytes);
+
+   governor.SetBudget(initialBudget);
+}
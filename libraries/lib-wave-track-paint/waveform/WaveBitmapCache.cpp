@@ -317,6 +317,11 @@ WaveBitmapCache::~WaveBitmapCache() = default;
 
 WaveBitmapCacheElement::~WaveBitmapCacheElement() = default;
 
+size_t WaveBitmapCacheElement::GetMemorySize() const
+{
+   return sizeof(WaveBitmapCacheElement) + Width() * Height() * 3;
+}
+
 
 WaveBitmapCache&
 WaveBitmapCache::SetPaintParameters(const WavePaintParameters& params)
@@ -363,6 +368,11 @@ void WaveBitmapCache::CheckCache(const ZoomInfo&, double, double)
    }
 }
 
+const void* WaveBitmapCache::GetOwner() const noexcept
+{
+   return &mWaveClip;
+}
+
 bool WaveBitmapCache::InitializeElement(
    const GraphicsDataCacheKey& key, WaveBitmapCacheElement& element)
 {
@@ -381,12 +391,31 @@ bool WaveBitmapCache::InitializeElement(
    auto sw = FrameStatistics::CreateStopwatch(
       FrameStatistics::SectionID::WaveBitmapCache);
 
-   const auto columnsCount = mLookupHelper->AvailableColumns;
-
    const auto defaultColor = Triplet(mPaintParamters.BlankColor);
 
    const auto height = static_cast<uint32_t>(mPaintParamters.Height);
 
+   // The data is being loaded in background and there is nothing to preview
+   // yet, show a blank element until it arrives
+   if (mLookupHelper->AvailableColumns == 0)
+   {
+      auto rowData = element.Allocate(CacheElementWidth, height);
+
+      for (size_t pixel = 0; pixel < CacheElementWidth * height; ++pixel)
+      {
+         *rowData++ = defaultColor.r;
+         *rowData++ = defaultColor.g;
+         *rowData++ = defaultColor.b;
+      }
+
+      element.AvailableColumns = 0;
+      element.IsComplete = false;
+
+      return true;
+   }
+
+   const auto columnsCount = mLookupHelper->AvailableColumns;
+
    auto rowData = element.Allocate(columnsCount, height);
 
    for (uint32_t row = 0; row < height; ++row)
@@ -34,6 +34,9 @@ public:
    virtual size_t Width() const = 0;
    virtual size_t Height() const = 0;
 
+   //! Accounts for the RGB image of Width() x Height() pixels
+   size_t GetMemorySize() const override;
+
    size_t AvailableColumns { 0 };
 };
 
@@ -55,6 +58,8 @@ private:
 
    void CheckCache(const ZoomInfo&, double, double) override;
 
+   const void* GetOwner() const noexcept override;
+
    struct LookupHelper;
 
    WavePaintParameters mPaintParamters;
@@ -12,6 +12,7 @@
 #include "FrameStatistics.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstring>
@@ -20,6 +21,7 @@
 #include "SampleFormat.h"
 #include "Sequence.h"
 #include "WaveClip.h"
+#include "WaveDataCacheWorkers.h"
 
 #include "RoundUpUnsafe.h"
 
@@ -72,6 +74,10 @@ public:
          FillBlocksFromAppendBuffer<256>(
             appendBuffer, appendedSamples, outBlock);
          break;
+      case WaveCacheSampleBlock::Type::MinMaxRMS4k:
+         FillBlocksFromAppendBuffer<4 * 1024>(
+            appendBuffer, appendedSamples, outBlock);
+         break;
       case WaveCacheSampleBlock::Type::MinMaxRMS64k:
          FillBlocksFromAppendBuffer<64 * 1024>(
             appendBuffer, appendedSamples, outBlock);
@@ -177,6 +183,63 @@ private:
    size_t mLastProcessedSample { 0 };
 };
 
+bool ReadBlock(
+   const SeqBlock& inputBlock, WaveCacheSampleBlock::Type dataType,
+   WaveCacheSampleBlock& outBlock)
+{
+   outBlock.FirstSample = inputBlock.start.as_long_long();
+   outBlock.NumSamples  = inputBlock.sb->GetSampleCount();
+
+   switch (dataType)
+   {
+   case WaveCacheSampleBlock::Type::Samples:
+   {
+      samplePtr ptr = static_cast<samplePtr>(
+         static_cast<void*>(outBlock.GetWritePointer(outBlock.NumSamples)));
+
+      inputBlock.sb->GetSamples(
+         ptr, floatSample, 0, outBlock.NumSamples, false);
+   }
+   break;
+   case WaveCacheSampleBlock::Type::MinMaxRMS256:
+   {
+      size_t framesCount = RoundUpUnsafe(outBlock.NumSamples, 256);
+
+      float* ptr =
+         static_cast<float*>(outBlock.GetWritePointer(framesCount * 3));
+
+      inputBlock.sb->GetSummary256(ptr, 0, framesCount);
+   }
+   break;
+   case WaveCacheSampleBlock::Type::MinMaxRMS4k:
+   {
+      size_t framesCount = RoundUpUnsafe(outBlock.NumSamples, 4 * 1024);
+
+      float* ptr =
+         static_cast<float*>(outBlock.GetWritePointer(framesCount * 3));
+
+      inputBlock.sb->GetSummary4k(ptr, 0, framesCount);
+   }
+   break;
+   case WaveCacheSampleBlock::Type::MinMaxRMS64k:
+   {
+      size_t framesCount = RoundUpUnsafe(outBlock.NumSamples, 64 * 1024);
+
+      float* ptr =
+         static_cast<float*>(outBlock.GetWritePointer(framesCount * 3));
+
+      inputBlock.sb->GetSummary64k(ptr, 0, framesCount);
+   }
+   break;
+   default:
+      return false;
+   }
+
+   outBlock.DataType = dataType;
+
+   return true;
+}
+
 WaveDataCache::DataProvider
 MakeDefaultDataProvider(const WaveClip& clip, int channelIndex)
 {
@@ -205,58 +268,157 @@ MakeDefaultDataProvider(const WaveClip& clip, int channelIndex)
       const auto blockIndex  = sequence->FindBlock(requiredSample);
       const auto& inputBlock = sequence->GetBlockArray()[blockIndex];
 
-      outBlock.FirstSample = inputBlock.start.as_long_long();
-      outBlock.NumSamples  = inputBlock.sb->GetSampleCount();
+      return ReadBlock(inputBlock, dataType, outBlock);
+   };
+}
 
-      switch (dataType)
-      {
-      case WaveCacheSampleBlock::Type::Samples:
+//! Fills the columns of an element, returns the number of processed samples
+template <typename Provider>
+size_t FillColumns(
+   const GraphicsDataCacheKey& key, size_t samplesPerColumn,
+   WaveCacheSampleBlock::Type blockType, Provider& provider,
+   WaveCacheSampleBlock& cachedBlock, WaveCacheElement::Columns& data,
+   size_t& availableColumns)
+{
+   int64_t firstSample = key.FirstSample;
+   size_t processedSamples = 0;
+
+   size_t columnIndex = 0;
+
+   for (; columnIndex < GraphicsDataCacheBase::CacheElementWidth; ++columnIndex)
+   {
+      WaveCacheSampleBlock::Summary summary;
+      size_t samplesLeft = samplesPerColumn;
+
+      while (samplesLeft != 0)
       {
-         samplePtr ptr = static_cast<samplePtr>(
-            static_cast<void*>(outBlock.GetWritePointer(outBlock.NumSamples)));
+         if (!cachedBlock.ContainsSample(firstSample))
+            if (!provider(firstSample, blockType, cachedBlock))
+               break;
+
+         summary = cachedBlock.GetSummary(firstSample, samplesLeft, summary);
 
-         inputBlock.sb->GetSamples(
-            ptr, floatSample, 0, outBlock.NumSamples, false);
+         samplesLeft -= summary.SamplesCount;
+         firstSample += summary.SamplesCount;
+         processedSamples += summary.SamplesCount;
       }
-      break;
-      case WaveCacheSampleBlock::Type::MinMaxRMS256:
+
+      if (summary.SamplesCount > 0)
       {
-         size_t framesCount = RoundUpUnsafe(outBlock.NumSamples, 256);
+         auto& column = data[columnIndex];
 
-         float* ptr =
-            static_cast<float*>(outBlock.GetWritePointer(framesCount * 3));
+         column.min = summary.Min;
+         column.max = summary.Max;
 
-         inputBlock.sb->GetSummary256(ptr, 0, framesCount);
+         column.rms = std::sqrt(summary.SquaresSum / summary.SumItemsCount);
       }
-      break;
-      case WaveCacheSampleBlock::Type::MinMaxRMS64k:
+
+      if (columnIndex > 0)
       {
-         size_t framesCount = RoundUpUnsafe(outBlock.NumSamples, 64 * 1024);
+         const auto prevColumn = data[columnIndex - 1];
+         auto& column = data[columnIndex];
+
+         bool updated = false;
+
+         if (prevColumn.min > column.max)
+         {
+            column.max = prevColumn.min;
+            updated    = true;
+         }
 
-         float* ptr =
-            static_cast<float*>(outBlock.GetWritePointer(framesCount * 3));
+         if (prevColumn.max < column.min)
+         {
+            column.min = prevColumn.max;
+            updated    = true;
+         }
 
-         inputBlock.sb->GetSummary64k(ptr, 0, framesCount);
+         if (updated)
+            column.rms = std::clamp(column.rms, column.min, column.max);
       }
-      break;
-      default:
-         return false;
+
+      if (samplesLeft != 0)
+      {
+         ++columnIndex;
+         break;
       }
+   }
 
-      outBlock.DataType = dataType;
+   availableColumns = columnIndex;
 
-      return true;
-   };
+   return processedSamples;
 }
 
 } // namespace
 
+//! Data needed to build an element on a worker thread, and the result
+struct WaveDataCacheRequest final
+{
+   GraphicsDataCacheKey Key;
+   size_t SamplesPerColumn { 0 };
+   WaveCacheSampleBlock::Type DataType { WaveCacheSampleBlock::Type::Samples };
+
+   //! Blocks of the sequence overlapping the element at the time of request
+   std::vector<SeqBlock> Blocks;
+   //! Length of the sequence at the time of request
+   int64_t SequenceSamples { 0 };
+
+   FrameStatistics::Timepoint RequestTime;
+
+   // Written by the worker before Done is set
+   WaveCacheElement::Columns Data;
+   size_t AvailableColumns { 0 };
+   size_t ProcessedSamples { 0 };
+
+   std::atomic<bool> Cancelled { false };
+   std::atomic<bool> Done { false };
+
+   //! Only accessed from the main thread
+   bool Consumed { false };
+
+   void Run()
+   {
+      if (!Cancelled.load(std::memory_order_relaxed))
+      {
+         auto provider = [this](
+                            int64_t requiredSample,
+                            WaveCacheSampleBlock::Type dataType,
+                            WaveCacheSampleBlock& outBlock)
+         {
+            auto it = std::upper_bound(
+               Blocks.begin(), Blocks.end(), requiredSample,
+               [](int64_t sample, const SeqBlock& block)
+               { return sample < block.start.as_long_long(); });
+
+            if (it == Blocks.begin())
+               return false;
+
+            --it;
+
+            if (requiredSample >=
+                it->start.as_long_long() + it->sb->GetSampleCount())
+               return false;
+
+            return ReadBlock(*it, dataType, outBlock);
+         };
+
+         WaveCacheSampleBlock cachedBlock;
+
+         ProcessedSamples = FillColumns(
+            Key, SamplesPerColumn, DataType, provider, cachedBlock, Data,
+            AvailableColumns);
+      }
+
+      Done.store(true, std::memory_order_release);
+   }
+};
+
 WaveDataCache::WaveDataCache(const WaveClip& waveClip, int channelIndex)
     : GraphicsDataCache<WaveCacheElement>(
          waveClip.GetRate() / waveClip.GetStretchRatio(),
          [] { return std::make_unique<WaveCacheElement>(); })
     , mProvider { MakeDefaultDataProvider(waveClip, channelIndex) }
     , mWaveClip { waveClip }
+    , mChannelIndex { channelIndex }
     , mStretchChangedSubscription {
        const_cast<WaveClip&>(waveClip)
           .Observer::Publisher<StretchRatioChange>::Subscribe(
@@ -268,96 +430,259 @@ WaveDataCache::WaveDataCache(const WaveClip& waveClip, int channelIndex)
 {
 }
 
+WaveDataCache& WaveDataCache::EnableBackgroundLoading(bool enable)
+{
+   mBackgroundLoading = enable;
+   return *this;
+}
+
+const void* WaveDataCache::GetOwner() const noexcept
+{
+   return &mWaveClip;
+}
+
 bool WaveDataCache::InitializeElement(
    const GraphicsDataCacheKey& key, WaveCacheElement& element)
 {
    auto sw = FrameStatistics::CreateStopwatch(
       FrameStatistics::SectionID::WaveDataCache);
 
-   element.AvailableColumns = 0;
-
-   int64_t firstSample = key.FirstSample;
+   if (element.BackgroundRequest)
+   {
+      if (const auto result = UpdateBackgroundLoading(element))
+         return *result;
+   }
 
    const size_t samplesPerColumn =
       static_cast<size_t>(std::max(0.0, GetScaledSampleRate() / key.PixelsPerSecond));
 
    const size_t elementSamplesCount =
       samplesPerColumn * WaveDataCache::CacheElementWidth;
-   size_t processedSamples = 0;
 
    const WaveCacheSampleBlock::Type blockType =
       samplesPerColumn >= 64 * 1024 ?
          WaveCacheSampleBlock::Type::MinMaxRMS64k :
+         samplesPerColumn >= 4 * 1024 ?
+         WaveCacheSampleBlock::Type::MinMaxRMS4k :
          (samplesPerColumn >= 256 ? WaveCacheSampleBlock::Type::MinMaxRMS256 :
                                     WaveCacheSampleBlock::Type::Samples);
 
+   // Reading the samples of a single element is fast enough, summaries
+   // of many blocks are read in background
+   if (
+      mBackgroundLoading && blockType != WaveCacheSampleBlock::Type::Samples &&
+      StartBackgroundLoading(key, samplesPerColumn, blockType, element))
+      return true;
+
+   element.AvailableColumns = 0;
+
    if (blockType != mCachedBlock.DataType)
       mCachedBlock.Reset();
 
-   size_t columnIndex = 0;
+   const auto processedSamples = FillColumns(
+      key, samplesPerColumn, blockType, mProvider, mCachedBlock, element.Data,
+      element.AvailableColumns);
+
+   element.IsComplete = processedSamples == elementSamplesCount;
+
+   return processedSamples != 0;
+}
+
+bool WaveDataCache::StartBackgroundLoading(
+   const GraphicsDataCacheKey& key, size_t samplesPerColumn,
+   WaveCacheSampleBlock::Type blockType, WaveCacheElement& element)
+{
+   const auto sequence = mWaveClip.GetSequence(mChannelIndex);
+   const auto sequenceSamples = sequence->GetNumSamples().as_long_long();
 
-   for (; columnIndex < WaveDataCache::CacheElementWidth; ++columnIndex)
+   const auto firstSample = key.FirstSample;
+   const auto lastSample = firstSample +
+      static_cast<int64_t>(samplesPerColumn * CacheElementWidth);
+
+   // The append buffer is owned by the main thread, so elements
+   // that need it are built synchronously
+   if (
+      firstSample < 0 || firstSample >= sequenceSamples ||
+      (lastSample > sequenceSamples &&
+       mWaveClip.GetAppendBufferLen(mChannelIndex) > 0))
+      return false;
+
+   auto request = std::make_shared<WaveDataCacheRequest>();
+
+   request->Key = key;
+   request->SamplesPerColumn = samplesPerColumn;
+   request->DataType = blockType;
+   request->SequenceSamples = sequenceSamples;
+
+   const auto& blocks = sequence->GetBlockArray();
+
+   for (auto index = static_cast<size_t>(sequence->FindBlock(firstSample));
+        index < blocks.size() && blocks[index].start.as_long_long() < lastSample;
+        ++index)
+      request->Blocks.push_back(blocks[index]);
+
+   request->RequestTime = FrameStatistics::Clock::now();
+
+   WaveDataCacheWorkers::Get().Enqueue([request] { request->Run(); });
+
+   element.BackgroundRequest = std::move(request);
+   element.IsComplete = false;
+
+   // Keep the data of a previous request if there is one
+   if (element.AvailableColumns == 0)
+      FillPreview(key, samplesPerColumn, element);
+
+   return true;
+}
+
+std::optional<bool>
+WaveDataCache::UpdateBackgroundLoading(WaveCacheElement& element)
+{
+   auto& request = *element.BackgroundRequest;
+
+   if (!request.Done.load(std::memory_order_acquire))
    {
-      WaveCacheSampleBlock::Summary summary;
-      size_t samplesLeft = samplesPerColumn;
+      // Keep showing the preview until the data arrives
+      element.IsComplete = false;
+      return true;
+   }
 
-      while (samplesLeft != 0)
-      {
-         if (!mCachedBlock.ContainsSample(firstSample))
-            if (!mProvider(firstSample, blockType, mCachedBlock))
-               break;
+   if (!request.Consumed)
+   {
+      FrameStatistics::AddEvent(
+         FrameStatistics::SectionID::WaveDataCacheBackground,
+         FrameStatistics::Clock::now() - request.RequestTime);
 
-         summary = mCachedBlock.GetSummary(firstSample, samplesLeft, summary);
+      request.Consumed = true;
+      // Release the sample blocks on the main thread
+      request.Blocks = {};
 
-         samplesLeft -= summary.SamplesCount;
-         firstSample += summary.SamplesCount;
-         processedSamples += summary.SamplesCount;
-      }
+      element.Data = request.Data;
+      element.AvailableColumns = request.AvailableColumns;
+      element.IsComplete = request.ProcessedSamples ==
+                           request.SamplesPerColumn * CacheElementWidth;
 
-      if (summary.SamplesCount > 0)
-      {
-         auto& column = element.Data[columnIndex];
+      return request.ProcessedSamples != 0;
+   }
 
-         column.min = summary.Min;
-         column.max = summary.Max;
+   // An element at the end of the clip is never complete.  Load it again
+   // only if the sequence has grown since
+   const auto sequenceSamples =
+      mWaveClip.GetSequence(mChannelIndex)->GetNumSamples().as_long_long();
 
-         column.rms = std::sqrt(summary.SquaresSum / summary.SumItemsCount);
-      }
+   if (
+      request.SequenceSamples == sequenceSamples &&
+      mWaveClip.GetAppendBufferLen(mChannelIndex) == 0)
+      return element.AvailableColumns != 0;
 
-      if (columnIndex > 0)
+   element.BackgroundRequest.reset();
+
+   return {};
+}
+
+void WaveDataCache::FillPreview(
+   const GraphicsDataCacheKey& key, size_t samplesPerColumn,
+   WaveCacheElement& element) const
+{
+   struct Source final
+   {
+      int64_t FirstSample;
+      size_t SamplesPerColumn;
+      const WaveCacheElement* Element;
+   };
+
+   std::vector<Source> sources;
+
+   ForEachElement(
+      [&](const GraphicsDataCacheKey& sourceKey,
+          const GraphicsDataCacheElementBase& sourceElement)
+      {
+         const auto& waveElement =
+            static_cast<const WaveCacheElement&>(sourceElement);
+
+         // Only use the data that was really loaded
+         if (
+            &waveElement == &element || waveElement.AvailableColumns == 0 ||
+            (waveElement.BackgroundRequest &&
+             !waveElement.BackgroundRequest->Consumed))
+            return;
+
+         const auto sourceSamplesPerColumn = static_cast<size_t>(std::max(
+            0.0, GetScaledSampleRate() / sourceKey.PixelsPerSecond));
+
+         if (sourceSamplesPerColumn == 0)
+            return;
+
+         sources.push_back(
+            { sourceKey.FirstSample, sourceSamplesPerColumn, &waveElement });
+      });
+
+   // Prefer the closest lower resolution, then the closest higher one
+   std::sort(
+      sources.begin(), sources.end(),
+      [samplesPerColumn](const Source& lhs, const Source& rhs)
       {
-         const auto prevColumn = element.Data[columnIndex - 1];
-         auto& column = element.Data[columnIndex];
+         const bool lhsCoarser = lhs.SamplesPerColumn >= samplesPerColumn;
+         const bool rhsCoarser = rhs.SamplesPerColumn >= samplesPerColumn;
 
-         bool updated = false;
+         if (lhsCoarser != rhsCoarser)
+            return lhsCoarser;
 
-         if (prevColumn.min > column.max)
-         {
-            column.max = prevColumn.min;
-            updated    = true;
-         }
+         return lhsCoarser ? lhs.SamplesPerColumn < rhs.SamplesPerColumn :
+                             lhs.SamplesPerColumn > rhs.SamplesPerColumn;
+      });
 
-         if (prevColumn.max < column.min)
+   size_t columnIndex = 0;
+
+   for (; columnIndex < CacheElementWidth; ++columnIndex)
+   {
+      const int64_t firstSample =
+         key.FirstSample +
+         static_cast<int64_t>(columnIndex * samplesPerColumn);
+      const int64_t lastSample =
+         firstSample + static_cast<int64_t>(samplesPerColumn);
+
+      const auto source = std::find_if(
+         sources.begin(), sources.end(),
+         [firstSample](const Source& candidate)
          {
-            column.min = prevColumn.max;
-            updated    = true;
-         }
+            return firstSample >= candidate.FirstSample &&
+                   firstSample < candidate.FirstSample +
+                                    static_cast<int64_t>(
+                                       candidate.SamplesPerColumn *
+                                       candidate.Element->AvailableColumns);
+         });
+
+      if (source == sources.end())
+         break;
 
-         if (updated)
-            column.rms = std::clamp(column.rms, column.min, column.max);
-      }
+      const auto from =
+         static_cast<size_t>(firstSample - source->FirstSample) /
+         source->SamplesPerColumn;
+      const auto to = std::clamp<size_t>(
+         RoundUpUnsafe(
+            static_cast<size_t>(lastSample - source->FirstSample),
+            source->SamplesPerColumn),
+         from + 1, source->Element->AvailableColumns);
 
-      if (samplesLeft != 0)
+      auto column = source->Element->Data[from];
+      double squaresSum = double(column.rms) * column.rms;
+
+      for (auto index = from + 1; index < to; ++index)
       {
-         ++columnIndex;
-         break;
+         const auto sourceColumn = source->Element->Data[index];
+
+         column.min = std::min(column.min, sourceColumn.min);
+         column.max = std::max(column.max, sourceColumn.max);
+         squaresSum += double(sourceColumn.rms) * sourceColumn.rms;
       }
+
+      column.rms = static_cast<float>(std::sqrt(squaresSum / (to - from)));
+
+      element.Data[columnIndex] = column;
    }
 
    element.AvailableColumns = columnIndex;
-   element.IsComplete       = processedSamples == elementSamplesCount;
-
-   return processedSamples != 0;
 }
 
 bool WaveCacheSampleBlock::ContainsSample(int64_t sampleIndex) const noexcept
@@ -449,6 +774,9 @@ WaveCacheSampleBlock::Summary WaveCacheSampleBlock::GetSummary(
    case WaveCacheSampleBlock::Type::MinMaxRMS256:
       processBlock<256>(data, from, samplesCount, summary);
       break;
+   case WaveCacheSampleBlock::Type::MinMaxRMS4k:
+      processBlock<4 * 1024>(data, from, samplesCount, summary);
+      break;
    case WaveCacheSampleBlock::Type::MinMaxRMS64k:
       processBlock<64 * 1024>(data, from, samplesCount, summary);
       break;
@@ -459,6 +787,20 @@ WaveCacheSampleBlock::Summary WaveCacheSampleBlock::GetSummary(
    return summary;
 }
 
+void WaveCacheElement::Dispose()
+{
+   if (BackgroundRequest)
+      BackgroundRequest->Cancelled.store(true, std::memory_order_relaxed);
+
+   BackgroundRequest.reset();
+   AvailableColumns = 0;
+}
+
+size_t WaveCacheElement::GetMemorySize() const
+{
+   return sizeof(WaveCacheElement);
+}
+
 void WaveCacheElement::Smooth(GraphicsDataCacheElementBase* prevElement)
 {
    if (prevElement == nullptr||prevElement->AwaitsEviction || AvailableColumns == 0)
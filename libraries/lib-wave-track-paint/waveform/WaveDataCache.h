@@ -12,7 +12,9 @@
 
 #include <array>
 #include <cstdint>
+#include <memory>
 #include <numeric>
+#include <optional>
 #include <vector>
 #include <functional>
 
@@ -21,6 +23,7 @@
 #include "Observer.h"
 
 class WaveClip;
+struct WaveDataCacheRequest;
 
 //! Helper structure used to transfer the data between the data and graphics layers
 struct WAVE_TRACK_PAINT_API WaveCacheSampleBlock final
@@ -37,7 +40,12 @@ struct WAVE_TRACK_PAINT_API WaveCacheSampleBlock final
       MinMaxRMS256,
       /*!
        * Each element of the resulting array is a tuple (min, max, rms)
-       * calculated over 256 samples.
+       * calculated over 4096 samples.
+       */
+      MinMaxRMS4k,
+      /*!
+       * Each element of the resulting array is a tuple (min, max, rms)
+       * calculated over 65536 samples.
        */
       MinMaxRMS64k,
    };
@@ -85,7 +93,12 @@ struct WAVE_TRACK_PAINT_API WaveCacheElement final : GraphicsDataCacheElementBas
    Columns Data;
    size_t AvailableColumns { 0 };
 
+   //! The last request to build the data of this element in background
+   std::shared_ptr<WaveDataCacheRequest> BackgroundRequest;
+
+   void Dispose() override;
    void Smooth(GraphicsDataCacheElementBase* prevElement) override;
+   size_t GetMemorySize() const override;
 };
 
 //! Cache that contains the waveform data
@@ -97,14 +110,34 @@ public:
 
    WaveDataCache(const WaveClip& waveClip, int channelIndex);
 
+   //! Build the summary based elements using WaveDataCacheWorkers
+   /*!
+    * While the data is being loaded, the element is incomplete and is filled
+    * from the elements already cached for other zoom levels, if any.
+    */
+   WaveDataCache& EnableBackgroundLoading(bool enable);
+
 private:
    bool InitializeElement(
       const GraphicsDataCacheKey& key, WaveCacheElement& element) override;
 
+   const void* GetOwner() const noexcept override;
+
+   bool StartBackgroundLoading(
+      const GraphicsDataCacheKey& key, size_t samplesPerColumn,
+      WaveCacheSampleBlock::Type blockType, WaveCacheElement& element);
+   std::optional<bool> UpdateBackgroundLoading(WaveCacheElement& element);
+   void FillPreview(
+      const GraphicsDataCacheKey& key, size_t samplesPerColumn,
+      WaveCacheElement& element) const;
+
    DataProvider mProvider;
 
    WaveCacheSampleBlock mCachedBlock;
 
    const WaveClip& mWaveClip;
+   const int mChannelIndex;
+   bool mBackgroundLoading { false };
+
    Observer::Subscription mStretchChangedSubscription;
 };
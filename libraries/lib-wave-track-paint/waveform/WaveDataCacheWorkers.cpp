@@ -0,0 +1,132 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WaveDataCacheWorkers.cpp
+
+**********************************************************************/
+#include "WaveDataCacheWorkers.h"
+
+#include <algorithm>
+
+#include "BasicUI.h"
+
+WaveDataCacheWorkers& WaveDataCacheWorkers::Get()
+{
+   // Owned by a shared pointer, so that deliveries queued with
+   // BasicUI::CallAfter can tell whether the workers still exist
+   static const std::shared_ptr<WaveDataCacheWorkers> workers {
+      new WaveDataCacheWorkers
+   };
+   return *workers;
+}
+
+WaveDataCacheWorkers::WaveDataCacheWorkers() = default;
+
+WaveDataCacheWorkers::~WaveDataCacheWorkers()
+{
+   {
+      std::lock_guard lock { mMutex };
+      mStopping = true;
+   }
+
+   mCondition.notify_all();
+
+   for (auto& thread : mThreads)
+      thread.join();
+}
+
+void WaveDataCacheWorkers::Enqueue(Task task)
+{
+   {
+      std::lock_guard lock { mMutex };
+
+      // Threads are only started once something has to be loaded
+      if (mThreads.empty())
+      {
+         const auto threadsCount =
+            std::max(1u, std::thread::hardware_concurrency() / 2);
+
+         for (unsigned i = 0; i < threadsCount; ++i)
+            mThreads.emplace_back([this] { WorkerThread(); });
+      }
+
+      mPendingTasks.push_back(std::move(task));
+   }
+
+   mCondition.notify_one();
+}
+
+size_t WaveDataCacheWorkers::GetQueueDepth() const
+{
+   std::lock_guard lock { mMutex };
+   return mPendingTasks.size();
+}
+
+void WaveDataCacheWorkers::Drain()
+{
+   {
+      std::unique_lock lock { mMutex };
+      mIdleCondition.wait(
+         lock, [this] { return mPendingTasks.empty() && mRunningTasks == 0; });
+   }
+
+   DeliverFinished();
+}
+
+void WaveDataCacheWorkers::WorkerThread()
+{
+   while (true)
+   {
+      Task task;
+
+      {
+         std::unique_lock lock { mMutex };
+
+         mCondition.wait(
+            lock, [this] { return mStopping || !mPendingTasks.empty(); });
+
+         if (mStopping)
+            return;
+
+         task = std::move(mPendingTasks.back());
+         mPendingTasks.pop_back();
+         ++mRunningTasks;
+      }
+
+      task();
+
+      std::lock_guard lock { mMutex };
+
+      mFinishedTasks.push_back(std::move(task));
+      --mRunningTasks;
+
+      if (!mNotificationPending)
+      {
+         mNotificationPending = true;
+         BasicUI::CallAfter([wThis = weak_from_this()] {
+            if (auto pThis = wThis.lock())
+               pThis->DeliverFinished();
+         });
+      }
+
+      if (mPendingTasks.empty() && mRunningTasks == 0)
+         mIdleCondition.notify_all();
+   }
+}
+
+void WaveDataCacheWorkers::DeliverFinished()
+{
+   std::vector<Task> finishedTasks;
+
+   {
+      std::lock_guard lock { mMutex };
+      std::swap(finishedTasks, mFinishedTasks);
+      mNotificationPending = false;
+   }
+
+   finishedTasks.clear();
+
+   Publish({});
+}
@@ -0,0 +1,76 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WaveDataCacheWorkers.h
+
+**********************************************************************/
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Observer.h"
+
+//! Message published on the main thread when background tasks have finished
+struct WaveDataCacheWorkersMessage final
+{
+};
+
+//! A pool of threads that builds the wave data cache elements off the main thread
+/*!
+ * Tasks are served in the reverse order, so that the elements requested for
+ * the latest frame are ready first. Finished tasks are destroyed on the main
+ * thread, so that the objects they hold (e. g. sample blocks) are never
+ * released by a worker.
+ */
+class WAVE_TRACK_PAINT_API WaveDataCacheWorkers final :
+    public Observer::Publisher<WaveDataCacheWorkersMessage>,
+    public std::enable_shared_from_this<WaveDataCacheWorkers>
+{
+public:
+   using Task = std::function<void()>;
+
+   static WaveDataCacheWorkers& Get();
+
+   ~WaveDataCacheWorkers();
+
+   //! Schedules the task. Must be called from the main thread
+   void Enqueue(Task task);
+
+   //! Number of the tasks waiting for a worker
+   size_t GetQueueDepth() const;
+
+   //! Waits for all scheduled tasks, then destroys them. Must be called from
+   //! the main thread
+   /*!
+    * Called before a project closes its database, so that no task still
+    * holds its sample blocks. Tasks of destroyed cache elements are
+    * cancelled and finish at once.
+    */
+   void Drain();
+
+private:
+   WaveDataCacheWorkers();
+
+   void WorkerThread();
+   void DeliverFinished();
+
+   mutable std::mutex mMutex;
+   std::condition_variable mCondition;
+   std::condition_variable mIdleCondition;
+
+   std::vector<Task> mPendingTasks;
+   std::vector<Task> mFinishedTasks;
+
+   std::vector<std::thread> mThreads;
+
+   size_t mRunningTasks { 0 };
+   bool mNotificationPending { false };
+   bool mStopping { false };
+};
@@ -13,6 +13,11 @@ SampleBlock.cpp
 
 #include <wx/defs.h>
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
 SampleBlockFactoryPtr SampleBlockFactory::New( AudacityProject &project )
 {
    auto &factory = Factory::Get();
@@ -68,6 +73,65 @@ SampleBlockPtr SampleBlockFactory::CreateFromId(
 
 SampleBlock::~SampleBlock() = default;
 
+bool SampleBlock::GetSummary4k(
+   float *dest, size_t frameoffset, size_t numframes)
+{
+   constexpr size_t framesRatio = 4096 / 256;
+
+   std::vector<float> summary256(3 * framesRatio * numframes);
+   const auto result = GetSummary256(
+      summary256.data(), frameoffset * framesRatio, framesRatio * numframes);
+
+   Summary4kFromSummary256(summary256.data(), frameoffset * 4096,
+      GetSampleCount(), dest, numframes);
+
+   return result;
+}
+
+void SampleBlock::Summary4kFromSummary256(const float *summary256,
+   size_t firstSample, size_t sampleCount, float *dest, size_t numframes)
+{
+   constexpr size_t framesRatio = 4096 / 256;
+
+   for (size_t frame = 0; frame < numframes; ++frame)
+   {
+      float min = FLT_MAX;
+      float max = -FLT_MAX;
+      double sumsq = 0.0;
+      size_t count = 0;
+
+      for (size_t i = 0; i < framesRatio; ++i)
+      {
+         const auto index = frame * framesRatio + i;
+         const auto start = firstSample + index * 256;
+
+         if (start >= sampleCount)
+            break;
+
+         const auto frameSamples = std::min<size_t>(256, sampleCount - start);
+         const auto src = summary256 + 3 * index;
+
+         min = std::min(min, src[0]);
+         max = std::max(max, src[1]);
+         sumsq += double(src[2]) * src[2] * frameSamples;
+         count += frameSamples;
+      }
+
+      const auto dst = dest + 3 * frame;
+
+      if (count == 0)
+      {
+         dst[0] = dst[1] = dst[2] = 0.0f;
+      }
+      else
+      {
+         dst[0] = min;
+         dst[1] = max;
+         dst[2] = static_cast<float>(std::sqrt(sumsq / count));
+      }
+   }
+}
+
 size_t SampleBlock::GetSamples(samplePtr dest,
                    sampleFormat destformat,
                    size_t sampleoffset,
@@ -73,6 +73,21 @@ public:
    //! Non-throwing, should fill with zeroes on failure
    virtual bool
       GetSummary64k(float *dest, size_t frameoffset, size_t numframes) = 0;
+   //! Non-throwing, should fill with zeroes on failure
+   /*! Default implementation aggregates the 256 summaries */
+   virtual bool
+      GetSummary4k(float *dest, size_t frameoffset, size_t numframes);
+
+   //! Aggregates 16 frames of the 256 summary into each frame of the 4k summary
+   /*!
+    @param summary256 16 * numframes frames of min, max and rms
+    @param firstSample index in the block of the first sample summarized
+    @param sampleCount number of samples in the block, frames past it are
+    zeroes and the rms of the last frame is weighted by its length
+    */
+   static void Summary4kFromSummary256(const float *summary256,
+      size_t firstSample, size_t sampleCount,
+      float *dest, size_t numframes);
 
    /// Gets extreme values for the specified region
    // If !mayThrow and there is an error, ignores it and returns zeroes.
@@ -87,6 +102,10 @@ public:
 
    virtual size_t GetSpaceUsage() const = 0;
 
+   //! Like GetSpaceUsage(), but computed from the block's sizes without
+   //! querying the storage; cheap enough to call for every block of a state
+   virtual size_t EstimateSpaceUsage() const = 0;
+
    virtual void SaveXML(XMLWriter &xmlFile) = 0;
 
 protected:
@@ -387,6 +387,79 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
    return sqrt(sumsq / length.as_double() );
 }
 
+bool Sequence::Scan(sampleCount start, sampleCount len,
+   const Classifier &classify, const ScanVisitor &visit, bool mayThrow) const
+{
+   if (len <= 0 || mBlock.empty())
+      return true;
+
+   constexpr size_t frameSize = 256;
+   const auto end = start + len;
+   std::vector<float> summary;
+
+   for (size_t b = FindBlock(start);
+      b < mBlock.size() && mBlock[b].start < end; ++b) {
+      const SeqBlock &theBlock = mBlock[b];
+      const auto &sb = theBlock.sb;
+
+      // Offsets in the block of the part of it in the range
+      const auto first = (std::max(start, theBlock.start) - theBlock.start)
+         .as_size_t();
+      const auto last =
+         limitSampleBufferSize(sb->GetSampleCount(), end - theBlock.start);
+
+      // The summary of the whole block is in memory already
+      const auto verdict = classify(sb->GetMinMaxRMS(mayThrow));
+      if (verdict != Verdict::Some) {
+         if (!visit(theBlock.start + first, last - first, nullptr, verdict))
+            return false;
+         continue;
+      }
+
+      // Else classify the frames of the 256 sample summary, and read the
+      // samples of the block only if one of the frames is undecided
+      const auto frame0 = first / frameSize;
+      const auto nFrames = (last + frameSize - 1) / frameSize - frame0;
+      summary.resize(3 * nFrames);
+      const bool haveSummary =
+         sb->GetSummary256(summary.data(), frame0, nFrames);
+
+      BlockSampleView view;
+      const auto visitPiece = [&](size_t pieceStart, size_t pieceEnd,
+         Verdict pieceVerdict) {
+         const float *samples = nullptr;
+         if (pieceVerdict == Verdict::Some) {
+            if (!view)
+               view = sb->GetFloatSampleView(mayThrow);
+            samples = view->data() + pieceStart;
+         }
+         return visit(theBlock.start + pieceStart, pieceEnd - pieceStart,
+            samples, pieceVerdict);
+      };
+
+      // Consecutive frames with the same verdict make one piece
+      auto pieceStart = first;
+      auto pieceVerdict = Verdict::Some;
+      for (size_t ii = 0; ii < nFrames; ++ii) {
+         auto frameVerdict = Verdict::Some;
+         if (haveSummary) {
+            const auto frame = summary.data() + 3 * ii;
+            frameVerdict = classify(MinMaxRMS{ frame[0], frame[1], frame[2] });
+         }
+         const auto frameStart = std::max(first, (frame0 + ii) * frameSize);
+         if (ii > 0 && frameVerdict != pieceVerdict) {
+            if (!visitPiece(pieceStart, frameStart, pieceVerdict))
+               return false;
+            pieceStart = frameStart;
+         }
+         pieceVerdict = frameVerdict;
+      }
+      if (!visitPiece(pieceStart, last, pieceVerdict))
+         return false;
+   }
+   return true;
+}
+
 // Must pass in the correct factory for the result.  If it's not the same
 // as in this, then block contents must be copied.
 std::unique_ptr<Sequence> Sequence::Copy( const SampleBlockFactoryPtr &pFactory,
@@ -1031,12 +1104,16 @@ void Sequence::WriteXML(XMLWriter &xmlFile) const
          auto sMsg =
             XO("Sequence has block file exceeding maximum %s samples per block.\nTruncating to this maximum length.")
                .Format( Internat::ToString(((wxLongLong)mMaxSamples).ToDouble(), 0) );
-         ShowMessageBox(
-            sMsg,
-            MessageBoxOptions{}
-               .Caption(XO("Warning - Truncating Overlong Block File"))
-               .IconStyle(Icon::Warning)
-               .ButtonStyle(Button::Ok));
+         // Projects may be written on worker threads, so defer the message
+         // to the main thread
+         CallAfter([sMsg]{
+            ShowMessageBox(
+               sMsg,
+               MessageBoxOptions{}
+                  .Caption(XO("Warning - Truncating Overlong Block File"))
+                  .IconStyle(Icon::Warning)
+                  .ButtonStyle(Button::Ok));
+         });
          wxLogWarning(sMsg.Translation()); //Debug?
 //         bb.sb->SetLength(mMaxSamples);
       }
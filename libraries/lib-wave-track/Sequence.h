@@ -21,6 +21,7 @@
 #include "SampleCount.h"
 #include "AudioSegmentSampleView.h"
 
+class MinMaxRMS;
 class SampleBlock;
 class SampleBlockFactory;
 using SampleBlockFactoryPtr = std::shared_ptr<SampleBlockFactory>;
@@ -215,6 +216,40 @@ class WAVE_TRACK_API Sequence final : public XMLTagHandler{
       sampleCount start, sampleCount len, bool mayThrow) const;
    float GetRMS(sampleCount start, sampleCount len, bool mayThrow) const;
 
+   //! What the summary of some samples proves about a test of each sample
+   enum class Verdict {
+      None, //!< No sample passes the test
+      All, //!< Every sample passes the test
+      Some, //!< The samples must be examined
+   };
+
+   //! Decides a verdict from the minimum, maximum and RMS of some samples
+   /*!
+    The verdict is also applied to parts of those samples, so it must be Some
+    unless it holds for every part
+    */
+   using Classifier = std::function<Verdict(const MinMaxRMS &summary)>;
+
+   //! Receives consecutive pieces of the scanned range
+   /*!
+    @param samples the float samples of the piece if verdict is Some, else null
+    @return false to stop the scan
+    */
+   using ScanVisitor = std::function<bool(sampleCount start, size_t len,
+      const float *samples, Verdict verdict)>;
+
+   //! Visits a range in order, deciding whole blocks from their summaries,
+   //! then frames of their 256 sample summaries, and giving samples only for
+   //! frames that remain undecided
+   /*!
+    Samples are given in place from the cache of each block, and are read only
+    for blocks that contain an undecided frame.
+
+    @return false if the visitor stopped the scan
+    */
+   bool Scan(sampleCount start, sampleCount len, const Classifier &classify,
+      const ScanVisitor &visit, bool mayThrow) const;
+
    //
    // Getting block size and alignment information
    //
@@ -0,0 +1,46 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SequenceStftSource.cpp
+
+**********************************************************************/
+#include "SequenceStftSource.h"
+
+#include <cassert>
+
+#include "SampleBlock.h"
+#include "Sequence.h"
+
+SequenceStftSource::SequenceStftSource(const Sequence& sequence, bool mayThrow)
+    : mSequence { sequence }
+    , mMayThrow { mayThrow }
+{
+}
+
+SequenceStftSource::~SequenceStftSource() = default;
+
+long long SequenceStftSource::GetSampleCount() const
+{
+   return mSequence.GetNumSamples().as_long_long();
+}
+
+size_t SequenceStftSource::GetSamples(long long start, const float*& samples)
+{
+   assert(0 <= start && start < GetSampleCount());
+
+   // Consecutive frames overlap, so usually the block is the same as before
+   if (
+      !mBlockView || start < mBlockStart ||
+      start >= mBlockStart + static_cast<long long>(mBlockView->size()))
+   {
+      const auto& block = mSequence.GetBlockArray()[mSequence.FindBlock(start)];
+      mBlockView = block.sb->GetFloatSampleView(mMayThrow);
+      mBlockStart = block.start.as_long_long();
+   }
+
+   const auto offset = static_cast<size_t>(start - mBlockStart);
+   samples = mBlockView->data() + offset;
+   return mBlockView->size() - offset;
+}
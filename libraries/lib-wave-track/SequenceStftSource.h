@@ -0,0 +1,45 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SequenceStftSource.h
+  @brief Feeds Stft with the samples of a Sequence, block by block
+
+**********************************************************************/
+#ifndef __AUDACITY_SEQUENCE_STFT_SOURCE__
+#define __AUDACITY_SEQUENCE_STFT_SOURCE__
+
+#include "AudioSegmentSampleView.h" // BlockSampleView
+#include "Stft.h"
+
+class Sequence;
+
+//! Gives Stft the float samples cached by the blocks of a Sequence, in place
+/*!
+ A frame spanning several blocks is windowed piece by piece, so the samples are
+ not gathered into a buffer first.
+
+ Sources are cheap; make one for each thread reading the sequence.
+ */
+class WAVE_TRACK_API SequenceStftSource final : public StftSampleSource
+{
+public:
+   //! @param mayThrow if false, the samples of the blocks failing to be read
+   //! are zeroes
+   explicit SequenceStftSource(const Sequence& sequence, bool mayThrow = false);
+   ~SequenceStftSource() override;
+
+   long long GetSampleCount() const override;
+   size_t GetSamples(long long start, const float*& samples) override;
+
+private:
+   const Sequence& mSequence;
+   const bool mMayThrow;
+
+   //! The samples of the block read last, which begins at mBlockStart
+   BlockSampleView mBlockView;
+   long long mBlockStart { 0 };
+};
+
+#endif
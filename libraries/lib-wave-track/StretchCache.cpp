@@ -0,0 +1,475 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  StretchCache.cpp
+
+**********************************************************************/
+#include "StretchCache.h"
+
+#include "AudioSegmentFactory.h"
+#include "BasicUI.h"
+#include "Prefs.h"
+#include "SampleBlock.h"
+#include "Sequence.h"
+#include "StretchRenderer.h"
+#include "WaveClip.h"
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+
+IntSetting StretchCacheBudget{ L"/TimeAndPitch/StretchCacheBudget", 256 };
+
+namespace
+{
+constexpr size_t Megabyte = 1024 * 1024;
+
+// Long enough for the rendering to cost much more than the hand-overs to the
+// main thread
+constexpr size_t blockSize = 1 << 16;
+
+// How many contents played once without a copy are remembered
+constexpr size_t maxMisses = 32;
+
+size_t GetBudget()
+{
+   return static_cast<size_t>(std::max(0, StretchCacheBudget.Read())) *
+          Megabyte;
+}
+
+size_t GetRenderedBytes(const WaveClip& clip)
+{
+   return static_cast<size_t>(
+             clip.GetVisibleSampleCount().as_double() *
+             clip.GetStretchRatio()) *
+          clip.NChannels() * SAMPLE_SIZE(floatSample);
+}
+
+using BlockRefs = std::vector<std::weak_ptr<SampleBlock>>;
+
+bool Expired(const BlockRefs& blocks)
+{
+   return std::any_of(blocks.begin(), blocks.end(),
+      [](const std::weak_ptr<SampleBlock>& wBlock) {
+         return wBlock.expired();
+      });
+}
+
+//! Not in use by playback, which can only get another reference with the
+//! lock
+bool Unused(const std::shared_ptr<const WaveClip>& pClip)
+{
+   return pClip.use_count() == 1;
+}
+
+//! Let playback and Mixer read the copies
+AudioSegmentFactory::RenderedClip::Scope installer{
+   [](const std::shared_ptr<const ClipInterface>& pClip)
+      -> std::shared_ptr<const ClipInterface>
+   {
+      if (const auto pWaveClip =
+             std::dynamic_pointer_cast<const WaveClip>(pClip))
+         return StretchCache::Get().Find(pWaveClip);
+      return nullptr;
+   }
+};
+} // namespace
+
+struct StretchCache::Key
+{
+   double stretchRatio;
+   int centShift;
+   PitchAndSpeedPreset preset;
+   int rate;
+   double trimLeft;
+   double trimRight;
+   //! Start and id of each block, the channels one after the other
+   std::vector<std::pair<long long, SampleBlockID>> blocks;
+
+   //! Null if the clip is being recorded
+   /*! @param pRefs if not null, receives the blocks of the clip */
+   static std::optional<Key> Make(const WaveClip& clip, BlockRefs* pRefs)
+   {
+      Key key{ clip.GetStretchRatio(), clip.GetCentShift(),
+         clip.GetPitchAndSpeedPreset(), clip.GetRate(), clip.GetTrimLeft(),
+         clip.GetTrimRight() };
+      for (size_t ii = 0; ii < clip.NChannels(); ++ii)
+      {
+         const auto pSequence = clip.GetSequence(ii);
+         if (pSequence->GetAppendBufferLen() > 0)
+            return {};
+         for (const auto& block : pSequence->GetBlockArray())
+         {
+            key.blocks.emplace_back(
+               block.start.as_long_long(), block.sb->GetBlockID());
+            if (pRefs)
+               pRefs->push_back(block.sb);
+         }
+         // Separate the channels
+         key.blocks.emplace_back(-1, 0);
+      }
+      return key;
+   }
+
+   bool operator==(const Key& other) const
+   {
+      return stretchRatio == other.stretchRatio &&
+             centShift == other.centShift && preset == other.preset &&
+             rate == other.rate && trimLeft == other.trimLeft &&
+             trimRight == other.trimRight && blocks == other.blocks;
+   }
+};
+
+struct StretchCache::Entry
+{
+   Key key;
+   //! Expire when the contents can no longer be played, and their ids may be
+   //! reused
+   BlockRefs sources;
+   std::shared_ptr<const WaveClip> pRendered;
+   size_t bytes;
+};
+
+struct StretchCache::Job
+{
+   Key key;
+   BlockRefs sources;
+   //! Shares the sample blocks of the clip, but not its later edits
+   std::shared_ptr<WaveClip> pSource;
+   std::unique_ptr<StretchRenderer> pRenderer;
+   //! Ids of the blocks of the copy that were published
+   std::unordered_set<SampleBlockID> written;
+   //! Whether the main thread took the last block rendered
+   bool appended{ false };
+};
+
+StretchCache& StretchCache::Get()
+{
+   static StretchCache cache;
+   return cache;
+}
+
+StretchCache::StretchCache() = default;
+
+StretchCache::~StretchCache()
+{
+   {
+      std::lock_guard lock{ mMutex };
+      mStopping = true;
+   }
+   mCondition.notify_all();
+   if (mThread.joinable())
+      mThread.join();
+}
+
+std::shared_ptr<const WaveClip>
+StretchCache::Find(const std::shared_ptr<const WaveClip>& pClip)
+{
+   if (!pClip->HasPitchOrSpeed())
+      return nullptr;
+   auto key = Key::Make(*pClip, nullptr);
+   if (!key)
+      return nullptr;
+   {
+      std::lock_guard lock{ mMutex };
+      const auto iter = std::find_if(
+         mEntries.begin(), mEntries.end(), [&](const Entry& entry) {
+            return entry.key == *key && !Expired(entry.sources);
+         });
+      if (iter != mEntries.end())
+      {
+         mEntries.splice(mEntries.begin(), mEntries, iter);
+         return iter->pRendered;
+      }
+      const auto miss = std::find(mMisses.begin(), mMisses.end(), *key);
+      if (miss == mMisses.end())
+      {
+         if (mMisses.size() == maxMisses)
+            mMisses.erase(mMisses.begin());
+         mMisses.push_back(std::move(*key));
+         return nullptr;
+      }
+      mMisses.erase(miss);
+   }
+   // Played again without a copy: worth rendering one
+   BasicUI::CallAfter([wClip = std::weak_ptr<const WaveClip>{ pClip }] {
+      Get().Request(wClip);
+   });
+   return nullptr;
+}
+
+void StretchCache::Request(const std::weak_ptr<const WaveClip>& wClip)
+{
+   const auto budget = GetBudget();
+   if (budget == 0)
+   {
+      Clear();
+      return;
+   }
+   const auto pClip = wClip.lock();
+   // A copy bigger than the budget would only evict all others
+   if (!pClip || !pClip->HasPitchOrSpeed() ||
+       GetRenderedBytes(*pClip) > budget)
+      return;
+   BlockRefs sources;
+   auto key = Key::Make(*pClip, &sources);
+   if (!key)
+      return;
+
+   std::vector<std::shared_ptr<const WaveClip>> garbage;
+   {
+      std::lock_guard lock{ mMutex };
+      Evict(budget, garbage);
+      const auto sameKey = [&](const auto& element) {
+         return element.key == *key;
+      };
+      const auto sameJobKey = [&](const std::shared_ptr<Job>& pJob) {
+         return sameKey(*pJob);
+      };
+      if (
+         std::any_of(mEntries.begin(), mEntries.end(), sameKey) ||
+         std::any_of(mQueue.begin(), mQueue.end(), sameJobKey) ||
+         (mCurrent && sameJobKey(mCurrent)))
+         return;
+   }
+
+   const auto& factory = pClip->GetSequence(0)->GetFactory();
+   auto pJob =
+      std::make_shared<Job>(Job{ std::move(*key), std::move(sources) });
+   pJob->pSource = std::make_shared<WaveClip>(*pClip, factory, false);
+   pJob->pRenderer = std::make_unique<StretchRenderer>(
+      pJob->pSource, factory, floatSample, blockSize);
+   {
+      std::lock_guard lock{ mMutex };
+      mQueue.push_back(std::move(pJob));
+      if (!mThread.joinable())
+         mThread = std::thread{ [this] { Work(); } };
+   }
+   mCondition.notify_all();
+}
+
+void StretchCache::Work()
+{
+   std::unique_lock lock{ mMutex };
+   while (true)
+   {
+      mCondition.wait(lock, [this] {
+         return mStopping || (!mCurrent && !mQueue.empty());
+      });
+      if (mStopping)
+         return;
+      const auto pJob = mCurrent = mQueue.front();
+      mQueue.erase(mQueue.begin());
+      // Clear() may abandon the job whenever the lock is released, but not
+      // while rendering
+      while (mCurrent == pJob && !mStopping)
+      {
+         mRendering = true;
+         lock.unlock();
+         pJob->pRenderer->Render();
+         lock.lock();
+         mRendering = false;
+         mCondition.notify_all();
+         if (mCurrent != pJob || mStopping)
+            break;
+         // Only the main thread writes sample blocks
+         pJob->appended = false;
+         lock.unlock();
+         BasicUI::CallAfter([pJob] { Get().Append(pJob); });
+         lock.lock();
+         mCondition.wait(lock, [&] {
+            return pJob->appended || mCurrent != pJob || mStopping;
+         });
+      }
+   }
+}
+
+void StretchCache::Append(const std::shared_ptr<Job>& pJob)
+{
+   {
+      std::lock_guard lock{ mMutex };
+      if (mCurrent != pJob)
+         // Abandoned
+         return;
+   }
+   // The worker waits, so the renderer is not shared
+   auto& renderer = *pJob->pRenderer;
+   const auto pFactory = pJob->pSource->GetSequence(0)->GetFactory().get();
+   std::shared_ptr<const WaveClip> pRendered;
+   std::vector<SampleBlockID> written;
+   try
+   {
+      renderer.Append();
+      if (renderer.Done())
+         pRendered = renderer.Finish();
+      const auto& copy = renderer.GetCopy();
+      for (size_t ii = 0; ii < copy.NChannels(); ++ii)
+         for (const auto& block : copy.GetSequence(ii)->GetBlockArray())
+            // Silent blocks have no rows
+            if (const auto id = block.sb->GetBlockID();
+                id > 0 && pJob->written.insert(id).second)
+               written.push_back(id);
+   }
+   catch (...)
+   {
+      // Writing failed, perhaps for want of disk space; the cache can do
+      // without this copy, and no one needs to know
+      {
+         std::lock_guard lock{ mMutex };
+         mCurrent.reset();
+      }
+      mCondition.notify_all();
+      pJob->pRenderer.reset();
+      pJob->pSource.reset();
+      return;
+   }
+   if (!written.empty())
+      Publish({ pFactory, std::move(written) });
+   if (!pRendered)
+   {
+      {
+         std::lock_guard lock{ mMutex };
+         pJob->appended = true;
+      }
+      mCondition.notify_all();
+      return;
+   }
+
+   pJob->pRenderer.reset();
+   pJob->pSource.reset();
+   const auto bytes = pRendered->GetVisibleSampleCount().as_size_t() *
+                      pRendered->NChannels() * SAMPLE_SIZE(floatSample);
+   std::vector<std::shared_ptr<const WaveClip>> garbage;
+   {
+      std::lock_guard lock{ mMutex };
+      mCurrent.reset();
+      if (Expired(pJob->sources))
+         // The clip was edited meanwhile
+         garbage.push_back(std::move(pRendered));
+      else
+      {
+         mEntries.push_front({ std::move(pJob->key),
+            std::move(pJob->sources), std::move(pRendered), bytes });
+         mTotalBytes += bytes;
+      }
+      Evict(GetBudget(), garbage);
+   }
+   mCondition.notify_all();
+   // Now the sample blocks of garbage are deleted, without the lock
+}
+
+void StretchCache::Evict(
+   size_t budget, std::vector<std::shared_ptr<const WaveClip>>& garbage)
+{
+   for (auto iter = mEntries.begin(); iter != mEntries.end();)
+   {
+      if (Expired(iter->sources))
+      {
+         mTotalBytes -= iter->bytes;
+         Discard(std::move(iter->pRendered), garbage);
+         iter = mEntries.erase(iter);
+      }
+      else
+         ++iter;
+   }
+   while (mTotalBytes > budget)
+   {
+      auto& entry = mEntries.back();
+      mTotalBytes -= entry.bytes;
+      Discard(std::move(entry.pRendered), garbage);
+      mEntries.pop_back();
+   }
+
+   const auto end =
+      std::stable_partition(mRetired.begin(), mRetired.end(), Unused);
+   std::move(mRetired.begin(), end, std::back_inserter(garbage));
+   mRetired.erase(mRetired.begin(), end);
+}
+
+void StretchCache::Discard(std::shared_ptr<const WaveClip> pClip,
+   std::vector<std::shared_ptr<const WaveClip>>& garbage)
+{
+   if (Unused(pClip))
+      garbage.push_back(std::move(pClip));
+   else
+      mRetired.push_back(std::move(pClip));
+}
+
+void StretchCache::Clear(const SampleBlockFactory& factory)
+{
+   DoClear(&factory);
+}
+
+void StretchCache::Clear()
+{
+   DoClear(nullptr);
+}
+
+void StretchCache::DoClear(const SampleBlockFactory* pFactory)
+{
+   const auto ofProject = [pFactory](const WaveClip& clip) {
+      return !pFactory || clip.GetSequence(0)->GetFactory().get() == pFactory;
+   };
+   const auto jobOfProject = [&](const std::shared_ptr<Job>& pJob) {
+      return !pJob->pSource || ofProject(*pJob->pSource);
+   };
+
+   std::vector<std::shared_ptr<const WaveClip>> garbage;
+   std::vector<std::shared_ptr<Job>> jobs;
+   {
+      std::unique_lock lock{ mMutex };
+      mCondition.wait(lock, [this] { return !mRendering; });
+
+      const auto queueEnd = std::stable_partition(mQueue.begin(), mQueue.end(),
+         [&](const std::shared_ptr<Job>& pJob) { return !jobOfProject(pJob); });
+      std::move(queueEnd, mQueue.end(), std::back_inserter(jobs));
+      mQueue.erase(queueEnd, mQueue.end());
+      if (mCurrent && jobOfProject(mCurrent))
+         jobs.push_back(std::move(mCurrent));
+
+      for (auto iter = mEntries.begin(); iter != mEntries.end();)
+      {
+         if (ofProject(*iter->pRendered))
+         {
+            mTotalBytes -= iter->bytes;
+            // The project plays none of its copies, but another might
+            if (pFactory)
+               garbage.push_back(std::move(iter->pRendered));
+            else
+               Discard(std::move(iter->pRendered), garbage);
+            iter = mEntries.erase(iter);
+         }
+         else
+            ++iter;
+      }
+
+      const auto retiredEnd = std::stable_partition(
+         mRetired.begin(), mRetired.end(),
+         [&](const std::shared_ptr<const WaveClip>& pClip) {
+            return pFactory ? ofProject(*pClip) : Unused(pClip);
+         });
+      std::move(mRetired.begin(), retiredEnd, std::back_inserter(garbage));
+      mRetired.erase(mRetired.begin(), retiredEnd);
+
+      if (!pFactory)
+         mMisses.clear();
+   }
+   mCondition.notify_all();
+   // The worker and pending calls of Append() hold the jobs, but no longer
+   // use them; delete their sample blocks now, with those of the copies
+   for (auto& pJob : jobs)
+   {
+      pJob->pRenderer.reset();
+      pJob->pSource.reset();
+   }
+}
+
+size_t StretchCache::GetTotalBytes() const
+{
+   std::lock_guard lock{ mMutex };
+   return mTotalBytes;
+}
@@ -0,0 +1,142 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  StretchCache.h
+
+  @brief Stretched and pitch-shifted copies of clips, for playback and mixing
+
+**********************************************************************/
+#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Observer.h"
+
+class IntSetting;
+class SampleBlockFactory;
+class WaveClip;
+
+using SampleBlockID = long long;
+
+//! Limit of the sample data of the stretched copies of clips, in megabytes; 0
+//! disables the cache
+/*!
+ The copies are sample blocks in the databases of the projects, so this bounds
+ their disk space, uncompressed float samples, not the memory
+ */
+extern WAVE_TRACK_API IntSetting StretchCacheBudget;
+
+//! Sent when sample blocks of the copies were written
+struct StretchCacheMessage
+{
+   //! Made the blocks
+   const SampleBlockFactory* pFactory;
+   std::vector<SampleBlockID> blockIDs;
+};
+
+//! Keeps copies of clips, already stretched and pitch-shifted, in ordinary
+//! sample blocks
+/*!
+ Playback and Mixer read the copy of a clip, when there is one, instead of
+ running the time and pitch algorithm again.  The copy of some clip contents is
+ rendered in the background when they are played a second time without one, so
+ that exporting once does not cost more.
+
+ The copies are found by contents: stretch ratio, pitch shift, formant
+ preservation, play region, and the ids of the source sample blocks.  An edit
+ changes some of these, so that the stale copy is not found again; it is
+ discarded when the source blocks are destroyed, or the least recently used
+ copies exceed the budget on disk.  The copies are not saved with projects.
+
+ The owner of the database learns the ids of the blocks of the copies from
+ the messages, published on the main thread, so that it can delete the blocks
+ that a crash left there, without taking them for lost blocks of the project.
+ */
+class WAVE_TRACK_API StretchCache final
+   : public Observer::Publisher<StretchCacheMessage>
+{
+public:
+   static StretchCache& Get();
+
+   StretchCache(const StretchCache&) = delete;
+   StretchCache& operator=(const StretchCache&) = delete;
+   ~StretchCache();
+
+   //! The copy of the clip, if there is one
+   /*!
+    May be called on any thread, and does not wait for rendering
+    @post result: `!result || result->GetStretchRatio() == 1`
+    */
+   std::shared_ptr<const WaveClip>
+   Find(const std::shared_ptr<const WaveClip>& pClip);
+
+   //! Discards the copies of the clips of one project, and abandons their
+   //! renderings in progress
+   /*!
+    Call on the main thread before closing or replacing the database
+    connection of the project, while the sample blocks can still be deleted,
+    and no playback or mixing of the project reads the copies
+    @param factory makes the sample blocks of the project
+    */
+   void Clear(const SampleBlockFactory& factory);
+
+   //! Discards all copies, and abandons the renderings in progress
+   /*!
+    Copies that playback still reads are kept until it no longer does, as for
+    eviction.  Call on the main thread
+    */
+   void Clear();
+
+   //! Bytes of sample data in the copies, which the budget bounds
+   size_t GetTotalBytes() const;
+
+private:
+   struct Key;
+   struct Entry;
+   struct Job;
+
+   StretchCache();
+
+   //! Starts rendering the clip, unless it changed or already has a copy
+   void Request(const std::weak_ptr<const WaveClip>& wClip);
+   //! Takes the block that the worker rendered, and keeps the finished copy
+   void Append(const std::shared_ptr<Job>& pJob);
+   //! Renders the requested copies, one at a time
+   void Work();
+
+   //! Moves out copies that are stale, or in excess of the budget, and
+   //! not being played
+   /*! @pre mMutex is locked */
+   void Evict(size_t budget,
+      std::vector<std::shared_ptr<const WaveClip>>& garbage);
+   //! Moves the copy to garbage, or to mRetired if it is being played
+   /*! @pre mMutex is locked */
+   void Discard(std::shared_ptr<const WaveClip> pClip,
+      std::vector<std::shared_ptr<const WaveClip>>& garbage);
+   //! Does Clear() for the project of the factory, or for all if it is null
+   void DoClear(const SampleBlockFactory* pFactory);
+
+   mutable std::mutex mMutex;
+   std::condition_variable mCondition;
+   //! Most recently used first
+   std::list<Entry> mEntries;
+   //! Copies evicted while playback might still read them
+   std::vector<std::shared_ptr<const WaveClip>> mRetired;
+   //! Contents played once without a copy, oldest first
+   std::vector<Key> mMisses;
+   std::vector<std::shared_ptr<Job>> mQueue;
+   //! Job whose blocks the worker renders, and the main thread appends
+   std::shared_ptr<Job> mCurrent;
+   size_t mTotalBytes{ 0 };
+   //! Whether the worker is in StretchRenderer::Render()
+   bool mRendering{ false };
+   bool mStopping{ false };
+   std::thread mThread;
+};
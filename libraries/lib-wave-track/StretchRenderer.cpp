@@ -0,0 +1,112 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  StretchRenderer.cpp
+
+**********************************************************************/
+#include "StretchRenderer.h"
+#include "Envelope.h"
+#include "WaveClip.h"
+
+#include <cassert>
+#include <cmath>
+
+StretchRenderer::StretchRenderer(const WaveTrack::IntervalHolder& pInterval,
+   const SampleBlockFactoryPtr& factory, sampleFormat format,
+   size_t blockSize
+)  : mInterval{ *pInterval }
+   , mDst{ std::make_shared<WaveTrack::Interval>(
+      mInterval.NChannels(), factory, format, mInterval.GetRate()) }
+   , mOriginalPlayStartTime{ mInterval.GetPlayStartTime() }
+   , mOriginalPlayEndTime{ mInterval.GetPlayEndTime() }
+   , mBlockSize{ blockSize }
+   , mContainer(blockSize, mInterval.NChannels())
+{
+   assert(mInterval.HasPitchOrSpeed());
+   const auto stretchRatio = mInterval.GetStretchRatio();
+
+   // Leave 1 second of raw, unstretched audio before and after visible region
+   // to give the algorithm a chance to be in a steady state when reaching the
+   // play boundaries.
+   mTmpPlayStartTime = std::max(
+      mInterval.GetSequenceStartTime(), mOriginalPlayStartTime - stretchRatio);
+   mTmpPlayEndTime = std::min(
+      mInterval.GetSequenceEndTime(), mOriginalPlayEndTime + stretchRatio);
+   mInterval.TrimLeftTo(mTmpPlayStartTime);
+   mInterval.TrimRightTo(mTmpPlayEndTime);
+
+   constexpr auto sourceDurationToDiscard = 0.;
+   mStretcherSource.emplace(
+      mInterval, sourceDurationToDiscard, PlaybackDirection::forward);
+   TimeAndPitchInterface::Parameters params;
+   params.timeRatio = stretchRatio;
+   params.pitchRatio = std::pow(2., mInterval.GetCentShift() / 1200.);
+   params.preserveFormants = mInterval.GetPitchAndSpeedPreset() ==
+      PitchAndSpeedPreset::OptimizeForVoice;
+   mStretcher.emplace(mInterval.GetRate(), mInterval.NChannels(),
+      *mStretcherSource, std::move(params));
+
+   mTotalNumOutSamples = sampleCount{
+      mInterval.GetVisibleSampleCount().as_double() * stretchRatio };
+}
+
+StretchRenderer::~StretchRenderer()
+{
+   if (!mFinished)
+   {
+      mInterval.TrimLeftTo(mOriginalPlayStartTime);
+      mInterval.TrimRightTo(mOriginalPlayEndTime);
+   }
+}
+
+void StretchRenderer::Render()
+{
+   assert(!Done());
+   assert(mNumInContainer == 0);
+   const auto numSamplesToGet =
+      limitSampleBufferSize(mBlockSize, mTotalNumOutSamples - mNumOutSamples);
+   mStretcher->GetSamples(mContainer.Get(), numSamplesToGet);
+   mNumInContainer = numSamplesToGet;
+   mNumOutSamples += numSamplesToGet;
+}
+
+void StretchRenderer::Append()
+{
+   if (mNumInContainer == 0)
+      return;
+   constSamplePtr data[2];
+   data[0] = reinterpret_cast<constSamplePtr>(mContainer.Get()[0]);
+   if (mInterval.NChannels() == 2)
+      data[1] = reinterpret_cast<constSamplePtr>(mContainer.Get()[1]);
+   mDst->Append(data, floatSample, mNumInContainer, 1, widestSampleFormat);
+   mNumInContainer = 0;
+}
+
+WaveTrack::IntervalHolder StretchRenderer::Finish()
+{
+   assert(Done());
+   Append();
+   mDst->Flush();
+
+   // Now we're all like `this` except unstretched. We can clear leading and
+   // trailing, stretching transient parts.
+   mDst->SetPlayStartTime(mTmpPlayStartTime);
+   mDst->ClearLeft(mOriginalPlayStartTime);
+   mDst->ClearRight(mOriginalPlayEndTime);
+
+   // We don't preserve cutlines but the relevant part of the envelope.
+   auto dstEnvelope = std::make_unique<Envelope>(mInterval.GetEnvelope());
+   const auto samplePeriod = 1. / mInterval.GetRate();
+   dstEnvelope->CollapseRegion(mOriginalPlayEndTime,
+      mInterval.GetSequenceEndTime() + samplePeriod, samplePeriod);
+   dstEnvelope->CollapseRegion(0, mOriginalPlayStartTime, samplePeriod);
+   dstEnvelope->SetOffset(mOriginalPlayStartTime);
+   mDst->SetEnvelope(move(dstEnvelope));
+
+   mFinished = true;
+
+   assert(!mDst->HasPitchOrSpeed());
+   return mDst;
+}
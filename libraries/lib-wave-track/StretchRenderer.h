@@ -0,0 +1,73 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  StretchRenderer.h
+
+**********************************************************************/
+#pragma once
+
+#include "AudioContainer.h"
+#include "ClipTimeAndPitchSource.h"
+#include "StaffPadTimeAndPitch.h"
+#include "WaveTrack.h"
+
+#include <optional>
+
+//! Renders the pitch and speed of one interval into a new interval, a block
+//! at a time
+/*!
+ Render() only reads the source interval and writes a buffer of this object, so
+ the renderers of different intervals may render on different threads at once.
+ Everything else, Append() in particular, happens on the thread that
+ constructed the renderer.
+ */
+class StretchRenderer
+{
+public:
+   //! @pre `pInterval->HasPitchOrSpeed()`
+   StretchRenderer(const WaveTrack::IntervalHolder& pInterval,
+      const SampleBlockFactoryPtr& factory, sampleFormat format,
+      size_t blockSize);
+   //! Restores the play region of the source, unless Finish() was called
+   ~StretchRenderer();
+
+   bool Done() const { return mNumOutSamples >= mTotalNumOutSamples; }
+   double Progress() const
+   {
+      return mNumOutSamples.as_double() / mTotalNumOutSamples.as_double();
+   }
+
+   //! Stretches the next block into the buffer
+   //! @pre `!Done()`
+   void Render();
+
+   //! Appends the block of the last Render() to the copy, if not already done
+   void Append();
+
+   //! @pre `Done()`
+   //! @post result: `result->GetStretchRatio() == 1`
+   WaveTrack::IntervalHolder Finish();
+
+   //! The copy being written, whose blocks Append() and Finish() change
+   const WaveTrack::Interval& GetCopy() const { return *mDst; }
+
+private:
+   WaveTrack::Interval& mInterval;
+   const WaveTrack::IntervalHolder mDst;
+   const double mOriginalPlayStartTime;
+   const double mOriginalPlayEndTime;
+   double mTmpPlayStartTime;
+   double mTmpPlayEndTime;
+   const size_t mBlockSize;
+
+   std::optional<ClipTimeAndPitchSource> mStretcherSource;
+   std::optional<StaffPadTimeAndPitch> mStretcher;
+   // Post-rendering sample counts, i.e., stretched units
+   sampleCount mTotalNumOutSamples;
+   sampleCount mNumOutSamples { 0 };
+   AudioContainer mContainer;
+   size_t mNumInContainer { 0 };
+   bool mFinished { false };
+};
@@ -92,6 +92,35 @@ float WaveChannelUtilities::GetRMS(const WaveChannel &channel,
    return duration > 0 ? sqrt(sumsq / duration) : 0.0;
 }
 
+bool WaveChannelUtilities::Scan(const WaveChannel &channel,
+   sampleCount start, sampleCount len,
+   const Sequence::Classifier &classify, const Sequence::ScanVisitor &visit,
+   bool mayThrow)
+{
+   const auto end = start + len;
+   for (const auto &clip : SortedClipArray(channel)) {
+      const auto clipStart = clip->GetPlayStartSample();
+      const auto clipEnd = clipStart + clip->GetVisibleSampleCount();
+      if (clipEnd <= start || clipStart >= end)
+         continue;
+      if (clip->HasPitchOrSpeed())
+         return false;
+
+      // The sequence begins with the samples trimmed from the left
+      const auto offset = clipStart - clip->TimeToSamples(clip->GetTrimLeft());
+      const auto s0 = std::max(start, clipStart);
+      const auto s1 = std::min(end, clipEnd);
+      const auto visitClip = [&](sampleCount pieceStart, size_t pieceLen,
+         const float *samples, Sequence::Verdict verdict) {
+         return visit(pieceStart + offset, pieceLen, samples, verdict);
+      };
+      if (!clip->GetSequence().Scan(
+         s0 - offset, s1 - s0, classify, visitClip, mayThrow))
+         return false;
+   }
+   return true;
+}
+
 namespace {
 using namespace WaveChannelUtilities;
 
@@ -19,6 +19,8 @@ enum class sampleFormat : unsigned;
 class WaveChannel;
 class WaveClipChannel;
 
+#include "Sequence.h" // Sequence::Classifier
+
 #include <algorithm>
 #include <functional>
 #include <memory>
@@ -87,6 +89,21 @@ WAVE_TRACK_API std::pair<float, float> GetMinMax(const WaveChannel &channel,
 WAVE_TRACK_API float GetRMS(const WaveChannel &channel,
    double t0, double t1, bool mayThrow = true);
 
+/*!
+ @brief Visits the samples of clips in [`start`, `start + len`) in order,
+ deciding what it can from the summaries, as by Sequence::Scan. Positions are
+ relative to the track, as for GetFloats.
+
+ Stretches between clips are not visited, though GetFloats would give zeroes.
+
+ @return false if the visitor stopped the scan, or if a clip in the range has
+ pitch or speed changes
+ */
+WAVE_TRACK_API bool Scan(const WaveChannel &channel,
+   sampleCount start, sampleCount len,
+   const Sequence::Classifier &classify, const Sequence::ScanVisitor &visit,
+   bool mayThrow = true);
+
 /*!
  @brief Gets as many samples as it can, but no more than `2 *
  numSideSamples + 1`, centered around `t`. Reads nothing if
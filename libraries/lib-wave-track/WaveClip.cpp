@@ -27,6 +27,7 @@
 #include "Resample.h"
 #include "Sequence.h"
 #include "TimeAndPitchInterface.h"
+#include "Track.h"
 #include "UserException.h"
 
 #ifdef _OPENMP
@@ -1083,9 +1084,14 @@ void WaveClip::WriteXML(size_t ii, XMLWriter &xmlFile) const
    xmlFile.WriteAttr(RawAudioTempo_attr, mRawAudioTempo.value_or(0.), 8);
    xmlFile.WriteAttr(ClipStretchRatio_attr, mClipStretchRatio, 8);
    xmlFile.WriteAttr(Name_attr, mName);
-   Attachments::ForEach([&](const WaveClipListener &listener){
-      listener.WriteXMLAttributes(xmlFile);
-   });
+   {
+      // Clips are written as parts of tracks, perhaps concurrently
+      std::lock_guard<std::recursive_mutex> lock{
+         Track::ExtensionWritersMutex() };
+      Attachments::ForEach([&](const WaveClipListener &listener){
+         listener.WriteXMLAttributes(xmlFile);
+      });
+   }
 
    mSequences[ii]->WriteXML(xmlFile);
    mEnvelope->WriteXML(xmlFile);
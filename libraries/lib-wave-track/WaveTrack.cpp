@@ -37,6 +37,7 @@ from the project that will own the track.
 #include <algorithm>
 #include <float.h>
 #include <math.h>
+#include <memory>
 #include <numeric>
 #include <optional>
 #include <type_traits>
@@ -46,10 +47,10 @@ from the project that will own the track.
 
 #include "AudioSegmentSampleView.h"
 #include "ChannelAttachments.h"
-#include "ClipTimeAndPitchSource.h"
 #include "Envelope.h"
 #include "Sequence.h"
-#include "StaffPadTimeAndPitch.h"
+#include "StretchRenderer.h"
+#include "concurrency/TaskPool.h"
 
 #include "TempoChange.h"
 #include "Project.h"
@@ -71,103 +72,88 @@ from the project that will own the track.
 
 using std::max;
 
+namespace {
 /*!
  * @post result: `result->GetStretchRatio() == 1`
  */
-namespace {
 WaveTrack::IntervalHolder GetRenderedCopy(
    const WaveTrack::IntervalHolder &pInterval,
    const std::function<void(double)>& reportProgress,
    const SampleBlockFactoryPtr& factory, sampleFormat format)
 {
-   auto &interval = *pInterval;
-   using Interval = WaveTrack::Interval;
-   if (!interval.HasPitchOrSpeed())
+   if (!pInterval->HasPitchOrSpeed())
       return pInterval;
 
-   const auto dst = std::make_shared<Interval>(
-      interval.NChannels(), factory, format, interval.GetRate());
-
-   const auto originalPlayStartTime = interval.GetPlayStartTime();
-   const auto originalPlayEndTime = interval.GetPlayEndTime();
-   const auto stretchRatio = interval.GetStretchRatio();
-
-   auto success = false;
-   Finally Do { [&] {
-      if (!success)
-      {
-         interval.TrimLeftTo(originalPlayStartTime);
-         interval.TrimRightTo(originalPlayEndTime);
-      }
-   } };
-
-   // Leave 1 second of raw, unstretched audio before and after visible region
-   // to give the algorithm a chance to be in a steady state when reaching the
-   // play boundaries.
-   const auto tmpPlayStartTime =
-      std::max(interval.GetSequenceStartTime(), originalPlayStartTime - stretchRatio);
-   const auto tmpPlayEndTime =
-      std::min(interval.GetSequenceEndTime(), originalPlayEndTime + stretchRatio);
-   interval.TrimLeftTo(tmpPlayStartTime);
-   interval.TrimRightTo(tmpPlayEndTime);
-
-   constexpr auto sourceDurationToDiscard = 0.;
    constexpr auto blockSize = 1024;
-   const auto numChannels = interval.NChannels();
-   ClipTimeAndPitchSource stretcherSource { interval, sourceDurationToDiscard,
-                                            PlaybackDirection::forward };
-   TimeAndPitchInterface::Parameters params;
-   params.timeRatio = stretchRatio;
-   params.pitchRatio = std::pow(2., interval.GetCentShift() / 1200.);
-   params.preserveFormants =
-      interval.GetPitchAndSpeedPreset() == PitchAndSpeedPreset::OptimizeForVoice;
-   StaffPadTimeAndPitch stretcher { interval.GetRate(), numChannels,
-                                    stretcherSource, std::move(params) };
-
-   // Post-rendering sample counts, i.e., stretched units
-   const auto totalNumOutSamples =
-      sampleCount { interval.GetVisibleSampleCount().as_double() *
-                    stretchRatio };
-
-   sampleCount numOutSamples { 0 };
-   AudioContainer container(blockSize, numChannels);
-
-   while (numOutSamples < totalNumOutSamples)
+   StretchRenderer renderer{ pInterval, factory, format, blockSize };
+   while (!renderer.Done())
    {
-      const auto numSamplesToGet =
-         limitSampleBufferSize(blockSize, totalNumOutSamples - numOutSamples);
-      stretcher.GetSamples(container.Get(), numSamplesToGet);
-      constSamplePtr data[2];
-      data[0] = reinterpret_cast<constSamplePtr>(container.Get()[0]);
-      if (interval.NChannels() == 2)
-         data[1] = reinterpret_cast<constSamplePtr>(container.Get()[1]);
-      dst->Append(data, floatSample, numSamplesToGet, 1, widestSampleFormat);
-      numOutSamples += numSamplesToGet;
+      renderer.Render();
+      renderer.Append();
       if (reportProgress)
-         reportProgress(
-            numOutSamples.as_double() / totalNumOutSamples.as_double());
+         reportProgress(renderer.Progress());
    }
-   dst->Flush();
+   return renderer.Finish();
+}
 
-   // Now we're all like `this` except unstretched. We can clear leading and
-   // trailing, stretching transient parts.
-   dst->SetPlayStartTime(tmpPlayStartTime);
-   dst->ClearLeft(originalPlayStartTime);
-   dst->ClearRight(originalPlayEndTime);
+/*!
+ Stretches the intervals with pitch or speed on the shared task pool.  Each
+ round renders a block of each interval of a batch concurrently, then appends
+ the blocks on this thread, which alone writes sample blocks.
+ @post result: the same size as intervals, with `GetStretchRatio() == 1` for
+ each member
+ */
+WaveTrack::IntervalHolders GetRenderedCopiesConcurrently(
+   const WaveTrack::IntervalHolders& intervals,
+   const std::function<void(double)>& reportProgress,
+   const SampleBlockFactoryPtr& factory, sampleFormat format)
+{
+   // Long enough for the rounds to cost much more than their scheduling
+   constexpr size_t blockSize = 1 << 16;
 
-   // We don't preserve cutlines but the relevant part of the envelope.
-   auto dstEnvelope = std::make_unique<Envelope>(interval.GetEnvelope());
-   const auto samplePeriod = 1. / interval.GetRate();
-   dstEnvelope->CollapseRegion(
-      originalPlayEndTime, interval.GetSequenceEndTime() + samplePeriod, samplePeriod);
-   dstEnvelope->CollapseRegion(0, originalPlayStartTime, samplePeriod);
-   dstEnvelope->SetOffset(originalPlayStartTime);
-   dst->SetEnvelope(move(dstEnvelope));
+   auto& pool = audacity::concurrency::TaskPool::Get();
+   // Batches of as many intervals as threads, to bound the buffer memory
+   const size_t batchSize = pool.GetWorkersCount() + 1;
 
-   success = true;
+   WaveTrack::IntervalHolders result{ intervals };
+   std::vector<size_t> stretched;
+   for (size_t ii = 0; ii < intervals.size(); ++ii)
+      if (intervals[ii]->HasPitchOrSpeed())
+         stretched.push_back(ii);
 
-   assert(!dst->HasPitchOrSpeed());
-   return dst;
+   for (size_t first = 0; first < stretched.size(); first += batchSize)
+   {
+      const auto count = std::min(batchSize, stretched.size() - first);
+      std::vector<std::unique_ptr<StretchRenderer>> renderers;
+      for (size_t ii = 0; ii < count; ++ii)
+         renderers.push_back(std::make_unique<StretchRenderer>(
+            intervals[stretched[first + ii]], factory, format, blockSize));
+
+      const auto done = [&]{
+         return std::all_of(renderers.begin(), renderers.end(),
+            [](auto& pRenderer){ return pRenderer->Done(); });
+      };
+      while (!done())
+      {
+         pool.ParallelFor(count, 1, [&](size_t begin, size_t end) {
+            for (auto ii = begin; ii < end; ++ii)
+               if (!renderers[ii]->Done())
+                  renderers[ii]->Render();
+         });
+         double progress = first;
+         for (auto& pRenderer : renderers)
+         {
+            pRenderer->Append();
+            progress += pRenderer->Progress();
+         }
+         if (reportProgress)
+            reportProgress(progress / stretched.size());
+      }
+
+      for (size_t ii = 0; ii < count; ++ii)
+         result[stretched[first + ii]] = renderers[ii]->Finish();
+   }
+   return result;
 }
 }
 
@@ -2509,8 +2495,11 @@ void WaveTrack::WriteOneXML(const WaveChannel &channel, XMLWriter &xmlFile,
 
    // Other persistent data specified elsewhere;
    // NOT written redundantly any more
-   if (iChannel == 0)
+   if (iChannel == 0) {
+      std::lock_guard<std::recursive_mutex> lock{
+         Track::ExtensionWritersMutex() };
       WaveTrackIORegistry::Get().CallWriters(track, xmlFile);
+   }
 
    for (const auto &clip : channel.Intervals())
       clip->WriteXML(xmlFile);
@@ -3182,13 +3171,22 @@ void WaveTrack::ApplyPitchAndSpeedOnIntervals(
    const ProgressReporter& reportProgress)
 {
    IntervalHolders dstIntervals;
-   dstIntervals.reserve(srcIntervals.size());
-   std::transform(
+   const auto nStretched = std::count_if(
       srcIntervals.begin(), srcIntervals.end(),
-      std::back_inserter(dstIntervals), [&](const IntervalHolder& interval) {
-         return GetRenderedCopy(interval,
-            reportProgress, mpFactory, GetSampleFormat());
-      });
+      [](const IntervalHolder& interval){
+         return interval->HasPitchOrSpeed(); });
+   if (nStretched > 1 && ConcurrentStretchRendering.Read())
+      dstIntervals = GetRenderedCopiesConcurrently(srcIntervals,
+         reportProgress, mpFactory, GetSampleFormat());
+   else {
+      dstIntervals.reserve(srcIntervals.size());
+      std::transform(
+         srcIntervals.begin(), srcIntervals.end(),
+         std::back_inserter(dstIntervals), [&](const IntervalHolder& interval) {
+            return GetRenderedCopy(interval,
+               reportProgress, mpFactory, GetSampleFormat());
+         });
+   }
 
    // If we reach this point it means that no error was thrown - we can replace
    // the source with the destination intervals.
@@ -3390,4 +3388,7 @@ bool GetEditClipsCanMove()
 BoolSetting EditClipsCanMove{
    L"/GUI/EditClipCanMove",         false  };
 
+BoolSetting ConcurrentStretchRendering{
+   L"/TimeAndPitch/ConcurrentRendering", true };
+
 DEFINE_XML_METHOD_REGISTRY( WaveTrackIORegistry );
@@ -949,6 +949,9 @@ extern WAVE_TRACK_API BoolSetting
 
 extern WAVE_TRACK_API StringSetting AudioTrackNameSetting;
 
+//! Whether applying pitch and speed renders the clips of a track concurrently
+extern WAVE_TRACK_API BoolSetting ConcurrentStretchRendering;
+
 WAVE_TRACK_API bool GetEditClipsCanMove();
 
 // Generate a registry for serialized data
@@ -414,6 +414,7 @@ WaveTrackUtilities::GetClipsIntersecting(const WaveTrack &track,
 }
 
 #include "ProjectFormatExtensionsRegistry.h"
+#include "UndoTracks.h"
 
 namespace {
 using namespace WaveTrackUtilities;
@@ -442,6 +443,22 @@ ProjectFormatExtensionsRegistry::Extension stretchedClipsExtension(
       return BaseProjectFormatVersion;
    }
 );
+
+// Let UndoManager account for the space of sample blocks in undo states
+UndoTracks::StorageInspector::Scope storageInspectorScope{
+   [](const TrackList &tracks,
+      const UndoStateExtension::StorageVisitor &visitor
+   ){
+      SampleBlockIDSet seen;
+      InspectBlocks(tracks, [&](SampleBlockConstPtr pBlock){
+         // Pushing an undo state must not query the database for each new
+         // block; the estimate is close enough for the History window
+         visitor(pBlock->GetBlockID(), [&]() -> unsigned long long {
+            return pBlock->EstimateSpaceUsage();
+         });
+      }, &seen);
+   }
+};
 }
 
 void WaveTrackUtilities::ExpandClipTillNextOne(
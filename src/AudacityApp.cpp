@@ -111,6 +111,7 @@ It handles initialization and termination by subclassing wxApp.
 #include "wxWidgetsBasicUI.h"
 #include "LogWindow.h"
 #include "FrameStatisticsDialog.h"
+#include "HeadlessBatch.h"
 #include "PluginStartupRegistration.h"
 #include "IncompatiblePluginsDialog.h"
 #include "wxWidgetsWindowPlacement.h"
@@ -132,6 +133,7 @@ It handles initialization and termination by subclassing wxApp.
 
 #include "ModuleManager.h"
 #include "PluginHost.h"
+#include "effects/EffectHost.h"
 
 #include "Import.h"
 
@@ -862,7 +864,7 @@ int main(int argc, char *argv[])
    CommandLineArgs::argc = argc;
    CommandLineArgs::argv = argv;
 
-   if(PluginHost::IsHostProcess())
+   if(PluginHost::IsHostProcess() || EffectHost::IsHostProcess())
    {
       sOSXIsGUIApplication = false;
       ProcessSerialNumber psn = { 0, kCurrentProcess };
@@ -1228,7 +1230,7 @@ AudacityApp::AudacityApp()
 
 bool AudacityApp::Initialize(int& argc, wxChar** argv)
 {
-   if(!PluginHost::IsHostProcess())
+   if(!PluginHost::IsHostProcess() && !EffectHost::IsHostProcess())
    {
       InitCrashreports();
    }
@@ -1373,6 +1375,7 @@ bool AudacityApp::OnInit()
    {
       InitPreferences(audacity::ApplicationSettings::Call());
       PopulatePreferences();
+      HeadlessBatch::ConfigureWorker();
    }
 
    mThemeChangeSubscription = theTheme.Subscribe(OnThemeChange);
@@ -1424,7 +1427,24 @@ bool AudacityApp::InitPart2()
    SetExitOnFrameDelete(false);
 #endif
 
+   // Parse command line and handle options that might require
+   // immediate exit...no need to initialize all of the audio
+   // stuff to display the version string.
+   std::shared_ptr< wxCmdLineParser > parser{ ParseCommandLine() };
+   if (!parser)
+   {
+      // Either user requested help or a parsing error occurred
+      exit(1);
+   }
+
+   // Batch processing neither shows dialogs, nor passes its files to
+   // another instance, and its workers have their own temp directories
+   const bool headless = HeadlessBatch::IsRequested(*parser);
+   if (headless)
+      HeadlessBatch::InstallServices();
+
    // Make sure the temp dir isn't locked by another process.
+   if (!headless)
    {
       auto key =
          PreferenceKey(FileNames::Operation::Temp, FileNames::PathType::_None);
@@ -1449,20 +1469,11 @@ bool AudacityApp::InitPart2()
    // Initialize the PluginManager
    PluginManager::Get().Initialize( [](const FilePath &localFileName){
       return std::make_unique<SettingsWX>(
-         AudacityFileConfig::Create({}, {}, localFileName)
+         AudacityFileConfig::Create({}, {},
+            HeadlessBatch::PrivateSettingsFile(localFileName))
       );
    });
 
-   // Parse command line and handle options that might require
-   // immediate exit...no need to initialize all of the audio
-   // stuff to display the version string.
-   std::shared_ptr< wxCmdLineParser > parser{ ParseCommandLine() };
-   if (!parser)
-   {
-      // Either user requested help or a parsing error occurred
-      exit(1);
-   }
-
    wxString journalFileName;
    const bool playingJournal = parser->Found("j", &journalFileName);
 
@@ -1492,6 +1503,9 @@ bool AudacityApp::InitPart2()
    if (playingJournal)
       Journal::SetInputFileName( journalFileName );
 
+   if (headless)
+      return InitHeadlessBatch(parser);
+
    // BG: Create a temporary window to set as the top window
    wxImage logoimage((const char **)Audacity_splash_xpm);
    logoimage.Scale(logoimage.GetWidth() * (2.0/3.0), logoimage.GetHeight() * (2.0/3.0), wxIMAGE_QUALITY_HIGH);
@@ -1751,9 +1765,39 @@ int AudacityApp::OnRun()
    if (result == 0)
       // If not otherwise abnormal, report any journal sync failure
       result = Journal::GetExitCode();
+   if (result == 0)
+      result = mExitCode;
    return result;
 }
 
+// Like the rest of InitPart2, but without the splash screen, the plug-in
+// scan, the journal, auto-recovery, or any window
+bool AudacityApp::InitHeadlessBatch(
+   const std::shared_ptr<wxCmdLineParser> &parser)
+{
+   InitDitherers();
+   AudioIO::Init();
+
+   Importer::Get().Initialize();
+   ExportPluginRegistry::Get().Initialize();
+
+   // Only a worker processes files, in a project never shown
+   const auto project = HeadlessBatch::IsWorkerProcess()
+      ? ProjectManager::New(false)
+      : nullptr;
+
+   CallAfter( [=] {
+      mExitCode = HeadlessBatch::Run(*parser, project);
+      QuitAudacity(true);
+   } );
+
+   gInited = true;
+
+   ModuleManager::Get().Dispatch(AppInitialized);
+
+   return true;
+}
+
 void AudacityApp::OnIdle( wxIdleEvent &evt )
 {
    evt.Skip();
@@ -2391,6 +2435,8 @@ std::unique_ptr<wxCmdLineParser> AudacityApp::ParseCommandLine()
    parser->AddOption(wxT("u"), wxT("url"), _("Handle 'audacity://' url"));
 #endif
 
+   HeadlessBatch::AddCommandLineOptions(*parser);
+
    // Run the parser
    if (parser->Parse() == 0)
       return parser;
@@ -2742,7 +2788,8 @@ static audacity::ApplicationSettings::Scope applicationSettingsScope {
    []{
       static std::once_flag configSetupFlag;
       std::call_once(configSetupFlag, [&]{
-         const auto configFileName = wxFileName { FileNames::Configuration() };
+         const auto configFileName = wxFileName {
+            HeadlessBatch::PrivateSettingsFile(FileNames::Configuration()) };
          gConfig = AudacityFileConfig::Create(
             wxTheApp->GetAppName(), wxEmptyString,
             configFileName.GetFullPath(),
@@ -124,6 +124,9 @@ class AudacityApp final
 
    bool InitTempDir();
    bool CreateSingleInstanceChecker(const wxString &dir);
+   bool InitHeadlessBatch(const std::shared_ptr<wxCmdLineParser> &parser);
+   //! Returned by OnRun(), if nothing else went wrong
+   int mExitCode{ 0 };
 
    std::unique_ptr<wxCmdLineParser> ParseCommandLine();
 
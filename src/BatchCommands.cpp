@@ -30,7 +30,9 @@ processing.  See also MacrosWindow and ApplyMacroDialog.
 #include "ProjectSettings.h"
 #include "effects/EffectManager.h"
 #include "effects/EffectUI.h"
+#include "effects/StatefulPerTrackEffect.h"
 #include "FileNames.h"
+#include "PerTrackEffect.h"
 #include "PluginManager.h"
 #include "Prefs.h"
 #include "SelectFile.h"
@@ -603,6 +605,80 @@ bool MacroCommands::ApplyCommandInBatchMode(
    return ApplyCommand( friendlyCommand, command, params, pContext );
 }
 
+namespace {
+//! Finds the commands after the i-th that can be applied in the same pass
+//! over the tracks as it, and prepares their effects
+/*!
+ Only effects for which PerTrackEffect::CanChain() is true are chained, and
+ after the first, only those that keep no state in the effect object.  Among
+ the built-in effects that leaves Bass and Treble and Phaser, and LADSPA
+ effects; effects that analyse first (Normalize, Compressor, Loudness) and
+ Equalization, which is not a PerTrackEffect, run in passes of their own.
+ @return the effect of the i-th command, which is null if there are no such
+ followers
+ */
+std::pair<const PerTrackEffect *, std::vector<PerTrackEffect::Follower>>
+ChainFollowers(
+   const CommandIDs &commands, const wxArrayString &params, size_t i)
+{
+   int bDebug;
+   gPrefs->Read(wxT("/Batch/Debug"), &bDebug, 0);
+   if (bDebug != 0)
+      return {};
+
+   auto &em = EffectManager::Get();
+   const auto chainable = [&](size_t j, bool follower)
+      -> const PerTrackEffect *
+   {
+      const auto &ID = em.GetEffectByIdentifier(commands[j]);
+      if (ID.empty())
+         return nullptr;
+      const auto plug = PluginManager::Get().GetPlugin(ID);
+      if (!plug || plug->GetPluginType() == PluginTypeAudacityCommand)
+         return nullptr;
+      const auto pEffect = dynamic_cast<const PerTrackEffect*>(em.GetEffect(ID));
+      if (!pEffect)
+         return nullptr;
+      // An effect that is not yet stateless processes with the state of the
+      // effect object, which its batch processing scope restores before the
+      // pass, and which it may compute in Init() from its input, not the
+      // output of the effect before it
+      if (follower && dynamic_cast<const StatefulPerTrackEffect*>(pEffect))
+         return nullptr;
+      if (!PerTrackEffect::CanChain(*pEffect))
+         return nullptr;
+      return pEffect;
+   };
+
+   const auto pFirst = chainable(i, false);
+   if (!pFirst)
+      return {};
+   std::vector<const PerTrackEffect *> effects{ pFirst };
+   std::vector<PerTrackEffect::Follower> followers;
+   for (auto j = i + 1; j < commands.size(); ++j) {
+      const auto pEffect = chainable(j, true);
+      // An effect may keep its settings in itself, so it occurs once only
+      if (!pEffect || make_iterator_range(effects).contains(pEffect))
+         break;
+      // Transfer the parameters as ApplyEffectCommand() does
+      const auto &ID = em.GetEffectByIdentifier(commands[j]);
+      auto cleanup = em.SetBatchProcessing(ID);
+      if (!em.SetEffectParameters(ID, params[j]))
+         break;
+      const auto pSettings = em.GetDefaultSettings(ID);
+      auto pInstance = std::dynamic_pointer_cast<EffectInstanceEx>(
+         pEffect->MakeInstance());
+      if (!pSettings || !pInstance || !pInstance->Init())
+         break;
+      effects.push_back(pEffect);
+      followers.push_back({ *pEffect, move(pInstance), *pSettings });
+   }
+   if (followers.empty())
+      return {};
+   return { pFirst, move(followers) };
+}
+}
+
 static int MacroReentryCount = 0;
 // ApplyMacro returns true on success, false otherwise.
 // Any error reporting to the user in setting up the macro
@@ -699,8 +775,21 @@ bool MacroCommands::ApplyMacro(
          before = wxTimeSpan(0, 0, 0, wxGetUTCTimeMillis());
       }
 
+      // Effects that transform each track independently, one after another,
+      // read and write each track once for all of them
+      auto [pChained, followers] =
+         ChainFollowers(mCommandMacro, mParamsMacro, i);
+      const auto nFollowers = followers.size();
+      if (pChained)
+         pChained->SetFollowers(move(followers));
+
       bool success = ApplyCommandInBatchMode(friendly, command, mParamsMacro[i]);
 
+      // The effect may have been skipped, leaving the followers to be
+      // applied each by itself
+      const auto nChained =
+         (pChained && pChained->TakeFollowers().empty()) ? nFollowers : 0;
+
       if (trace) {
          auto after = wxTimeSpan(0, 0, 0, wxGetUTCTimeMillis());
          wxLogMessage(wxT("Macro line #%ld took %s : %s:%s"),
@@ -708,10 +797,16 @@ bool MacroCommands::ApplyMacro(
             (after - before).Format(wxT("%H:%M:%S.%l")),
             command.GET(),
             mParamsMacro[i]);
+         for (size_t j = i + 1; j <= i + nChained; ++j)
+            wxLogMessage(wxT("Macro line #%ld applied in the same pass : %s:%s"),
+               j + 1,
+               mCommandMacro[j].GET(),
+               mParamsMacro[j]);
       }
 
       if (!success || mAbort)
          break;
+      i += nChained;
    }
 
    // Restore message level
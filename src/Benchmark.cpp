@@ -29,12 +29,21 @@ of sample block storage.
 #include <wx/valtext.h>
 
 #include "Project.h"
+#include "ProjectSerializer.h"
 #include "ProjectTimeSignature.h"
 #include "SampleBlock.h"
 #include "ShuttleGui.h"
 #include "TempoChange.h"
+#include "WaveChannelUtilities.h"
 #include "WaveClip.h"
 #include "WaveTrack.h"
+#include "XMLTagHandler.h"
+#include "effects/BassTreble.h"
+#include "effects/Paulstretch.h"
+#include "effects/RemoteEffectInstance.h"
+#include "effects/nyquist/Nyquist.h"
+#include "prefs/SpectrogramSettings.h"
+#include "tracks/playabletrack/wavetrack/ui/SpectrumCache.h"
 #include "Sequence.h"
 #include "Prefs.h"
 #include "ProjectRate.h"
@@ -573,6 +582,457 @@ void BenchmarkDialog::OnRun( wxCommandEvent & WXUNUSED(event))
    Printf( XO("At 44100 Hz, %d bytes per sample, the estimated number of\n simultaneous tracks that could be played at once: %.1f\n" )
       .Format( SAMPLE_SIZE(SampleFormat), (nChunks*chunkSize/44100.0)/(elapsed/1000.0) ) );
 
+   Printf( XO("Computing spectrograms...\n") );
+
+   wxTheApp->Yield();
+   FlushPrint();
+
+   {
+      // Recompute all columns of a spectrogram spanning the whole clip
+      constexpr size_t numPixels = 1000;
+      constexpr int frames = 20;
+      WaveClipChannel clip{ *t->GetClip(0), 0 };
+      auto &cache = WaveClipSpectrumCache::Get(clip);
+      const double pixelsPerSecond = numPixels / clip.GetPlayDuration();
+
+      const std::pair<int, TranslatableString> algorithms[] = {
+         { SpectrogramSettings::algSTFT, XO("Frequencies") },
+         { SpectrogramSettings::algReassignment, XO("Reassignment") },
+         { SpectrogramSettings::algPitchEAC, XO("Pitch (EAC)") },
+      };
+
+      for (const auto &[algorithm, name] : algorithms) {
+         SpectrogramSettings settings{ SpectrogramSettings::defaults() };
+         settings.algorithm = algorithm;
+
+         const float *spectrogram = nullptr;
+         const sampleCount *where = nullptr;
+
+         timer.Start();
+         for (int frame = 0; frame < frames; ++frame) {
+            cache.MarkChanged();
+            cache.GetSpectrogram(clip, spectrogram, settings, where,
+               numPixels, clip.GetPlayStartTime(), pixelsPerSecond);
+         }
+         elapsed = timer.Time();
+
+         Printf( XO("%s spectrogram: %.0f columns per second\n")
+            .Format( name,
+               frames * numPixels / (std::max(elapsed, 1L) / 1000.0) ) );
+      }
+   }
+
+   Printf( XO("Scanning for clipping...\n") );
+
+   wxTheApp->Yield();
+   FlushPrint();
+
+   {
+      // Count the samples at full scale by reading every sample, then by
+      // reading only what the summaries of the blocks can't decide
+      const auto &channel = **t->Channels().begin();
+      const sampleCount length = nChunks * chunkSize;
+      const auto isClipped = [](float sample){ return fabs(sample) >= 1.0f; };
+      long long counts[2]{};
+      long times[2]{};
+
+      timer.Start();
+      Floats buffer{ t->GetMaxBlockSize() };
+      for (sampleCount s = 0; s < length;) {
+         const auto count =
+            limitSampleBufferSize(t->GetBestBlockSize(s), length - s);
+         channel.GetFloats(buffer.get(), s, count);
+         counts[0] +=
+            std::count_if(buffer.get(), buffer.get() + count, isClipped);
+         s += count;
+      }
+      times[0] = timer.Time();
+
+      timer.Start();
+      WaveChannelUtilities::Scan(channel, 0, length,
+         [](const MinMaxRMS &summary) {
+            return (summary.max < 1.0f && summary.min > -1.0f)
+               ? Sequence::Verdict::None : Sequence::Verdict::Some;
+         },
+         [&](sampleCount, size_t count, const float *samples,
+            Sequence::Verdict) {
+            if (samples)
+               counts[1] += std::count_if(samples, samples + count, isClipped);
+            return true;
+         });
+      times[1] = timer.Time();
+
+      if (counts[0] != counts[1]) {
+         Printf( XO("Found %lld clipped samples reading all, %lld with summaries.\n")
+            .Format( counts[0], counts[1] ) );
+         goto fail;
+      }
+      Printf( XO("%lld clipped samples: %ld ms reading all, %ld ms with summaries\n")
+         .Format( counts[0], times[0], times[1] ) );
+   }
+
+   Printf( XO("Reading summaries for mid zoom...\n") );
+
+   wxTheApp->Yield();
+   FlushPrint();
+
+   {
+      // What the waveform reads of each block when drawn at 4k to 64k
+      // samples per pixel: the 4k summary, or as before, the 256 summary
+      // aggregated by 16 frames
+      constexpr int frames = 20;
+      const auto &blocks = t->GetClip(0)->GetSequence(0)->GetBlockArray();
+      std::vector<float> summaries[2];
+      long times[2]{};
+
+      for (int ii : { 0, 1 }) {
+         timer.Start();
+         for (int frame = 0; frame < frames; ++frame) {
+            summaries[ii].clear();
+            for (const auto &block : blocks) {
+               const auto frames4k =
+                  (block.sb->GetSampleCount() + 4095) / 4096;
+               const auto size = summaries[ii].size();
+               summaries[ii].resize(size + 3 * frames4k);
+               const auto dest = summaries[ii].data() + size;
+               if (ii == 0)
+                  block.sb->SampleBlock::GetSummary4k(dest, 0, frames4k);
+               else
+                  block.sb->GetSummary4k(dest, 0, frames4k);
+            }
+         }
+         times[ii] = timer.Time();
+      }
+
+      if (summaries[0] != summaries[1]) {
+         Printf( XO("The 4k summaries differ from the aggregated ones.\n") );
+         goto fail;
+      }
+      Printf( XO("%lld summary frames: %ld ms aggregating, %ld ms stored\n")
+         .Format( static_cast<long long>(summaries[0].size() / 3),
+            times[0], times[1] ) );
+   }
+
+   Printf( XO("Decoding a project document...\n") );
+
+   wxTheApp->Yield();
+   FlushPrint();
+
+   {
+      // A document shaped like that of a project with many clips, decoded
+      // as when the project is opened, by a handler that only counts tags
+      constexpr int nTracks = 1000;
+      constexpr int nClips = 10;
+      constexpr int nBlocks = 10;
+      constexpr int frames = 10;
+
+      ProjectSerializer writer;
+      writer.StartTag(wxT("project"));
+      for (int track = 0; track < nTracks; ++track) {
+         writer.StartTag(wxT("wavetrack"));
+         writer.WriteAttr(wxT("name"), wxString::Format(wxT("Track %d"), track));
+         writer.WriteAttr(wxT("rate"), 44100.0);
+         for (int clip = 0; clip < nClips; ++clip) {
+            writer.StartTag(wxT("waveclip"));
+            writer.WriteAttr(wxT("offset"), clip * 10.0, 8);
+            writer.WriteAttr(wxT("name"), wxString::Format(wxT("Clip %d"), clip));
+            writer.StartTag(wxT("sequence"));
+            writer.WriteAttr(wxT("maxsamples"), 262144);
+            for (int block = 0; block < nBlocks; ++block) {
+               writer.StartTag(wxT("waveblock"));
+               writer.WriteAttr(wxT("start"), block * 262144LL);
+               writer.WriteAttr(wxT("blockid"),
+                  ((track * nClips + clip) * nBlocks + block) + 1LL);
+               writer.EndTag(wxT("waveblock"));
+            }
+            writer.EndTag(wxT("sequence"));
+            writer.EndTag(wxT("waveclip"));
+         }
+         writer.EndTag(wxT("wavetrack"));
+      }
+      writer.EndTag(wxT("project"));
+
+      // The dictionary followed by the data, as LoadProject reads them
+      std::vector<uint8_t> doc;
+      for (const auto &stream : { &writer.GetDict(), &writer.GetData() })
+         for (const auto [data, size] : *stream) {
+            const auto bytes = static_cast<const uint8_t *>(data);
+            doc.insert(doc.end(), bytes, bytes + size);
+         }
+
+      struct Counter final : XMLTagHandler {
+         bool HandleXMLTag(const std::string_view &, const AttributesList &)
+            override { ++tags; return true; }
+         XMLTagHandler *HandleXMLChild(const std::string_view &) override
+            { return this; }
+         long long tags = 0;
+      } counter;
+
+      timer.Start();
+      for (int frame = 0; frame < frames; ++frame)
+         if (!ProjectSerializer::Decode(doc.data(), doc.size(), &counter)) {
+            Printf( XO("Decoding the project document failed.\n") );
+            goto fail;
+         }
+      elapsed = std::max(timer.Time(), 1L);
+
+      const long long expected =
+         frames * (1 + nTracks * (1 + nClips * (2 + nBlocks)));
+      if (counter.tags != expected) {
+         Printf( XO("Decoded %lld tags, expected %lld.\n")
+            .Format( counter.tags, expected ) );
+         goto fail;
+      }
+      Printf( XO("%.1f MB document: %.0f ms per decode, %.1f MB/s\n")
+         .Format( doc.size() / 1048576.0, elapsed / double(frames),
+            frames * doc.size() / 1048576.0 / (elapsed / 1000.0) ) );
+   }
+
+   Printf( XO("Applying Bass and Treble...\n") );
+
+   wxTheApp->Yield();
+   FlushPrint();
+
+   {
+      // Process ten seconds of copies of the track, one track after another,
+      // then concurrently
+      constexpr double seconds = 10.0;
+      constexpr double rate = 44100.0;
+      EffectBassTreble effect;
+
+      for (const size_t nTracks : { 1, 2, 4, 8, 16, 40 }) {
+         long times[2]{};
+         for (const bool concurrent : { false, true }) {
+            const auto tracks = TrackList::Temporary(nullptr);
+            double t1 = seconds;
+            for (size_t ii = 0; ii < nTracks; ++ii) {
+               const auto pCopy =
+                  std::static_pointer_cast<WaveTrack>(t->Duplicate());
+               pCopy->SetRate(rate);
+               pCopy->SetSelected(true);
+               t1 = std::min(t1, pCopy->GetEndTime());
+               tracks->Add(pCopy);
+            }
+
+            ConcurrentTrackProcessing.Write(concurrent);
+            effect.SetTracks(tracks.get());
+            effect.mT0 = 0;
+            effect.mT1 = t1;
+            auto settings = effect.MakeSettings();
+            const auto pInstance = std::dynamic_pointer_cast<EffectInstanceEx>(
+               effect.MakeInstance());
+
+            timer.Start();
+            const bool ok = pInstance && pInstance->Process(settings);
+            times[concurrent] = timer.Time();
+            effect.SetTracks(nullptr);
+            if (!ok) {
+               Printf( XO("Bass and Treble failed on %lld tracks.\n")
+                  .Format( static_cast<long long>(nTracks) ) );
+               goto fail;
+            }
+         }
+
+         Printf( XO("%lld tracks: %ld ms one at a time, %ld ms concurrently\n")
+            .Format( static_cast<long long>(nTracks), times[0], times[1] ) );
+      }
+   }
+
+   Printf( XO("Applying Paulstretch...\n") );
+
+   wxTheApp->Yield();
+   FlushPrint();
+
+   {
+      // Stretch ten seconds of a copy of the track, transforming one window
+      // at a time, then batches of windows concurrently
+      constexpr double seconds = 10.0;
+      constexpr double rate = 44100.0;
+      long times[2]{};
+      for (const bool concurrent : { false, true }) {
+         EffectPaulstretch effect;
+         const auto tracks = TrackList::Temporary(nullptr);
+         const auto pCopy =
+            std::static_pointer_cast<WaveTrack>(t->Duplicate());
+         pCopy->SetRate(rate);
+         pCopy->SetSelected(true);
+         tracks->Add(pCopy);
+
+         ConcurrentTrackProcessing.Write(concurrent);
+         effect.SetTracks(tracks.get());
+         effect.mT0 = 0;
+         effect.mT1 = std::min(seconds, pCopy->GetEndTime());
+         auto settings = effect.MakeSettings();
+         const auto pInstance = std::dynamic_pointer_cast<EffectInstanceEx>(
+            effect.MakeInstance());
+
+         timer.Start();
+         const bool ok = pInstance && pInstance->Process(settings);
+         times[concurrent] = timer.Time();
+         effect.SetTracks(nullptr);
+         if (!ok) {
+            Printf( XO("Paulstretch failed.\n") );
+            goto fail;
+         }
+      }
+
+      Printf( XO("Paulstretch: %ld ms one window at a time, %ld ms concurrently\n")
+         .Format( times[0], times[1] ) );
+   }
+
+   Printf( XO("Applying a Nyquist effect...\n") );
+
+   wxTheApp->Yield();
+   FlushPrint();
+
+   {
+      // Halve a minute of a copy of the track in Nyquist, fetching the
+      // samples chunk by chunk, then block by block; the results must agree
+      constexpr double seconds = 60.0;
+      constexpr double rate = 44100.0;
+      long times[2]{};
+      std::shared_ptr<TrackList> results[2];
+      for (const bool blocks : { false, true }) {
+         NyquistEffect effect{ NYQUIST_WORKER_ID };
+         effect.SetCommand(wxT(";version 3\n;type process\n(mult s 0.5)"));
+
+         const auto tracks = TrackList::Temporary(nullptr);
+         const auto pCopy =
+            std::static_pointer_cast<WaveTrack>(t->Duplicate());
+         pCopy->SetRate(rate);
+         pCopy->SetSelected(true);
+         tracks->Add(pCopy);
+
+         NyquistBlockTransfer.Write(blocks);
+         effect.SetTracks(tracks.get());
+         effect.mT0 = 0;
+         effect.mT1 = std::min(seconds, pCopy->GetEndTime());
+         auto settings = effect.MakeSettings();
+         const auto pInstance = std::dynamic_pointer_cast<EffectInstanceEx>(
+            effect.MakeInstance());
+
+         timer.Start();
+         const bool ok = pInstance && pInstance->Process(settings);
+         times[blocks] = timer.Time();
+         effect.SetTracks(nullptr);
+         if (!ok) {
+            Printf( XO("Nyquist failed.\n") );
+            goto fail;
+         }
+         results[blocks] = tracks;
+      }
+
+      const auto &first = **results[0]->Any<const WaveTrack>().begin();
+      const auto &second = **results[1]->Any<const WaveTrack>().begin();
+      const auto len = first.TimeToLongSamples(first.GetEndTime());
+      if (len != second.TimeToLongSamples(second.GetEndTime())) {
+         Printf( XO("Nyquist results differ in length.\n") );
+         goto fail;
+      }
+      const size_t bufferLen = first.GetMaxBlockSize();
+      Floats buffers[2]{ Floats{ bufferLen }, Floats{ bufferLen } };
+      for (sampleCount start = 0; start < len; start += bufferLen) {
+         const auto count = limitSampleBufferSize(bufferLen, len - start);
+         if (!(**first.Channels().begin()).GetFloats(
+               buffers[0].get(), start, count) ||
+             !(**second.Channels().begin()).GetFloats(
+               buffers[1].get(), start, count) ||
+             !std::equal(buffers[0].get(), buffers[0].get() + count,
+               buffers[1].get())) {
+            Printf( XO("Nyquist results differ.\n") );
+            goto fail;
+         }
+      }
+
+      Printf( XO("Nyquist: %ld ms fetching chunks, %ld ms sharing blocks\n")
+         .Format( times[0], times[1] ) );
+   }
+
+   Printf( XO("Applying Bass and Treble in an effect host...\n") );
+
+   wxTheApp->Yield();
+   FlushPrint();
+
+   {
+      // Process ten seconds of a copy of the track in this process, then in
+      // an effect host process, handing the blocks over in shared memory; the
+      // results must agree.  Bass and Treble is built in, so its instance is
+      // replaced explicitly
+      constexpr double seconds = 10.0;
+      constexpr double rate = 44100.0;
+      ConcurrentTrackProcessing.Write(false);
+      long times[2]{};
+      long startTime = 0;
+      std::shared_ptr<TrackList> results[2];
+      for (const bool isolated : { false, true }) {
+         EffectBassTreble effect;
+         const auto tracks = TrackList::Temporary(nullptr);
+         const auto pCopy =
+            std::static_pointer_cast<WaveTrack>(t->Duplicate());
+         pCopy->SetRate(rate);
+         pCopy->SetSelected(true);
+         tracks->Add(pCopy);
+
+         effect.SetTracks(tracks.get());
+         effect.mT0 = 0;
+         effect.mT1 = std::min(seconds, pCopy->GetEndTime());
+         auto settings = effect.MakeSettings();
+         const auto pInstance = std::dynamic_pointer_cast<EffectInstanceEx>(
+            effect.MakeInstance());
+
+         std::shared_ptr<EffectInstance> pRemote;
+         std::optional<PerTrackEffect::IsolatedInstance::Scope> scope;
+         if (isolated && pInstance) {
+            timer.Start();
+            pRemote = RemoteEffectInstance::Make(effect, *pInstance);
+            startTime = timer.Time();
+            if (!pRemote) {
+               effect.SetTracks(nullptr);
+               Printf( XO("Could not start an effect host.\n") );
+               goto fail;
+            }
+            scope.emplace([&pRemote](const PerTrackEffect &,
+               const EffectInstance &) { return pRemote; });
+         }
+
+         timer.Start();
+         const bool ok = pInstance && pInstance->Process(settings);
+         times[isolated] = timer.Time();
+         scope.reset();
+         effect.SetTracks(nullptr);
+         if (!ok) {
+            Printf( XO("Bass and Treble failed.\n") );
+            goto fail;
+         }
+         results[isolated] = tracks;
+      }
+
+      const auto &first = **results[0]->Any<const WaveTrack>().begin();
+      const auto &second = **results[1]->Any<const WaveTrack>().begin();
+      const auto len = first.TimeToLongSamples(first.GetEndTime());
+      if (len != second.TimeToLongSamples(second.GetEndTime())) {
+         Printf( XO("Bass and Treble results differ in length.\n") );
+         goto fail;
+      }
+      const size_t bufferLen = first.GetMaxBlockSize();
+      Floats buffers[2]{ Floats{ bufferLen }, Floats{ bufferLen } };
+      for (sampleCount start = 0; start < len; start += bufferLen) {
+         const auto count = limitSampleBufferSize(bufferLen, len - start);
+         if (!(**first.Channels().begin()).GetFloats(
+               buffers[0].get(), start, count) ||
+             !(**second.Channels().begin()).GetFloats(
+               buffers[1].get(), start, count) ||
+             !std::equal(buffers[0].get(), buffers[0].get() + count,
+               buffers[1].get())) {
+            Printf( XO("Bass and Treble results differ.\n") );
+            goto fail;
+         }
+      }
+
+      Printf( XO("Bass and Treble: %ld ms in this process, %ld ms in an effect host, which took %ld ms to start\n")
+         .Format( times[0], times[1], startTime ) );
+   }
+
    goto success;
 
  fail:
@@ -12,10 +12,13 @@
 
 #include "MemoryX.h"
 #include "FrameStatistics.h"
+#include "waveform/WaveDataCacheWorkers.h"
+#include "GraphicsDataCacheGovernor.h"
 
 #include "ShuttleGui.h"
 #include "wxPanelWrapper.h"
 
+#include <limits>
 #include <string>
 
 #include <wx/stattext.h>
@@ -45,11 +48,40 @@ public:
             AddSection(S, FrameStatistics::SectionID::WaveBitmapCachePreprocess);
             S.AddFixedText(Verbatim("WaveBitmapCache Lookups"));
             AddSection(S, FrameStatistics::SectionID::WaveBitmapCache);
+            S.AddFixedText(Verbatim("WaveDataCache Background Loading"));
+            AddSection(S, FrameStatistics::SectionID::WaveDataCacheBackground);
+            S.StartMultiColumn(2, wxEXPAND);
+            {
+               S.AddFixedText(Verbatim("Queued:"));
+               mQueueDepth = S.AddVariableText({});
+            }
+            S.EndMultiColumn();
+            S.AddFixedText(Verbatim("Graphics Data Caches"));
+            S.StartMultiColumn(2, wxEXPAND);
+            {
+               S.AddFixedText(Verbatim("Memory:"));
+               mCacheMemory = S.AddVariableText({});
+
+               S.AddFixedText(Verbatim("Hit rate:"));
+               mCacheHitRate = S.AddVariableText({});
+
+               S.AddFixedText(Verbatim("Clips:"));
+               mCacheClips = S.AddVariableText({});
+
+               S.AddFixedText(Verbatim("Avg per clip:"));
+               mCacheAveragePerClip = S.AddVariableText({});
+
+               S.AddFixedText(Verbatim("Max per clip:"));
+               mCacheMaxPerClip = S.AddVariableText({});
+            }
+            S.EndMultiColumn();
          }
          S.EndVerticalLay();
       }
       S.EndPanel();
 
+      CacheStatisticsUpdated();
+
       Layout();
       Fit();
 
@@ -62,11 +94,28 @@ public:
          wxEVT_IDLE,
          [this](wxIdleEvent& evt)
          {
+            bool framePainted = false;
+
             for (size_t i = 0; i < size_t(FrameStatistics::SectionID::Count);
                  ++i)
             {
                if (mSections[i].Dirty)
+               {
                   SectionUpdated(FrameStatistics::SectionID(i));
+                  framePainted = true;
+               }
+            }
+
+            if (framePainted)
+               CacheStatisticsUpdated();
+
+            const auto queueDepth =
+               WaveDataCacheWorkers::Get().GetQueueDepth();
+
+            if (queueDepth != mLastQueueDepth)
+            {
+               mLastQueueDepth = queueDepth;
+               mQueueDepth->SetLabel(std::to_string(queueDepth));
             }
          });
    }
@@ -141,7 +190,39 @@ private:
       bool Dirty { true };
    };
 
+   void CacheStatisticsUpdated()
+   {
+      const auto& governor = GraphicsDataCacheGovernor::Get();
+
+      const auto statistics = governor.GetStatistics();
+      const auto owners = governor.GetOwnerStatistics();
+
+      mCacheMemory->SetLabel(
+         FormatBytes(statistics.Bytes) + " / " +
+         FormatBytes(governor.GetBudget()));
+      mCacheHitRate->SetLabel(
+         std::to_string(statistics.GetHitRate() * 100.0) + " %");
+      mCacheClips->SetLabel(std::to_string(owners.size()));
+      mCacheAveragePerClip->SetLabel(FormatBytes(
+         owners.empty() ? 0 : statistics.Bytes / owners.size()));
+      mCacheMaxPerClip->SetLabel(FormatBytes(
+         owners.empty() ? 0 : owners.front().Statistics.Bytes));
+   }
+
+   wxString FormatBytes(size_t bytes)
+   {
+      return std::to_string(bytes / 1024) + " KB";
+   }
+
    Section mSections[size_t(FrameStatistics::SectionID::Count)];
+   wxStaticText* mQueueDepth {};
+   size_t mLastQueueDepth { std::numeric_limits<size_t>::max() };
+
+   wxStaticText* mCacheMemory {};
+   wxStaticText* mCacheHitRate {};
+   wxStaticText* mCacheClips {};
+   wxStaticText* mCacheAveragePerClip {};
+   wxStaticText* mCacheMaxPerClip {};
 
    Observer::Subscription mStatisticsUpdated;
 };
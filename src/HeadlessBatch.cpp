@@ -0,0 +1,620 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file HeadlessBatch.cpp
+
+**********************************************************************/
+
+#include "HeadlessBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <wx/app.h>
+#include <wx/cmdline.h>
+#include <wx/filename.h>
+#include <wx/process.h>
+#include <wx/thread.h>
+#include <wx/utils.h>
+
+#include "AudacityException.h"
+#include "BasicUI.h"
+#include "BatchCommands.h"
+#include "Clipboard.h"
+#include "CommandLineArgs.h"
+#include "PlatformCompatibility.h"
+#include "Prefs.h"
+#include "Project.h"
+#include "ProjectFileManager.h"
+#include "ProjectManager.h"
+#include "SelectUtilities.h"
+#include "TempDirectory.h"
+#include "Track.h"
+
+namespace {
+
+//! First argument of a worker process, followed by its directory
+const auto WorkerArgument = "--batch-worker";
+
+const auto MacroOption = wxT("batch-macro");
+const auto JobsOption = wxT("batch-jobs");
+const auto MemoryOption = wxT("batch-memory");
+const auto TimeoutOption = wxT("batch-timeout");
+
+//! Lines written by a worker to its standard output; anything else that it
+//! has to say goes to its standard error
+const std::string ReadyReply = "ready";
+const std::string DoneReply = "done";
+const std::string FailedReply = "failed";
+
+//! Estimates for the memory budget:  the worker process, before any file...
+constexpr unsigned long long WorkerFootprint = 256ull << 20;
+//! ... and the size of a file multiplied by this, for the decoded samples,
+//! which may be larger than the file, and a copy made by an effect
+constexpr unsigned long long ExpansionFactor = 4;
+
+//! Milliseconds between polls of the workers
+constexpr unsigned long PollInterval = 10;
+
+//! Seconds that a worker may spend on one file, unless given on the command
+//! line
+constexpr long DefaultTimeout = 600;
+
+using Clock = std::chrono::steady_clock;
+
+wxString WorkerDirectory()
+{
+   return wxString{ CommandLineArgs::argv[2] };
+}
+
+void Print(const TranslatableString &title, const TranslatableString &message)
+{
+   if (title.empty())
+      wxFprintf(stderr, "%s\n", message.Translation());
+   else
+      wxFprintf(stderr, "%s: %s\n", title.Translation(), message.Translation());
+}
+
+class HeadlessProgress final : public BasicUI::ProgressDialog
+{
+public:
+   ~HeadlessProgress() override = default;
+   BasicUI::ProgressResult Poll(
+      unsigned long long, unsigned long long, const TranslatableString &)
+      override
+   {
+      return BasicUI::ProgressResult::Success;
+   }
+   void SetMessage(const TranslatableString &) override {}
+   void SetDialogTitle(const TranslatableString &) override {}
+   void Reinit() override {}
+};
+
+class HeadlessGenericProgress final : public BasicUI::GenericProgressDialog
+{
+public:
+   ~HeadlessGenericProgress() override = default;
+   BasicUI::ProgressResult Pulse() override
+   {
+      return BasicUI::ProgressResult::Success;
+   }
+};
+
+//! Prints what would be shown in dialogs, and answers none of the questions
+class HeadlessServices final : public BasicUI::Services
+{
+public:
+   ~HeadlessServices() override = default;
+
+protected:
+   void DoCallAfter(const BasicUI::Action &action) override
+   {
+      wxTheApp->CallAfter(action);
+   }
+   void DoYield() override
+   {
+      wxTheApp->Yield();
+   }
+   void DoShowErrorDialog(const BasicUI::WindowPlacement &,
+      const TranslatableString &dlogTitle,
+      const TranslatableString &message,
+      const ManualPageID &,
+      const BasicUI::ErrorDialogOptions &) override
+   {
+      Print(dlogTitle, message);
+   }
+   BasicUI::MessageBoxResult DoMessageBox(
+      const TranslatableString &message,
+      BasicUI::MessageBoxOptions options) override
+   {
+      Print(options.caption, message);
+      return BasicUI::MessageBoxResult::None;
+   }
+   std::unique_ptr<BasicUI::ProgressDialog>
+   DoMakeProgress(const TranslatableString &,
+      const TranslatableString &,
+      unsigned,
+      const TranslatableString &) override
+   {
+      return std::make_unique<HeadlessProgress>();
+   }
+   std::unique_ptr<BasicUI::GenericProgressDialog>
+   DoMakeGenericProgress(const BasicUI::WindowPlacement &,
+      const TranslatableString &,
+      const TranslatableString &) override
+   {
+      return std::make_unique<HeadlessGenericProgress>();
+   }
+   int DoMultiDialog(const TranslatableString &message,
+      const TranslatableString &title,
+      const TranslatableStrings &,
+      const ManualPageID &,
+      const TranslatableString &, bool) override
+   {
+      Print(title, message);
+      return 0;
+   }
+   bool DoOpenInDefaultBrowser(const wxString &) override
+   {
+      return false;
+   }
+   std::unique_ptr<BasicUI::WindowPlacement> DoFindFocus() override
+   {
+      return std::make_unique<BasicUI::WindowPlacement>();
+   }
+   void DoSetFocus(const BasicUI::WindowPlacement &) override {}
+   bool IsUsingRtlLayout() const override
+   {
+      return false;
+   }
+   bool IsUiThread() const override
+   {
+      return wxIsMainThread();
+   }
+};
+
+void Reply(const std::string &line)
+{
+   fputs(line.c_str(), stdout);
+   fputc('\n', stdout);
+   fflush(stdout);
+}
+
+int RunWorker(AudacityProject &project, const wxString &macro)
+{
+   MacroCommands macroCommands{ project };
+   macroCommands.ReadMacro(macro);
+   const MacroCommandsCatalog catalog{ &project };
+
+   auto &globalClipboard = Clipboard::Get();
+   // Move global clipboard contents aside temporarily
+   Clipboard::Scope scope;
+
+   Reply(ReadyReply);
+
+   // Each line of input names one file; the end of input means quit
+   std::string line;
+   while (std::getline(std::cin, line)) {
+      if (!line.empty() && line.back() == '\r')
+         line.pop_back();
+      const auto fileName = wxString::FromUTF8(line);
+
+      double duration = 0;
+      auto success = GuardedCall<bool>([&] {
+         if (!ProjectFileManager::Get(project).Import(fileName, false))
+            return false;
+         duration = TrackList::Get(project).GetEndTime();
+         SelectUtilities::DoSelectAll(project);
+         return macroCommands.ApplyMacro(catalog);
+      });
+
+      // Ensure project is completely reset, as ApplyMacroDialog does
+      ProjectManager::Get(project).ResetProjectToEmpty();
+      globalClipboard.Clear();
+
+      Reply(success
+         ? DoneReply + ' ' + std::to_string(duration)
+         : FailedReply);
+   }
+   return 0;
+}
+
+class WorkerProcess final : public wxProcess
+{
+public:
+   WorkerProcess() { Redirect(); }
+
+   //! Unlike the default, does not delete this
+   void OnTerminate(int, int) override { mTerminated = true; }
+
+   bool mTerminated{ false };
+};
+
+class Coordinator final
+{
+public:
+   Coordinator(const wxString &macro, const wxArrayString &files,
+      size_t nWorkers, unsigned long long fileBudget,
+      std::chrono::seconds timeout);
+
+   //! @return exit code for the process
+   int Run();
+
+private:
+   struct Worker {
+      std::unique_ptr<WorkerProcess> pProcess;
+      //! A partial line of output
+      std::string output;
+      bool ready{ false };
+      bool busy{ false };
+      //! Killed for exceeding the deadline, and not yet terminated
+      bool killed{ false };
+      size_t file{ 0 };
+      Clock::time_point start;
+   };
+
+   bool Spawn(Worker &worker);
+   void Poll(Worker &worker);
+   void OnReply(Worker &worker, const std::string &line);
+   void Dispatch(Worker &worker);
+   void Finish(Worker &worker, bool success, double duration);
+   //! Stops a worker that exceeded the deadline for its file, which fails;
+   //! another worker replaces it once it has terminated
+   void Kill(Worker &worker);
+   //! Counts all files not yet given to a worker as failed
+   void Abandon();
+
+   const wxString mMacro;
+   const wxArrayString mFiles;
+   std::vector<unsigned long long> mSizes;
+   const unsigned long long mFileBudget;
+   const std::chrono::seconds mTimeout;
+   const wxString mDirectory;
+   std::vector<Worker> mWorkers;
+   size_t mSpawned{ 0 };
+
+   //! Index of the next file to give to a worker
+   size_t mNext{ 0 };
+   size_t mDone{ 0 };
+   size_t mFailed{ 0 };
+   //! Estimated memory taken by the files in progress
+   unsigned long long mInFlight{ 0 };
+   unsigned long long mBytes{ 0 };
+   double mAudioSeconds{ 0 };
+};
+
+Coordinator::Coordinator(const wxString &macro, const wxArrayString &files,
+   size_t nWorkers, unsigned long long fileBudget,
+   std::chrono::seconds timeout)
+   : mMacro{ macro }
+   , mFiles{ files }
+   , mFileBudget{ fileBudget }
+   , mTimeout{ timeout }
+   , mDirectory{ wxFileName{ TempDirectory::TempDir(),
+      wxString::Format(wxT("batch-%lu"), wxGetProcessId()) }.GetFullPath() }
+   , mWorkers(nWorkers)
+{
+   for (const auto &file : files) {
+      const auto size = wxFileName::GetSize(file);
+      mSizes.push_back(size == wxInvalidSize ? 0 : size.GetValue());
+   }
+}
+
+int Coordinator::Run()
+{
+   const auto startTime = Clock::now();
+   wxFileName::Mkdir(mDirectory, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
+
+   while (mDone < mFiles.size()) {
+      for (auto &worker : mWorkers) {
+         // A worker that quit, perhaps crashing on a file, is replaced
+         if (!worker.pProcess && mNext < mFiles.size() && !Spawn(worker))
+            Abandon();
+         if (worker.pProcess)
+            Poll(worker);
+         if (worker.pProcess && worker.busy &&
+             Clock::now() - worker.start > mTimeout)
+            Kill(worker);
+         if (worker.pProcess && worker.ready && !worker.busy)
+            Dispatch(worker);
+      }
+      BasicUI::Yield();
+      wxMilliSleep(PollInterval);
+   }
+
+   // The end of input lets the workers quit
+   for (auto &worker : mWorkers)
+      if (worker.pProcess)
+         worker.pProcess->CloseOutput();
+   while (std::any_of(mWorkers.begin(), mWorkers.end(),
+      [](const Worker &worker){ return worker.pProcess != nullptr; })
+   ) {
+      for (auto &worker : mWorkers)
+         if (worker.pProcess)
+            Poll(worker);
+      BasicUI::Yield();
+      wxMilliSleep(PollInterval);
+   }
+   wxFileName::Rmdir(mDirectory, wxPATH_RMDIR_RECURSIVE);
+
+   const auto seconds = std::max(1e-3,
+      std::chrono::duration<double>(Clock::now() - startTime).count());
+   wxPrintf(_("%d of %d files done in %.2f s by %d workers: "
+      "%.1f files per minute, %.1f times real time, %.2f MB/s\n"),
+      int(mDone - mFailed), int(mFiles.size()), seconds, int(mWorkers.size()),
+      60 * (mDone - mFailed) / seconds, mAudioSeconds / seconds,
+      mBytes / seconds / (1 << 20));
+   fflush(stdout);
+
+   return mFailed == 0 ? 0 : 1;
+}
+
+bool Coordinator::Spawn(Worker &worker)
+{
+   const auto directory = wxFileName{ mDirectory,
+      wxString::Format(wxT("worker-%d"), int(mSpawned++)) }.GetFullPath();
+   if (!wxFileName::Mkdir(directory, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+      return false;
+
+   // Pass the arguments unparsed, so that no quoting is needed for any
+   // characters in the paths or the macro name
+   const wxString args[] = {
+      PlatformCompatibility::GetExecutablePath(),
+      WorkerArgument, directory,
+      wxString{ wxT("--") } + MacroOption, mMacro
+   };
+   std::vector<const wxChar *> argv;
+   for (const auto &arg : args)
+      argv.push_back(arg.wc_str());
+   argv.push_back(nullptr);
+
+   auto pProcess = std::make_unique<WorkerProcess>();
+   if (wxExecute(argv.data(),
+      wxEXEC_ASYNC | wxEXEC_HIDE_CONSOLE, pProcess.get()) == 0)
+      return false;
+   worker = {};
+   worker.pProcess = std::move(pProcess);
+   return true;
+}
+
+void Coordinator::Poll(Worker &worker)
+{
+   auto &process = *worker.pProcess;
+
+   // Pass on the messages of the worker
+   while (process.IsErrorAvailable()) {
+      const auto c = process.GetErrorStream()->GetC();
+      if (c == wxEOF)
+         break;
+      fputc(c, stderr);
+   }
+
+   while (process.IsInputAvailable()) {
+      const auto c = process.GetInputStream()->GetC();
+      if (c == wxEOF)
+         break;
+      if (c == '\n') {
+         if (!worker.output.empty() && worker.output.back() == '\r')
+            worker.output.pop_back();
+         OnReply(worker, worker.output);
+         worker.output.clear();
+      }
+      else
+         worker.output.push_back(char(c));
+   }
+
+   if (process.mTerminated &&
+       !process.IsInputAvailable() && !process.IsErrorAvailable()) {
+      if (worker.busy)
+         Finish(worker, false, 0);
+      else if (!worker.ready && !worker.killed)
+         // It could not start, and others would fail likewise
+         Abandon();
+      worker.pProcess.reset();
+   }
+}
+
+void Coordinator::OnReply(Worker &worker, const std::string &line)
+{
+   if (line == ReadyReply)
+      worker.ready = true;
+   else if (worker.busy && line.compare(0, DoneReply.size(), DoneReply) == 0)
+      Finish(worker, true, std::strtod(line.c_str() + DoneReply.size(), nullptr));
+   else if (worker.busy && line == FailedReply)
+      Finish(worker, false, 0);
+   else
+      fprintf(stderr, "%s\n", line.c_str());
+}
+
+void Coordinator::Dispatch(Worker &worker)
+{
+   if (mNext == mFiles.size())
+      return;
+
+   // Files are taken in order; one too large for the budget goes alone
+   const auto footprint = mSizes[mNext] * ExpansionFactor;
+   if (mInFlight > 0 && mInFlight + footprint > mFileBudget)
+      return;
+
+   mInFlight += footprint;
+   worker.file = mNext++;
+   worker.busy = true;
+   worker.start = Clock::now();
+
+   const auto line = mFiles[worker.file].ToUTF8();
+   auto &stream = *worker.pProcess->GetOutputStream();
+   stream.Write(line.data(), line.length());
+   stream.PutC('\n');
+}
+
+void Coordinator::Finish(Worker &worker, bool success, double duration)
+{
+   const auto seconds = std::max(1e-3,
+      std::chrono::duration<double>(Clock::now() - worker.start).count());
+   mInFlight -= mSizes[worker.file] * ExpansionFactor;
+   worker.busy = false;
+   ++mDone;
+
+   const auto &file = mFiles[worker.file];
+   if (success) {
+      mAudioSeconds += duration;
+      mBytes += mSizes[worker.file];
+      wxPrintf(_("%s: done in %.2f s, %.1f times real time\n"),
+         file, seconds, duration / seconds);
+   }
+   else {
+      ++mFailed;
+      wxPrintf(_("%s: failed after %.2f s\n"), file, seconds);
+   }
+   fflush(stdout);
+}
+
+void Coordinator::Kill(Worker &worker)
+{
+   // The worker may be stuck in a plug-in, or waiting for an answer that
+   // nobody gives; it can't be asked to give up on the file
+   wxFprintf(stderr, _("%s: no result after %ld s, stopping its worker\n"),
+      mFiles[worker.file], static_cast<long>(mTimeout.count()));
+   wxProcess::Kill(worker.pProcess->GetPid(), wxSIGKILL, wxKILL_CHILDREN);
+   worker.ready = false;
+   worker.killed = true;
+   Finish(worker, false, 0);
+}
+
+void Coordinator::Abandon()
+{
+   for (; mNext < mFiles.size(); ++mNext) {
+      ++mDone;
+      ++mFailed;
+      wxPrintf(_("%s: not processed\n"), mFiles[mNext]);
+   }
+   fflush(stdout);
+}
+
+int RunCoordinator(const wxCmdLineParser &parser, const wxString &macro)
+{
+   if (MacroCommands::GetNames().Index(macro) == wxNOT_FOUND) {
+      wxPrintf(_("There is no macro named %s\n"), macro);
+      return 1;
+   }
+
+   wxArrayString files;
+   for (size_t i = 0, cnt = parser.GetParamCount(); i < cnt; ++i)
+      files.push_back(parser.GetParam(i));
+   if (files.empty()) {
+      wxPrintf(_("No files to process\n"));
+      return 1;
+   }
+
+   long jobs = 0;
+   if (!parser.Found(JobsOption, &jobs) || jobs < 1)
+      jobs = std::max(1, wxThread::GetCPUCount());
+
+   // By default, half of the memory that is free now
+   auto budget = std::numeric_limits<unsigned long long>::max();
+   long megabytes = 0;
+   if (parser.Found(MemoryOption, &megabytes) && megabytes > 0)
+      budget = static_cast<unsigned long long>(megabytes) << 20;
+   else if (const auto freeMemory = wxGetFreeMemory(); freeMemory > 0)
+      budget = freeMemory.GetValue() / 2;
+
+   // Each worker takes its share of the budget before any file
+   const auto nWorkers = std::max<unsigned long long>(1, std::min({
+      static_cast<unsigned long long>(jobs),
+      static_cast<unsigned long long>(files.size()),
+      budget / WorkerFootprint }));
+   const auto fileBudget =
+      budget - std::min(budget, nWorkers * WorkerFootprint);
+
+   long timeout = 0;
+   if (!parser.Found(TimeoutOption, &timeout) || timeout < 1)
+      timeout = DefaultTimeout;
+
+   Coordinator coordinator{ macro, files, static_cast<size_t>(nWorkers),
+      fileBudget, std::chrono::seconds{ timeout } };
+   return coordinator.Run();
+}
+
+}
+
+void HeadlessBatch::AddCommandLineOptions(wxCmdLineParser &parser)
+{
+   /*i18n-hint: This applies a macro to the files named on the command line,
+    *           without showing any windows */
+   parser.AddOption({}, MacroOption,
+      _("apply the named macro to the files, without windows, and exit"));
+   /*i18n-hint: This sets how many files the batch processing does at once */
+   parser.AddOption({}, JobsOption,
+      _("number of files to process at once with --batch-macro"),
+      wxCMD_LINE_VAL_NUMBER);
+   /*i18n-hint: This limits the memory that the batch processing uses */
+   parser.AddOption({}, MemoryOption,
+      _("memory budget in megabytes for --batch-macro"),
+      wxCMD_LINE_VAL_NUMBER);
+   /*i18n-hint: This limits the time that the batch processing spends on
+    *           one file */
+   parser.AddOption({}, TimeoutOption,
+      _("seconds after which --batch-macro gives up on a file"),
+      wxCMD_LINE_VAL_NUMBER);
+   // Given by the coordinator to its workers, but not for users
+   parser.AddOption({}, wxString{ WorkerArgument }.Mid(2), {},
+      wxCMD_LINE_VAL_STRING, wxCMD_LINE_HIDDEN);
+}
+
+bool HeadlessBatch::IsRequested(const wxCmdLineParser &parser)
+{
+   return parser.Found(MacroOption);
+}
+
+bool HeadlessBatch::IsWorkerProcess()
+{
+   return CommandLineArgs::argc >= 3 &&
+      wxStrcmp(CommandLineArgs::argv[1], WorkerArgument) == 0;
+}
+
+FilePath HeadlessBatch::PrivateSettingsFile(const FilePath &path)
+{
+   if (!IsWorkerProcess())
+      return path;
+
+   wxFileName copy{ path };
+   copy.SetPath(WorkerDirectory());
+   if (!copy.FileExists() && wxFileExists(path))
+      wxCopyFile(path, copy.GetFullPath());
+   return copy.GetFullPath();
+}
+
+void HeadlessBatch::ConfigureWorker()
+{
+   if (!IsWorkerProcess())
+      return;
+
+   const auto temp =
+      wxFileName{ WorkerDirectory(), wxT("temp") }.GetFullPath();
+   gPrefs->Write(PreferenceKey(
+      FileNames::Operation::Temp, FileNames::PathType::_None), temp);
+   gPrefs->Flush();
+}
+
+void HeadlessBatch::InstallServices()
+{
+   static HeadlessServices services;
+   (void)BasicUI::Install(&services);
+}
+
+int HeadlessBatch::Run(const wxCmdLineParser &parser, AudacityProject *pProject)
+{
+   wxString macro;
+   parser.Found(MacroOption, &macro);
+   if (pProject)
+      return RunWorker(*pProject, macro);
+   return RunCoordinator(parser, macro);
+}
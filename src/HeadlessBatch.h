@@ -0,0 +1,69 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file HeadlessBatch.h
+  @brief Applying a macro to many files without windows, in worker processes
+
+**********************************************************************/
+
+#ifndef __AUDACITY_HEADLESS_BATCH__
+#define __AUDACITY_HEADLESS_BATCH__
+
+#include "FileNames.h"
+
+class wxCmdLineParser;
+class AudacityProject;
+
+//! Batch processing from the command line
+/*!
+ The process started by the user is the coordinator.  It never opens a
+ project, but starts worker processes of the same executable, and gives each
+ file to the next idle worker, while the files in progress fit the memory
+ budget.  It reports the time taken for each file, and the throughput.  A
+ worker that takes longer than the deadline on one file is killed, the file
+ counts as failed, and a new worker takes its place.
+
+ Each worker has one hidden project, and its own directory for temporary
+ files and for copies of the settings files, so that the workers may never
+ write to the same file.  Projects, commands and effects belong to the main
+ thread of a process, so processes, not threads, make the files independent.
+
+ No window is shown, but the processes still initialize the toolkit.  Under
+ GTK that needs a display, so on a server without one, run the command under
+ a virtual display, such as with xvfb-run.
+ */
+namespace HeadlessBatch {
+
+//! Adds the options for batch processing to the command line parser
+void AddCommandLineOptions(wxCmdLineParser &parser);
+
+//! Whether the parsed command line asks for batch processing
+bool IsRequested(const wxCmdLineParser &parser);
+
+//! Whether this process is a worker started by a coordinator
+/*! Decided from CommandLineArgs, so it may be called before preferences exist */
+bool IsWorkerProcess();
+
+//! The path of the settings file to use in place of path
+/*! In a worker, a copy of the file in its own directory, made on first use;
+ else, path itself */
+FilePath PrivateSettingsFile(const FilePath &path);
+
+//! In a worker, points the temporary directory preference at its own directory
+void ConfigureWorker();
+
+//! Replaces the BasicUI services, so that messages are printed and progress
+//! is not shown
+void InstallServices();
+
+//! Processes all files of the command line, or, in a worker, those it is given
+/*!
+ @param pProject the hidden project of a worker; else null
+ @return exit code for the process
+ */
+int Run(const wxCmdLineParser &parser, AudacityProject *pProject);
+
+}
+
+#endif
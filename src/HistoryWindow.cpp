@@ -36,7 +36,6 @@ undo memory so as to free up space.
 #include "../images/Arrow.xpm"
 #include "../images/Empty9x16.xpm"
 #include "UndoManager.h"
-#include "UndoTracks.h"
 #include "Project.h"
 #include "ProjectFileIO.h"
 #include "ProjectHistory.h"
@@ -52,62 +51,20 @@ undo memory so as to free up space.
 
 namespace {
 using namespace WaveTrackUtilities;
-struct SpaceUsageCalculator {
-   using Type = unsigned long long;
-   using SpaceArray = std::vector<Type> ;
-
-   Type CalculateUsage(const TrackList &tracks, SampleBlockIDSet &seen)
-   {
-      Type result = 0;
-      //TIMER_START( "CalculateSpaceUsage", space_calc );
-      InspectBlocks(
-         tracks,
-         BlockSpaceUsageAccumulator( result ),
-         &seen
-      );
-      return result;
-   }
-
-   SpaceArray space;
-   Type clipboardSpaceUsage;
-
-   void Calculate( UndoManager &manager )
-   {
-      SampleBlockIDSet seen;
-
-      // After copies and pastes, a block file may be used in more than
-      // one place in one undo history state, and it may be used in more than
-      // one undo history state.  It might even be used in two states, but not
-      // in another state that is between them -- as when you have state A,
-      // then make a cut to get state B, but then paste it back into state C.
-
-      // So be sure to count each block file once only, in the last undo item that
-      // contains it.
-
-      // Why the last and not the first? Because the user of the History dialog
-      // may DELETE undo states, oldest first.  To reclaim disk space you must
-      // DELETE all states containing the block file.  So the block file's
-      // contribution to space usage should be counted only in that latest
-      // state.
-
-      manager.VisitStates(
-         [this, &seen](const UndoStackElem &elem) {
-            // Scan all tracks at current level
-            if (auto pTracks = UndoTracks::Find(elem))
-               space.push_back(CalculateUsage(*pTracks, seen));
-         },
-         true // newest state first
-      );
-
-      // Count the usage of the clipboard separately, using another set.  Do not
-      // multiple-count any block occurring multiple times within the clipboard.
-      seen.clear();
-      clipboardSpaceUsage = CalculateUsage(
-         Clipboard::Get().GetTracks(), seen);
-
-      //TIMER_STOP( space_calc );
-   }
-};
+//! Space of the clipboard, which the UndoManager does not account for
+/*! Do not multiple-count any block occurring multiple times within the
+ clipboard */
+unsigned long long CalculateClipboardUsage()
+{
+   unsigned long long result = 0;
+   SampleBlockIDSet seen;
+   InspectBlocks(
+      Clipboard::Get().GetTracks(),
+      BlockSpaceUsageAccumulator( result ),
+      &seen
+   );
+   return result;
+}
 }
 
 enum {
@@ -285,19 +242,15 @@ void HistoryDialog::DoUpdate()
 {
    int i = 0;
 
-   SpaceUsageCalculator calculator;
-   calculator.Calculate( *mManager );
-
-   // point to size for oldest state
-   auto iter = calculator.space.rbegin();
-
    mList->DeleteAllItems();
 
    wxLongLong_t total = 0;
    mSelected = mManager->GetCurrentState();
    mManager->VisitStates(
       [&]( const UndoStackElem &elem ){
-         const auto space = *iter++;
+         // Each block is counted only in the last undo item that contains it,
+         // so that discarding the oldest states reclaims the space shown
+         const auto space = elem.spaceUsage;
          total += space;
          const auto size = Internat::FormatSize(space);
          const auto &desc = elem.description;
@@ -310,7 +263,7 @@ void HistoryDialog::DoUpdate()
 
    mTotal->SetValue(Internat::FormatSize(total).Translation());
 
-   auto clipboardUsage = calculator.clipboardSpaceUsage;
+   auto clipboardUsage = CalculateClipboardUsage();
    mClipboard->SetValue(Internat::FormatSize(clipboardUsage).Translation());
 #if defined(ALLOW_DISCARD)
    FindWindowById(ID_DISCARD_CLIPBOARD)->Enable(clipboardUsage > 0);
@@ -58,6 +58,7 @@ Paul Licameli split from AudacityProject.cpp
 #include "WaveTrackUtilities.h"
 #include "XMLFileReader.h"
 #include "import/ImportStreamDialog.h"
+#include "waveform/WaveDataCacheWorkers.h"
 #include "prefs/ImportExportPrefs.h"
 #include "widgets/FileHistory.h"
 #include "widgets/UnwritableLocationErrorDialog.h"
@@ -861,6 +862,9 @@ void ProjectFileManager::CloseProject()
    auto &project = mProject;
    auto &projectFileIO = ProjectFileIO::Get(project);
 
+   // Background loading of waveforms may still hold sample blocks
+   WaveDataCacheWorkers::Get().Drain();
+
    projectFileIO.CloseProject();
 
    // Blocks were locked in CompactProjectOnClose, so DELETE the data structure so that
@@ -300,7 +300,7 @@ void InitProjectWindow( ProjectWindow &window )
    ProjectManager::Get( project ).SetStatusText( msg, MainStatusBarField() );
 }
 
-AudacityProject *ProjectManager::New()
+AudacityProject *ProjectManager::New(bool show)
 {
    wxRect wndRect;
    bool bMaximized = false;
@@ -359,7 +359,8 @@ AudacityProject *ProjectManager::New()
 
    ModuleManager::Get().Dispatch(ProjectInitialized);
 
-   window.Show(true);
+   if (show)
+      window.Show(true);
 
    return p;
 }
@@ -44,7 +44,8 @@ public:
    ~ProjectManager() override;
 
    // This is the factory for projects:
-   static AudacityProject *New();
+   //! @param show false for a project only processed by commands, never seen
+   static AudacityProject *New(bool show = true);
 
    // The function that imports files can act as a factory too, and for that
    // reason remains in this class, not in ProjectFileManager
@@ -24,6 +24,7 @@ and in the spectrogram spectral selection.
 
 #include "SpectrumAnalyst.h"
 #include "FFT.h"
+#include "Stft.h"
 
 #include "SampleFormat.h"
 #include <wx/dcclient.h>
@@ -149,18 +150,36 @@ bool SpectrumAnalyst::Calculate(Algorithm alg, int windowFunc,
 
    size_t start = 0;
    int windows = 0;
-   while (start + mWindowSize <= dataLen) {
+   if (alg == Spectrum) {
+      // Window and transform the frames in batches, straight from the data
+      const Stft stft{ std::vector<float>(win.get(), win.get() + mWindowSize) };
+      StftBufferSource source{ data, static_cast<long long>(dataLen) };
+      const auto frameSize = stft.GetFrameSize(Stft::Output::Power);
+      const auto nFrames = (dataLen - mWindowSize) / half + 1;
+      constexpr size_t framesPerBatch = 64;
+      std::vector<float> power(framesPerBatch * frameSize);
+
+      for (size_t first = 0; first < nFrames; first += framesPerBatch) {
+         const auto count = std::min(framesPerBatch, nFrames - first);
+         stft.Compute(source, static_cast<double>(first * half), half, count,
+            Stft::Output::Power, power.data());
+
+         for (size_t frame = 0; frame < count; frame++)
+            for (size_t i = 0; i < half; i++)
+               mProcessed[i] += power[frame * frameSize + i];
+
+         // Update the progress bar
+         if (progress) {
+            progress->SetValue((first + count - 1) * half);
+         }
+      }
+      windows = nFrames;
+   }
+   else while (start + mWindowSize <= dataLen) {
       for (size_t i = 0; i < mWindowSize; i++)
          in[i] = win[i] * data[start + i];
 
       switch (alg) {
-         case Spectrum:
-            PowerSpectrum(mWindowSize, in.get(), out.get());
-
-            for (size_t i = 0; i < half; i++)
-               mProcessed[i] += out[i];
-            break;
-
          case Autocorrelation:
          case CubeRootAutocorrelation:
          case EnhancedAutocorrelation:
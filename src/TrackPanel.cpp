@@ -84,6 +84,7 @@ is time to refresh some aspect of the screen.
 #include "WaveTrack.h"
 
 #include "FrameStatistics.h"
+#include "waveform/WaveDataCacheWorkers.h"
 
 #include "tracks/ui/TrackControls.h"
 #include "tracks/ui/ChannelView.h"
@@ -344,6 +345,10 @@ TrackPanel::TrackPanel(wxWindow * parent, wxWindowID id,
    mSelectionSubscription = viewInfo->selectedRegion
       .Subscribe([this](auto&){ Refresh(false); });
 
+   // Waveform data loaded in background replaces the previews
+   mWaveDataCacheSubscription = WaveDataCacheWorkers::Get()
+      .Subscribe([this](auto&){ Refresh(false); });
+
    UpdatePrefs();
 }
 
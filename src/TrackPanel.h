@@ -186,6 +186,7 @@ protected:
       , mSyncLockSubscription
       , mProjectRulerInvalidatedSubscription
       , mSelectionSubscription
+      , mWaveDataCacheSubscription
    ;
 
    std::shared_ptr<TrackList> mTracks;
@@ -0,0 +1,101 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+TrackSpectrumTransformer.cpp
+
+Edward Hui
+
+**********************************************************************/
+
+#include "TrackSpectrumTransformer.h"
+
+#include <algorithm>
+#include "WaveTrack.h"
+
+void
+TrackSpectrumTransformer::DoOutput(const float *outBuffer, size_t mStepSize)
+{
+   mOutputTrack->Append((constSamplePtr)outBuffer, floatSample, mStepSize);
+}
+
+bool TrackSpectrumTransformer::Process(const WindowProcessor &processor,
+   const WaveChannel &channel, size_t queueLength, sampleCount start,
+   sampleCount len)
+{
+   mpChannel = &channel;
+
+   if (!Start(queueLength))
+      return false;
+
+   auto bufferSize = channel.GetMaxBlockSize();
+   FloatVector buffer(bufferSize);
+
+   bool bLoopSuccess = true;
+   auto samplePos = start;
+   while (bLoopSuccess && samplePos < start + len) {
+      //Get a blockSize of samples (smaller than the size of the buffer)
+      const auto blockSize = limitSampleBufferSize(
+         std::min(bufferSize, channel.GetBestBlockSize(samplePos)),
+         start + len - samplePos);
+
+      //Get the samples from the track and put them in the buffer
+      channel.GetFloats(buffer.data(), samplePos, blockSize);
+      samplePos += blockSize;
+      bLoopSuccess = ProcessSamples(processor, buffer.data(), blockSize);
+   }
+
+   if (!Finish(processor))
+      return false;
+
+   return bLoopSuccess;
+}
+
+bool TrackSpectrumTransformer::ProcessConcurrently(
+   const WindowProcessor &processor, const Factory &factory,
+   const WaveTrack &track, WaveTrack &outputTrack, size_t queueLength,
+   sampleCount start, sampleCount len, size_t historyLen,
+   const ProgressReporter &progress)
+{
+   assert(track.NChannels() == outputTrack.NChannels());
+   std::vector<Channel> channels;
+   auto iter = outputTrack.Channels().begin();
+   for (const auto pChannel : track.Channels()) {
+      const auto pOutputChannel = *iter++;
+      channels.push_back({
+         [&factory, pOutputChannel]{ return factory(*pOutputChannel); },
+         [pChannel, start](float *buffer, long long offset, size_t size){
+            pChannel->GetFloats(buffer, start + offset, size);
+         },
+         [pOutputChannel](const float *buffer, size_t size){
+            pOutputChannel->Append(
+               (constSamplePtr)buffer, floatSample, size);
+         }
+      });
+   }
+   return SpectrumTransformer::ProcessConcurrently(processor, channels,
+      queueLength, len.as_long_long(), historyLen, progress);
+}
+
+bool TrackSpectrumTransformer::DoFinish()
+{
+   return SpectrumTransformer::DoFinish();
+}
+
+bool TrackSpectrumTransformer::PostProcess(
+   WaveTrack &outputTrack, sampleCount len)
+{
+   outputTrack.Flush();
+   auto tLen = outputTrack.LongSamplesToTime(len);
+   // Filtering effects always end up with more data than they started with.
+   // Delete this 'tail'.
+   outputTrack.Clear(tLen, outputTrack.GetEndTime());
+   return true;
+}
+
+TrackSpectrumTransformer::~TrackSpectrumTransformer() = default;
+
+bool TrackSpectrumTransformer::DoStart()
+{
+   return SpectrumTransformer::DoStart();
+}
@@ -0,0 +1,76 @@
+/*!********************************************************************
+
+Audacity: A Digital Audio Editor
+
+TrackSpectrumTransformer.h
+@brief Transformer of wave track channels by FFT, coefficient changes, inverse FFT, overlap-add
+
+Paul Licameli
+
+**********************************************************************/
+
+#ifndef __AUDACITY_TRACK_SPECTRUM_TRANSFORMER__
+#define __AUDACITY_TRACK_SPECTRUM_TRANSFORMER__
+
+#include "SampleCount.h"
+#include "SpectrumTransformer.h"
+
+class WaveChannel;
+class WaveTrack;
+
+//! Subclass of SpectrumTransformer that rewrites a track
+class TrackSpectrumTransformer /* not final */ : public SpectrumTransformer {
+public:
+   /*!
+    @copydoc SpectrumTransformer::SpectrumTransformer(bool,
+       eWindowFunctions, eWindowFunctions, size_t, unsigned, bool, bool)
+    @pre `!needsOutput || pOutputTrack != nullptr`
+    */
+   TrackSpectrumTransformer(WaveChannel *pOutputTrack,
+      bool needsOutput, eWindowFunctions inWindowType,
+      eWindowFunctions outWindowType, size_t windowSize,
+      unsigned stepsPerWindow, bool leadingPadding, bool trailingPadding
+   )  : SpectrumTransformer{ needsOutput, inWindowType, outWindowType,
+         windowSize, stepsPerWindow, leadingPadding, trailingPadding
+      }
+      , mOutputTrack{ pOutputTrack }
+   {
+      assert(!needsOutput || pOutputTrack != nullptr);
+   }
+   ~TrackSpectrumTransformer() override;
+
+   //! Invokes Start(), ProcessSamples(), and Finish()
+   bool Process(const WindowProcessor &processor, const WaveChannel &channel,
+      size_t queueLength, sampleCount start, sampleCount len);
+
+   //! Makes a transformer appending to the given channel
+   using Factory = std::function<
+      std::unique_ptr<TrackSpectrumTransformer>(WaveChannel &outputChannel)>;
+
+   //! Like Process() for each channel of track, appending to the
+   //! corresponding channel of outputTrack, but done concurrently
+   /*!
+    @copydetails SpectrumTransformer::ProcessConcurrently(
+       const WindowProcessor &, const std::vector<Channel> &, size_t,
+       long long, size_t, const ProgressReporter &, size_t)
+    @pre `track.NChannels() == outputTrack.NChannels()`
+    */
+   static bool ProcessConcurrently(const WindowProcessor &processor,
+      const Factory &factory, const WaveTrack &track, WaveTrack &outputTrack,
+      size_t queueLength, sampleCount start, sampleCount len,
+      size_t historyLen, const ProgressReporter &progress);
+
+   //! Final flush and trimming of tail samples
+   static bool PostProcess(WaveTrack &outputTrack, sampleCount len);
+
+protected:
+   bool DoStart() override;
+   void DoOutput(const float *outBuffer, size_t mStepSize) override;
+   bool DoFinish() override;
+
+private:
+   WaveChannel *const mOutputTrack;
+   const WaveChannel *mpChannel = nullptr;
+};
+
+#endif
@@ -98,6 +98,12 @@ EffectAmplify::Instance::~Instance()
    static_cast<EffectAmplify&>(GetEffect()).DestroyOutputTracks();
 }
 
+bool EffectAmplify::Instance::CanProcessConcurrently() const
+{
+   // ProcessBlock() only reads mRatio
+   return true;
+}
+
 EffectAmplify::EffectAmplify()
 {
    mAmp = Amp.def;
@@ -355,6 +361,11 @@ std::shared_ptr<EffectInstance> EffectAmplify::MakeInstance() const
    return std::make_shared<Instance>(const_cast<EffectAmplify&>(*this));
 }
 
+bool EffectAmplify::ProcessesConcurrently() const
+{
+   return true;
+}
+
 // EffectAmplify implementation
 
 void EffectAmplify::CheckClip()
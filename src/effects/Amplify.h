@@ -64,11 +64,13 @@ public:
    bool TransferDataFromWindow(EffectSettings &settings) override;
 
    std::shared_ptr<EffectInstance> MakeInstance() const override;
+   bool ProcessesConcurrently() const override;
 
 private:
    struct Instance : StatefulPerTrackEffect::Instance {
       using StatefulPerTrackEffect::Instance::Instance;
       ~Instance() override;
+      bool CanProcessConcurrently() const override;
    };
 
    void ClampRatio();
@@ -133,6 +133,8 @@ struct EffectBassTreble::Instance
    unsigned GetAudioInCount() const override;
    unsigned GetAudioOutCount() const override;
 
+   bool CanProcessConcurrently() const override;
+
    static void InstanceInit(EffectSettings& settings, EffectBassTrebleState& data, float sampleRate);
 
    static size_t InstanceProcess(EffectSettings&        settings,
@@ -157,6 +159,11 @@ EffectBassTreble::MakeInstance() const
    return std::make_shared<Instance>(*this);
 }
 
+bool EffectBassTreble::ProcessesConcurrently() const
+{
+   return true;
+}
+
 
 EffectBassTreble::EffectBassTreble()
 {
@@ -206,6 +213,12 @@ unsigned EffectBassTreble::Instance::GetAudioOutCount() const
    return 1;
 }
 
+bool EffectBassTreble::Instance::CanProcessConcurrently() const
+{
+   // All state is in mState and the settings
+   return true;
+}
+
 bool EffectBassTreble::Instance::ProcessInitialize(
    EffectSettings& settings, double sampleRate, ChannelNames)
 {
@@ -83,6 +83,7 @@ public:
    struct Instance;
 
    std::shared_ptr<EffectInstance> MakeInstance() const override;
+   bool ProcessesConcurrently() const override;
 
 
 private:
@@ -9,25 +9,68 @@ Max Maisel
 ***********************************************************************/
 
 #include "EBUR128.h"
+#include <algorithm>
 #include <cstring>
 
-EBUR128::EBUR128(double rate, size_t channels)
+namespace {
+// Taps of each phase of the true peak interpolation, as in ITU-R BS.1770-4
+constexpr size_t TruePeakPhaseTaps = 12;
+// Phases computed for each sample; with less oversampling, phases repeat
+constexpr size_t MaxOversampling = 4;
+}
+
+EBUR128::EBUR128(double rate, size_t channels, bool measureTruePeak)
    : mChannelCount{ channels }
    , mRate{ rate }
    , mBlockSize( ceil(0.4 * mRate) ) // 400 ms blocks
    , mBlockOverlap( ceil(0.1 * mRate) ) // 100 ms overlap
+   , mMeasureTruePeak{ measureTruePeak }
+   , mWeightingFilter{ CalcWeightingFilter(mRate) }
+   , mFilterState( 2 * 4 * mChannelCount, 0.0 )
+   , mInterleavedChannels( mChannelCount )
 {
    mLoudnessHist.reinit(HIST_BIN_COUNT, false);
    mBlockRingBuffer.reinit(mBlockSize);
-   mWeightingFilter.reinit(mChannelCount, false);
-   for(size_t channel = 0; channel < mChannelCount; ++channel)
-      mWeightingFilter[channel] = CalcWeightingFilter(mRate);
 
    memset(mLoudnessHist.get(), 0, HIST_BIN_COUNT*sizeof(long int));
-   for(size_t channel = 0; channel < mChannelCount; ++channel)
+
+   // Oversample for the true peak by 4 below 96 kHz, as ITU-R BS.1770 asks
+   // for 48 kHz (so 44.1 kHz becomes 176.4 kHz), and by 2 below 192 kHz, with
+   // a windowed sinc interpolator that passes up to the Nyquist frequency of
+   // the input
+   mOversampling = mRate < 96000 ? 4 : mRate < 192000 ? 2 : 1;
+   if (mMeasureTruePeak && mOversampling > 1)
    {
-      mWeightingFilter[channel][0].Reset();
-      mWeightingFilter[channel][1].Reset();
+      // Centered on a tap, so that the first phase gives the samples
+      // themselves and the others fall between them
+      const auto length = TruePeakPhaseTaps * mOversampling;
+      const auto center = length / 2;
+      std::vector<double> impulse(length);
+      for(size_t i = 0; i < length; ++i)
+      {
+         const double t = (double(i) - double(center)) / mOversampling;
+         const double sinc = t == 0 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+         // Blackman window, whose last point, zero, is left out
+         const double phase = 2 * M_PI * i / length;
+         const double window = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2 * phase);
+         impulse[i] = sinc * window;
+      }
+      // Reverse each phase, so that it is a dot product with the input in
+      // order, and interleave the phases tap by tap; give each phase unit
+      // gain at DC
+      mOversamplingFilter.resize(TruePeakPhaseTaps * MaxOversampling);
+      for(size_t phase = 0; phase < MaxOversampling; ++phase)
+      {
+         const auto from = phase % mOversampling;
+         double sum = 0;
+         for(size_t k = 0; k < TruePeakPhaseTaps; ++k)
+            sum += impulse[from + k * mOversampling];
+         for(size_t k = 0; k < TruePeakPhaseTaps; ++k)
+            mOversamplingFilter[k * MaxOversampling + phase] =
+               impulse[from + (TruePeakPhaseTaps - 1 - k) * mOversampling] /
+               sum;
+      }
+      mPeakHistory.resize((TruePeakPhaseTaps - 1) * mChannelCount, 0.0f);
    }
 }
 
@@ -80,18 +123,169 @@ ArrayOf<Biquad> EBUR128::CalcWeightingFilter(double fs)
    return pBiquad;
 }
 
-void EBUR128::ProcessSampleFromChannel(float x_in, size_t channel) const
+void EBUR128::ProcessSampleFromChannel(float x_in, size_t channel)
 {
-   double value;
-   value = mWeightingFilter[channel][0].ProcessOne(x_in);
-   value = mWeightingFilter[channel][1].ProcessOne(value);
-   if(channel == 0)
-      mBlockRingBuffer[mBlockRingPos] = value * value;
-   else
+   const float *const in = &x_in;
+   Weight<1>(&in, 1, 0, 1, channel);
+}
+
+template<size_t Lanes> void EBUR128::Weight(const float *const *channels,
+   size_t stride, size_t offset, size_t len, size_t firstChannel)
+{
+   // Copy the state of Lanes channels where the compiler can keep it in
+   // registers, then filter them all with the same vector instructions
+   double state[2][4][Lanes];
+   for(size_t filter = 0; filter < 2; ++filter)
+      for(size_t ii = 0; ii < 4; ++ii)
+         for(size_t lane = 0; lane < Lanes; ++lane)
+            state[filter][ii][lane] =
+               FilterState(filter, ii)[firstChannel + lane];
+
+   const float *in[Lanes];
+   for(size_t lane = 0; lane < Lanes; ++lane)
+      in[lane] = channels[lane] + offset * stride;
+
+   // The same arithmetic as Biquad::ProcessOne(), which takes and gives floats
+   // but computes in double
+   const auto biquad = [](const Biquad &coefficients,
+      double (&s)[4][Lanes], float (&x)[Lanes])
    {
+      for(size_t lane = 0; lane < Lanes; ++lane)
+      {
+         const double y = double(x[lane]) * coefficients.fNumerCoeffs[Biquad::B0] +
+            s[0][lane] * coefficients.fNumerCoeffs[Biquad::B1] +
+            s[1][lane] * coefficients.fNumerCoeffs[Biquad::B2] -
+            s[2][lane] * coefficients.fDenomCoeffs[Biquad::A1] -
+            s[3][lane] * coefficients.fDenomCoeffs[Biquad::A2];
+         s[1][lane] = s[0][lane];
+         s[0][lane] = x[lane];
+         s[3][lane] = s[2][lane];
+         s[2][lane] = y;
+         x[lane] = y;
+      }
+   };
+
+   double *const out = &mBlockRingBuffer[mBlockRingPos];
+   for(size_t i = 0; i < len; ++i)
+   {
+      float x[Lanes];
+      for(size_t lane = 0; lane < Lanes; ++lane)
+         x[lane] = in[lane][i * stride];
+      biquad(mWeightingFilter[0], state[0], x);
+      biquad(mWeightingFilter[1], state[1], x);
+
       // Add the power of additional channels to the power of first channel.
       // As a result, stereo tracks appear about 3 LUFS louder, as specified.
-      mBlockRingBuffer[mBlockRingPos] += value * value;
+      double power = firstChannel == 0 ? 0.0 : out[i];
+      for(size_t lane = 0; lane < Lanes; ++lane)
+         power += double(x[lane]) * x[lane];
+      out[i] = power;
+   }
+
+   for(size_t filter = 0; filter < 2; ++filter)
+      for(size_t ii = 0; ii < 4; ++ii)
+         for(size_t lane = 0; lane < Lanes; ++lane)
+            FilterState(filter, ii)[firstChannel + lane] =
+               state[filter][ii][lane];
+}
+
+void EBUR128::ProcessSamples(const float *const *channels, size_t len)
+{
+   Process(channels, 1, len);
+}
+
+void EBUR128::ProcessInterleavedSamples(const float *buffer, size_t len)
+{
+   for(size_t channel = 0; channel < mChannelCount; ++channel)
+      mInterleavedChannels[channel] = buffer + channel;
+   Process(mInterleavedChannels.data(), mChannelCount, len);
+}
+
+void EBUR128::Process(const float *const *channels, size_t stride, size_t len)
+{
+   if(mMeasureTruePeak)
+      MeasureTruePeak(channels, stride, len);
+
+   size_t done = 0;
+   while(done < len)
+   {
+      // Stop where NextSample() would look for a full block or close the ring
+      const auto boundary = std::min(mBlockSize,
+         (mBlockRingPos / mBlockOverlap + 1) * mBlockOverlap);
+      const auto count = std::min(len - done, boundary - mBlockRingPos);
+
+      size_t channel = 0;
+      for(; channel + 4 <= mChannelCount; channel += 4)
+         Weight<4>(channels + channel, stride, done, count, channel);
+      switch(mChannelCount - channel)
+      {
+      case 3:
+         Weight<3>(channels + channel, stride, done, count, channel); break;
+      case 2:
+         Weight<2>(channels + channel, stride, done, count, channel); break;
+      case 1:
+         Weight<1>(channels + channel, stride, done, count, channel); break;
+      default:
+         break;
+      }
+
+      done += count;
+      mBlockRingPos += count;
+      mBlockRingSize += count;
+      mSampleCount += count;
+
+      if(mBlockRingPos % mBlockOverlap == 0)
+      {
+         // A new full block of samples was submitted.
+         if(mBlockRingSize >= mBlockSize)
+            AddBlockToHistogram(mBlockSize);
+      }
+      // Close the ring.
+      if(mBlockRingPos == mBlockSize)
+         mBlockRingPos = 0;
+   }
+}
+
+void EBUR128::MeasureTruePeak(const float *const *channels, size_t stride,
+   size_t len)
+{
+   const auto historyLen = TruePeakPhaseTaps - 1;
+   for(size_t channel = 0; channel < mChannelCount; ++channel)
+   {
+      const float *const in = channels[channel];
+
+      // The peak of the samples themselves is a lower bound
+      float peak = mTruePeak;
+      for(size_t i = 0; i < len; ++i)
+         peak = std::max(peak, std::fabs(in[i * stride]));
+
+      if(mOversampling > 1)
+      {
+         // Gather the history and the new samples
+         float *const history = mPeakHistory.data() + channel * historyLen;
+         mPeakWork.resize(historyLen + len);
+         std::copy(history, history + historyLen, mPeakWork.begin());
+         for(size_t i = 0; i < len; ++i)
+            mPeakWork[historyLen + i] = in[i * stride];
+
+         // All phases at once, as lanes of vectors
+         for(size_t i = 0; i < len; ++i)
+         {
+            const float *const x = mPeakWork.data() + i;
+            float y[MaxOversampling]{};
+            for(size_t k = 0; k < TruePeakPhaseTaps; ++k)
+            {
+               const float *const h =
+                  mOversamplingFilter.data() + k * MaxOversampling;
+               for(size_t phase = 0; phase < MaxOversampling; ++phase)
+                  y[phase] += h[phase] * x[k];
+            }
+            for(size_t phase = 0; phase < MaxOversampling; ++phase)
+               peak = std::max(peak, std::fabs(y[phase]));
+         }
+         std::copy(mPeakWork.end() - historyLen, mPeakWork.end(), history);
+      }
+      mTruePeak = peak;
    }
 }
 
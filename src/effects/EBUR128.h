@@ -13,6 +13,7 @@ Max Maisel
 
 #include "Biquad.h"
 #include <memory>
+#include <vector>
 #include "SampleFormat.h"
 
 #include <cmath>
@@ -21,22 +22,48 @@ Max Maisel
 class EBUR128
 {
 public:
-   EBUR128(double rate, size_t channels);
+   //! @param measureTruePeak whether ProcessSamples() and
+   //! ProcessInterleavedSamples() also measure TruePeak(), which costs more
+   //! than the loudness
+   EBUR128(double rate, size_t channels, bool measureTruePeak = false);
    EBUR128(const EBUR128&) = delete;
    EBUR128(EBUR128&&) = delete;
    ~EBUR128() = default;
 
    static ArrayOf<Biquad> CalcWeightingFilter(double fs);
-   void ProcessSampleFromChannel(float x_in, size_t channel) const;
+   void ProcessSampleFromChannel(float x_in, size_t channel);
    void NextSample();
+
+   //! Processes len samples of each channel, given in separate buffers
+   /*! Equivalent to ProcessSampleFromChannel() for each channel and then
+    NextSample(), for each sample, but the channels are filtered together */
+   void ProcessSamples(const float *const *channels, size_t len);
+   //! Processes len samples of each channel, given interleaved in one buffer
+   void ProcessInterleavedSamples(const float *buffer, size_t len);
+
    double IntegrativeLoudness();
    inline double IntegrativeLoudnessToLUFS(double loudness)
       { return 10 * log10(loudness); }
 
+   //! Greatest absolute value of the signal, oversampled as in ITU-R BS.1770
+   /*! Only samples given to ProcessSamples() or ProcessInterleavedSamples()
+    are measured, if the constructor was so requested */
+   double TruePeak() const { return mTruePeak; }
+   inline double TruePeakToDBTP(double peak)
+      { return 20 * log10(peak); }
+
 private:
    void HistogramSums(size_t start_idx, double& sum_v, long int& sum_c) const;
    void AddBlockToHistogram(size_t validLen);
 
+   void Process(const float *const *channels, size_t stride, size_t len);
+   //! Adds the weighted power of channels firstChannel to
+   //! firstChannel + Lanes - 1, given by channels, to the block ring
+   template<size_t Lanes> void Weight(const float *const *channels,
+      size_t stride, size_t offset, size_t len, size_t firstChannel);
+   void MeasureTruePeak(const float *const *channels, size_t stride,
+      size_t len);
+
    static constexpr size_t HIST_BIN_COUNT = 65536;
    /// EBU R128 absolute threshold
    static constexpr double GAMMA_A = (-70.0 + 0.691) / 10.0;
@@ -49,12 +76,30 @@ private:
    const double mRate;
    const size_t mBlockSize;
    const size_t mBlockOverlap;
+   const bool mMeasureTruePeak;
 
-   /// This is be an array of arrays of the type
-   /// mWeightingFilter[CHANNEL][FILTER] with
-   /// CHANNEL = LEFT/RIGHT (0/1) and
+   /// Coefficients of the two filters, the same for all channels:
    /// FILTER  = HSF/HPF    (0/1)
-   ArrayOf<ArrayOf<Biquad>> mWeightingFilter;
+   ArrayOf<Biquad> mWeightingFilter;
+
+   /// State of the filters for each channel, with the channels adjacent so
+   /// that they are filtered together:
+   /// mFilterState[FILTER][STATE][CHANNEL] with
+   /// STATE = previous input, input before, previous output, output before
+   std::vector<double> mFilterState;
+   double *FilterState(size_t filter, size_t state)
+      { return mFilterState.data() + (4 * filter + state) * mChannelCount; }
+
+   /// Polyphase interpolation filter for the true peak, the phases
+   /// interleaved
+   std::vector<float> mOversamplingFilter;
+   size_t mOversampling{ 1 };
+   /// The latest samples of each channel, for the interpolation
+   std::vector<float> mPeakHistory;
+   std::vector<float> mPeakWork;
+   double mTruePeak{ 0 };
+
+   std::vector<const float*> mInterleavedChannels;
 };
 
 #endif
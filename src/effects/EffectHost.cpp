@@ -0,0 +1,420 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file EffectHost.cpp
+
+**********************************************************************/
+
+#include "EffectHost.h"
+#include "EffectHostRing.h"
+
+#include <wx/log.h>
+#include <wx/module.h>
+#include <wx/process.h>
+#include <wx/utils.h>
+
+#include "AudacityFileConfig.h"
+#include "CommandLineArgs.h"
+#include "EffectPlugin.h"
+#include "FileNames.h"
+#include "IPCChannel.h"
+#include "IPCClient.h"
+#include "IPCSharedMemory.h"
+#include "ModuleManager.h"
+#include "PlatformCompatibility.h"
+#include "PluginIPCUtils.h"
+#include "PluginManager.h"
+#include "Prefs.h"
+#include "SettingsWX.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+constexpr auto HostArgument = "--effect-host";
+
+//! How long the host sleeps before it checks again whether to stop
+constexpr auto WaitInterval = 100ms;
+
+//! Serves one RemoteEffectInstance
+class Host final : public IPCChannelStatusCallback
+{
+public:
+   explicit Host(int connectPort);
+
+   void OnConnect(IPCChannel &channel) noexcept override;
+   void OnDisconnect() noexcept override;
+   void OnConnectionError() noexcept override;
+   void OnDataAvailable(const void *data, size_t size) noexcept override;
+
+   //! Handles requests and processes blocks until disconnected
+   void Run();
+
+private:
+   void Stop() noexcept;
+   wxString Handle(const wxString &request);
+   wxString Initialize(const wxArrayString &fields);
+   wxString Finalize();
+   //! @return whether there were blocks to process
+   bool ProcessSubmitted();
+   void ProcessSlot(uint32_t index);
+
+   // Shared with the threads of the channel
+   std::mutex mSync;
+   std::condition_variable mCondition;
+   IPCChannel *mChannel{};
+   detail::InputMessageReader mInputMessageReader;
+   std::deque<wxString> mRequests;
+   //! Lets a request wake the host while it waits for blocks; in mpMemory,
+   //! which is replaced only while this is null
+   std::atomic<uint32_t> *mpWakeWord{};
+   bool mRunning{ true };
+
+   // Used on the main thread only
+   PluginID mProviderID;
+   PluginPath mPath;
+   std::unique_ptr<ComponentInterface> mpComponent;
+   const EffectPlugin *mpEffect{};
+   std::shared_ptr<EffectInstance> mpInstance;
+   EffectSettings mSettings;
+   double mSampleRate{};
+   //! As set in the instance, which may be less than the ring's
+   size_t mBlockSize{};
+   std::unique_ptr<IPCSharedMemory> mpMemory;
+   std::optional<EffectHostRing> mRing;
+   uint32_t mCompleted{};
+   bool mInitialized{ false };
+   std::vector<const float*> mInputs;
+   std::vector<float*> mOutputs;
+
+   //! Destroyed first, so callbacks end before the rest is destroyed
+   std::unique_ptr<IPCClient> mClient;
+};
+
+Host::Host(int connectPort)
+{
+   FileNames::InitializePathList();
+   InitPreferences(audacity::ApplicationSettings::Call());
+
+   auto &moduleManager = ModuleManager::Get();
+   moduleManager.Initialize();
+   moduleManager.DiscoverProviders();
+
+   // Effects may read their preferences, but the main process owns the
+   // registry
+   PluginManager::Get().InitializeSettings([](const FilePath &localFileName){
+      return std::make_unique<SettingsWX>(
+         AudacityFileConfig::Create({}, {}, localFileName));
+   });
+
+   mClient = std::make_unique<IPCClient>(connectPort, *this);
+}
+
+void Host::OnConnect(IPCChannel &channel) noexcept
+{
+   std::lock_guard lock{ mSync };
+   mChannel = &channel;
+}
+
+void Host::OnDisconnect() noexcept
+{
+   Stop();
+}
+
+void Host::OnConnectionError() noexcept
+{
+   Stop();
+}
+
+void Host::OnDataAvailable(const void *data, size_t size) noexcept
+{
+   try {
+      {
+         std::lock_guard lock{ mSync };
+         mInputMessageReader.ConsumeBytes(data, size);
+         while (mInputMessageReader.CanPop())
+            mRequests.push_back(mInputMessageReader.Pop());
+         if (mpWakeWord)
+            mpMemory->Wake(*mpWakeWord);
+      }
+      mCondition.notify_one();
+   }
+   catch (...) {
+      Stop();
+   }
+}
+
+void Host::Stop() noexcept
+{
+   try {
+      std::lock_guard lock{ mSync };
+      mRunning = false;
+      mChannel = nullptr;
+      if (mpWakeWord)
+         mpMemory->Wake(*mpWakeWord);
+   }
+   catch (...) {
+      // See PluginHost::Stop()
+   }
+   mCondition.notify_one();
+}
+
+void Host::Run()
+{
+   while (true) {
+      std::optional<wxString> request;
+      {
+         std::unique_lock lock{ mSync };
+         if (!mRunning)
+            break;
+         if (!mRequests.empty()) {
+            request = std::move(mRequests.front());
+            mRequests.pop_front();
+         }
+         else if (!mInitialized) {
+            // Between tracks, the counters of the ring are not to be read
+            mCondition.wait_for(lock, WaitInterval,
+               [this]{ return !mRunning || !mRequests.empty(); });
+            continue;
+         }
+      }
+      if (request) {
+         const auto reply = Handle(*request);
+         std::lock_guard lock{ mSync };
+         if (mChannel)
+            detail::PutMessage(*mChannel, reply);
+      }
+      else if (!ProcessSubmitted())
+         mpMemory->Wait(mRing->GetHeader().submitted, mCompleted, WaitInterval);
+   }
+   if (mInitialized)
+      Finalize();
+}
+
+wxString Host::Handle(const wxString &request)
+{
+   try {
+      const auto fields = EffectHost::ParseMessage(request);
+      if (fields.empty())
+         return "malformed request";
+      if (fields[0] == EffectHost::Request::Initialize)
+         return Initialize(fields);
+      if (fields[0] == EffectHost::Request::Finalize)
+         return Finalize();
+      return "unknown request";
+   }
+   catch (...) {
+      // Maybe in third-party code
+      return "unknown error";
+   }
+}
+
+wxString Host::Initialize(const wxArrayString &fields)
+{
+   if (fields.size() != 10)
+      return "malformed request";
+   if (mInitialized)
+      Finalize();
+
+   const auto &providerID = fields[1];
+   const auto &path = fields[2];
+   const auto &settings = fields[3];
+   double sampleRate{};
+   unsigned long blockSize{}, nIn{}, nOut{};
+   if (!fields[4].ToCDouble(&sampleRate) || !fields[5].ToULong(&blockSize) ||
+       !fields[6].ToULong(&nIn) || !fields[7].ToULong(&nOut) ||
+       blockSize == 0 || nOut == 0)
+      return "malformed request";
+   std::vector<ChannelName> channels;
+   for (const auto &field : wxSplit(fields[8], ',')) {
+      long channel{};
+      if (!field.ToLong(&channel))
+         return "malformed request";
+      channels.push_back(static_cast<ChannelName>(channel));
+   }
+   if (!channels.empty())
+      channels.push_back(ChannelNameEOL);
+   const auto memoryName = fields[9].ToStdString();
+
+   if (!mpEffect || providerID != mProviderID || path != mPath) {
+      mpInstance.reset();
+      mpEffect = nullptr;
+      mpComponent = ModuleManager::Get().LoadPlugin(providerID, path);
+      mpEffect = dynamic_cast<const EffectPlugin*>(mpComponent.get());
+      if (!mpEffect)
+         return "cannot load the effect";
+      mProviderID = providerID;
+      mPath = path;
+   }
+
+   mSettings = mpEffect->GetDefinition().MakeSettings();
+   if (!mpEffect->LoadSettingsFromString(settings, mSettings))
+      return "cannot load the settings";
+
+   if (!mpInstance) {
+      mpInstance = mpEffect->MakeInstance();
+      const auto pInstanceEx =
+         std::dynamic_pointer_cast<EffectInstanceEx>(mpInstance);
+      if (!mpInstance || (pInstanceEx && !pInstanceEx->Init())) {
+         mpInstance.reset();
+         return "cannot make an instance of the effect";
+      }
+   }
+   // The main process allocated its buffers for these counts
+   if (mpInstance->GetAudioInCount() != nIn ||
+       mpInstance->GetAudioOutCount() != nOut)
+      return "the channel counts differ";
+   mBlockSize = std::min<size_t>(mpInstance->SetBlockSize(blockSize), blockSize);
+   if (mBlockSize == 0)
+      return "cannot set the block size";
+
+   const auto size = EffectHostRing::GetSize(blockSize, nIn, nOut);
+   if (!mpMemory || mpMemory->GetName() != memoryName ||
+       mpMemory->Size() != size) {
+      {
+         std::lock_guard lock{ mSync };
+         mpWakeWord = nullptr;
+      }
+      mRing.reset();
+      mpMemory = IPCSharedMemory::Open(memoryName, size);
+      if (!mpMemory)
+         return "cannot open the shared memory";
+   }
+   mRing.emplace(mpMemory->Data(), blockSize, nIn, nOut);
+   // The main process submits nothing before the reply
+   auto &header = mRing->GetHeader();
+   header.submitted.store(0, std::memory_order_relaxed);
+   header.latency.store(0, std::memory_order_relaxed);
+   header.completed.store(0, std::memory_order_release);
+   mCompleted = 0;
+   {
+      std::lock_guard lock{ mSync };
+      mpWakeWord = &mRing->GetHeader().submitted;
+   }
+   mInputs.resize(nIn);
+   mOutputs.resize(nOut);
+   mSampleRate = sampleRate;
+
+   if (!mpInstance->ProcessInitialize(mSettings, sampleRate,
+      channels.empty() ? nullptr : channels.data()))
+      return "cannot initialize the effect";
+   mInitialized = true;
+   return EffectHost::ReplyOK;
+}
+
+wxString Host::Finalize()
+{
+   if (mRing)
+      ProcessSubmitted();
+   if (mInitialized) {
+      mInitialized = false;
+      if (!mpInstance->ProcessFinalize())
+         return "cannot finalize the effect";
+   }
+   return EffectHost::ReplyOK;
+}
+
+bool Host::ProcessSubmitted()
+{
+   if (!mInitialized)
+      return false;
+   auto &header = mRing->GetHeader();
+   const auto submitted = header.submitted.load(std::memory_order_acquire);
+   // Counters may wrap around
+   if (static_cast<int32_t>(submitted - mCompleted) <= 0)
+      return false;
+   while (static_cast<int32_t>(submitted - mCompleted) > 0) {
+      ProcessSlot(mCompleted);
+      const auto latency = mpInstance->GetLatency(mSettings, mSampleRate);
+      header.latency.store(static_cast<uint32_t>(
+         std::min<EffectInstance::SampleCount>(latency, UINT32_MAX)),
+         std::memory_order_relaxed);
+      header.completed.store(++mCompleted, std::memory_order_release);
+      mpMemory->Wake(header.completed);
+   }
+   return true;
+}
+
+void Host::ProcessSlot(uint32_t index)
+{
+   auto &slot = mRing->GetSlot(index);
+   const auto length = std::min<size_t>(slot.length, mRing->GetBlockSize());
+   size_t processed = 0;
+   try {
+      // The effect may take smaller blocks than the ring
+      while (processed < length) {
+         const auto count = std::min(length - processed, mBlockSize);
+         for (unsigned ii = 0; ii < mInputs.size(); ++ii)
+            mInputs[ii] = mRing->GetInput(index, ii) + processed;
+         for (unsigned ii = 0; ii < mOutputs.size(); ++ii)
+            mOutputs[ii] = mRing->GetOutput(index, ii) + processed;
+         if (mpInstance->ProcessBlock(
+            mSettings, mInputs.data(), mOutputs.data(), count) != count)
+            break;
+         processed += count;
+      }
+   }
+   catch (...) {
+      // The main process fails the effect
+   }
+   slot.processed = static_cast<uint32_t>(processed);
+}
+}
+
+bool EffectHost::IsHostProcess()
+{
+   return CommandLineArgs::argc >= 3 &&
+      wxStrcmp(CommandLineArgs::argv[1], HostArgument) == 0;
+}
+
+long EffectHost::Start(int connectPort)
+{
+   const auto cmd = wxString::Format("\"%s\" %s %d",
+      PlatformCompatibility::GetExecutablePath(), HostArgument, connectPort);
+
+   auto process = std::make_unique<wxProcess>();
+   process->Detach();
+   const auto pid = wxExecute(cmd, wxEXEC_ASYNC, process.get());
+   if (pid != 0)
+      // process will delete itself upon termination
+      process.release();
+   return pid;
+}
+
+//! Serves in place of the application, in a host process
+class EffectHostModule final : public wxModule
+{
+public:
+   DECLARE_DYNAMIC_CLASS(EffectHostModule)
+
+   bool OnInit() override
+   {
+      if (!EffectHost::IsHostProcess())
+         return true;
+
+      long connectPort;
+      if (!wxString{ CommandLineArgs::argv[2] }.ToLong(&connectPort))
+         return false;
+
+      // No message boxes from a process without windows
+      wxLog::EnableLogging(false);
+
+      Host host(connectPort);
+      host.Run();
+      // Terminate the process
+      return false;
+   }
+
+   void OnExit() override
+   {
+   }
+};
+IMPLEMENT_DYNAMIC_CLASS(EffectHostModule, wxModule);
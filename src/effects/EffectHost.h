@@ -0,0 +1,67 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file EffectHost.h
+  @brief Processing with effects in a separate process
+
+**********************************************************************/
+
+#ifndef __AUDACITY_EFFECT_HOST__
+#define __AUDACITY_EFFECT_HOST__
+
+#include <wx/arrstr.h>
+#include <wx/string.h>
+
+//! A process of the same executable, started for each remote instance of an
+//! effect, so that a crash of a third-party effect ends only that process
+/*!
+ The host connects to the main process with IPCClient.  Requests and
+ replies are messages of lib-module-manager's detail::PutMessage().  The
+ audio goes through an EffectHostRing in IPCSharedMemory, so that processing
+ a block costs no copies through the socket and no round trip of messages.
+
+ The host loads the effect with ModuleManager, without the plug-in registry,
+ and exits when the connection closes.
+ */
+namespace EffectHost {
+
+//! Whether this process was started by Start()
+/*! Decided from CommandLineArgs, so it may be called before preferences exist */
+bool IsHostProcess();
+
+//! Starts a host process that connects to the port
+/*! @return the id of the process, or 0 if it did not start */
+long Start(int connectPort);
+
+//! Names of requests, the first field of each; the host replies ReplyOK or
+//! an error message
+namespace Request {
+//! Fields: provider id, plug-in path, settings string, sample rate, block
+//! size, input and output channel counts, channel names, and the name of the
+//! shared memory
+/*! Loads the effect if not loaded; then sets the block size and calls
+ ProcessInitialize() of its instance, and resets the counters of the ring
+ before it replies, so that it never sees them change under it. */
+constexpr auto Initialize = "initialize";
+//! No fields
+/*! Calls ProcessFinalize(), after all submitted blocks are processed */
+constexpr auto Finalize = "finalize";
+}
+
+constexpr auto ReplyOK = "ok";
+
+//! Joins the fields of a request, escaping the separator
+inline wxString MakeMessage(const wxArrayString &fields)
+{
+   return wxJoin(fields, ';');
+}
+
+inline wxArrayString ParseMessage(const wxString &message)
+{
+   return wxSplit(message, ';');
+}
+
+}
+
+#endif
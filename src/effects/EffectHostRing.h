@@ -0,0 +1,115 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file EffectHostRing.h
+  @brief Layout of the shared memory through which an effect host process
+  exchanges audio with the main process
+
+**********************************************************************/
+
+#ifndef __AUDACITY_EFFECT_HOST_RING__
+#define __AUDACITY_EFFECT_HOST_RING__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//! A ring of slots, each with the input and output samples of one block
+/*!
+ The main process fills the input of the next slot, then increments
+ `submitted`; the host processes the block, writes the output, then
+ increments `completed`.  Each side sleeps with IPCSharedMemory::Wait on
+ the counter that the other increments.  The host resets the counters to
+ zero when it initializes for each track, and only then; they may wrap
+ around, so compare them by their difference.
+ */
+class EffectHostRing final
+{
+public:
+   //! While the host processes one block, the main process fills the next
+   static constexpr size_t NumSlots = 2;
+
+   struct Header {
+      std::atomic<uint32_t> submitted;
+      std::atomic<uint32_t> completed;
+      //! Latency of the effect in the host, updated before `completed`
+      std::atomic<uint32_t> latency;
+   };
+
+   struct Slot {
+      //! Written by the main process
+      uint32_t length;
+      //! Written by the host; less than length if the effect failed
+      uint32_t processed;
+   };
+
+   static size_t GetSize(size_t blockSize, unsigned nIn, unsigned nOut)
+   {
+      return HeaderSize + NumSlots * SlotSize(blockSize, nIn, nOut);
+   }
+
+   //! @pre `memory` has at least `GetSize(blockSize, nIn, nOut)` bytes,
+   //! suitably aligned
+   EffectHostRing(void *memory, size_t blockSize, unsigned nIn, unsigned nOut)
+      : mMemory{ static_cast<char*>(memory) }
+      , mBlockSize{ blockSize }, mNumIn{ nIn }, mNumOut{ nOut }
+   {}
+
+   Header &GetHeader() const
+   {
+      return *reinterpret_cast<Header*>(mMemory);
+   }
+
+   //! @param index counts blocks, and is reduced modulo NumSlots
+   Slot &GetSlot(uint32_t index) const
+   {
+      return *reinterpret_cast<Slot*>(SlotAddress(index));
+   }
+
+   //! @pre `channel < nIn`
+   float *GetInput(uint32_t index, unsigned channel) const
+   {
+      return Samples(index) + channel * mBlockSize;
+   }
+
+   //! @pre `channel < nOut`
+   float *GetOutput(uint32_t index, unsigned channel) const
+   {
+      return Samples(index) + (mNumIn + channel) * mBlockSize;
+   }
+
+   size_t GetBlockSize() const { return mBlockSize; }
+   unsigned GetAudioInCount() const { return mNumIn; }
+   unsigned GetAudioOutCount() const { return mNumOut; }
+
+private:
+   // Cache line, so the counters don't share one with the samples
+   static constexpr size_t HeaderSize = 64;
+   static constexpr size_t SlotHeaderSize = 64;
+   static_assert(sizeof(Header) <= HeaderSize);
+   static_assert(sizeof(Slot) <= SlotHeaderSize);
+
+   static size_t SlotSize(size_t blockSize, unsigned nIn, unsigned nOut)
+   {
+      return SlotHeaderSize + (nIn + nOut) * blockSize * sizeof(float);
+   }
+
+   char *SlotAddress(uint32_t index) const
+   {
+      return mMemory + HeaderSize +
+         (index % NumSlots) * SlotSize(mBlockSize, mNumIn, mNumOut);
+   }
+
+   float *Samples(uint32_t index) const
+   {
+      return reinterpret_cast<float*>(SlotAddress(index) + SlotHeaderSize);
+   }
+
+   char *const mMemory;
+   const size_t mBlockSize;
+   const unsigned mNumIn;
+   const unsigned mNumOut;
+};
+
+#endif
@@ -16,11 +16,72 @@
 
 #include "AudioIO.h"
 #include "BasicUI.h"
+#include "ClientData.h"
 #include "MixAndRender.h"
+#include "Observer.h"
+#include "Project.h"
 #include "ProjectAudioIO.h"
 #include "TransportUtilities.h"
+#include "UndoManager.h"
 #include "WaveTrack.h"
 
+namespace {
+//! The input of the last preview of a linear effect, mixed from the selected
+//! tracks, which is reused while the project and the previewed times remain
+struct PreviewMixCache final : ClientData::Base {
+   static PreviewMixCache &Get(AudacityProject &project);
+
+   explicit PreviewMixCache(AudacityProject &project)
+      // Any change of the tracks, or undo or redo, makes the mix stale
+      : mTrackListSubscription{ TrackList::Get(project)
+         .Subscribe([this](const TrackListEvent &){ mMix.reset(); }) }
+      , mUndoSubscription{ UndoManager::Get(project)
+         .Subscribe([this](const UndoRedoMessage &){ mMix.reset(); }) }
+   {}
+
+   //! A copy of the mix, if it was made from the same tracks and times
+   Track::Holder Find(const std::vector<TrackId> &ids,
+      double t0, double t1, double rate) const
+   {
+      if (!mMix || ids != mIds || t0 != mT0 || t1 != mT1 || rate != mRate)
+         return nullptr;
+      // The copy shares the sample blocks of the mix
+      return mMix->Duplicate();
+   }
+
+   void Store(std::vector<TrackId> ids,
+      double t0, double t1, double rate, const Track &mix)
+   {
+      mIds = move(ids);
+      mT0 = t0;
+      mT1 = t1;
+      mRate = rate;
+      mMix = mix.Duplicate();
+   }
+
+private:
+   const Observer::Subscription mTrackListSubscription;
+   const Observer::Subscription mUndoSubscription;
+
+   std::vector<TrackId> mIds;
+   double mT0{};
+   double mT1{};
+   double mRate{};
+   Track::Holder mMix;
+};
+
+const AudacityProject::AttachedObjects::RegisteredFactory sPreviewMixCacheKey{
+   [](AudacityProject &project) {
+      return std::make_shared<PreviewMixCache>(project);
+   }
+};
+
+PreviewMixCache &PreviewMixCache::Get(AudacityProject &project)
+{
+   return project.AttachedObjects::Get<PreviewMixCache>(sPreviewMixCacheKey);
+}
+}
+
 void EffectPreview(EffectBase &effect,
    EffectSettingsAccess &access, std::function<void()> updateUI, bool dryOnly)
 {
@@ -120,13 +181,24 @@ void EffectPreview(EffectBase &effect,
    // Linear Effect preview optimised by pre-mixing to one track.
    // Generators need to generate per track.
    if (isLinearEffect && !isGenerator) {
-      auto newTrack = MixAndRender(
-         saveTracks->Selected<const WaveTrack>(),
-         Mixer::WarpOptions{ saveTracks->GetOwner() },
-         wxString{}, // Don't care about the name of the temporary tracks
-         factory, rate, floatSample, mT0, t1);
-      if (!newTrack)
-         return;
+      // Pressing Preview again after changing only the settings need not
+      // mix the same input again
+      std::vector<TrackId> ids;
+      for (auto src : saveTracks->Selected<const WaveTrack>())
+         ids.push_back(src->GetId());
+      const auto pCache = pProject ? &PreviewMixCache::Get(*pProject) : nullptr;
+      auto newTrack = pCache ? pCache->Find(ids, mT0, t1, rate) : nullptr;
+      if (!newTrack) {
+         newTrack = MixAndRender(
+            saveTracks->Selected<const WaveTrack>(),
+            Mixer::WarpOptions{ saveTracks->GetOwner() },
+            wxString{}, // Don't care about the name of the temporary tracks
+            factory, rate, floatSample, mT0, t1);
+         if (!newTrack)
+            return;
+         if (pCache)
+            pCache->Store(move(ids), mT0, t1, rate, *newTrack);
+      }
       mTracks->Add(newTrack);
 
       newTrack->MoveTo(0);
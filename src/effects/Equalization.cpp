@@ -37,6 +37,7 @@
 #include "EffectEditor.h"
 #include "EffectOutputTracks.h"
 #include "LoadEffects.h"
+#include "PartitionedConvolver.h"
 #include "ShuttleGui.h"
 
 #include "WaveClip.h"
@@ -363,43 +364,6 @@ bool EffectEqualization::Init()
    return(true);
 }
 
-struct EffectEqualization::Task {
-   Task(size_t M, size_t idealBlockLen, WaveChannel &channel)
-      : buffer{ idealBlockLen }
-      , idealBlockLen{ idealBlockLen }
-      , output{ channel }
-      , leftTailRemaining{ (M - 1) / 2 }
-   {
-      memset(lastWindow, 0, windowSize * sizeof(float));
-   }
-
-   void AccumulateSamples(constSamplePtr buffer, size_t len)
-   {
-      auto leftTail = std::min(len, leftTailRemaining);
-      leftTailRemaining -= leftTail;
-      len -= leftTail;
-      buffer += leftTail * sizeof(float);
-      output.Append(buffer, floatSample, len);
-   }
-
-   static constexpr auto windowSize = EqualizationFilter::windowSize;
-   Floats window1{ windowSize };
-   Floats window2{ windowSize };
-
-   Floats buffer;
-   const size_t idealBlockLen;
-
-   // These pointers are swapped after each FFT window
-   float *thisWindow{ window1.get() };
-   float *lastWindow{ window2.get() };
-
-   // a new WaveChannel to hold all of the output,
-   // including 'tails' each end
-   WaveChannel &output;
-
-   size_t leftTailRemaining;
-};
-
 bool EffectEqualization::Process(EffectInstance &, EffectSettings &)
 {
    EffectOutputTracks outputs { *mTracks, GetType(), { { mT0, mT1 } } };
@@ -420,33 +384,15 @@ bool EffectEqualization::Process(EffectInstance &, EffectSettings &)
 
          auto pTempTrack = track->EmptyCopy();
          pTempTrack->ConvertToSampleFormat(floatSample);
-         auto iter0 = pTempTrack->Channels().begin();
-
-         for (const auto pChannel : track->Channels()) {
-            constexpr auto windowSize = EqualizationFilter::windowSize;
-            const auto &M = mParameters.mM;
-
-            wxASSERT(M - 1 < windowSize);
-            size_t L = windowSize - (M - 1);   //Process L samples at a go
-            auto s = start;
-            auto idealBlockLen = pChannel->GetMaxBlockSize() * 4;
-            if (idealBlockLen % L != 0)
-               idealBlockLen += (L - (idealBlockLen % L));
-            auto pNewChannel = *iter0++;
-            Task task{ M, idealBlockLen, *pNewChannel };
-            bGoodResult = ProcessOne(task, count, *pChannel, start, len);
-            if (!bGoodResult)
-               goto done;
-         }
+         bGoodResult = ProcessOne(count, *track, *pTempTrack, start, len);
+         if (!bGoodResult)
+            break;
          pTempTrack->Flush();
-         // Remove trailing data from the temp track
-         pTempTrack->Clear(t1 - t0, pTempTrack->GetEndTime());
          track->ClearAndPaste(t0, t1, *pTempTrack, true, true);
       }
 
       count++;
    }
-   done:
 
    if (bGoodResult)
       outputs.Commit();
@@ -472,85 +418,69 @@ bool EffectEqualization::TransferDataToWindow(const EffectSettings &settings)
 
 // EffectEqualization implementation
 
-bool EffectEqualization::ProcessOne(Task &task,
-   int count, const WaveChannel &t, sampleCount start, sampleCount len)
+bool EffectEqualization::ProcessOne(int count, const WaveTrack &track,
+   WaveTrack &output, sampleCount start, sampleCount len)
 {
-   constexpr auto windowSize = EqualizationFilter::windowSize;
-
    const auto &M = mParameters.mM;
-
-   wxASSERT(M - 1 < windowSize);
-   size_t L = windowSize - (M - 1);   //Process L samples at a go
+   const auto nChannels = track.NChannels();
+
+   // All channels go through one convolver, which shares the spectra of the
+   // impulse response among them
+   PartitionedConvolver convolver{
+      PartitionedConvolver::OfflineBlockSize(M), nChannels, M };
+   convolver.SetImpulse(mParameters.mImpulse.data(), M);
+   const auto blockSize = convolver.GetBlockSize();
+
+   // Read whole blocks of the convolver at a go
+   auto idealBlockLen = track.GetMaxBlockSize() * 4;
+   if (idealBlockLen % blockSize != 0)
+      idealBlockLen += (blockSize - (idealBlockLen % blockSize));
+
+   std::vector<Floats> buffers;
+   std::vector<float *> pointers(nChannels);
+   for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+      buffers.emplace_back(idealBlockLen);
+
+   // The response is centered, so the first (M - 1) / 2 samples of output are
+   // its left tail; input past the end is silence, which gives the right tail
+   size_t leftTailRemaining = (M - 1) / 2;
+   const auto end = start + len;
    auto s = start;
-
-   auto &buffer = task.buffer;
-   auto &window1 = task.window1;
-   auto &window2 = task.window2;
-   auto &thisWindow = task.thisWindow;
-   auto &lastWindow = task.lastWindow;
-
-   auto originalLen = len;
-
-   auto &output = task.output;
+   auto remaining = len;
 
    TrackProgress(count, 0.);
-   bool bLoopSuccess = true;
-   size_t wcopy = 0;
-
-   while (len != 0)
+   while (remaining > 0)
    {
-      auto block = limitSampleBufferSize( task.idealBlockLen, len );
-
-      t.GetFloats(buffer.get(), s, block);
-
-      for(size_t i = 0; i < block; i += L)   //go through block in lumps of length L
-      {
-         wcopy = std::min <size_t> (L, block - i);
-         for(size_t j = 0; j < wcopy; j++)
-            thisWindow[j] = buffer[i+j];   //copy the L (or remaining) samples
-         for(auto j = wcopy; j < windowSize; j++)
-            thisWindow[j] = 0;   //this includes the padding
-
-         mParameters.Filter(windowSize, thisWindow);
-
-         // Overlap - Add
-         for(size_t j = 0; (j < M - 1) && (j < wcopy); j++)
-            buffer[i+j] = thisWindow[j] + lastWindow[L + j];
-         for(size_t j = M - 1; j < wcopy; j++)
-            buffer[i+j] = thisWindow[j];
-
-         std::swap( thisWindow, lastWindow );
-      }  //next i, lump of this block
-
-      task.AccumulateSamples((samplePtr)buffer.get(), block);
-      len -= block;
-      s += block;
-
-      if (TrackProgress(count, ( s - start ).as_double() /
-                        originalLen.as_double()))
-      {
-         bLoopSuccess = false;
-         break;
+      const auto block =
+         s < end ? limitSampleBufferSize(idealBlockLen, end - s) : 0;
+      auto iter = buffers.begin();
+      for (const auto pChannel : track.Channels()) {
+         const auto buffer = (iter++)->get();
+         if (block > 0)
+            pChannel->GetFloats(buffer, s, block);
+         std::fill(buffer + block, buffer + idealBlockLen, 0.0f);
       }
-   }
 
-   if (bLoopSuccess) {
-      // M-1 samples of 'tail' left in lastWindow, get them now
-      if(wcopy < (M - 1)) {
-         // Still have some overlap left to process
-         // (note that lastWindow and thisWindow have been exchanged at this point
-         //  so that 'thisWindow' is really the window prior to 'lastWindow')
-         size_t j = 0;
-         for(; j < M - 1 - wcopy; j++)
-            buffer[j] = lastWindow[wcopy + j] + thisWindow[L + wcopy + j];
-         // And fill in the remainder after the overlap
-         for( ; j < M - 1; j++)
-            buffer[j] = lastWindow[wcopy + j];
-      } else {
-         for(size_t j = 0; j < M - 1; j++)
-            buffer[j] = lastWindow[wcopy + j];
+      for (size_t i = 0; i < idealBlockLen; i += blockSize) {
+         for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+            pointers[iChannel] = buffers[iChannel].get() + i;
+         convolver.ProcessBlock(pointers.data(), pointers.data());
       }
-      task.AccumulateSamples((samplePtr)buffer.get(), M - 1);
+      s += idealBlockLen;
+
+      const auto leftTail = std::min(idealBlockLen, leftTailRemaining);
+      leftTailRemaining -= leftTail;
+      const auto toAppend =
+         limitSampleBufferSize(idealBlockLen - leftTail, remaining);
+      iter = buffers.begin();
+      for (const auto pChannel : output.Channels())
+         pChannel->Append(
+            (samplePtr)((iter++)->get() + leftTail), floatSample, toAppend);
+      remaining -= toAppend;
+
+      if (TrackProgress(count,
+         (len - remaining).as_double() / len.as_double()))
+         return false;
    }
-   return bLoopSuccess;
+   return true;
 }
@@ -17,7 +17,7 @@
 #include "StatefulEffect.h"
 #include "EqualizationUI.h"
 
-class WaveChannel;
+class WaveTrack;
 
 class EffectEqualization : public StatefulEffect
 {
@@ -68,8 +68,7 @@ public:
 private:
    // EffectEqualization implementation
 
-   struct Task;
-   bool ProcessOne(Task &task, int count, const WaveChannel &t,
+   bool ProcessOne(int count, const WaveTrack &track, WaveTrack &output,
       sampleCount start, sampleCount len);
    
    wxWeakRef<wxWindow> mUIParent{};
@@ -22,6 +22,7 @@
 #include "EffectEditor.h"
 #include "EffectOutputTracks.h"
 #include "LoadEffects.h"
+#include "SampleBlock.h"
 
 #include <math.h>
 
@@ -31,6 +32,7 @@
 #include "AudacityMessageBox.h"
 
 #include "../LabelTrack.h"
+#include "WaveChannelUtilities.h"
 #include "WaveTrack.h"
 
 const EffectParameterMethods& EffectFindClipping::Parameters() const
@@ -129,46 +131,15 @@ bool EffectFindClipping::Process(EffectInstance &, EffectSettings &)
 bool EffectFindClipping::ProcessOne(LabelTrack &lt,
    int count, const WaveChannel &wt, sampleCount start, sampleCount len)
 {
-   bool bGoodResult = true;
-   size_t blockSize = (mStart * 1000);
-
    if (len < mStart)
       return true;
 
-   Floats buffer;
-   try {
-      // mStart should be positive.
-      // if we are throwing bad_alloc and mStart is negative, find out why.
-      if (mStart < 0 || (int)blockSize < mStart)
-         // overflow
-         throw std::bad_alloc{};
-      buffer.reinit(blockSize);
-   }
-   catch( const std::bad_alloc & ) {
-      EffectUIServices::DoMessageBox(*this,
-         XO("Requested value exceeds memory capacity."));
-      return false;
-   }
-
-   float *ptr = buffer.get();
-
-   decltype(len) s = 0, startrun = 0, stoprun = 0, samps = 0;
-   decltype(blockSize) block = 0;
+   decltype(len) startrun = 0, stoprun = 0, samps = 0;
    double startTime = -1.0;
 
-   while (s < len) {
-      if (block == 0) {
-         if (TrackProgress(count, s.as_double() / len.as_double() )) {
-            bGoodResult = false;
-            break;
-         }
-         block = limitSampleBufferSize( blockSize, len - s );
-         wt.GetFloats(buffer.get(), start + s, block);
-         ptr = buffer.get();
-      }
-
-      float v = fabs(*ptr++);
-      if (v >= MAX_AUDIO) {
+   // Advance the search by one sample, at s samples after start
+   const auto step = [&](bool clipped, sampleCount s) {
+      if (clipped) {
          if (startrun == 0) {
             startTime = wt.LongSamplesToTime(start + s);
             samps = 0;
@@ -204,10 +175,44 @@ bool EffectFindClipping::ProcessOne(LabelTrack &lt,
          else
             startrun = 0;
       }
-      s++;
-      block--;
-   }
-   return bGoodResult;
+   };
+
+   // Samples before this one, relative to start, have been stepped over
+   sampleCount next = 0;
+
+   // Step over samples known not to be clipped.  Only the first mStop of
+   // them can matter, by ending a run
+   const auto skip = [&](sampleCount to) {
+      const auto limit = std::min(to, next + mStop);
+      for (; next < limit && startrun > 0; ++next)
+         step(false, next);
+      next = to;
+   };
+
+   // Summaries decide most blocks, which then need not be read
+   const auto classify = [](const MinMaxRMS &summary) {
+      return (summary.max < MAX_AUDIO && summary.min > -MAX_AUDIO)
+         ? Sequence::Verdict::None : Sequence::Verdict::Some;
+   };
+   const auto visit = [&](sampleCount s, size_t block,
+      const float *samples, Sequence::Verdict) {
+      // Stretches between clips are silent
+      skip(s - start);
+      if (samples) {
+         for (size_t i = 0; i < block; ++i, ++next)
+            step(fabs(samples[i]) >= MAX_AUDIO, next);
+      }
+      else
+         skip(next + block);
+      return !TrackProgress(count, next.as_double() / len.as_double());
+   };
+
+   if (TrackProgress(count, 0) ||
+      !WaveChannelUtilities::Scan(wt, start, len, classify, visit))
+      return false;
+   // The stretch after the last clip may end a run too
+   skip(len);
+   return true;
 }
 
 std::unique_ptr<EffectEditor> EffectFindClipping::PopulateOrExchange(
@@ -30,6 +30,7 @@
 #include "WaveTrack.h"
 #include "../widgets/valnum.h"
 #include "ProgressDialog.h"
+#include "concurrency/TaskPool.h"
 
 #include "LoadEffects.h"
 
@@ -113,6 +114,17 @@ bool EffectLoudness::Process(EffectInstance &, EffectSettings &)
    AllocBuffers(outputs.Get());
    mProgressVal = 0;
 
+   // Measure all tracks (or channels) together first
+   std::vector<double> loudness;
+   if (mNormalizeTo == kLoudness) {
+      mProgressMsg = topMsg + XO("Analyzing...");
+      if (!AnalyseLoudness(outputs.Get(), loudness)) {
+         FreeBuffers();
+         return false;
+      }
+   }
+   auto nextLoudness = loudness.begin();
+
    for (auto pTrack : outputs.Get().Selected<WaveTrack>()) {
       // Get start and end times from track
       double trackStart = pTrack->GetStartTime();
@@ -139,17 +151,9 @@ bool EffectLoudness::Process(EffectInstance &, EffectSettings &)
       mProcStereo = nChannels > 1;
 
       const auto processOne = [&](WaveChannel &track){
-         std::optional<EBUR128> loudnessProcessor;
          float RMS[2];
 
-         if (mNormalizeTo == kLoudness) {
-            loudnessProcessor.emplace(mCurRate, nChannels);
-            if (!ProcessOne(track, nChannels,
-               curT0, curT1, 0, &*loudnessProcessor))
-               // Processing failed -> abort
-               return false;
-         }
-         else {
+         if (mNormalizeTo != kLoudness) {
             // RMS
             if (mProcStereo) {
                size_t idx = 0;
@@ -168,7 +172,7 @@ bool EffectLoudness::Process(EffectInstance &, EffectSettings &)
          // Calculate normalization values the analysis results
          float extent;
          if (mNormalizeTo == kLoudness)
-            extent = loudnessProcessor->IntegrativeLoudness();
+            extent = *nextLoudness++;
          else {
             // RMS
             extent = RMS[0];
@@ -197,7 +201,7 @@ bool EffectLoudness::Process(EffectInstance &, EffectSettings &)
          }
 
          mProgressMsg = topMsg + XO("Processing: %s").Format( trackName );
-         if (!ProcessOne(track, nChannels, curT0, curT1, mult, nullptr)) {
+         if (!ProcessOne(track, nChannels, curT0, curT1, mult)) {
             // Processing failed -> abort
             return false;
          }
@@ -391,15 +395,134 @@ bool EffectLoudness::GetTrackRMS(WaveChannel &track,
    return true;
 }
 
+/// Measures the integrative loudness of each selected track, or of each
+/// channel when they are normalized independently, in the order in which
+/// Process() visits them.
+/// Samples are read on this thread, one buffer of each track at a time, and
+/// the buffers are analysed concurrently.
+bool EffectLoudness::AnalyseLoudness(TrackList &outputs,
+   std::vector<double> &loudness)
+{
+   struct Analysis {
+      WaveChannel *pChannel;
+      double rate;
+      size_t nChannels;
+      sampleCount pos;
+      sampleCount end;
+      std::unique_ptr<EBUR128> pProcessor;
+      Floats buffers[2];
+      size_t len;
+   };
+
+   // Find the ranges first; the processors and buffers are made only for a
+   // batch of as many channels as the pool has threads
+   std::vector<Analysis> analyses;
+   double totalLen = 0;
+
+   for (auto pTrack : outputs.Selected<WaveTrack>()) {
+      const double curT0 = std::max(pTrack->GetStartTime(), mT0);
+      const double curT1 = std::min(pTrack->GetEndTime(), mT1);
+      // Abort if the right marker is not to the right of the left marker
+      if (curT1 <= curT0)
+         return false;
+
+      const auto channels = pTrack->Channels();
+      const auto nChannels = mStereoInd ? 1 : channels.size();
+      const auto addOne = [&](WaveChannel &channel) {
+         auto &analysis = analyses.emplace_back();
+         analysis.pChannel = &channel;
+         analysis.rate = pTrack->GetRate();
+         analysis.nChannels = nChannels;
+         analysis.pos = channel.TimeToLongSamples(curT0);
+         analysis.end = channel.TimeToLongSamples(curT1);
+         totalLen += (analysis.end - analysis.pos).as_double() * nChannels;
+      };
+      if (mStereoInd)
+         for (const auto pChannel : channels)
+            addOne(*pChannel);
+      else
+         addOne(**channels.begin());
+   }
+
+   auto &pool = audacity::concurrency::TaskPool::Get();
+   const auto batchSize = std::max<size_t>(1, pool.GetWorkersCount());
+   double doneLen = 0;
+   for (size_t first = 0; first < analyses.size(); first += batchSize) {
+      const auto last = std::min(analyses.size(), first + batchSize);
+      for (auto ii = first; ii < last; ++ii) {
+         auto &analysis = analyses[ii];
+         analysis.pProcessor =
+            std::make_unique<EBUR128>(analysis.rate, analysis.nChannels);
+         for (size_t idx = 0; idx < analysis.nChannels; ++idx)
+            analysis.buffers[idx].reinit(mTrackBufferCapacity);
+      }
+
+      while (true) {
+         bool more = false;
+         for (auto ii = first; ii < last; ++ii) {
+            auto &analysis = analyses[ii];
+            analysis.len = 0;
+            if (analysis.pos >= analysis.end)
+               continue;
+            more = true;
+            auto &channel = *analysis.pChannel;
+            const size_t remainingLen =
+               (analysis.end - analysis.pos).as_size_t();
+            analysis.len = std::min(remainingLen, limitSampleBufferSize(
+               channel.GetBestBlockSize(analysis.pos), mTrackBufferCapacity));
+            if (analysis.nChannels == 1)
+               channel.GetFloats(
+                  analysis.buffers[0].get(), analysis.pos, analysis.len);
+            else {
+               size_t idx = 0;
+               for (const auto pChannel : channel.GetTrack().Channels())
+                  pChannel->GetFloats(analysis.buffers[idx++].get(),
+                     analysis.pos, analysis.len);
+            }
+         }
+         if (!more)
+            break;
+
+         pool.ParallelFor(last - first, 1, [&](size_t begin, size_t end) {
+            for (auto ii = first + begin; ii < first + end; ++ii) {
+               auto &analysis = analyses[ii];
+               if (analysis.len == 0)
+                  continue;
+               const float *channels[2] = {
+                  analysis.buffers[0].get(), analysis.buffers[1].get() };
+               analysis.pProcessor->ProcessSamples(channels, analysis.len);
+            }
+         });
+
+         for (auto ii = first; ii < last; ++ii) {
+            auto &analysis = analyses[ii];
+            analysis.pos += analysis.len;
+            doneLen += double(analysis.len) * analysis.nChannels;
+         }
+         // The analysis is the first of two passes
+         mProgressVal = doneLen / (2 * totalLen);
+         if (TotalProgress(mProgressVal, mProgressMsg))
+            return false;
+      }
+
+      // Keep only the results of the batch
+      for (auto ii = first; ii < last; ++ii) {
+         auto &analysis = analyses[ii];
+         loudness.push_back(analysis.pProcessor->IntegrativeLoudness());
+         analysis.pProcessor.reset();
+         for (auto &buffer : analysis.buffers)
+            buffer.reset();
+      }
+   }
+   return true;
+}
+
 /// ProcessOne() takes a track, transforms it to bunch of buffer-blocks,
 /// and executes ProcessData, on it...
 ///  uses mMult to normalize a track.
 ///  mMult must be set before this is called
-/// In analyse mode, it executes the selected analyse operation on it...
-///  mMult does not have to be set before this is called
 bool EffectLoudness::ProcessOne(WaveChannel &track, size_t nChannels,
-   const double curT0, const double curT1, const float mult,
-   EBUR128 *pLoudnessProcessor)
+   const double curT0, const double curT1, const float mult)
 {
    // Transform the marker timepoints to samples
    auto start = track.TimeToLongSamples(curT0);
@@ -429,16 +552,10 @@ bool EffectLoudness::ProcessOne(WaveChannel &track, size_t nChannels,
       LoadBufferBlock(track, nChannels, s, blockLen);
 
       // Process the buffer.
-      if (pLoudnessProcessor) {
-         if (!AnalyseBufferBlock(*pLoudnessProcessor))
-            return false;
-      }
-      else {
-         if (!ProcessBufferBlock(mult))
-            return false;
-         if (!StoreBufferBlock(track, nChannels, s, blockLen))
-            return false;
-      }
+      if (!ProcessBufferBlock(mult))
+         return false;
+      if (!StoreBufferBlock(track, nChannels, s, blockLen))
+         return false;
 
       // Increment s one blockfull of samples
       s += blockLen;
@@ -467,23 +584,6 @@ void EffectLoudness::LoadBufferBlock(WaveChannel &track, size_t nChannels,
    mTrackBufferLen = len;
 }
 
-/// Calculates sample sum (for DC) and EBU R128 weighted square sum
-/// (for loudness).
-bool EffectLoudness::AnalyseBufferBlock(EBUR128 &loudnessProcessor)
-{
-   for(size_t i = 0; i < mTrackBufferLen; i++)
-   {
-      loudnessProcessor.ProcessSampleFromChannel(mTrackBuffer[0][i], 0);
-      if (mProcStereo)
-         loudnessProcessor.ProcessSampleFromChannel(mTrackBuffer[1][i], 1);
-      loudnessProcessor.NextSample();
-   }
-
-   if (!UpdateProgress())
-      return false;
-   return true;
-}
-
 bool EffectLoudness::ProcessBufferBlock(const float mult)
 {
    for(size_t i = 0; i < mTrackBufferLen; i++)
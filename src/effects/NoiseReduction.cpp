@@ -50,13 +50,14 @@
 #include "FFT.h"
 #include "Prefs.h"
 #include "RealFFTf.h"
-#include "../SpectrumTransformer.h"
+#include "../TrackSpectrumTransformer.h"
 
 #include "WaveTrack.h"
 #include "AudacityMessageBox.h"
 #include "../widgets/valnum.h"
 
 #include <algorithm>
+#include <optional>
 #include <vector>
 #include <math.h>
 
@@ -262,6 +263,7 @@ struct MyTransformer : TrackSpectrumTransformer {
          windowSize, stepsPerWindow, leadingPadding, trailingPadding
       }
       , mWorker{ worker }
+      , mFreqSmoothingScratch(windowSize / 2 + 1)
    {
    }
    struct MyWindow : public Window
@@ -283,6 +285,9 @@ struct MyTransformer : TrackSpectrumTransformer {
    bool DoFinish() override;
 
    EffectNoiseReduction::Worker &mWorker;
+   //! Each transformer has its own, so the segments of a track can be
+   //! processed concurrently
+   FloatVector mFreqSmoothingScratch;
 };
 
 //----------------------------------------------------------------------------
@@ -308,12 +313,15 @@ public:
       TrackList &tracks, double mT0, double mT1);
 
    static bool Processor(SpectrumTransformer &transformer);
+   //! Does not update the progress, which is done between segments instead
+   static bool ConcurrentProcessor(SpectrumTransformer &transformer);
 
-   void ApplyFreqSmoothing(FloatVector &gains);
+   void ProcessWindow(MyTransformer &transformer);
+   void ApplyFreqSmoothing(FloatVector &gains, FloatVector &scratch) const;
    void GatherStatistics(MyTransformer &transformer);
    inline bool Classify(
-      MyTransformer &transformer, unsigned nWindows, int band);
-   void ReduceNoise(MyTransformer &transformer);
+      MyTransformer &transformer, unsigned nWindows, int band) const;
+   void ReduceNoise(MyTransformer &transformer) const;
    void FinishTrackStatistics();
 
    const bool mDoProfile;
@@ -322,7 +330,6 @@ public:
    const Settings &mSettings;
    Statistics &mStatistics;
 
-   FloatVector mFreqSmoothingScratch;
    const size_t mFreqSmoothingBins;
    // When spectral selection limits the affected band:
    size_t mBinLow;  // inclusive lower bound
@@ -340,6 +347,9 @@ public:
    unsigned  mNWindowsToExamine;
    unsigned  mCenter;
    unsigned  mHistoryLen;
+   //! How many windows the release of gains can carry through, before the
+   //! queue; nullopt if the release never decays to the noise floor
+   std::optional<unsigned> mReleaseLen;
 
    // Following are for progress indicator only:
    unsigned  mProgressTrackCount = 0;
@@ -766,7 +776,27 @@ bool EffectNoiseReduction::Worker::Process(
             pFirstTrack = ppTempTrack->get();
             pIter.emplace(pFirstTrack->Channels().begin());
          }
-         for (const auto pChannel : track->Channels()) {
+         if (ppTempTrack && mReleaseLen) {
+            // Reduce noise in all channels and in segments of each at once
+            const auto nChannels = track->NChannels();
+            const auto factory = [&](WaveChannel &outputChannel) {
+               return std::make_unique<MyTransformer>(*this, &outputChannel,
+                  true, inWindowType, outWindowType,
+                  mSettings.WindowSize(), mSettings.StepsPerWindow(),
+                  true, true);
+            };
+            const auto progress = [&](double fraction) {
+               return !mEffect.TrackProgress(
+                  mProgressTrackCount, fraction * nChannels);
+            };
+            // One more window of history, to be safe
+            if (!TrackSpectrumTransformer::ProcessConcurrently(
+               ConcurrentProcessor, factory, *track, *pFirstTrack,
+               mHistoryLen, start, len, *mReleaseLen + 1, progress))
+               return false;
+            mProgressTrackCount += nChannels;
+         }
+         else for (const auto pChannel : track->Channels()) {
             auto pOutputTrack = pIter ? *(*pIter)++ : nullptr;
             MyTransformer transformer{ *this, pOutputTrack.get(),
                !mSettings.mDoProfile, inWindowType, outWindowType,
@@ -799,7 +829,8 @@ bool EffectNoiseReduction::Worker::Process(
    return true;
 }
 
-void EffectNoiseReduction::Worker::ApplyFreqSmoothing(FloatVector &gains)
+void EffectNoiseReduction::Worker::ApplyFreqSmoothing(
+   FloatVector &gains, FloatVector &scratch) const
 {
    // Given an array of gain mutipliers, average them
    // GEOMETRICALLY.  Don't multiply and take nth root --
@@ -811,7 +842,7 @@ void EffectNoiseReduction::Worker::ApplyFreqSmoothing(FloatVector &gains)
    const auto spectrumSize = mSettings.SpectrumSize();
 
    {
-      auto pScratch = mFreqSmoothingScratch.data();
+      auto pScratch = scratch.data();
       std::fill(pScratch, pScratch + spectrumSize, 0.0f);
    }
 
@@ -823,13 +854,13 @@ void EffectNoiseReduction::Worker::ApplyFreqSmoothing(FloatVector &gains)
       const int j0 = std::max(0, ii - (int)mFreqSmoothingBins);
       const int j1 = std::min(spectrumSize - 1, ii + mFreqSmoothingBins);
       for(int jj = j0; jj <= j1; ++jj) {
-         mFreqSmoothingScratch[ii] += gains[jj];
+         scratch[ii] += gains[jj];
       }
-      mFreqSmoothingScratch[ii] /= (j1 - j0 + 1);
+      scratch[ii] /= (j1 - j0 + 1);
    }
 
    for (size_t ii = 0; ii < spectrumSize; ++ii)
-      gains[ii] = exp(mFreqSmoothingScratch[ii]);
+      gains[ii] = exp(scratch[ii]);
 }
 
 EffectNoiseReduction::Worker::Worker(EffectNoiseReduction &effect,
@@ -844,7 +875,6 @@ EffectNoiseReduction::Worker::Worker(EffectNoiseReduction &effect,
 , mSettings{ settings }
 , mStatistics{ statistics }
 
-, mFreqSmoothingScratch(mSettings.SpectrumSize())
 , mFreqSmoothingBins{ size_t(std::max(0.0, settings.mFreqSmoothingBands)) }
 , mBinLow{ 0 }
 , mBinHigh{ mSettings.SpectrumSize() }
@@ -883,6 +913,19 @@ EffectNoiseReduction::Worker::Worker(EffectNoiseReduction &effect,
    // Applies to power, divide by 10:
    mOldSensitivityFactor = pow(10.0, settings.mOldSensitivity / 10.0);
 
+   // Follow a gain of 1 as ReduceNoise() releases it, until it reaches the
+   // floor; the float arithmetic is the same, so the count is exact
+   mReleaseLen = 0;
+   for (float gain = 1.0f; gain * mOneBlockRelease > mNoiseAttenFactor;) {
+      const float next = gain * mOneBlockRelease;
+      if (next == gain) {
+         mReleaseLen.reset();
+         break;
+      }
+      gain = next;
+      ++*mReleaseLen;
+   }
+
    mNWindowsToExamine = (mMethod == DM_OLD_METHOD)
       ? std::max(2, (int)(minSignalTime * sampleRate / mSettings.StepSize()))
       : 1 + mSettings.StepsPerWindow();
@@ -919,6 +962,25 @@ bool EffectNoiseReduction::Worker::Processor(SpectrumTransformer &trans)
 {
    auto &transformer = static_cast<MyTransformer &>(trans);
    auto &worker = transformer.mWorker;
+   worker.ProcessWindow(transformer);
+
+   // Update the Progress meter, let user cancel
+   return !worker.mEffect.TrackProgress(worker.mProgressTrackCount,
+      std::min(1.0,
+         ((++worker.mProgressWindowCount).as_double() *
+          worker.mSettings.StepSize()) / worker.mLen.as_double()));
+}
+
+bool EffectNoiseReduction::Worker::ConcurrentProcessor(
+   SpectrumTransformer &trans)
+{
+   auto &transformer = static_cast<MyTransformer &>(trans);
+   transformer.mWorker.ProcessWindow(transformer);
+   return true;
+}
+
+void EffectNoiseReduction::Worker::ProcessWindow(MyTransformer &transformer)
+{
    // Compute power spectrum in the newest window
    {
       auto &record = transformer.NthWindow(0);
@@ -926,7 +988,7 @@ bool EffectNoiseReduction::Worker::Processor(SpectrumTransformer &trans)
       const double dc = record.mRealFFTs[0];
       *pSpectrum++ = dc * dc;
       float *pReal = &record.mRealFFTs[1], *pImag = &record.mImagFFTs[1];
-      for (size_t nn = worker.mSettings.SpectrumSize() - 2; nn--;) {
+      for (size_t nn = mSettings.SpectrumSize() - 2; nn--;) {
          const double re = *pReal++, im = *pImag++;
          *pSpectrum++ = re * re + im * im;
       }
@@ -934,16 +996,10 @@ bool EffectNoiseReduction::Worker::Processor(SpectrumTransformer &trans)
       *pSpectrum = nyquist * nyquist;
    }
 
-   if (worker.mDoProfile)
-      worker.GatherStatistics(transformer);
+   if (mDoProfile)
+      GatherStatistics(transformer);
    else
-      worker.ReduceNoise(transformer);
-
-   // Update the Progress meter, let user cancel
-   return !worker.mEffect.TrackProgress(worker.mProgressTrackCount,
-      std::min(1.0,
-         ((++worker.mProgressWindowCount).as_double() *
-          worker.mSettings.StepSize()) / worker.mLen.as_double()));
+      ReduceNoise(transformer);
 }
 
 void EffectNoiseReduction::Worker::FinishTrackStatistics()
@@ -1006,7 +1062,7 @@ void EffectNoiseReduction::Worker::GatherStatistics(MyTransformer &transformer)
 // Examine the band in a few neighboring windows to decide.
 inline
 bool EffectNoiseReduction::Worker::Classify(
-   MyTransformer &transformer, unsigned nWindows, int band)
+   MyTransformer &transformer, unsigned nWindows, int band) const
 {
    switch (mMethod) {
 #ifdef OLD_METHOD_AVAILABLE
@@ -1077,7 +1133,8 @@ bool EffectNoiseReduction::Worker::Classify(
    }
 }
 
-void EffectNoiseReduction::Worker::ReduceNoise(MyTransformer &transformer)
+void EffectNoiseReduction::Worker::ReduceNoise(
+   MyTransformer &transformer) const
 {
    auto historyLen = transformer.CurrentQueueSize();
    auto nWindows = std::min<unsigned>(mNWindowsToExamine, historyLen);
@@ -1169,7 +1226,8 @@ void EffectNoiseReduction::Worker::ReduceNoise(MyTransformer &transformer)
       if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
          // Apply frequency smoothing to output gain
          // Gains are not less than mNoiseAttenFactor
-         ApplyFreqSmoothing(record.mGains);
+         ApplyFreqSmoothing(
+            record.mGains, transformer.mFreqSmoothingScratch);
 
       // Apply gain to FFT
       {
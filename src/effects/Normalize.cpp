@@ -17,6 +17,7 @@
 #include "EffectEditor.h"
 #include "EffectOutputTracks.h"
 #include "LoadEffects.h"
+#include "SampleBlock.h"
 
 #include <math.h>
 
@@ -337,8 +338,6 @@ bool EffectNormalize::AnalyseTrackData(const WaveChannel &track,
    const ProgressReport &report, const double curT0, const double curT1,
    float &offset)
 {
-   bool rc = true;
-
    //Transform the marker timepoints to samples
    auto start = track.TimeToLongSamples(curT0);
    auto end = track.TimeToLongSamples(curT1);
@@ -348,43 +347,28 @@ bool EffectNormalize::AnalyseTrackData(const WaveChannel &track,
    //to make it a double now than it is to do it later
    auto len = (end - start).as_double();
 
-   //Initiate a processing buffer.  This buffer will (most likely)
-   //be shorter than the length of the track being processed.
-   Floats buffer{ track.GetMaxBlockSize() };
-
    double sum = 0.0; // dc offset inits
-
-   sampleCount blockSamples;
    sampleCount totalSamples = 0;
 
-   //Go through the track one buffer at a time. s counts which
-   //sample the current buffer starts at.
-   auto s = start;
-   while (s < end) {
-      //Get a block of samples (smaller than the size of the buffer)
-      //Adjust the block size if it is the final block in the track
-      const auto block = limitSampleBufferSize(
-         track.GetBestBlockSize(s),
-         end - s
-      );
-
-      //Get the samples from the track and put them in the buffer
-      track.GetFloats(
-         buffer.get(), s, block, FillFormat::fillZero, true, &blockSamples);
-      totalSamples += blockSamples;
-
-      //Process the buffer.
-      sum = AnalyseDataDC(buffer.get(), block, sum);
-
-      //Increment s one blockfull of samples
-      s += block;
+   //The summaries can't give the sum, but they can show that samples are all
+   //zero, as they are in silent blocks, which then need not be read
+   const auto classify = [](const MinMaxRMS &summary) {
+      return (summary.min == 0 && summary.max == 0)
+         ? Sequence::Verdict::None : Sequence::Verdict::Some;
+   };
+   const auto visit = [&](sampleCount s, size_t block,
+      const float *samples, Sequence::Verdict) {
+      //Only samples within clips count
+      totalSamples += block;
+      if (samples)
+         sum = AnalyseDataDC(samples, block, sum);
 
       //Update the Progress meter
-      if (!report((s - start).as_double() / len)) {
-         rc = false; //lda .. break, not return, so that buffer is deleted
-         break;
-      }
-   }
+      return report((s + block - start).as_double() / len);
+   };
+   const bool rc = WaveChannelUtilities::Scan(
+      track, start, end - start, classify, visit);
+
    if (totalSamples > 0)
       // calculate actual offset (amount that needs to be added on)
       offset = -sum / totalSamples.as_double();
@@ -457,7 +441,8 @@ bool EffectNormalize::ProcessOne(WaveChannel &track,
 }
 
 /// @see AnalyseDataLoudnessDC
-double EffectNormalize::AnalyseDataDC(float *buffer, size_t len, double sum)
+double EffectNormalize::AnalyseDataDC(
+   const float *buffer, size_t len, double sum)
 {
    for(decltype(len) i = 0; i < len; i++)
       sum += (double)buffer[i];
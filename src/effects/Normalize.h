@@ -67,7 +67,8 @@ private:
    static bool AnalyseTrackData(const WaveChannel &track,
       const ProgressReport &report, double curT0, double curT1,
       float &offset);
-   static double AnalyseDataDC(float *buffer, size_t len, double sum);
+   static double AnalyseDataDC(
+      const float *buffer, size_t len, double sum);
    void ProcessData(float *buffer, size_t len, float offset);
 
    void OnUpdateUI(wxCommandEvent & evt);
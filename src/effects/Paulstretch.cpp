@@ -26,6 +26,10 @@
 
 #include "ShuttleGui.h"
 #include "FFT.h"
+#include "FFTPlan.h"
+#include "PerTrackEffect.h"
+#include "PowerSpectrumGetter.h"
+#include "concurrency/TaskPool.h"
 #include "../widgets/valnum.h"
 #include "AudacityMessageBox.h"
 #include "Prefs.h"
@@ -51,14 +55,40 @@ public:
    //in_bufsize is also a half of a FFT buffer (in samples)
    virtual ~PaulStretch();
 
-   void process(float *smps, size_t nsmps);
+   //! Transforms windows of the pool, with scratch space of its own
+   /*! Depends on no state of PaulStretch, so that several windows may be
+    transformed concurrently, each by its own Window */
+   class Window
+   {
+   public:
+      explicit Window(size_t poolsize);
+
+      //! Randomizes the phases of the spectrum of a window of the pool
+      /*!
+       @param pool poolsize samples
+       @param phases from draw_phases()
+       @param output poolsize samples
+       */
+      void Transform(const float *pool, const unsigned *phases, float *output);
+
+   private:
+      const size_t poolsize;
+      const std::shared_ptr<const FFTPlan> plan;
+      PffftFloatVector spectrum, work;
+   };
+
+   //! Adds samples to the pool, from which the next window is taken
+   void add_to_pool(const float *smps, size_t nsmps);
+   const float *get_pool() const { return in_pool.get(); }
+   //! Draws from rand() the poolsize / 2 - 1 phases for the next window
+   void draw_phases(unsigned *phases) const;
+   //! Makes out_buf from the next window, given by Window::Transform()
+   void overlap(const float *window);
 
    size_t get_nsamples();//how many samples are required to be added in the pool next time
    size_t get_nsamples_for_fill();//how many samples are required to be added for a complete buffer refill (at start of the song or after seek)
 
 private:
-   void process_spectrum(float *WXUNUSED(freq)) {};
-
    const float samplerate;
    const float rap;
    const size_t in_bufsize;
@@ -77,8 +107,6 @@ private:
    const Floats in_pool;//de marimea in_bufsize
 
    double remained_samples;//how many fraction of samples has remained (0..1)
-
-   const Floats fft_smps, fft_c, fft_s, fft_freq, fft_tmp;
 };
 
 //
@@ -248,6 +276,18 @@ void EffectPaulstretch::OnText(wxCommandEvent & WXUNUSED(evt))
       mUIParent, mUIParent->TransferDataFromWindow());
 }
 
+size_t EffectPaulstretch::GetBatchSize(size_t poolsize)
+{
+   // Two windows at least, for the start; as many as the pool runs at once,
+   // twice over, if their buffers fit in a bound
+   constexpr size_t minSize = 2;
+   constexpr size_t maxBytes = 64 * 1024 * 1024;
+   const auto slotBytes = 6 * poolsize * sizeof(float);
+   const auto workers =
+      audacity::concurrency::TaskPool::Get().GetWorkersCount();
+   return std::clamp<size_t>(maxBytes / slotBytes, minSize, 2 * (workers + 1));
+}
+
 size_t EffectPaulstretch::GetBufferSize(double rate) const
 {
    // Audacity's fft requires a power of 2
@@ -359,48 +399,105 @@ bool EffectPaulstretch::ProcessOne(const WaveChannel &track,
       const auto fade_len = std::min<size_t>(100, bufsize / 2 - 1);
       bool cancelled = false;
 
+      // The windows are independent but for the overlap of the outputs, so
+      // they are taken from the pool and transformed in batches, and the
+      // transforms of a batch are done concurrently
+      struct Slot {
+         explicit Slot(size_t poolsize)
+            : window{ poolsize }, pool{ poolsize }
+            , phases{ poolsize / 2 }, output{ poolsize }
+         {}
+         PaulStretch::Window window;
+         Floats pool;
+         ArrayOf<unsigned> phases;
+         Floats output;
+         //! Whether the output is appended, not only overlapped with the next
+         bool append{};
+         //! Samples of the selection added to the pool so far
+         sampleCount added{};
+      };
+      const bool concurrent = ConcurrentTrackProcessing.Read();
+      std::vector<std::unique_ptr<Slot>> slots;
+      for (size_t ii = 0, nn = concurrent ? GetBatchSize(bufsize) : 2;
+           ii < nn; ++ii)
+         slots.push_back(std::make_unique<Slot>(bufsize));
+      const auto transform = [&](size_t begin, size_t end) {
+         for (; begin < end; ++begin) {
+            auto &slot = *slots[begin];
+            slot.window.Transform(
+               slot.pool.get(), slot.phases.get(), slot.output.get());
+         }
+      };
+
       {
          Floats fade_track_smps{ fade_len };
          decltype(len) s=0;
-
-         while (s < len) {
-            track.GetFloats(bufferptr0, start + s, nget);
-            stretch.process(buffer0.get(), nget);
-
-            if (first_time) {
-               stretch.process(buffer0.get(), 0);
+         bool filled = false;
+
+         while (s < len && !cancelled) {
+            size_t nSlots = 0;
+            const auto take = [&](bool append) {
+               auto &slot = *slots[nSlots++];
+               std::copy(stretch.get_pool(), stretch.get_pool() + bufsize,
+                  slot.pool.get());
+               stretch.draw_phases(slot.phases.get());
+               slot.append = append;
+               slot.added = s;
             };
-
-            s += nget;
-
-            if (first_time){//blend the start of the selection
-               track.GetFloats(fade_track_smps.get(), start, fade_len);
-               first_time = false;
-               for (size_t i = 0; i < fade_len; i++){
-                  float fi = (float)i / (float)fade_len;
-                  stretch.out_buf[i] =
-                     stretch.out_buf[i] * fi + (1.0 - fi) * fade_track_smps[i];
+            while (nSlots < slots.size() && s < len) {
+               track.GetFloats(bufferptr0, start + s, nget);
+               stretch.add_to_pool(buffer0.get(), nget);
+               s += nget;
+               // The output of the very first window only overlaps the
+               // second, from the same pool
+               if (!filled) {
+                  take(false);
+                  filled = true;
                }
+               take(true);
+               nget = stretch.get_nsamples();
             }
-            if (s >= len){//blend the end of the selection
-               track.GetFloats(fade_track_smps.get(), end - fade_len, fade_len);
-               for (size_t i = 0; i < fade_len; i++){
-                  float fi = (float)i / (float)fade_len;
-                  auto i2 = bufsize / 2 - 1 - i;
-                  stretch.out_buf[i2] =
-                     stretch.out_buf[i2] * fi + (1.0 - fi) *
-                     fade_track_smps[fade_len - 1 - i];
+
+            if (concurrent)
+               audacity::concurrency::TaskPool::Get().ParallelFor(
+                  nSlots, 1, transform);
+            else
+               transform(0, nSlots);
+
+            for (size_t ii = 0; ii < nSlots; ++ii) {
+               auto &slot = *slots[ii];
+               stretch.overlap(slot.output.get());
+               if (!slot.append)
+                  continue;
+
+               if (first_time){//blend the start of the selection
+                  track.GetFloats(fade_track_smps.get(), start, fade_len);
+                  first_time = false;
+                  for (size_t i = 0; i < fade_len; i++){
+                     float fi = (float)i / (float)fade_len;
+                     stretch.out_buf[i] =
+                        stretch.out_buf[i] * fi + (1.0 - fi) * fade_track_smps[i];
+                  }
+               }
+               if (slot.added >= len){//blend the end of the selection
+                  track.GetFloats(fade_track_smps.get(), end - fade_len, fade_len);
+                  for (size_t i = 0; i < fade_len; i++){
+                     float fi = (float)i / (float)fade_len;
+                     auto i2 = bufsize / 2 - 1 - i;
+                     stretch.out_buf[i2] =
+                        stretch.out_buf[i2] * fi + (1.0 - fi) *
+                        fade_track_smps[fade_len - 1 - i];
+                  }
                }
-            }
 
-            outputTrack.Append((samplePtr)stretch.out_buf.get(), floatSample, stretch.out_bufsize);
+               outputTrack.Append((samplePtr)stretch.out_buf.get(), floatSample, stretch.out_bufsize);
 
-            nget = stretch.get_nsamples();
-            if (TrackProgress(count,
-               s.as_double() / len.as_double()
-            )) {
-               cancelled = true;
-               break;
+               if (TrackProgress(count,
+                  slot.added.as_double() / len.as_double()
+               )) {
+                  cancelled = true;
+                  break;
+               }
             }
          }
       }
@@ -427,11 +524,6 @@ PaulStretch::PaulStretch(float rap_, size_t in_bufsize_, float samplerate_ )
    , poolsize { in_bufsize_ * 2 }
    , in_pool { poolsize, true }
    , remained_samples { 0.0 }
-   , fft_smps { poolsize, true }
-   , fft_c { poolsize, true }
-   , fft_s { poolsize, true }
-   , fft_freq { poolsize, true }
-   , fft_tmp { poolsize }
 {
 }
 
@@ -439,7 +531,15 @@ PaulStretch::~PaulStretch()
 {
 }
 
-void PaulStretch::process(float *smps, size_t nsmps)
+PaulStretch::Window::Window(size_t poolsize)
+   : poolsize{ poolsize }
+   , plan{ FFTPlan::Get(poolsize) }
+   , spectrum(poolsize)
+   , work(poolsize)
+{
+}
+
+void PaulStretch::add_to_pool(const float *smps, size_t nsmps)
 {
    //add NEW samples to the pool
    if ((smps != NULL) && (nsmps != 0)) {
@@ -456,43 +556,46 @@ void PaulStretch::process(float *smps, size_t nsmps)
       for (size_t i = 0; i < nsmps; i++)
          in_pool[i + nleft] = smps[i];
    }
+}
 
-   //get the samples from the pool
-   for (size_t i = 0; i < poolsize; i++)
-      fft_smps[i] = in_pool[i];
-   WindowFunc(eWinFuncHann, poolsize, fft_smps.get());
-
-   RealFFT(poolsize, fft_smps.get(), fft_c.get(), fft_s.get());
+void PaulStretch::draw_phases(unsigned *phases) const
+{
+   // Drawn in the order of the windows, so the result does not depend on
+   // how many windows are transformed at once
+   for (size_t i = 1; i < poolsize / 2; i++)
+      phases[i - 1] = (rand()) & 0x7fff;
+}
 
-   for (size_t i = 0; i < poolsize / 2; i++)
-      fft_freq[i] = sqrt(fft_c[i] * fft_c[i] + fft_s[i] * fft_s[i]);
-   process_spectrum(fft_freq.get());
+void PaulStretch::Window::Transform(
+   const float *pool, const unsigned *phases, float *output)
+{
+   //get the samples from the pool
+   std::copy(pool, pool + poolsize, spectrum.data());
+   WindowFunc(eWinFuncHann, poolsize, spectrum.data());
 
+   // The bins are packed as described for FFTPlan::Forward()
+   plan->Forward(spectrum.data(), spectrum.data(), work.data());
 
    //put randomize phases to frequencies and do a IFFT
    float inv_2p15_2pi = 1.0 / 16384.0 * (float)M_PI;
    for (size_t i = 1; i < poolsize / 2; i++) {
-      unsigned int random = (rand()) & 0x7fff;
-      float phase = random * inv_2p15_2pi;
-      float s = fft_freq[i] * sin(phase);
-      float c = fft_freq[i] * cos(phase);
-
-      fft_c[i] = fft_c[poolsize - i] = c;
-
-      fft_s[i] = s; fft_s[poolsize - i] = -s;
-   }
-   fft_c[0] = fft_s[0] = 0.0;
-   fft_c[poolsize / 2] = fft_s[poolsize / 2] = 0.0;
-
-   FFT(poolsize, true, fft_c.get(), fft_s.get(), fft_smps.get(), fft_tmp.get());
-
-   float max = 0.0, max2 = 0.0;
-   for (size_t i = 0; i < poolsize; i++) {
-      max = std::max(max, fabsf(fft_tmp[i]));
-      max2 = std::max(max2, fabsf(fft_smps[i]));
+      const float re = spectrum[2 * i];
+      const float im = spectrum[2 * i + 1];
+      const float freq = sqrt(re * re + im * im);
+      float phase = phases[i - 1] * inv_2p15_2pi;
+      spectrum[2 * i] = freq * cos(phase);
+      spectrum[2 * i + 1] = freq * sin(phase);
    }
+   spectrum[0] = spectrum[1] = 0.0;
 
+   plan->Inverse(spectrum.data(), spectrum.data(), work.data());
+   const float scale = 1.0f / poolsize;
+   for (size_t i = 0; i < poolsize; i++)
+      output[i] = spectrum[i] * scale;
+}
 
+void PaulStretch::overlap(const float *window)
+{
    //make the output buffer
    float tmp = 1.0 / (float) out_bufsize * M_PI;
    float hinv_sqrt2 = 0.853553390593f;//(1.0+1.0/sqrt(2))*0.5;
@@ -505,7 +608,7 @@ void PaulStretch::process(float *smps, size_t nsmps)
 
    for (size_t i = 0; i < out_bufsize; i++) {
       float a = (0.5 + 0.5 * cos(i * tmp));
-      float out = fft_smps[i + out_bufsize] * (1.0 - a) + old_out_smp_buf[i] * a;
+      float out = window[i + out_bufsize] * (1.0 - a) + old_out_smp_buf[i] * a;
       out_buf[i] =
          out * (hinv_sqrt2 - (1.0 - hinv_sqrt2) * cos(i * 2.0 * tmp)) *
          ampfactor;
@@ -513,7 +616,7 @@ void PaulStretch::process(float *smps, size_t nsmps)
 
    //copy the current output buffer to old buffer
    for (size_t i = 0; i < out_bufsize * 2; i++)
-      old_out_smp_buf[i] = fft_smps[i];
+      old_out_smp_buf[i] = window[i];
 }
 
 size_t PaulStretch::get_nsamples()
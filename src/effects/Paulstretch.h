@@ -54,6 +54,8 @@ private:
    
    void OnText(wxCommandEvent & evt);
    size_t GetBufferSize(double rate) const;
+   //! How many windows of poolsize samples to transform at once
+   static size_t GetBatchSize(size_t poolsize);
 
    bool ProcessOne(const WaveChannel &track, WaveChannel &outputTrack,
       double t0, double t1, int count);
@@ -154,6 +154,8 @@ struct EffectPhaser::Instance
    unsigned GetAudioInCount() const override;
    unsigned GetAudioOutCount() const override;
 
+   bool CanProcessConcurrently() const override;
+
    void InstanceInit(EffectSettings& settings, EffectPhaserState& data, float sampleRate);
 
    size_t InstanceProcess(EffectSettings& settings,
@@ -178,6 +180,11 @@ EffectPhaser::MakeInstance() const
    return std::make_shared<Instance>(*this);
 }
 
+bool EffectPhaser::ProcessesConcurrently() const
+{
+   return true;
+}
+
 
 
 EffectPhaser::EffectPhaser()
@@ -228,6 +235,12 @@ unsigned EffectPhaser::Instance::GetAudioOutCount() const
    return 1;
 }
 
+bool EffectPhaser::Instance::CanProcessConcurrently() const
+{
+   // All state is in mState and the settings
+   return true;
+}
+
 bool EffectPhaser::Instance::ProcessInitialize(
    EffectSettings& settings, double sampleRate, ChannelNames chanMap)
 {
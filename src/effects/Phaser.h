@@ -108,6 +108,7 @@ private:
    struct Instance;
 
    std::shared_ptr<EffectInstance> MakeInstance() const override;
+   bool ProcessesConcurrently() const override;
 
    const EffectParameterMethods& Parameters() const override;
 
@@ -0,0 +1,409 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file RemoteEffectInstance.cpp
+
+**********************************************************************/
+
+#include "RemoteEffectInstance.h"
+#include "EffectHost.h"
+
+#include <wx/utils.h>
+
+#include "EffectBase.h"
+#include "EffectPlugin.h"
+#include "IPCChannel.h"
+#include "IPCServer.h"
+#include "IPCSharedMemory.h"
+#include "PerTrackEffect.h"
+#include "PluginIPCUtils.h"
+#include "PluginManager.h"
+#include "wxArrayStringEx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+BoolSetting OutOfProcessEffects{ L"/Effects/OutOfProcess", false };
+
+namespace {
+using namespace std::chrono_literals;
+
+//! How long to wait for a host to start and load its modules, and for it to
+//! answer a request
+constexpr auto ConnectTimeout = 30s;
+constexpr auto ReplyTimeout = 30s;
+//! How long a block may take before processing fails
+constexpr auto StallTimeout = 30s;
+//! How often to check the connection while waiting for a block
+constexpr auto PollInterval = 50ms;
+
+//! Big enough that handing over a block costs little in comparison with
+//! processing it
+constexpr size_t MaxBlockSize = 16384;
+
+//! Whether the effect is not Audacity's own code
+bool IsThirdParty(const EffectPlugin &effect)
+{
+   const auto family = effect.GetDefinition().GetFamily().Internal();
+   return family != wxT("Audacity") &&
+      family != NYQUISTEFFECTS_FAMILY.Internal();
+}
+
+PerTrackEffect::IsolatedInstance::Scope installer{
+   [](const PerTrackEffect &effect, const EffectInstance &instance)
+      -> std::shared_ptr<EffectInstance>
+   {
+      if (!OutOfProcessEffects.Read() || !IsThirdParty(effect))
+         return nullptr;
+      return RemoteEffectInstance::Make(effect, instance);
+   }
+};
+}
+
+//! Server side of the connection with the host
+class RemoteEffectInstance::Connection final : public IPCChannelStatusCallback
+{
+public:
+   ~Connection() override
+   {
+      bool connected;
+      {
+         std::lock_guard lock{ mSync };
+         connected = mState != State::Closed;
+      }
+      mServer.reset();
+      // A host that is stuck in the effect never sees the disconnection; one
+      // that closed the connection is exiting already, and its id may be
+      // reused
+      if (connected)
+         Terminate();
+   }
+
+   //! Starts the host and waits for it to connect
+   /*! @return success; may also throw */
+   bool Start()
+   {
+      mServer = std::make_unique<IPCServer>(*this);
+      mPid = EffectHost::Start(mServer->GetConnectPort());
+      if (mPid == 0)
+         return false;
+      std::unique_lock lock{ mSync };
+      mCondition.wait_for(lock, ConnectTimeout,
+         [this]{ return mState != State::Waiting; });
+      if (mState == State::Connected)
+         return true;
+      lock.unlock();
+      Terminate();
+      return false;
+   }
+
+   //! Sends the request and waits for the reply
+   /*! @return the reply, or an error message */
+   wxString Request(const wxString &request)
+   {
+      std::unique_lock lock{ mSync };
+      if (!mChannel)
+         return "not connected";
+      detail::PutMessage(*mChannel, request);
+      if (!mCondition.wait_for(lock, ReplyTimeout,
+         [this]{ return mState == State::Closed || !mReplies.empty(); })) {
+         lock.unlock();
+         Terminate();
+         return "no reply";
+      }
+      if (mReplies.empty())
+         return "disconnected";
+      auto reply = std::move(mReplies.front());
+      mReplies.pop_front();
+      return reply;
+   }
+
+   //! Kills the host, which stopped answering
+   /*! Then the connection closes */
+   void Terminate() noexcept
+   {
+      if (const auto pid = std::exchange(mPid, 0))
+         wxKill(pid, wxSIGKILL);
+   }
+
+   //! May be called often, without locking
+   bool IsConnected() const
+   {
+      return mConnected.load(std::memory_order_acquire);
+   }
+
+   void OnConnect(IPCChannel &channel) noexcept override
+   {
+      {
+         std::lock_guard lock{ mSync };
+         mChannel = &channel;
+         mState = State::Connected;
+         mConnected.store(true, std::memory_order_release);
+      }
+      mCondition.notify_all();
+   }
+
+   void OnDisconnect() noexcept override
+   {
+      Close();
+   }
+
+   void OnConnectionError() noexcept override
+   {
+      Close();
+   }
+
+   void OnDataAvailable(const void *data, size_t size) noexcept override
+   {
+      try {
+         {
+            std::lock_guard lock{ mSync };
+            mInputMessageReader.ConsumeBytes(data, size);
+            while (mInputMessageReader.CanPop())
+               mReplies.push_back(mInputMessageReader.Pop());
+         }
+         mCondition.notify_all();
+      }
+      catch (...) {
+         Close();
+      }
+   }
+
+private:
+   void Close() noexcept
+   {
+      try {
+         std::lock_guard lock{ mSync };
+         mChannel = nullptr;
+         mState = State::Closed;
+      }
+      catch (...) {
+         // See PluginHost::Stop()
+      }
+      mConnected.store(false, std::memory_order_release);
+      mCondition.notify_all();
+   }
+
+   enum class State { Waiting, Connected, Closed };
+
+   std::mutex mSync;
+   std::condition_variable mCondition;
+   IPCChannel *mChannel{};
+   State mState{ State::Waiting };
+   std::atomic<bool> mConnected{ false };
+   detail::InputMessageReader mInputMessageReader;
+   std::deque<wxString> mReplies;
+   //! Of the host process, or 0 if it is not running or was killed
+   long mPid{};
+
+   //! Destroyed first, so callbacks end before the rest is destroyed; the
+   //! host exits when the connection closes
+   std::unique_ptr<IPCServer> mServer;
+};
+
+std::shared_ptr<RemoteEffectInstance> RemoteEffectInstance::Make(
+   const EffectPlugin &effect, const EffectInstance &instance)
+{
+   const auto pDesc = PluginManager::Get()
+      .GetPlugin(PluginManager::GetID(&effect.GetDefinition()));
+   if (!pDesc)
+      return nullptr;
+
+   auto pConnection = std::make_unique<Connection>();
+   try {
+      if (!pConnection->Start())
+         return nullptr;
+   }
+   catch (...) {
+      return nullptr;
+   }
+   return std::make_shared<RemoteEffectInstance>(effect,
+      pDesc->GetProviderID(), pDesc->GetPath(),
+      instance.GetAudioInCount(), instance.GetAudioOutCount(),
+      instance.NeedsDither(), std::move(pConnection));
+}
+
+RemoteEffectInstance::RemoteEffectInstance(const EffectPlugin &effect,
+   PluginID providerID, PluginPath path,
+   unsigned numAudioIn, unsigned numAudioOut, bool needsDither,
+   std::unique_ptr<Connection> pConnection
+)  : mEffect{ effect }
+   , mProviderID{ std::move(providerID) }, mPath{ std::move(path) }
+   , mNumAudioIn{ numAudioIn }, mNumAudioOut{ numAudioOut }
+   , mNeedsDither{ needsDither }
+   , mpConnection{ std::move(pConnection) }
+{
+}
+
+RemoteEffectInstance::~RemoteEffectInstance() = default;
+
+size_t RemoteEffectInstance::SetBlockSize(size_t maxBlockSize)
+{
+   return EffectInstanceWithBlockSize::SetBlockSize(
+      std::min(maxBlockSize, MaxBlockSize));
+}
+
+unsigned RemoteEffectInstance::GetAudioInCount() const
+{
+   return mNumAudioIn;
+}
+
+unsigned RemoteEffectInstance::GetAudioOutCount() const
+{
+   return mNumAudioOut;
+}
+
+auto RemoteEffectInstance::GetLatency(
+   const EffectSettings &, double) const -> SampleCount
+{
+   if (!mRing)
+      return 0;
+   // Some effects report latency only after processing a block
+   if (mSubmitted > 0) {
+      try {
+         WaitForCompleted(1);
+      }
+      catch (...) {
+         // The next ProcessBlock() fails
+      }
+   }
+   return mRing->GetHeader().latency.load(std::memory_order_relaxed) +
+      mRing->GetBlockSize();
+}
+
+bool RemoteEffectInstance::NeedsDither() const
+{
+   return mNeedsDither;
+}
+
+bool RemoteEffectInstance::ProcessInitialize(EffectSettings &settings,
+   double sampleRate, ChannelNames chanMap)
+{
+   if (mInitialized)
+      ProcessFinalize();
+
+   const auto blockSize = GetBlockSize();
+   if (blockSize == 0 || !mpConnection->IsConnected())
+      return false;
+
+   const auto size =
+      EffectHostRing::GetSize(blockSize, mNumAudioIn, mNumAudioOut);
+   if (!mpMemory || mpMemory->Size() != size) {
+      mRing.reset();
+      mpMemory = IPCSharedMemory::Create(size);
+      if (!mpMemory)
+         return false;
+   }
+   mRing.emplace(mpMemory->Data(), blockSize, mNumAudioIn, mNumAudioOut);
+   // The host resets the counters of the ring before it replies
+   mSubmitted = mCollected = 0;
+   // Output is late by one block
+   mPending.assign(mNumAudioOut, std::vector<float>(blockSize, 0.0f));
+
+   wxString parms;
+   if (!mEffect.SaveSettingsAsString(settings, parms))
+      return false;
+   wxArrayStringEx channels;
+   for (auto pName = chanMap; pName && *pName != ChannelNameEOL; ++pName)
+      channels.push_back(wxString::Format("%d", static_cast<int>(*pName)));
+
+   const auto reply = mpConnection->Request(EffectHost::MakeMessage(
+   wxArrayStringEx{
+      wxString{ EffectHost::Request::Initialize }, mProviderID, mPath, parms,
+      wxString::FromCDouble(sampleRate),
+      wxString::Format("%llu", static_cast<unsigned long long>(blockSize)),
+      wxString::Format("%u", mNumAudioIn),
+      wxString::Format("%u", mNumAudioOut),
+      wxJoin(channels, ','),
+      wxString::FromUTF8(mpMemory->GetName())
+   }));
+   if (reply != EffectHost::ReplyOK)
+      return false;
+   // The host mapped the memory, which then needs no name
+   mpMemory->RemoveName();
+   mInitialized = true;
+   return true;
+}
+
+bool RemoteEffectInstance::ProcessFinalize() noexcept
+{
+   if (!mInitialized)
+      return true;
+   mInitialized = false;
+   try {
+      // The host finishes the submitted blocks first
+      return mpConnection->Request(EffectHost::MakeMessage(
+         wxArrayStringEx{ EffectHost::Request::Finalize }))
+         == EffectHost::ReplyOK;
+   }
+   catch (...) {
+      return false;
+   }
+}
+
+size_t RemoteEffectInstance::ProcessBlock(EffectSettings &,
+   const float *const *inBlock, float *const *outBlock, size_t blockLen)
+{
+   if (!mInitialized || blockLen > mRing->GetBlockSize())
+      throw std::logic_error{ "block does not fit the ring" };
+
+   const auto index = mSubmitted;
+   for (unsigned ii = 0; ii < mNumAudioIn; ++ii)
+      std::copy(inBlock[ii], inBlock[ii] + blockLen,
+         mRing->GetInput(index, ii));
+   auto &slot = mRing->GetSlot(index);
+   slot.length = static_cast<uint32_t>(blockLen);
+   slot.processed = 0;
+   auto &header = mRing->GetHeader();
+   header.submitted.store(++mSubmitted, std::memory_order_release);
+   mpMemory->Wake(header.submitted);
+
+   // While the host processes this block, take the output of the one before;
+   // mPending then holds one block size of samples
+   while (mSubmitted - mCollected > 1)
+      Collect(mCollected++);
+   for (unsigned ii = 0; ii < mNumAudioOut; ++ii) {
+      auto &pending = mPending[ii];
+      std::copy(pending.begin(), pending.begin() + blockLen, outBlock[ii]);
+      pending.erase(pending.begin(), pending.begin() + blockLen);
+   }
+   return blockLen;
+}
+
+void RemoteEffectInstance::WaitForCompleted(uint32_t count) const
+{
+   auto &completed = mRing->GetHeader().completed;
+   const auto start = std::chrono::steady_clock::now();
+   while (true) {
+      const auto value = completed.load(std::memory_order_acquire);
+      // Counters may wrap around
+      if (static_cast<int32_t>(value - count) >= 0)
+         return;
+      if (!mpConnection->IsConnected())
+         throw std::runtime_error{ "the effect host ended" };
+      if (std::chrono::steady_clock::now() - start > StallTimeout) {
+         mpConnection->Terminate();
+         throw std::runtime_error{ "the effect host stopped answering" };
+      }
+      mpMemory->Wait(completed, value, PollInterval);
+   }
+}
+
+void RemoteEffectInstance::Collect(uint32_t index)
+{
+   WaitForCompleted(index + 1);
+   const auto &slot = mRing->GetSlot(index);
+   if (slot.processed != slot.length)
+      throw std::runtime_error{ "the effect failed in the host" };
+   for (unsigned ii = 0; ii < mNumAudioOut; ++ii) {
+      const auto output = mRing->GetOutput(index, ii);
+      mPending[ii].insert(mPending[ii].end(), output, output + slot.length);
+   }
+}
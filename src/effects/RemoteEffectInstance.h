@@ -0,0 +1,113 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file RemoteEffectInstance.h
+  @brief Instance of an effect that processes in an EffectHost process
+
+**********************************************************************/
+
+#ifndef __AUDACITY_REMOTE_EFFECT_INSTANCE__
+#define __AUDACITY_REMOTE_EFFECT_INSTANCE__
+
+#include "EffectHostRing.h"
+#include "EffectInterface.h"
+#include "PluginProvider.h"
+#include "Prefs.h"
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+class EffectPlugin;
+class IPCSharedMemory;
+
+//! Whether third-party effects process in separate processes, so that a crash
+//! of one fails the effect instead of ending Audacity
+extern BoolSetting OutOfProcessEffects;
+
+//! Sends each block to an effect in a host process, and returns the output
+//! of the block before
+/*!
+ While the host processes one block, the main process receives the next, so
+ processing adds one block of latency, which GetLatency() reports, so that
+ it is discarded like the latency of the effect itself.
+
+ Processing fails, instead of hanging or crashing, if the host ends or stops
+ answering.  Only destructive processing is supported.
+ */
+class RemoteEffectInstance final : public EffectInstanceWithBlockSize
+{
+public:
+   class Connection;
+
+   //! Starts a host process, and waits for it to connect
+   /*!
+    @param instance a local instance, which gives the channel counts
+    @return null if the effect is not registered, or the host fails to start
+    */
+   static std::shared_ptr<RemoteEffectInstance> Make(
+      const EffectPlugin &effect, const EffectInstance &instance);
+
+   RemoteEffectInstance(const EffectPlugin &effect,
+      PluginID providerID, PluginPath path,
+      unsigned numAudioIn, unsigned numAudioOut, bool needsDither,
+      std::unique_ptr<Connection> pConnection);
+   ~RemoteEffectInstance() override;
+
+   //! Limits blocks to a size that keeps the added latency small, and that
+   //! the host can process while the next block is read
+   size_t SetBlockSize(size_t maxBlockSize) override;
+
+   unsigned GetAudioInCount() const override;
+   unsigned GetAudioOutCount() const override;
+
+   //! The latency of the effect in the host, plus one block
+   SampleCount GetLatency(
+      const EffectSettings &settings, double sampleRate) const override;
+
+   bool NeedsDither() const override;
+
+   //! Sends the settings to the host, which initializes its own instance
+   /*! @pre `GetBlockSize() > 0` */
+   bool ProcessInitialize(EffectSettings &settings,
+      double sampleRate, ChannelNames chanMap) override;
+
+   bool ProcessFinalize() noexcept override;
+
+   //! Submits the block, and returns the output of the block before, or
+   //! silence for the first
+   /*!
+    Settings were sent in ProcessInitialize()
+    @pre `blockLen <= GetBlockSize()`
+    */
+   size_t ProcessBlock(EffectSettings &settings,
+      const float *const *inBlock, float *const *outBlock, size_t blockLen)
+   override;
+
+private:
+   //! Waits until the host completed the given count of blocks
+   /*! @throws std::exception if the host ended or stopped answering */
+   void WaitForCompleted(uint32_t count) const;
+   //! Appends the output of a completed block to mPending
+   void Collect(uint32_t index);
+
+   const EffectPlugin &mEffect;
+   const PluginID mProviderID;
+   const PluginPath mPath;
+   const unsigned mNumAudioIn;
+   const unsigned mNumAudioOut;
+   const bool mNeedsDither;
+
+   std::unique_ptr<Connection> mpConnection;
+   std::unique_ptr<IPCSharedMemory> mpMemory;
+   std::optional<EffectHostRing> mRing;
+   //! Blocks submitted, and whose output was collected, for this track
+   uint32_t mSubmitted{};
+   uint32_t mCollected{};
+   //! Output of collected blocks, not yet returned, for each channel
+   std::vector<std::vector<float>> mPending;
+   bool mInitialized{ false };
+};
+
+#endif
@@ -13,6 +13,8 @@ effect that uses SBSMS to do its processing (TimeScale)
 #if USE_SBSMS
 #include "SBSMSEffect.h"
 #include "EffectOutputTracks.h"
+#include "PerTrackEffect.h"
+#include "concurrency/TaskPool.h"
 
 #include <math.h>
 
@@ -22,7 +24,12 @@ effect that uses SBSMS to do its processing (TimeScale)
 #include "WaveTrack.h"
 #include "TimeWarper.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 enum {
   SBSMSOutBlockSize = 512
@@ -223,6 +230,82 @@ double EffectSBSMS::getRate(double rateStart, double rateEnd, SlideType slideTyp
    return slide.getRate(t);
 }
 
+//! Everything for the time scaling of one track, which may be done on a
+//! worker thread while others are done on other threads; its resamplers,
+//! SBSMS and buffers exist only while its batch is processed
+struct SBSMSJob {
+   SBSMSJob(SlideType rateSlideType, double rateStart, double rateEnd,
+      SlideType pitchSlideType, double pitchStart, double pitchEnd)
+      : rateSlide{ rateSlideType, rateStart, rateEnd }
+      , pitchSlide{ pitchSlideType, pitchStart, pitchEnd }
+   {}
+
+   //! Each job has its own slides, which its interface uses
+   Slide rateSlide;
+   Slide pitchSlide;
+   // the resampler needs a callback to supply its samples
+   ResampleBuf rb;
+   std::unique_ptr<Resampler> pResampler;
+
+   WaveTrack *pTrack{};
+   WaveChannel *leftTrack{};
+   //! Null if mono
+   WaveChannel *rightTrack{};
+   sampleCount start{};
+   sampleCount end{};
+   float srTrack{};
+   float srProcess{};
+   WaveTrack::Holder outputTrack;
+   std::unique_ptr<TimeWarper> warper;
+   sampleCount samplesOut{};
+   bool stereo{};
+   int trackNum{};
+   bool result{ false };
+
+   //! Samples made, updated by the worker thread
+   std::atomic<long long> made{ 0 };
+   //! Samples made by the worker thread and not yet appended
+   std::mutex mutex;
+   std::vector<float> pending[2];
+};
+
+namespace {
+//! Receives output samples of the right channel, if any, and the left
+using SBSMSSink =
+   std::function<bool(const float *left, const float *right, size_t count)>;
+
+//! Runs the resamplers and SBSMS of the job to the end or until sink
+//! returns false
+bool RunSBSMSJob(SBSMSJob &job, const SBSMSSink &sink)
+{
+   audio outBuf[SBSMSOutBlockSize];
+   float outBufLeft[2 * SBSMSOutBlockSize];
+   float outBufRight[2 * SBSMSOutBlockSize];
+
+   long pos = 0;
+   long outputCount = -1;
+
+   // process
+   while (pos < job.samplesOut && outputCount) {
+      const auto frames =
+         limitSampleBufferSize(SBSMSOutBlockSize, job.samplesOut - pos);
+
+      outputCount = job.pResampler->read(outBuf, frames);
+      for (int i = 0; i < outputCount; ++i) {
+         outBufLeft[i] = outBuf[i][0];
+         if (job.stereo)
+            outBufRight[i] = outBuf[i][1];
+      }
+      pos += outputCount;
+      if (!sink(outBufLeft, job.stereo ? outBufRight : nullptr, outputCount))
+         return false;
+   }
+   return true;
+}
+
+constexpr auto PollInterval = std::chrono::milliseconds{ 50 };
+}
+
 bool EffectSBSMS::Process(EffectInstance &, EffectSettings &)
 {
    bool bGoodResult = true;
@@ -235,9 +318,12 @@ bool EffectSBSMS::Process(EffectInstance &, EffectSettings &)
    double maxDuration = 0.0;
 
    Slide rateSlide(rateSlideType,rateStart,rateEnd);
-   Slide pitchSlide(pitchSlideType,pitchStart,pitchEnd);
    mTotalStretch = rateSlide.getTotalStretch();
 
+   // The tracks are independent, so they are collected here, then may be
+   // processed concurrently
+   std::vector<std::unique_ptr<SBSMSJob>> jobs;
+
    outputs.Get().Any().VisitWhile(bGoodResult,
       [&](auto &&fallthrough){ return [&](LabelTrack &lt) {
          if (!(lt.GetSelected() || SyncLock::IsSyncLockSelected(lt)))
@@ -268,78 +354,18 @@ bool EffectSBSMS::Process(EffectInstance &, EffectSettings &)
             const float srTrack = track.GetRate();
             const float srProcess = bLinkRatePitch ? srTrack : 44100.0;
 
-            // the resampler needs a callback to supply its samples
-            ResampleBuf rb;
-            const auto maxBlockSize = track.GetMaxBlockSize();
-            rb.blockSize = maxBlockSize;
-            rb.buf.reinit(rb.blockSize, true);
-            rb.leftTrack = leftTrack;
-            rb.rightTrack = rightTrack ? rightTrack : leftTrack;
-            rb.leftBuffer.reinit(maxBlockSize, true);
-            rb.rightBuffer.reinit(maxBlockSize, true);
-
-            // Samples in selection
-            const auto samplesIn = end - start;
-
-            // Samples for SBSMS to process after resampling
-            const auto samplesToProcess = static_cast<sampleCount>(
-               samplesIn.as_float() * (srProcess/srTrack));
-
-            SlideType outSlideType;
-            SBSMSResampleCB outResampleCB;
-
-            if (bLinkRatePitch) {
-              rb.bPitch = true;
-              outSlideType = rateSlideType;
-              outResampleCB = resampleCB;
-              rb.offset = start;
-              rb.end = end;
-               // Third party library has its own type alias, check it
-               static_assert(sizeof(sampleCount::type) <=
-                 sizeof(_sbsms_::SampleCountType),
-"Type _sbsms_::SampleCountType is too narrow to hold a sampleCount");
-              rb.iface = std::make_unique<SBSMSInterfaceSliding>(
-                  &rateSlide, &pitchSlide, bPitchReferenceInput,
-                  static_cast<_sbsms_::SampleCountType>(
-                     samplesToProcess.as_long_long()),
-                  0, nullptr);
-            }
-            else {
-               rb.bPitch = false;
-               outSlideType =
-                  (srProcess == srTrack ? SlideIdentity : SlideConstant);
-               outResampleCB = postResampleCB;
-               rb.ratio = srProcess/srTrack;
-               rb.quality = std::make_unique<SBSMSQuality>(&SBSMSQualityStandard);
-               rb.resampler = std::make_unique<Resampler>(resampleCB, &rb,
-                  srProcess == srTrack ? SlideIdentity : SlideConstant);
-               rb.sbsms = std::make_unique<SBSMS>(
-                  rightTrack ? 2 : 1, rb.quality.get(), true);
-               rb.SBSMSBlockSize = rb.sbsms->getInputFrameSize();
-               rb.SBSMSBuf.reinit(static_cast<size_t>(rb.SBSMSBlockSize), true);
-               rb.offset = start;
-               rb.end = end;
-               rb.iface = std::make_unique<SBSMSEffectInterface>(
-                  rb.resampler.get(), &rateSlide, &pitchSlide,
-                  bPitchReferenceInput,
-                  static_cast<_sbsms_::SampleCountType>(
-                     samplesToProcess.as_long_long()),
-                  0,
-                  rb.quality.get());
-            }
-
-            Resampler resampler(outResampleCB, &rb, outSlideType);
-
-            audio outBuf[SBSMSOutBlockSize];
-            float outBufLeft[2 * SBSMSOutBlockSize];
-            float outBufRight[2 * SBSMSOutBlockSize];
-
-            // Samples in output after SBSMS
-            const sampleCount samplesToOutput = rb.iface->getSamplesToOutput();
-
-            // Samples in output after resampling back
-            const auto samplesOut = static_cast<sampleCount>(
-               samplesToOutput.as_float() * (srTrack / srProcess));
+            auto &job = *jobs.emplace_back(std::make_unique<SBSMSJob>(
+               rateSlideType, rateStart, rateEnd,
+               pitchSlideType, pitchStart, pitchEnd));
+            job.pTrack = &track;
+            job.leftTrack = leftTrack;
+            job.rightTrack = rightTrack;
+            job.start = start;
+            job.end = end;
+            job.srTrack = srTrack;
+            job.srProcess = srProcess;
+            job.stereo = (rightTrack != nullptr);
+            job.trackNum = mCurTrackNum;
 
             // Duration in track time
             const double duration = (mT1 - mT0) * mTotalStretch;
@@ -347,41 +373,147 @@ bool EffectSBSMS::Process(EffectInstance &, EffectSettings &)
             if (duration > maxDuration)
                maxDuration = duration;
 
-            const auto warper = createTimeWarper(
+            job.warper = createTimeWarper(
                mT0, mT1, maxDuration, rateStart, rateEnd, rateSlideType);
 
-            WaveTrack::Holder outputTrack = track.EmptyCopy();
-            auto iter = outputTrack->Channels().begin();
-            rb.outputTrack = outputTrack.get();
-            rb.outputLeftChannel = (*iter++).get();
-            if (rightTrack)
-               rb.outputRightChannel = (*iter).get();
+         }
+         mCurTrackNum++;
+      }; },
+      [&](Track &t) {
+         if (SyncLock::IsSyncLockSelected(t))
+            t.SyncLockAdjust(mT1, mT0 + (mT1 - mT0) * mTotalStretch);
+      }
+   );
 
-            long pos = 0;
-            long outputCount = -1;
+   // The resamplers, SBSMS and buffers of a job are made only when its batch
+   // is processed, so that memory does not grow with the number of tracks
+   const auto prepare = [&](SBSMSJob &job) {
+      auto &track = *job.pTrack;
+      const auto start = job.start;
+      const auto end = job.end;
+      const auto srTrack = job.srTrack;
+      const auto srProcess = job.srProcess;
+
+      // the resampler needs a callback to supply its samples
+      auto &rb = job.rb;
+      const auto maxBlockSize = track.GetMaxBlockSize();
+      rb.blockSize = maxBlockSize;
+      rb.buf.reinit(rb.blockSize, true);
+      rb.leftTrack = job.leftTrack;
+      rb.rightTrack = job.rightTrack ? job.rightTrack : job.leftTrack;
+      rb.leftBuffer.reinit(maxBlockSize, true);
+      rb.rightBuffer.reinit(maxBlockSize, true);
+
+      // Samples in selection
+      const auto samplesIn = end - start;
+
+      // Samples for SBSMS to process after resampling
+      const auto samplesToProcess = static_cast<sampleCount>(
+         samplesIn.as_float() * (srProcess/srTrack));
+
+      SlideType outSlideType;
+      SBSMSResampleCB outResampleCB;
+
+      if (bLinkRatePitch) {
+        rb.bPitch = true;
+        outSlideType = rateSlideType;
+        outResampleCB = resampleCB;
+        rb.offset = start;
+        rb.end = end;
+         // Third party library has its own type alias, check it
+         static_assert(sizeof(sampleCount::type) <=
+           sizeof(_sbsms_::SampleCountType),
+"Type _sbsms_::SampleCountType is too narrow to hold a sampleCount");
+        rb.iface = std::make_unique<SBSMSInterfaceSliding>(
+            &job.rateSlide, &job.pitchSlide, bPitchReferenceInput,
+            static_cast<_sbsms_::SampleCountType>(
+               samplesToProcess.as_long_long()),
+            0, nullptr);
+      }
+      else {
+         rb.bPitch = false;
+         outSlideType =
+            (srProcess == srTrack ? SlideIdentity : SlideConstant);
+         outResampleCB = postResampleCB;
+         rb.ratio = srProcess/srTrack;
+         rb.quality = std::make_unique<SBSMSQuality>(&SBSMSQualityStandard);
+         rb.resampler = std::make_unique<Resampler>(resampleCB, &rb,
+            srProcess == srTrack ? SlideIdentity : SlideConstant);
+         rb.sbsms = std::make_unique<SBSMS>(
+            job.rightTrack ? 2 : 1, rb.quality.get(), true);
+         rb.SBSMSBlockSize = rb.sbsms->getInputFrameSize();
+         rb.SBSMSBuf.reinit(static_cast<size_t>(rb.SBSMSBlockSize), true);
+         rb.offset = start;
+         rb.end = end;
+         rb.iface = std::make_unique<SBSMSEffectInterface>(
+            rb.resampler.get(), &job.rateSlide, &job.pitchSlide,
+            bPitchReferenceInput,
+            static_cast<_sbsms_::SampleCountType>(
+               samplesToProcess.as_long_long()),
+            0,
+            rb.quality.get());
+      }
 
-            // process
-            while (pos < samplesOut && outputCount) {
-               const auto frames =
-                  limitSampleBufferSize(SBSMSOutBlockSize, samplesOut - pos);
+      job.pResampler =
+         std::make_unique<Resampler>(outResampleCB, &rb, outSlideType);
+
+      // Samples in output after SBSMS
+      const sampleCount samplesToOutput = rb.iface->getSamplesToOutput();
+
+      // Samples in output after resampling back
+      job.samplesOut = static_cast<sampleCount>(
+         samplesToOutput.as_float() * (srTrack / srProcess));
+
+      job.outputTrack = track.EmptyCopy();
+      auto iter = job.outputTrack->Channels().begin();
+      rb.outputTrack = job.outputTrack.get();
+      rb.outputLeftChannel = (*iter++).get();
+      if (job.rightTrack)
+         rb.outputRightChannel = (*iter).get();
+   };
+
+   // Process in batches as large as the pool, or of one track
+   const bool concurrent = jobs.size() > 1 && ConcurrentTrackProcessing.Read();
+   const size_t batchSize = concurrent
+      ? std::max<size_t>(1,
+         audacity::concurrency::TaskPool::Get().GetWorkersCount())
+      : 1;
+   // The progress of a batch is weighted by its input samples
+   double totalIn = 0;
+   for (const auto &pJob : jobs)
+      totalIn += (pJob->end - pJob->start).as_double();
+   double doneIn = 0;
+
+   for (size_t first = 0; bGoodResult && first < jobs.size();) {
+      const auto last = std::min(jobs.size(), first + batchSize);
+      double batchIn = 0;
+      for (auto ii = first; ii < last; ++ii) {
+         prepare(*jobs[ii]);
+         batchIn += (jobs[ii]->end - jobs[ii]->start).as_double();
+      }
 
-               outputCount = resampler.read(outBuf, frames);
-               for (int i = 0; i < outputCount; ++i) {
-                  outBufLeft[i] = outBuf[i][0];
-                  if (rightTrack)
-                     outBufRight[i] = outBuf[i][1];
-               }
-               pos += outputCount;
+      if (concurrent)
+         bGoodResult = ProcessConcurrently(jobs, first, last,
+            totalIn > 0 ? doneIn / totalIn : 0,
+            totalIn > 0 ? (doneIn + batchIn) / totalIn : 1);
+      else
+         for (auto ii = first; ii < last; ++ii) {
+            auto &job = *jobs[ii];
+            auto &rb = job.rb;
+            job.result = RunSBSMSJob(job, [&](
+               const float *left, const float *right, size_t count
+            ){
                rb.outputLeftChannel->Append(
-                  (samplePtr)outBufLeft, floatSample, outputCount);
-               if (rightTrack)
+                  (samplePtr)left, floatSample, count);
+               if (right)
                   rb.outputRightChannel->Append(
-                     (samplePtr)outBufRight, floatSample, outputCount);
+                     (samplePtr)right, floatSample, count);
 
-               double frac = static_cast<double>(pos) / samplesOut.as_double();
-               int nWhichTrack = mCurTrackNum;
-               if (rightTrack) {
-                  nWhichTrack = 2 * (mCurTrackNum / 2);
+               job.made += count;
+               double frac = job.made / job.samplesOut.as_double();
+               int nWhichTrack = job.trackNum;
+               if (job.stereo) {
+                  nWhichTrack = 2 * (job.trackNum / 2);
                   if (frac < 0.5)
                      // Show twice as far for each track,
                      // because we're doing 2 at once.
@@ -394,29 +526,34 @@ bool EffectSBSMS::Process(EffectInstance &, EffectSettings &)
                      frac *= 2.0;
                   }
                }
-               if (TrackProgress(nWhichTrack, frac)) {
-                  bGoodResult = false;
-                  return;
-               }
+               return !TrackProgress(nWhichTrack, frac);
+            });
+            if (!job.result) {
+               bGoodResult = false;
+               break;
             }
+         }
 
+      if (bGoodResult)
+         for (auto ii = first; ii < last; ++ii) {
+            auto &job = *jobs[ii];
             {
-               auto pException = rb.mpException;
-               rb.mpException = {};
+               auto pException = job.rb.mpException;
+               job.rb.mpException = {};
                if (pException)
                   std::rethrow_exception(pException);
             }
 
-            rb.outputTrack->Flush();
-            Finalize(track, *outputTrack, *warper);
+            job.rb.outputTrack->Flush();
+            Finalize(*job.pTrack, *job.outputTrack, *job.warper);
          }
-         mCurTrackNum++;
-      }; },
-      [&](Track &t) {
-         if (SyncLock::IsSyncLockSelected(t))
-            t.SyncLockAdjust(mT1, mT0 + (mT1 - mT0) * mTotalStretch);
-      }
-   );
+
+      // Free the buffers and SBSMS objects of the batch
+      for (auto ii = first; ii < last; ++ii)
+         jobs[ii].reset();
+      doneIn += batchIn;
+      first = last;
+   }
 
    if (bGoodResult)
       outputs.Commit();
@@ -424,6 +561,102 @@ bool EffectSBSMS::Process(EffectInstance &, EffectSettings &)
    return bGoodResult;
 }
 
+bool EffectSBSMS::ProcessConcurrently(
+   const std::vector<std::unique_ptr<SBSMSJob>> &jobs,
+   size_t first, size_t last, double progressStart, double progressEnd)
+{
+   using audacity::concurrency::TaskPool;
+
+   // The workers only read the tracks; this thread appends what they made,
+   // as does the sequential processing, and reports the progress of all
+   std::atomic<bool> cancelled{ false };
+   std::atomic<bool> finished{ false };
+   std::exception_ptr pException;
+   std::thread driver{ [&]{
+      try {
+         TaskPool::Get().ParallelFor(last - first, 1,
+            [&](size_t begin, size_t end) {
+               for (; begin < end; ++begin) {
+                  auto &job = *jobs[first + begin];
+                  job.result = RunSBSMSJob(job, [&](
+                     const float *left, const float *right, size_t count
+                  ){
+                     {
+                        std::lock_guard lock{ job.mutex };
+                        job.pending[0].insert(
+                           job.pending[0].end(), left, left + count);
+                        if (right)
+                           job.pending[1].insert(
+                              job.pending[1].end(), right, right + count);
+                     }
+                     job.made += count;
+                     return !cancelled.load();
+                  });
+               }
+            });
+      }
+      catch (...) {
+         pException = std::current_exception();
+      }
+      finished = true;
+   } };
+
+   double totalOut = 0;
+   for (auto ii = first; ii < last; ++ii)
+      totalOut += jobs[ii]->samplesOut.as_double();
+   std::vector<float> samples[2];
+   const auto append = [&]{
+      for (auto ii = first; ii < last; ++ii) {
+         auto &job = *jobs[ii];
+         {
+            std::lock_guard lock{ job.mutex };
+            for (size_t ii : { 0, 1 }) {
+               samples[ii].swap(job.pending[ii]);
+               job.pending[ii].clear();
+            }
+         }
+         if (samples[0].empty())
+            continue;
+         job.rb.outputLeftChannel->Append((samplePtr)samples[0].data(),
+            floatSample, samples[0].size());
+         if (job.stereo)
+            job.rb.outputRightChannel->Append((samplePtr)samples[1].data(),
+               floatSample, samples[1].size());
+      }
+   };
+
+   std::exception_ptr pAppendException;
+   while (!finished) {
+      std::this_thread::sleep_for(PollInterval);
+      try {
+         append();
+         double made = 0;
+         for (auto ii = first; ii < last; ++ii)
+            made += jobs[ii]->made;
+         const auto frac = totalOut > 0 ? made / totalOut : 1.0;
+         if (TotalProgress(
+            progressStart + frac * (progressEnd - progressStart)))
+            cancelled = true;
+      }
+      catch (...) {
+         // Stop the workers, then rethrow
+         if (!pAppendException)
+            pAppendException = std::current_exception();
+         cancelled = true;
+      }
+   }
+   driver.join();
+   if (pException)
+      std::rethrow_exception(pException);
+   if (pAppendException)
+      std::rethrow_exception(pAppendException);
+   append();
+
+   return !cancelled &&
+      std::all_of(jobs.begin() + first, jobs.begin() + last,
+         [](const auto &pJob){ return pJob->result; });
+}
+
 void EffectSBSMS::Finalize(
    WaveTrack &orig, const WaveTrack &out, const TimeWarper &warper)
 {
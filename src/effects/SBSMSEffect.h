@@ -25,6 +25,7 @@ using namespace _sbsms_;
 
 class LabelTrack;
 class TimeWarper;
+struct SBSMSJob;
 
 class EffectSBSMS /* not final */ : public StatefulEffect
 {
@@ -48,6 +49,11 @@ private:
    EffectType GetType() const override;
 
    bool ProcessLabelTrack(LabelTrack *track);
+   //! Processes the tracks of the jobs in [first, last) on the TaskPool,
+   //! reporting total progress from progressStart to progressEnd
+   bool ProcessConcurrently(
+      const std::vector<std::unique_ptr<SBSMSJob>> &jobs,
+      size_t first, size_t last, double progressStart, double progressEnd);
    /*!
     @pre `orig.NChannels() == out.NChannels()`
     */
@@ -19,6 +19,7 @@
 #include "EffectEditor.h"
 #include "EffectOutputTracks.h"
 #include "LoadEffects.h"
+#include "SampleBlock.h"
 
 #include <algorithm>
 #include <list>
@@ -33,6 +34,7 @@
 #include "Project.h"
 #include "ShuttleGui.h"
 #include "SyncLock.h"
+#include "WaveChannelUtilities.h"
 #include "WaveTrack.h"
 #include "../widgets/valnum.h"
 #include "AudacityMessageBox.h"
@@ -103,6 +105,32 @@ static const double DEF_MinTruncMs = 0.001;
 // Typical fraction of total time taken by detection (better to guess low)
 const double detectFrac = 0.4;
 
+namespace {
+//! Sorted, disjoint half-open ranges of sample offsets
+using Runs = std::vector<std::pair<size_t, size_t>>;
+
+//! Removes the parts of runs that overlap others
+Runs Subtract(const Runs &runs, const Runs &others)
+{
+   Runs result;
+   auto other = others.begin();
+   for (auto [first, last] : runs) {
+      while (other != others.end() && other->second <= first)
+         ++other;
+      for (auto iter = other; first < last; ++iter) {
+         if (iter == others.end() || iter->first >= last) {
+            result.emplace_back(first, last);
+            break;
+         }
+         if (iter->first > first)
+            result.emplace_back(first, iter->first);
+         first = std::max(first, iter->second);
+      }
+   }
+   return result;
+}
+}
+
 const ComponentInterfaceSymbol EffectTruncSilence::Symbol
 { XO("Truncate Silence") };
 
@@ -614,10 +642,38 @@ bool EffectTruncSilence::Analyze(RegionList& silenceList,
       // Limit size of current block if we've reached the end
       auto count = limitSampleBufferSize( blockLen, end - *index );
 
-      // Fill buffers
+      // Fill buffers, leaving zeroes where the summaries show silence or
+      // there are no clips, and find the runs silent in every channel
+      const auto classify = [&](const MinMaxRMS &summary) {
+         return (summary.max < truncDbSilenceThreshold &&
+            summary.min > -truncDbSilenceThreshold)
+            ? Sequence::Verdict::All : Sequence::Verdict::Some;
+      };
+      Runs silentRuns{ { 0, count } };
       size_t iChannel = 0;
-      for (const auto pChannel : wt.Channels())
-         pChannel->GetFloats(buffers[iChannel++].get(), *index, count);
+      for (const auto pChannel : wt.Channels()) {
+         const auto buffer = buffers[iChannel++].get();
+         std::fill(buffer, buffer + count, 0.0f);
+         Runs undecided;
+         if (!WaveChannelUtilities::Scan(*pChannel, *index, count, classify,
+            [&](sampleCount s, size_t len,
+               const float *samples, Sequence::Verdict) {
+               if (samples) {
+                  const auto offset = (s - *index).as_size_t();
+                  std::copy(samples, samples + len, buffer + offset);
+                  undecided.emplace_back(offset, offset + len);
+               }
+               return true;
+            })
+         ) {
+            // Clips with pitch or speed changes, as in the unrendered input
+            // tracks of a preview, can't be decided from their summaries
+            pChannel->GetFloats(buffer, *index, count);
+            undecided = { { 0, count } };
+         }
+         silentRuns = Subtract(silentRuns, undecided);
+      }
+      auto silentRun = silentRuns.begin();
 
       // Look for silenceList in current block
       for (decltype(count) i = 0; i < count; ++i) {
@@ -629,6 +685,14 @@ bool EffectTruncSilence::Analyze(RegionList& silenceList,
             break;
          }
 
+         // A known silent run only lengthens the current silence
+         if (silentRun != silentRuns.end() && silentRun->first == i) {
+            *silentFrame += silentRun->second - i;
+            i = silentRun->second - 1;
+            ++silentRun;
+            continue;
+         }
+
          const bool silent = std::all_of(buffers, buffers + iChannel,
          [&](const Floats &buffer){
             return fabs(buffer[i]) < truncDbSilenceThreshold;
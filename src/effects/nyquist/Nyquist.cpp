@@ -71,6 +71,8 @@ effects from this one class.
 #include "ProgressDialog.h"
 #include "Project.h"
 #include "ProjectRate.h"
+#include "SampleBlock.h"
+#include "Sequence.h"
 #include "ShuttleAutomation.h"
 #include "ShuttleGui.h"
 #include "SyncLock.h"
@@ -95,8 +97,6 @@ effects from this one class.
 #include <sstream>
 #include <float.h>
 
-#define NYQUIST_WORKER_ID wxT("Nyquist Worker")
-
 int NyquistEffect::mReentryCount = 0;
 
 enum
@@ -120,6 +120,8 @@ enum
 static const wxChar *KEY_Command = wxT("Command");
 static const wxChar *KEY_Parameters = wxT("Parameters");
 
+BoolSetting NyquistBlockTransfer{ L"/Nyquist/BlockTransfer", true };
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // NyquistEffect
@@ -676,13 +678,20 @@ struct NyquistEffect::NyxContext {
 
    int GetCallback(float *buffer, int channel,
       int64_t start, int64_t len, int64_t totlen);
-   int PutCallback(float *buffer, int channel,
+   int PutCallback(const float *buffer, int channel,
       int64_t start, int64_t len, int64_t totlen);
    static int StaticGetCallback(float *buffer, int channel,
       int64_t start, int64_t len, int64_t totlen, void *userdata);
-   static int StaticPutCallback(float *buffer, int channel,
+   static int StaticPutCallback(const float *buffer, int channel,
       int64_t start, int64_t len, int64_t totlen, void *userdata);
 
+   //! Copies from views of blocks; false if some of the samples need
+   //! GetFromBuffer() instead
+   bool GetFromBlocks(float *buffer, int ch, sampleCount pos, size_t len);
+   void GetFromBuffer(float *buffer, int ch, sampleCount pos, size_t len);
+   //! Makes mCurView[ch] contain pos; false if it cannot
+   bool FetchView(int ch, sampleCount pos);
+
    WaveTrack *mCurChannelGroup{};
    WaveChannel       *mCurTrack[2]{};
    sampleCount       mCurStart{};
@@ -695,6 +704,17 @@ struct NyquistEffect::NyxContext {
    size_t            mCurBufferLen[2]{};
    sampleCount       mCurLen{};
 
+   //! Samples of one channel that GetCallback copies without fetching them
+   //! again: a whole decoded block of a clip, or silence between clips
+   struct View {
+      BlockSampleView samples; //!< null for silence
+      sampleCount start{}; //!< position in the track
+      size_t offset{}; //!< of the sample at start, in samples
+      size_t length{};
+   };
+   View              mCurView[2]; //!< used only in GetCallback
+   const bool        mBlockTransfer{ NyquistBlockTransfer.Read() };
+
    WaveTrack::Holder mOutputTrack;
 
    double            mProgressIn{};
@@ -2561,20 +2581,108 @@ int NyquistEffect::NyxContext::StaticGetCallback(float *buffer, int channel,
 
 int NyquistEffect::NyxContext::GetCallback(float *buffer, int ch,
    int64_t start, int64_t len, int64_t)
+{
+   try {
+      const auto pos = mCurStart + start;
+      if (!(mBlockTransfer && GetFromBlocks(buffer, ch, pos, len)))
+         GetFromBuffer(buffer, ch, pos, len);
+   }
+   catch ( ... ) {
+      // Save the exception object for re-throw when out of the library
+      mpException = std::current_exception();
+      return -1;
+   }
+
+   if (ch == 0) {
+      double progress = mScale * ((start + len) / mCurLen.as_double());
+      if (progress > mProgressIn)
+         mProgressIn = progress;
+      if (mProgressReport(mProgressIn + mProgressOut + mProgressTot))
+         return -1;
+   }
+
+   return 0;
+}
+
+bool NyquistEffect::NyxContext::GetFromBlocks(
+   float *buffer, int ch, sampleCount pos, size_t len)
+{
+   // Nyquist asks for less than a block at a time, so most requests are
+   // copied from the view made for the one before
+   while (len > 0) {
+      auto &view = mCurView[ch];
+      if (!(pos >= view.start && pos < view.start + view.length) &&
+          !FetchView(ch, pos))
+         return false;
+      const auto offset = (pos - view.start).as_size_t();
+      const auto count = std::min(len, view.length - offset);
+      if (view.samples)
+         std::copy_n(view.samples->data() + view.offset + offset,
+            count, buffer);
+      else
+         std::fill_n(buffer, count, 0.0f);
+      buffer += count;
+      pos += count;
+      len -= count;
+   }
+   return true;
+}
+
+bool NyquistEffect::NyxContext::FetchView(int ch, sampleCount pos)
+{
+   auto &view = mCurView[ch];
+   view = {};
+   view.start = pos;
+   // Silence lasts until the next clip, or the end of the selection
+   auto end = mCurStart + mCurLen;
+   for (const auto &pClip : mCurTrack[ch]->Intervals()) {
+      const auto clipStart = pClip->GetPlayStartSample();
+      const auto clipEnd = pClip->GetPlayEndSample();
+      if (pos >= clipEnd)
+         continue;
+      if (pos < clipStart) {
+         end = std::min(end, clipStart);
+         continue;
+      }
+      // Stretched samples, and those not yet in blocks, are left to
+      // GetFromBuffer()
+      if (pClip->HasPitchOrSpeed())
+         return false;
+      const auto &sequence = pClip->GetSequence();
+      const auto seqPos =
+         pos - clipStart + pClip->TimeToSamples(pClip->GetTrimLeft());
+      if (seqPos >= sequence.GetNumSamples())
+         return false;
+      const auto &block =
+         sequence.GetBlockArray()[sequence.FindBlock(seqPos)];
+      // The view is shared with the cache of the block, so this decodes the
+      // block only if no other reader holds it
+      view.samples = block.sb->GetFloatSampleView(true);
+      view.offset = (seqPos - block.start).as_size_t();
+      view.length = limitSampleBufferSize(
+         block.sb->GetSampleCount() - view.offset, clipEnd - pos);
+      return true;
+   }
+   view.length =
+      limitSampleBufferSize(mCurTrack[ch]->GetMaxBlockSize(), end - pos);
+   return view.length > 0;
+}
+
+void NyquistEffect::NyxContext::GetFromBuffer(
+   float *buffer, int ch, sampleCount pos, size_t len)
 {
    if (mCurBuffer[ch]) {
-      if ((mCurStart + start) < mCurBufferStart[ch] ||
-          (mCurStart + start) + len >
-          mCurBufferStart[ch] + mCurBufferLen[ch]) {
+      if (pos < mCurBufferStart[ch] ||
+          pos + len > mCurBufferStart[ch] + mCurBufferLen[ch]) {
          mCurBuffer[ch].reset();
       }
    }
 
    if (!mCurBuffer[ch]) {
-      mCurBufferStart[ch] = (mCurStart + start);
+      mCurBufferStart[ch] = pos;
       mCurBufferLen[ch] = mCurTrack[ch]->GetBestBlockSize(mCurBufferStart[ch]);
 
-      if (mCurBufferLen[ch] < (size_t) len)
+      if (mCurBufferLen[ch] < len)
          mCurBufferLen[ch] = mCurTrack[ch]->GetIdealBlockSize();
 
       mCurBufferLen[ch] = limitSampleBufferSize(mCurBufferLen[ch],
@@ -2583,42 +2691,25 @@ int NyquistEffect::NyxContext::GetCallback(float *buffer, int ch,
       // C++20
       // mCurBuffer[ch] = std::make_unique_for_overwrite(mCurBufferLen[ch]);
       mCurBuffer[ch] = Buffer{ safenew float[ mCurBufferLen[ch] ] };
-      try {
-         mCurTrack[ch]->GetFloats( mCurBuffer[ch].get(),
-            mCurBufferStart[ch], mCurBufferLen[ch]);
-      }
-      catch ( ... ) {
-         // Save the exception object for re-throw when out of the library
-         mpException = std::current_exception();
-         return -1;
-      }
+      mCurTrack[ch]->GetFloats( mCurBuffer[ch].get(),
+         mCurBufferStart[ch], mCurBufferLen[ch]);
    }
 
    // We have guaranteed above that this is nonnegative and bounded by
    // mCurBufferLen[ch]:
-   auto offset = (mCurStart + start - mCurBufferStart[ch]).as_size_t();
+   auto offset = (pos - mCurBufferStart[ch]).as_size_t();
    const void *src = &mCurBuffer[ch][offset];
    std::memcpy(buffer, src, len * sizeof(float));
-
-   if (ch == 0) {
-      double progress = mScale * ((start + len) / mCurLen.as_double());
-      if (progress > mProgressIn)
-         mProgressIn = progress;
-      if (mProgressReport(mProgressIn + mProgressOut + mProgressTot))
-         return -1;
-   }
-
-   return 0;
 }
 
-int NyquistEffect::NyxContext::StaticPutCallback(float *buffer, int channel,
+int NyquistEffect::NyxContext::StaticPutCallback(const float *buffer, int channel,
    int64_t start, int64_t len, int64_t totlen, void *userdata)
 {
    auto This = static_cast<NyxContext*>(userdata);
    return This->PutCallback(buffer, channel, start, len, totlen);
 }
 
-int NyquistEffect::NyxContext::PutCallback(float *buffer, int channel,
+int NyquistEffect::NyxContext::PutCallback(const float *buffer, int channel,
    int64_t start, int64_t len, int64_t totlen)
 {
    // Don't let C++ exceptions propagate through the Nyquist library
@@ -2634,7 +2725,7 @@ int NyquistEffect::NyxContext::PutCallback(float *buffer, int channel,
       auto iChannel = mOutputTrack->Channels().begin();
       std::advance(iChannel, channel);
       const auto pChannel = *iChannel;
-      pChannel->Append((samplePtr)buffer, floatSample, len);
+      pChannel->Append((constSamplePtr)buffer, floatSample, len);
 
       return 0; // success
    }, MakeSimpleGuard(-1)); // translate all exceptions into failure
@@ -23,9 +23,11 @@ class wxFileName;
 class wxCheckBox;
 class wxTextCtrl;
 
+class BoolSetting;
 class EffectOutputTracks;
 
 #define NYQUISTEFFECTS_VERSION wxT("1.0.0.0")
+#define NYQUIST_WORKER_ID wxT("Nyquist Worker")
 
 enum NyqControlType
 {
@@ -309,5 +311,8 @@ private:
    DECLARE_EVENT_TABLE()
 };
 
+//! Whether Nyquist reads the samples of whole blocks of the tracks, shared
+//! with their caches, rather than fetching a new buffer for each request
+extern AUDACITY_DLL_API BoolSetting NyquistBlockTransfer;
 
 #endif
@@ -124,16 +124,6 @@ void EffectsPrefs::PopulateOrExchange(ShuttleGui & S)
    }
    S.EndStatic();
 
-#ifdef EXPERIMENTAL_EQ_SSE_THREADED
-   S.StartStatic(XO("Instruction Set"));
-   {
-      S.TieCheckBox(XXO("&Use SSE/SSE2/.../AVX"),
-                    {wxT("/SSE/GUI"),
-                    true});
-   }
-   S.EndStatic();
-#endif
-
    if (auto pButton = S.AddButton(XXO("Open Plugin &Manager"), wxALIGN_LEFT))
       pButton->Bind(wxEVT_BUTTON, [this](auto) {
          //Adding dependency on PluginRegistrationDialog, not good. Alternatively
@@ -11,36 +11,42 @@
 #include "SpectrumCache.h"
 
 #include "../../../../prefs/SpectrogramSettings.h"
-#include "RealFFTf.h"
+#include "FFTPlan.h"
+#include "ProjectTileCache.h"
 #include "Sequence.h"
+#include "SequenceStftSource.h"
 #include "Spectrum.h"
+#include "Stft.h"
 #include "WaveClipUIUtilities.h"
 #include "WaveTrack.h"
 #include "WideSampleSequence.h"
+#include "concurrency/TaskPool.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <mutex>
 
 namespace {
 
-static void ComputeSpectrumUsingRealFFTf
-   (float * __restrict buffer, const FFTParam *hFFT,
-    const float * __restrict window, size_t len, float * __restrict out)
+//! Computes the power spectrum in dB of the windowed samples
+/*! buffer is overwritten */
+void ComputeSpectrumUsingFFT
+   (float * __restrict buffer, const SpecCache::Transform &transform,
+    const float * __restrict window, float * __restrict work,
+    float * __restrict out)
 {
-   size_t i;
-   if(len > hFFT->Points * 2)
-      len = hFFT->Points * 2;
-   for(i = 0; i < len; i++)
+   const auto fftLen = transform.fftLen;
+   for (size_t i = 0; i < fftLen; i++)
       buffer[i] *= window[i];
-   for( ; i < (hFFT->Points * 2); i++)
-      buffer[i] = 0; // zero pad as needed
-   RealFFTf(buffer, hFFT);
+   transform(buffer, work);
    // Handle the (real-only) DC
    float power = buffer[0] * buffer[0];
    if(power <= 0)
       out[0] = -160.0;
    else
       out[0] = 10.0 * log10f(power);
-   for(i = 1; i < hFFT->Points; i++) {
-      const int index = hFFT->BitReversed[i];
+   for (size_t i = 1; i < fftLen / 2; i++) {
+      const auto index = transform.Index(i);
       const float re = buffer[index], im = buffer[index + 1];
       power = re * re + im * im;
       if(power <= 0)
@@ -70,6 +76,89 @@ void ComputeSpectrogramGainFactors
    }
 }
 
+// Columns of the spectrum computed by one task, at least
+constexpr size_t MinColumnsPerTask = 8;
+
+// Columns of the spectrum in one tile
+constexpr long long TileWidth = 64;
+// Zoom levels sharing the tiles differ by less than 1/2 of 1/16 octave, so
+// the columns of the tiles are within about 2% of the pixels of any of them
+constexpr double ZoomBucketsPerOctave = 16;
+// Limit of the memory held by the decoded tiles of one cache
+constexpr size_t MaxTilesBytes = 16 * 1024 * 1024;
+// Change when the contents of the tiles change
+constexpr int TileFormatVersion = 2;
+// Tiles store the dB values in 1/100 dB
+constexpr float TileValueScale = 100.0f;
+
+long long ZoomBucket(double samplesPerPixel)
+{
+   return std::llround(std::log2(samplesPerPixel) * ZoomBucketsPerOctave);
+}
+
+// Distance of the columns of the tiles, close to the samples per pixel
+double TileSamplesPerColumn(long long zoomBucket)
+{
+   return std::exp2(zoomBucket / ZoomBucketsPerOctave);
+}
+
+//! Accumulates the bytes of the key of a tile, and their 64 bit FNV-1a hash
+class TileKeyBuilder final
+{
+public:
+   template<typename T> void Add(const T &value)
+   {
+      const auto bytes = reinterpret_cast<const uint8_t *>(&value);
+      mData.insert(mData.end(), bytes, bytes + sizeof(T));
+      for (size_t ii = 0; ii < sizeof(T); ++ii)
+         mHash = (mHash ^ bytes[ii]) * 1099511628211ull;
+   }
+
+   ProjectTileCache::Key GetHash() const
+   {
+      return static_cast<ProjectTileCache::Key>(mHash);
+   }
+
+   ProjectTileCache::KeyData &GetData() { return mData; }
+
+private:
+   ProjectTileCache::KeyData mData;
+   uint64_t mHash { 14695981039346656037ull };
+};
+
+}
+
+SpecCache::Transform::Transform(size_t fftLen_)
+   : plan{ FFTPlan::Get(fftLen_) }
+   , fftLen{ fftLen_ }
+   , stride{ fftLen_ }
+{
+}
+
+PffftFloatVector SpecCache::Transform::MakeScratch(size_t nBuffers) const
+{
+   // One more buffer is the work area of the plan
+   return PffftFloatVector((nBuffers + 1) * stride);
+}
+
+void SpecCache::Transform::operator()(float *buffer, float *work) const
+{
+   plan->Forward(buffer, buffer, work);
+}
+
+void SpecCache::ReassignmentBuffer::Add(int x, size_t bin, float power)
+{
+   const auto index = static_cast<size_t>(x) * nBins + bin;
+   if (x >= ownBegin && x < ownEnd)
+      out[index] += power;
+   else
+      overflow.emplace_back(index, power);
+}
+
+void SpecCache::ReassignmentBuffer::Merge() const
+{
+   for (const auto &[index, power] : overflow)
+      out[index] += power;
 }
 
 bool SpecCache::Matches(
@@ -94,8 +183,9 @@ bool SpecCache::Matches(
 bool SpecCache::CalculateOneSpectrum(
    const SpectrogramSettings& settings, const WaveChannelInterval& clip,
    const int xx, double pixelsPerSecond, int lowerBoundX, int upperBoundX,
-   const std::vector<float>& gainFactors, float* __restrict scratch,
-   float* __restrict out) const
+   const std::vector<float>& gainFactors, const Transform &transform,
+   float* __restrict scratch, float* __restrict out,
+   ReassignmentBuffer *pReassigned) const
 {
    bool result = false;
    const bool reassignment =
@@ -167,12 +257,10 @@ bool SpecCache::CalculateOneSpectrum(
          }
 
          if (myLen > 0) {
-            constexpr auto iChannel = 0u;
             constexpr auto mayThrow = false; // Don't throw just for display
-            mSampleCacheHolder.emplace(
-               clip.GetSampleView(from, myLen, mayThrow));
+            const auto sampleView = clip.GetSampleView(from, myLen, mayThrow);
             floats.resize(myLen);
-            mSampleCacheHolder->Copy(floats.data(), myLen);
+            sampleView.Copy(floats.data(), myLen);
             useBuffer = floats.data();
             if (copy) {
                if (useBuffer)
@@ -197,37 +285,39 @@ bool SpecCache::CalculateOneSpectrum(
       }
       else if (reassignment) {
          static const double epsilon = 1e-16;
-         const auto hFFT = settings.hFFT.get();
+         const auto nPoints = fftLen / 2;
+
+         float *const scratch2 = scratch + transform.stride;
+         std::copy(scratch, scratch + fftLen, scratch2);
 
-         float *const scratch2 = scratch + fftLen;
-         std::copy(scratch, scratch2, scratch2);
+         float *const scratch3 = scratch + 2 * transform.stride;
+         std::copy(scratch, scratch + fftLen, scratch3);
 
-         float *const scratch3 = scratch + 2 * fftLen;
-         std::copy(scratch, scratch2, scratch3);
+         float *const work = scratch + 3 * transform.stride;
 
          {
             const float *const window = settings.window.get();
             for (size_t ii = 0; ii < fftLen; ++ii)
                scratch[ii] *= window[ii];
-            RealFFTf(scratch, hFFT);
+            transform(scratch, work);
          }
 
          {
             const float *const dWindow = settings.dWindow.get();
             for (size_t ii = 0; ii < fftLen; ++ii)
                scratch2[ii] *= dWindow[ii];
-            RealFFTf(scratch2, hFFT);
+            transform(scratch2, work);
          }
 
          {
             const float *const tWindow = settings.tWindow.get();
             for (size_t ii = 0; ii < fftLen; ++ii)
                scratch3[ii] *= tWindow[ii];
-            RealFFTf(scratch3, hFFT);
+            transform(scratch3, work);
          }
 
-         for (size_t ii = 0; ii < hFFT->Points; ++ii) {
-            const int index = hFFT->BitReversed[ii];
+         for (size_t ii = 0; ii < nPoints; ++ii) {
+            const auto index = transform.Index(ii);
             const float
                denomRe = scratch[index],
                denomIm = ii == 0 ? 0 : scratch[index + 1];
@@ -256,7 +346,7 @@ bool SpecCache::CalculateOneSpectrum(
             const int bin = (int)((int)ii + freqCorrection + 0.5f);
             // Must check if correction takes bin out of bounds, above or below!
             // bin is signed!
-            if (bin >= 0 && bin < (int)hFFT->Points) {
+            if (bin >= 0 && bin < (int)nPoints) {
                double timeCorrection;
                {
                   const float
@@ -278,15 +368,9 @@ bool SpecCache::CalculateOneSpectrum(
                {
                   result = true;
 
-                  // This is non-negative, because bin and correctedX are
-                  auto ind = (int)nBins * correctedX + bin;
-#ifdef _OPENMP
-                  // This assignment can race if index reaches into another thread's bins.
-                  // The probability of a race very low, so this carries little overhead,
-                  // about 5% slower vs allowing it to race.
-                  #pragma omp atomic update
-#endif
-                  out[ind] += power;
+                  // Only the columns owned by this task are written at once;
+                  // correctedX and bin are non-negative
+                  pReassigned->Add(correctedX, bin, power);
                }
             }
          }
@@ -302,8 +386,8 @@ bool SpecCache::CalculateOneSpectrum(
          // the part of useBuffer in the padding zones.
 
          // This function mutates useBuffer
-         ComputeSpectrumUsingRealFFTf
-            (useBuffer, settings.hFFT.get(), settings.window.get(), fftLen, results);
+         ComputeSpectrumUsingFFT(useBuffer, transform, settings.window.get(),
+            scratch + transform.stride, results);
          if (!gainFactors.empty()) {
             // Apply a frequency-dependent gain factor
             for (size_t ii = 0; ii < nBins; ++ii)
@@ -357,60 +441,61 @@ void SpecCache::Populate(
    const size_t fftLen = windowSizeSetting * zeroPaddingFactorSetting;
    const auto nBins = settings.NBins();
 
-   const size_t bufferSize = fftLen;
-   const size_t scratchSize = reassignment ? 3 * bufferSize : bufferSize;
-   std::vector<float> scratch(scratchSize);
+   const Transform transform{ fftLen };
+   const size_t scratchBuffers = reassignment ? 3 : 1;
 
    std::vector<float> gainFactors;
    if (!autocorrelation)
       ComputeSpectrogramGainFactors(
          fftLen, sampleRate, frequencyGainSetting, gainFactors);
 
+   auto &taskPool = audacity::concurrency::TaskPool::Get();
+
    // Loop over the ranges before and after the copied portion and compute anew.
    // One of the ranges may be empty.
    for (int jj = 0; jj < 2; ++jj) {
       const int lowerBoundX = jj == 0 ? 0 : copyEnd;
       const int upperBoundX = jj == 0 ? copyBegin : numPixels;
-
-// todo(mhodgkinson): I don't find an option to define _OPENMP anywhere. Is this
-// still of interest?
-#ifdef _OPENMP
-      // Storage for mutable per-thread data.
-      // private clause ensures one copy per thread
-      struct ThreadLocalStorage {
-         ThreadLocalStorage()  { }
-         ~ThreadLocalStorage() { }
-
-         void init(SampleTrackCache &waveTrackCache, size_t scratchSize) {
-            if (!cache) {
-               cache = std::make_unique<SampleTrackCache>(waveTrackCache.GetTrack());
-               scratch.resize(scratchSize);
+      if (lowerBoundX >= upperBoundX)
+         continue;
+
+      // Each task has its own aligned scratch.  Reassignment may move the
+      // power into the columns of other tasks; that is deferred, and merged
+      // in the order of the columns when all tasks are done
+      std::mutex reassignedMutex;
+      std::vector<ReassignmentBuffer> reassigned;
+
+      taskPool.ParallelFor(upperBoundX - lowerBoundX, MinColumnsPerTask,
+         [&](size_t begin, size_t end) {
+            auto scratch = transform.MakeScratch(scratchBuffers);
+            ReassignmentBuffer buffer{ &freq[0], nBins,
+               lowerBoundX + static_cast<int>(begin),
+               lowerBoundX + static_cast<int>(end) };
+
+            for (auto xx = buffer.ownBegin; xx < buffer.ownEnd; ++xx)
+               CalculateOneSpectrum(
+                  settings, clip, xx, pixelsPerSecond, lowerBoundX, upperBoundX,
+                  gainFactors, transform, scratch.data(), &freq[0], &buffer);
+
+            if (!buffer.overflow.empty()) {
+               std::lock_guard lock{ reassignedMutex };
+               reassigned.push_back(std::move(buffer));
             }
-         }
-         std::unique_ptr<SampleTrackCache> cache;
-         std::vector<float> scratch;
-      } tls;
+         });
 
-      #pragma omp parallel for private(tls)
-#endif
-      for (auto xx = lowerBoundX; xx < upperBoundX; ++xx)
-      {
-#ifdef _OPENMP
-         tls.init(waveTrackCache, scratchSize);
-         SampleTrackCache& cache = *tls.cache;
-         float* buffer = &tls.scratch[0];
-#else
-         float* buffer = &scratch[0];
-#endif
-         CalculateOneSpectrum(
-            settings, clip, xx, pixelsPerSecond, lowerBoundX, upperBoundX,
-            gainFactors, buffer, &freq[0]);
-      }
+      std::sort(reassigned.begin(), reassigned.end(),
+         [](const auto &a, const auto &b){ return a.ownBegin < b.ownBegin; });
+      for (const auto &buffer : reassigned)
+         buffer.Merge();
 
       if (reassignment) {
          // Need to look beyond the edges of the range to accumulate more
          // time reassignments.
          // I'm not sure what's a good stopping criterion?
+         auto scratch = transform.MakeScratch(scratchBuffers);
+         // No other task runs now, so all columns of the range are owned
+         ReassignmentBuffer buffer{ &freq[0], nBins, lowerBoundX, upperBoundX };
+
          auto xx = lowerBoundX;
          const double pixelsPerSample =
             pixelsPerSecond * clip.GetStretchRatio() / sampleRate;
@@ -419,7 +504,7 @@ void SpecCache::Populate(
          {
             const bool result = CalculateOneSpectrum(
                settings, clip, --xx, pixelsPerSecond, lowerBoundX, upperBoundX,
-               gainFactors, &scratch[0], &freq[0]);
+               gainFactors, transform, scratch.data(), &freq[0], &buffer);
             if (!result)
                break;
          }
@@ -429,40 +514,275 @@ void SpecCache::Populate(
          {
             const bool result = CalculateOneSpectrum(
                settings, clip, xx++, pixelsPerSecond, lowerBoundX, upperBoundX,
-               gainFactors, &scratch[0], &freq[0]);
+               gainFactors, transform, scratch.data(), &freq[0], &buffer);
             if (!result)
                break;
          }
 
          // Now Convert to dB terms.  Do this only after accumulating
          // power values, which may cross columns with the time correction.
-#ifdef _OPENMP
-         #pragma omp parallel for
-#endif
-         for (xx = lowerBoundX; xx < upperBoundX; ++xx) {
-            float *const results = &freq[nBins * xx];
-            for (size_t ii = 0; ii < nBins; ++ii) {
-               float &power = results[ii];
-               if (power <= 0)
-                  power = -160.0;
-               else
-                  power = 10.0*log10f(power);
+         taskPool.ParallelFor(upperBoundX - lowerBoundX, MinColumnsPerTask,
+            [&](size_t begin, size_t end) {
+               for (auto xx = lowerBoundX + begin; xx < lowerBoundX + end; ++xx) {
+                  float *const results = &freq[nBins * xx];
+                  for (size_t ii = 0; ii < nBins; ++ii) {
+                     float &power = results[ii];
+                     if (power <= 0)
+                        power = -160.0;
+                     else
+                        power = 10.0*log10f(power);
+                  }
+                  if (!gainFactors.empty()) {
+                     // Apply a frequency-dependent gain factor
+                     for (size_t ii = 0; ii < nBins; ++ii)
+                        results[ii] += gainFactors[ii];
+                  }
+               }
+            });
+      }
+   }
+}
+
+void SpecCache::PopulateFromTiles(
+   const SpectrogramSettings& settings, const WaveChannelInterval& clip,
+   int copyBegin, int copyEnd, size_t numPixels, double pixelsPerSecond,
+   ProjectTileCache &tileCache)
+{
+   const auto numSamples = clip.GetSequence().GetNumSamples();
+   // where[] is relative to the play start, the tiles to the sequence start
+   const auto trimLeft = clip.GetClip().TimeToSamples(clip.GetTrimLeft());
+   const auto samplesPerColumn = TileSamplesPerColumn(ZoomBucket(spp));
+   const auto nBins = settings.NBins();
+
+   const Tile *tile = nullptr;
+   long long tileIndex = -1;
+   std::optional<Transform> transform;
+   PffftFloatVector scratch;
+   std::vector<float> gainFactors;
+
+   for (int jj = 0; jj < 2; ++jj) {
+      const int lowerBoundX = jj == 0 ? 0 : copyEnd;
+      const int upperBoundX = jj == 0 ? copyBegin : numPixels;
+
+      for (auto xx = lowerBoundX; xx < upperBoundX; ++xx) {
+         float *const results = &freq[nBins * xx];
+
+         if (where[xx] < 0 || where[xx] >= numSamples) {
+            // Pixel column is out of bounds of the clip
+            std::fill(results, results + nBins, 0.0f);
+            continue;
+         }
+
+         // Nearest column of the tiles, at most half a column away
+         const auto column = std::llround(
+            (where[xx] + trimLeft).as_double() / samplesPerColumn);
+
+         if (column / TileWidth != tileIndex) {
+            tileIndex = column / TileWidth;
+            tile = GetTile(settings, clip, tileIndex, tileCache);
+         }
+
+         if (tile) {
+            const auto offset = (column % TileWidth) * nBins;
+            std::copy(tile->values.begin() + offset,
+               tile->values.begin() + offset + nBins, results);
+         }
+         else {
+            // Blocks not yet in the database, compute the column as usual
+            if (!transform) {
+               transform.emplace(settings.GetFFTLength());
+               scratch = transform->MakeScratch(1);
+               if (settings.algorithm != SpectrogramSettings::algPitchEAC)
+                  ComputeSpectrogramGainFactors(settings.GetFFTLength(),
+                     clip.GetRate(), settings.frequencyGain, gainFactors);
+            }
+            ReassignmentBuffer unused{ &freq[0], nBins, xx, xx + 1 };
+            CalculateOneSpectrum(
+               settings, clip, xx, pixelsPerSecond, lowerBoundX, upperBoundX,
+               gainFactors, *transform, scratch.data(), &freq[0], &unused);
+         }
+      }
+   }
+}
+
+auto SpecCache::GetTile(
+   const SpectrogramSettings& settings, const WaveChannelInterval& clip,
+   long long tileIndex, ProjectTileCache &tileCache) -> const Tile *
+{
+   const auto &sequence = clip.GetSequence();
+   const auto numSamples = sequence.GetNumSamples();
+   const auto zoomBucket = ZoomBucket(spp);
+   const auto samplesPerColumn = TileSamplesPerColumn(zoomBucket);
+   const auto windowSizeSetting = settings.WindowSize();
+   const auto nBins = settings.NBins();
+
+   const auto columnCenter = [&](long long column) {
+      return sampleCount{ std::llround(column * samplesPerColumn) };
+   };
+
+   // The samples that the tile depends on
+   const auto firstColumn = tileIndex * TileWidth;
+   const auto from = std::clamp<sampleCount>(
+      columnCenter(firstColumn) - (windowSizeSetting >> 1), 0, numSamples);
+   const auto to = std::clamp<sampleCount>(
+      columnCenter(firstColumn + TileWidth - 1) - (windowSizeSetting >> 1) +
+         windowSizeSetting, 0, numSamples);
+
+   // The key identifies everything the contents depend on: the settings,
+   // the positions of the columns, and the blocks of samples with their
+   // positions.  Edits replace the blocks, so stale tiles are not found
+   TileKeyBuilder builder;
+   builder.Add(TileFormatVersion);
+   builder.Add(settings.algorithm);
+   builder.Add(settings.windowType);
+   builder.Add(windowSizeSetting);
+   builder.Add(settings.ZeroPaddingFactor());
+   builder.Add(settings.frequencyGain);
+   builder.Add(clip.GetRate());
+   builder.Add(zoomBucket);
+   builder.Add(tileIndex);
+   builder.Add(from.as_long_long());
+   builder.Add(to.as_long_long());
+
+   if (from < to) {
+      const auto &blocks = sequence.GetBlockArray();
+      for (auto ii = sequence.FindBlock(from);
+           ii < (int)blocks.size() && blocks[ii].start < to; ++ii) {
+         const auto &block = blocks[ii];
+         const auto blockID = block.sb->GetBlockID();
+         // Not committed yet
+         if (blockID == 0)
+            return nullptr;
+         builder.Add(blockID);
+         builder.Add(block.start.as_long_long());
+         builder.Add(block.sb->GetSampleCount());
+      }
+   }
+
+   const auto key = builder.GetHash();
+   auto &keyData = builder.GetData();
+
+   const auto found = std::find_if(mTiles.begin(), mTiles.end(),
+      [&](const Tile &tile){ return tile.key == key && tile.keyData == keyData; });
+   if (found != mTiles.end()) {
+      // Mark as most recently used
+      std::rotate(found, found + 1, mTiles.end());
+      return &mTiles.back();
+   }
+
+   Tile tile{ key, std::move(keyData), std::vector<float>(TileWidth * nBins) };
+   const auto tileBytes = tile.values.size() * sizeof(int16_t);
+   ProjectTileCache::Tile data;
+
+   if (tileCache.Read(key, tile.keyData, data) && data.size() == tileBytes) {
+      const auto values = reinterpret_cast<const int16_t *>(data.data());
+      std::transform(values, values + tile.values.size(), tile.values.begin(),
+         [](int16_t value){ return value / TileValueScale; });
+   }
+   else {
+      const bool autocorrelation =
+         settings.algorithm == SpectrogramSettings::algPitchEAC;
+      const auto fftLen = settings.GetFFTLength();
+      const auto padding =
+         static_cast<long long>((fftLen - windowSizeSetting) / 2);
+      std::vector<float> gainFactors;
+      if (!autocorrelation)
+         ComputeSpectrogramGainFactors(
+            fftLen, clip.GetRate(), settings.frequencyGain, gainFactors);
+
+      // First samples of the windows of the columns, including the zero
+      // padding; the columns past the end of the sequence are left zeroes
+      std::vector<long long> frameStarts;
+      for (long long jj = 0; jj < TileWidth; ++jj) {
+         const auto center = columnCenter(firstColumn + jj);
+         if (center >= numSamples)
+            break;
+         frameStarts.push_back(
+            (center - (windowSizeSetting >> 1)).as_long_long() - padding);
+      }
+
+      const auto nColumns = frameStarts.size();
+      if (autocorrelation)
+         audacity::concurrency::TaskPool::Get().ParallelFor(
+            nColumns, MinColumnsPerTask, [&](size_t begin, size_t end) {
+            PffftFloatVector buffer(windowSizeSetting);
+            for (auto jj = begin; jj < end; ++jj) {
+               // Take a window of the sequence,
+               // padding with zeroes beyond its bounds
+               std::fill(buffer.begin(), buffer.end(), 0.0f);
+               const auto windowStart =
+                  sampleCount{ frameStarts[jj] + padding };
+               const auto first = std::max<sampleCount>(windowStart, 0);
+               const auto last = std::min<sampleCount>(
+                  windowStart + windowSizeSetting, numSamples);
+               if (first < last) {
+                  constexpr auto mayThrow = false; // Don't throw just for display
+                  const auto length = (last - first).as_size_t();
+                  sequence.GetFloatSampleView(first, length, mayThrow).Copy(
+                     buffer.data() + (first - windowStart).as_size_t(),
+                     length);
+               }
+               ComputeSpectrum(
+                  buffer.data(), windowSizeSetting, windowSizeSetting,
+                  &tile.values[nBins * jj], autocorrelation,
+                  settings.windowType);
             }
-            if (!gainFactors.empty()) {
-               // Apply a frequency-dependent gain factor
+         });
+      else {
+         // Window and transform the columns straight from the blocks
+         const Stft stft{ std::vector<float>(
+            settings.window.get(), settings.window.get() + fftLen) };
+         const auto frameSize = stft.GetFrameSize(Stft::Output::Power);
+
+         audacity::concurrency::TaskPool::Get().ParallelFor(
+            nColumns, MinColumnsPerTask, [&](size_t begin, size_t end) {
+            SequenceStftSource source{ sequence };
+            std::vector<float> power((end - begin) * frameSize);
+            stft.Compute(source, frameStarts.data() + begin, end - begin,
+               Stft::Output::Power, power.data());
+
+            for (auto jj = begin; jj < end; ++jj) {
+               const float *const columnPower =
+                  &power[(jj - begin) * frameSize];
+               float *const results = &tile.values[nBins * jj];
                for (size_t ii = 0; ii < nBins; ++ii)
+                  results[ii] = columnPower[ii] <= 0
+                     ? -160.0f : 10.0f * log10f(columnPower[ii]);
+               for (size_t ii = 0; ii < gainFactors.size() && ii < nBins; ++ii)
                   results[ii] += gainFactors[ii];
             }
-         }
+         });
       }
+
+      data.resize(tileBytes);
+      const auto values = reinterpret_cast<int16_t *>(data.data());
+      std::transform(tile.values.begin(), tile.values.end(), values,
+         [](float value){
+            return static_cast<int16_t>(std::clamp(
+               std::lround(value * TileValueScale), -32768L, 32767L));
+         });
+      tileCache.Write(key, tile.keyData, std::move(data));
    }
+
+   mTilesBytes += tile.keyData.size() + tile.values.size() * sizeof(float);
+   mTiles.push_back(std::move(tile));
+
+   // Drop the least recently used tiles, but never the new one
+   size_t dropped = 0;
+   while (mTilesBytes > MaxTilesBytes && dropped + 1 < mTiles.size()) {
+      const auto &old = mTiles[dropped++];
+      mTilesBytes -= old.keyData.size() + old.values.size() * sizeof(float);
+   }
+   mTiles.erase(mTiles.begin(), mTiles.begin() + dropped);
+
+   return &mTiles.back();
 }
 
 bool WaveClipSpectrumCache::GetSpectrogram(
    const WaveChannelInterval &clip,
    const float*& spectrogram, SpectrogramSettings& settings,
    const sampleCount*& where, size_t numPixels, double t0,
-   double pixelsPerSecond)
+   double pixelsPerSecond, ProjectTileCache *pTileCache)
 
 {
    auto &mSpecCache = mSpecCaches[clip.GetChannelIndex()];
@@ -562,8 +882,17 @@ bool WaveClipSpectrumCache::GetSpectrogram(
       mSpecCache->where, numPixels, addBias, correction, t0, sampleRate,
       stretchRatio, samplesPerPixel);
 
-   mSpecCache->Populate(
-      settings, clip, copyBegin, copyEnd, numPixels, pixelsPerSecond);
+   // Tiles are computed at fixed positions of the samples, and there are
+   // too many of them when zoomed in beyond one sample per pixel
+   if (pTileCache &&
+       settings.algorithm != SpectrogramSettings::algReassignment &&
+       samplesPerPixel >= 1.0)
+      mSpecCache->PopulateFromTiles(
+         settings, clip, copyBegin, copyEnd, numPixels, pixelsPerSecond,
+         *pTileCache);
+   else
+      mSpecCache->Populate(
+         settings, clip, copyBegin, copyEnd, numPixels, pixelsPerSecond);
 
    mSpecCache->dirty = mDirty;
    spectrogram = &mSpecCache->freq[0];
@@ -11,6 +11,8 @@
 #ifndef __AUDACITY_WAVECLIP_SPECTRUM_CACHE__
 #define __AUDACITY_WAVECLIP_SPECTRUM_CACHE__
 
+class FFTPlan;
+class ProjectTileCache;
 class sampleCount;
 class SpectrogramSettings;
 class WaveClipChannel;
@@ -19,12 +21,46 @@ class WideSampleSequence;
 
 #include <vector>
 #include "MemoryX.h"
+#include "PowerSpectrumGetter.h"
 #include "WaveClip.h" // to inherit WaveClipListener
 
 using Floats = ArrayOf<float>;
 
 class AUDACITY_DLL_API SpecCache {
 public:
+   //! Forward real FFT by the shared FFTPlan of the size
+   /*! Read-only once constructed, so tasks can share it */
+   struct Transform {
+      explicit Transform(size_t fftLen);
+
+      //! Aligned buffers for the transforms, followed by the work area of the plan
+      PffftFloatVector MakeScratch(size_t nBuffers) const;
+
+      //! Transforms the aligned buffer in place
+      void operator()(float *buffer, float *work) const;
+      //! Position of the real part of the bin in a transformed buffer,
+      //! followed by the imaginary part, except for bin 0
+      static size_t Index(size_t bin) { return 2 * bin; }
+
+      const std::shared_ptr<const FFTPlan> plan;
+      const size_t fftLen;
+      //! Distance of the buffers made by MakeScratch
+      const PffftAlignedCount stride;
+   };
+
+   //! Accumulates reassigned power of the columns computed by one task
+   /*! The columns that the task owns are written directly, the other ones
+    later, by Merge */
+   struct ReassignmentBuffer {
+      float *out;
+      size_t nBins;
+      int ownBegin;
+      int ownEnd;
+      std::vector<std::pair<size_t, float>> overflow;
+
+      void Add(int x, size_t bin, float power);
+      void Merge() const;
+   };
 
    // Make invalid cache
    SpecCache()
@@ -55,6 +91,14 @@ public:
       const SpectrogramSettings& settings, const WaveChannelInterval& clip,
       int copyBegin, int copyEnd, size_t numPixels, double pixelsPerSecond);
 
+   // Like Populate, but copy the columns from tiles of the spectrum computed
+   // at fixed positions of the sequence, which persist in the project file.
+   // Not for reassignment, which spreads the power over neighbouring columns
+   void PopulateFromTiles(
+      const SpectrogramSettings& settings, const WaveChannelInterval& clip,
+      int copyBegin, int copyEnd, size_t numPixels, double pixelsPerSecond,
+      ProjectTileCache &tileCache);
+
    size_t       len { 0 }; // counts pixels, not samples
    int          algorithm;
    double       spp; // samples per pixel
@@ -75,10 +119,26 @@ private:
    bool CalculateOneSpectrum(
       const SpectrogramSettings& settings, const WaveChannelInterval &clip,
       const int xx, double pixelsPerSecond, int lowerBoundX, int upperBoundX,
-      const std::vector<float>& gainFactors, float* __restrict scratch,
-      float* __restrict out) const;
+      const std::vector<float>& gainFactors, const Transform &transform,
+      float* __restrict scratch, float* __restrict out,
+      ReassignmentBuffer *pReassigned) const;
+
+   struct Tile {
+      int64_t key;
+      //! Compared too, in case the hashes collide
+      std::vector<uint8_t> keyData;
+      std::vector<float> values;
+   };
+
+   //! Finds the tile in memory or in the project file, or computes it
+   /*! @return null if the tile can't be identified by the sample blocks */
+   const Tile *GetTile(
+      const SpectrogramSettings& settings, const WaveChannelInterval& clip,
+      long long tileIndex, ProjectTileCache &tileCache);
 
-   mutable std::optional<AudioSegmentSampleView> mSampleCacheHolder;
+   //! Recently used tiles, most recent last
+   std::vector<Tile> mTiles;
+   size_t mTilesBytes { 0 };
 };
 
 class SpecPxCache {
@@ -128,7 +188,8 @@ struct WaveClipSpectrumCache final : WaveClipListener
       const float *&spectrogram,
       SpectrogramSettings &spectrogramSettings,
       const sampleCount *&where, size_t numPixels,
-      double t0 /*absolute time*/, double pixelsPerSecond);
+      double t0 /*absolute time*/, double pixelsPerSecond,
+      ProjectTileCache *pTileCache = nullptr /*!< reuses the persisted tiles */);
 
    void MakeStereo(WaveClipListener &&other, bool aligned) override;
    void SwapChannels() override;
@@ -26,6 +26,7 @@ Paul Licameli split from WaveChannelView.cpp
 #include "AColor.h"
 #include "PendingTracks.h"
 #include "Prefs.h"
+#include "ProjectTileCache.h"
 #include "NumberScale.h"
 #include "../../../../TrackArt.h"
 #include "../../../../TrackArtist.h"
@@ -424,9 +425,13 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
    const double binUnit = sampleRate / (2 * half);
    const float *freq = 0;
    const sampleCount *where = 0;
+   ProjectTileCache *pTileCache = nullptr;
+   if (const auto pTrackList = channel.GetTrack().GetOwner();
+       pTrackList && pTrackList->GetOwner() && ProjectTileCache::IsEnabled())
+      pTileCache = &ProjectTileCache::Get(*pTrackList->GetOwner());
    bool updated = WaveClipSpectrumCache::Get(clip).GetSpectrogram(
       clip, freq, settings, where, (size_t)hiddenMid.width, t0,
-      averagePixelsPerSecond);
+      averagePixelsPerSecond, pTileCache);
    auto nBins = settings.NBins();
 
    float minFreq, maxFreq;
@@ -197,6 +197,13 @@ struct WaveBitmapCacheElementWX final : public WaveBitmapCacheElement
       return mImage.GetHeight();
    }
 
+   size_t GetMemorySize() const override
+   {
+      // The bitmap is created from the image on the first draw and
+      // typically uses 4 bytes per pixel
+      return WaveBitmapCacheElement::GetMemorySize() + Width() * Height() * 4;
+   }
+
 private:
    wxBitmap mBitmap;
    wxImage  mImage;
@@ -231,6 +238,7 @@ public:
       for (auto channelIndex = 0; channelIndex < nChannels; ++channelIndex)
       {
          auto dataCache = std::make_shared<WaveDataCache>(clip, channelIndex);
+         dataCache->EnableBackgroundLoading(true);
 
          auto bitmapCache = std::make_unique<WaveBitmapCache>(
             clip, dataCache,